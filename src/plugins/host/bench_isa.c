@@ -0,0 +1,85 @@
+//-------------------------------------------------------------------------------------
+// ISA port access timing, see outp and friends in plugin.h
+//
+// Times the accessors against a memory mapped bus, a buffer here. Built
+// as bench_isa with the inlined direct path and as bench_isa_call with
+// MX_ISA_INLINE=0, where every access goes through the mxIsaOutp style
+// pointers to the outpb_isa functions of plugin.c, as it did before.
+//
+//  bench_isa [million calls], default 20
+//-------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "plugin_target.h"
+
+static uint8 bus[0x10000] __attribute__((aligned(4)));
+static volatile uint16 benchPort = 0x240;
+
+static uint64_t nanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static void report(const char* name, uint64_t t, uint32 calls)
+{
+    printf("%-12s %6.2f ns/call\n", name, (double)t / calls);
+}
+
+int main(int argc, char** argv)
+{
+    uint32 loops = ((argc > 1) ? atoi(argv[1]) : 20) * 1000000;
+
+    // the swapping bus of the Hades, Milan, Panther and Raven guesses
+    isabase = (uint32)bus;
+    mxIsaOutp = outpb_isa;
+    mxIsaOutpw = outpw_isa;
+    mxIsaInp = inpb_isa;
+    mxIsaInpw = inpw_isa;
+    mxIsaOutpBuf = outpb_buf_isa;
+    mxIsaOutpwBuf = outpw_buf_isa;
+    mxIsaDirect = isabase;
+    mxIsaDirectSwap = true;
+
+    printf("%s, %d million calls each\n", MX_ISA_INLINE ? "inline" : "function pointers", loops / 1000000);
+    uint16 port = benchPort;
+    uint32 sum = 0;
+    uint64_t t;
+
+    t = nanos();
+    for (uint32 i=0; i<loops; i++) {
+        outp(port + 0x103, (uint8)i);
+    }
+    report("outp", nanos() - t, loops);
+
+    t = nanos();
+    for (uint32 i=0; i<loops; i++) {
+        outpw(port + 0x104, (uint16)i);
+    }
+    report("outpw", nanos() - t, loops);
+
+    t = nanos();
+    for (uint32 i=0; i<loops; i++) {
+        sum += inp(port + 0x105);
+    }
+    report("inp", nanos() - t, loops);
+
+    t = nanos();
+    for (uint32 i=0; i<loops; i++) {
+        sum += inpw(port + 0x104);
+    }
+    report("inpw", nanos() - t, loops);
+
+    // a voice register write the way the InterWave tick does it
+    t = nanos();
+    for (uint32 i=0; i<loops; i+=3) {
+        outp(port + 0x102, (uint8)(i & 31));
+        outp(port + 0x103, 0x01);
+        outpw(port + 0x104, (uint16)i);
+    }
+    report("voice write", nanos() - t, loops - (loops % 3));
+
+    return (sum == 0x12345678) ? 1 : 0;
+}
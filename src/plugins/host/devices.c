@@ -0,0 +1,332 @@
+//-------------------------------------------------------------------------------------
+// Simulated ISA cards
+//
+// Just enough of each card for the drivers to detect and program it:
+//   InterWave at 0x240, registers and DRAM, no sound generation
+//   OPL3 at 0x388, registers and timer 1 for the detection
+//   MPU-401 at 0x330, acks for reset and uart mode
+//
+// Every access can be written to a trace file, one line each:
+//   <seconds> <r|w><b|w> <port> <value>
+//-------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+#include "host.h"
+
+enum {
+    DEV_IW = 0,
+    DEV_OPL,
+    DEV_MPU,
+    DEV_OTHER,
+    DEV_COUNT
+};
+
+static simDevStats devStats[DEV_COUNT] = {
+    { "interwave", 0, 0 },
+    { "opl3",      0, 0 },
+    { "mpu401",    0, 0 },
+    { "other",     0, 0 },
+};
+
+static FILE* traceFile = 0;
+
+static void trace(char dir, char width, uint16 port, uint16 data) {
+    if (traceFile) {
+        fprintf(traceFile, "%u.%09u %c%c %03x %04x\n",
+            (unsigned int)(simNow / 1000000000ULL), (unsigned int)(simNow % 1000000000ULL),
+            dir, width, (unsigned int)port, (unsigned int)data);
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// InterWave
+// ------------------------------------------------------------------------------------------
+#define IW_BASE     0x240
+#define IW_BANK     (4 * 1024 * 1024UL)
+
+uint32 simIwMemory = 1024 * 1024;
+
+static uint8* iwDram = 0;
+static uint8  iwVoice = 0;
+static uint8  iwSelect = 0;
+static uint16 iwVoiceRegs[32][32];
+static uint16 iwRegs[256];
+
+static bool iwMapped(uint32 addr) {
+    // banks of 4MB filled in order, the rest of each bank is unpopulated
+    uint32 bank = (addr >> 22) & 3;
+    uint32 size = (simIwMemory > (bank * IW_BANK)) ? (simIwMemory - (bank * IW_BANK)) : 0;
+    size = (size > IW_BANK) ? IW_BANK : size;
+    return (addr & (IW_BANK - 1)) < size;
+}
+
+static uint32 iwAddr() {
+    return ((uint32)(iwRegs[0x44] & 0xff) << 16) | iwRegs[0x43];
+}
+
+static void iwSetAddr(uint32 addr) {
+    iwRegs[0x43] = addr & 0xffff;
+    iwRegs[0x44] = (addr >> 16) & 0xff;
+}
+
+static uint8 iwPeek(uint32 addr) {
+    addr &= 0xffffff;
+    return iwMapped(addr) ? iwDram[addr] : 0xff;
+}
+
+static void iwPoke(uint32 addr, uint8 data) {
+    addr &= 0xffffff;
+    if (iwMapped(addr)) {
+        iwDram[addr] = data;
+    }
+}
+
+static uint16* iwReg(uint8 index) {
+    // voice registers are read back at index | 0x80
+    uint8 r = ((index & 0xe0) == 0x80) ? (index & 0x1f) : index;
+    return (r < 0x20) ? &iwVoiceRegs[iwVoice & 31][r] : &iwRegs[r];
+}
+
+static bool iwWrite(uint16 port, uint16 data, bool word) {
+    if (!iwDram) {
+        return false;
+    }
+    switch (port - IW_BASE) {
+        case 0x102:
+            iwVoice = data;
+            return true;
+        case 0x103:
+            iwSelect = data;
+            return true;
+        case 0x104:
+            if (iwSelect == 0x51) {
+                // dram word write, low byte first
+                uint32 addr = iwAddr();
+                iwPoke(addr + 0, data & 0xff);
+                iwPoke(addr + 1, data >> 8);
+                if (iwRegs[0x53] & 0x01) {
+                    iwSetAddr(addr + 2);
+                }
+            } else {
+                *iwReg(iwSelect) = word ? data : ((*iwReg(iwSelect) & 0xff00) | (data & 0xff));
+            }
+            return true;
+        case 0x105:
+            *iwReg(iwSelect) = data & 0xff;
+            return true;
+        case 0x107:
+            iwPoke(iwAddr(), data);
+            return true;
+        case 0x000: case 0x006: case 0x008: case 0x009: case 0x100:
+            return true;
+    }
+    return false;
+}
+
+static bool iwRead(uint16 port, uint16* data, bool word) {
+    if (!iwDram) {
+        return false;
+    }
+    switch (port - IW_BASE) {
+        case 0x102:
+            *data = iwVoice;
+            return true;
+        case 0x103:
+            *data = iwSelect;
+            return true;
+        case 0x104:
+            if (iwSelect == 0x51) {
+                uint32 addr = iwAddr();
+                *data = iwPeek(addr) | (iwPeek(addr + 1) << 8);
+                if (iwRegs[0x53] & 0x01) {
+                    iwSetAddr(addr + 2);
+                }
+            } else {
+                *data = word ? *iwReg(iwSelect) : (*iwReg(iwSelect) & 0xff);
+            }
+            return true;
+        case 0x105:
+            *data = *iwReg(iwSelect) & 0xff;
+            return true;
+        case 0x107:
+            *data = iwPeek(iwAddr());
+            return true;
+        case 0x000: case 0x006: case 0x008: case 0x009: case 0x100:
+            *data = 0;
+            return true;
+    }
+    return false;
+}
+
+// ------------------------------------------------------------------------------------------
+// OPL3
+// ------------------------------------------------------------------------------------------
+#define OPL_BASE    0x388
+
+static uint16 oplSelect = 0;
+static uint8  oplRegs[0x200];
+static uint8  oplFlags = 0;
+static uint64_t oplT1Start = 0;
+
+static uint8 oplStatus() {
+    // timer 1 counts up from its preset in 80us steps
+    uint8 ctrl = oplRegs[0x04];
+    if ((ctrl & 0x01) && !(ctrl & 0x40)) {
+        uint64_t len = (256 - oplRegs[0x02]) * 80000ULL;
+        if ((simNow - oplT1Start) >= len) {
+            oplFlags |= 0xC0;
+        }
+    }
+    return oplFlags;
+}
+
+static bool oplWrite(uint16 port, uint8 data) {
+    switch (port - OPL_BASE) {
+        case 0:
+            oplSelect = data;
+            return true;
+        case 2:
+            oplSelect = 0x100 | data;
+            return true;
+        case 1:
+        case 3:
+            if (oplSelect == 0x04) {
+                if (data & 0x80) {
+                    oplFlags = 0;
+                    return true;
+                }
+                if ((data & 0x01) && !(oplRegs[0x04] & 0x01)) {
+                    oplT1Start = simNow;
+                }
+                oplFlags &= (data & 0x40) ? ~0x40 : 0xff;
+                oplFlags &= (data & 0x20) ? ~0x20 : 0xff;
+                oplFlags = (oplFlags & 0x60) ? oplFlags : 0;
+            }
+            oplRegs[oplSelect] = data;
+            return true;
+    }
+    return false;
+}
+
+static bool oplRead(uint16 port, uint8* data) {
+    switch (port - OPL_BASE) {
+        case 0:
+            // the low bits are clear on an OPL3
+            *data = oplStatus();
+            return true;
+        case 1: case 2: case 3:
+            *data = 0xff;
+            return true;
+    }
+    return false;
+}
+
+// ------------------------------------------------------------------------------------------
+// MPU-401
+// ------------------------------------------------------------------------------------------
+#define MPU_BASE    0x330
+
+static uint8 mpuQueue[16];
+static uint8 mpuQueueLen = 0;
+
+static bool mpuWrite(uint16 port, uint8 data) {
+    switch (port - MPU_BASE) {
+        case 0:
+            return true;
+        case 1:
+            if (((data == 0xff) || (data == 0x3f)) && (mpuQueueLen < sizeof(mpuQueue))) {
+                mpuQueue[mpuQueueLen++] = 0xfe;
+            }
+            return true;
+    }
+    return false;
+}
+
+static bool mpuRead(uint16 port, uint8* data) {
+    switch (port - MPU_BASE) {
+        case 0:
+            *data = mpuQueueLen ? mpuQueue[0] : 0xff;
+            if (mpuQueueLen) {
+                memmove(&mpuQueue[0], &mpuQueue[1], --mpuQueueLen);
+            }
+            return true;
+        case 1:
+            // always ready for output, 0x80 is clear while input is pending
+            *data = mpuQueueLen ? 0x3f : 0xbf;
+            return true;
+    }
+    return false;
+}
+
+// ------------------------------------------------------------------------------------------
+// bus
+// ------------------------------------------------------------------------------------------
+void simDevInit(const char* tracename) {
+    traceFile = tracename ? fopen(tracename, "w") : 0;
+    if (tracename && !traceFile) {
+        fprintf(stderr, "cannot create %s\n", tracename);
+    }
+    if (simIwMemory) {
+        iwDram = __real_malloc(simIwMemory);
+        memset(iwDram, 0xff, simIwMemory);
+    }
+    iwRegs[0x5b] = 0x10;
+}
+
+void simDevClose() {
+    if (traceFile) {
+        fclose(traceFile);
+        traceFile = 0;
+    }
+    if (iwDram) {
+        __real_free(iwDram);
+        iwDram = 0;
+    }
+}
+
+int simDevStatsGet(simDevStats** stats) {
+    *stats = devStats;
+    return DEV_COUNT;
+}
+
+static void busWrite(uint16 port, uint16 data, bool word) {
+    int dev = iwWrite(port, data, word) ? DEV_IW :
+              (!word && oplWrite(port, data)) ? DEV_OPL :
+              (!word && mpuWrite(port, data)) ? DEV_MPU : DEV_OTHER;
+    devStats[dev].writes++;
+    trace('w', word ? 'w' : 'b', port, data);
+}
+
+static uint16 busRead(uint16 port, bool word) {
+    uint16 data = word ? 0xffff : 0xff;
+    uint8 data8;
+    int dev = DEV_OTHER;
+    if (iwRead(port, &data, word)) {
+        dev = DEV_IW;
+    } else if (!word && oplRead(port, &data8)) {
+        data = data8;
+        dev = DEV_OPL;
+    } else if (!word && mpuRead(port, &data8)) {
+        data = data8;
+        dev = DEV_MPU;
+    }
+    devStats[dev].reads++;
+    trace('r', word ? 'w' : 'b', port, data);
+    return data;
+}
+
+void simOutp(uint16 port, uint8 data) {
+    busWrite(port, data, false);
+}
+
+void simOutpw(uint16 port, uint16 data) {
+    busWrite(port, data, true);
+}
+
+uint8 simInp(uint16 port) {
+    return busRead(port, false);
+}
+
+uint16 simInpw(uint16 port) {
+    return busRead(port, true);
+}
@@ -0,0 +1,62 @@
+//-------------------------------------------------------------------------------------
+// Host simulation of the plugin environment
+//
+// plugin_host.c stands in for plugin.c, pluginA.S and the crt0 files with a
+// simulated clock, devices.c models the ISA cards and main.c replays what
+// mxPlay and Jam do with a plugin.
+//-------------------------------------------------------------------------------------
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "plugin.h"
+
+// -----------------------------------------------------------------------
+// clock and timer interrupts
+// -----------------------------------------------------------------------
+extern uint64_t simNow;                     // simulated time in ns
+extern uint32   simSlowdown;                // target cpu this many times slower than the host
+extern long     simCpu;                     // _CPU cookie
+extern long     simMch;                     // _MCH cookie
+
+extern uint64_t hostNanos();                // host cpu time in ns
+extern void     simRun(uint64_t ns);        // advance the clock, firing timer interrupts
+
+typedef struct {
+    uint32   calls;
+    uint32   skips;
+    uint64_t cpu;                           // host ns
+    uint64_t cpumax;
+} simIsrStats;
+extern simIsrStats simTimerStats;
+
+// -----------------------------------------------------------------------
+// heap accounting, the plugins allocate through the wrapped malloc
+// -----------------------------------------------------------------------
+extern uint32   simHeapNow;
+extern uint32   simHeapPeak;
+extern uint32   simHeapAllocs;
+extern void*    __real_malloc(size_t size);
+extern void     __real_free(void* ptr);
+
+// -----------------------------------------------------------------------
+// isa devices
+// -----------------------------------------------------------------------
+typedef struct {
+    const char* name;
+    uint32   reads;
+    uint32   writes;
+} simDevStats;
+
+extern uint32   simIwMemory;                // InterWave DRAM in bytes, 0 for no card
+extern void     simDevInit(const char* trace);
+extern void     simDevClose();
+extern int      simDevStatsGet(simDevStats** stats);
+
+extern void     simOutp(uint16 port, uint8 data);
+extern void     simOutpw(uint16 port, uint16 data);
+extern uint8    simInp(uint16 port);
+extern uint16   simInpw(uint16 port);
+
+#endif // _HOST_H_
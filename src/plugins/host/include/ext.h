@@ -0,0 +1,7 @@
+// host stand-in for libcmini ext.h, delays advance the simulated clock
+#ifndef _HOST_EXT_H_
+#define _HOST_EXT_H_
+
+void delay(unsigned long milliseconds);
+
+#endif // _HOST_EXT_H_
@@ -0,0 +1,8 @@
+// forced into every host compile, libcmini pulls these in from its own headers
+#ifndef _HOST_COMPAT_H_
+#define _HOST_COMPAT_H_
+
+#include <stdlib.h>
+#include <fcntl.h>
+
+#endif // _HOST_COMPAT_H_
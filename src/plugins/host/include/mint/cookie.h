@@ -0,0 +1,14 @@
+// host stand-in for the libcmini cookie jar, see host/plugin_host.c
+#ifndef _HOST_MINT_COOKIE_H_
+#define _HOST_MINT_COOKIE_H_
+
+#define C__CPU      0x5F435055L     /* Central Processor Unit Type */
+#define C__MCH      0x5F4D4348L     /* Machine Type */
+#define C__ISA      0x5F495341L     /* isa_bios */
+
+#define C_FOUND     0
+#define C_NOTFOUND  -1
+
+int Getcookie(long cookie, long *val);
+
+#endif // _HOST_MINT_COOKIE_H_
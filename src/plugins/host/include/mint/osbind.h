@@ -0,0 +1,35 @@
+// host stand-in for the gemdos calls the plugins use, files go to the host
+#ifndef _HOST_MINT_OSBIND_H_
+#define _HOST_MINT_OSBIND_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define FA_DIR              0x10
+
+static inline long Fopen(const char* name, short mode) {
+    int fd = open(name, (mode == 0) ? O_RDONLY : (mode == 1) ? O_WRONLY : O_RDWR);
+    return (fd < 0) ? -33 : fd;
+}
+static inline long Fcreate(const char* name, short attr) {
+    int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    return (fd < 0) ? -36 : fd;
+}
+static inline long Fread(short fh, long count, void* buf)         { return read(fh, buf, count); }
+static inline long Fwrite(short fh, long count, const void* buf)  { return write(fh, buf, count); }
+static inline long Fclose(short fh)                               { return close(fh); }
+static inline long Fdelete(const char* name)                      { return unlink(name); }
+static inline long Fattrib(const char* name, short rwflag, short attr) {
+    struct stat st;
+    return stat(name, &st) ? -33 : S_ISDIR(st.st_mode) ? FA_DIR : 0;
+}
+
+// gemdos without Mxalloc, the plugins fall back to malloc. Malloc only
+// answers how much is free, 16MB.
+static inline long Mxalloc(long size, short mode)                 { return -32; }
+static inline long Mfree(void* ptr)                               { return -40; }
+static inline long Malloc(long size)                              { return (size < 0) ? (16L << 20) : 0; }
+
+#endif // _HOST_MINT_OSBIND_H_
@@ -0,0 +1,228 @@
+//-------------------------------------------------------------------------------------
+// Host driver, plays a song through a plugin the way mxPlay or Jam would
+//
+//  host_<plugin>_<player> [options] <file>
+//    -t <seconds>      simulated play time, default 10
+//    -s <slowdown>     target cpu this many times slower than the host, default 0
+//    -r <file>         record isa port accesses
+//    -c <cpu>          _CPU cookie, default 30
+//    -m <kb>           InterWave DRAM, 0 for no card, default 1024
+//    -v                show plugin log messages (Jam)
+//    -n <file>         next song, switched to when the first one is done (Jam)
+//-------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+
+#define SIM_STEP_NS     20000000ULL     // the players poll at 50hz
+
+static uint32 optSeconds = 10;
+static const char* optTrace = 0;
+static const char* optFile = 0;
+static const char* optNext = 0;
+
+static uint8* fileLoad(const char* name, uint32* size) {
+    FILE* f = fopen(name, "rb");
+    if (!f) {
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8* buf = __real_malloc(*size + 4);
+    if (buf && (fread(buf, 1, *size, f) != *size)) {
+        __real_free(buf);
+        buf = 0;
+    }
+    fclose(f);
+    return buf;
+}
+
+static bool parseArgs(int argc, char** argv) {
+    for (int i=1; i<argc; i++) {
+        char* a = argv[i];
+        char* v = (i + 1 < argc) ? argv[i + 1] : 0;
+        if ((a[0] != '-') && !optFile) {
+            optFile = a;
+        } else if (!strcmp(a, "-v")) {
+            #ifdef PLUGIN_JAM
+            extern bool simVerbose;
+            simVerbose = true;
+            #endif
+        } else if (v && !strcmp(a, "-t")) {
+            optSeconds = atoi(v); i++;
+        } else if (v && !strcmp(a, "-s")) {
+            simSlowdown = atoi(v); i++;
+        } else if (v && !strcmp(a, "-r")) {
+            optTrace = v; i++;
+        } else if (v && !strcmp(a, "-c")) {
+            simCpu = atoi(v); i++;
+        } else if (v && !strcmp(a, "-m")) {
+            simIwMemory = atoi(v) * 1024; i++;
+        } else if (v && !strcmp(a, "-n")) {
+            optNext = v; i++;
+        } else {
+            return false;
+        }
+    }
+    return optFile != 0;
+}
+
+// ------------------------------------------------------------------------------------------
+// Jam
+// ------------------------------------------------------------------------------------------
+#ifdef PLUGIN_JAM
+extern uint32 jamMessageHandler(int32 param, int32 msg, void* data2, void* data1);
+
+static volatile uint16 nextSong;
+
+static void run() {
+    uint64_t end = simNow + (optSeconds * 1000000000ULL);
+    nextSong = 0;
+    while ((simNow < end) && !nextSong) {
+        simRun(SIM_STEP_NS);
+        jamMessageHandler(0, JAM_UPDATE, 0, 0);
+    }
+    if (nextSong) {
+        printf("finished\n");
+    }
+}
+
+static bool play(uint8* buf, uint32 size, uint8* next) {
+    static jamSongInfo info;
+    static jamSongInfo nextInfo;
+    jamPluginInfo* plugin = (jamPluginInfo*) jamMessageHandler(0, JAM_INFO, 0, 0);
+    printf("plugin:   %s\n", plugin->pluginName);
+    jamMessageHandler(0, JAM_INIT, 0, 0);
+    jamMessageHandler(0, JAM_SONG_NEXT_HOOK, 0, (void*)&nextSong);
+    jamMessageHandler(0, JAM_LOG_HOOK, 0, (void*)1);
+    jamMessageHandler(0, JAM_ALERT_HOOK, 0, (void*)1);
+    jamMessageHandler(0, JAM_ACTIVATE, 0, 0);
+
+    uint64_t t0 = hostNanos();
+    jamMessageHandler(0, JAM_SONGSELECT, 0, buf);
+    jamMessageHandler(0, JAM_SONGINFO, buf, &info);
+    jamMessageHandler(0, JAM_PLAY, 0, 0);
+    printf("song:     %s / %s\n", info.title, info.composer);
+    printf("load:     %.3f ms\n", (hostNanos() - t0) / 1000000.0);
+
+    run();
+    if (next) {
+        jamMessageHandler(0, JAM_STOP, 0, 0);
+        t0 = hostNanos();
+        jamMessageHandler(0, JAM_SONGSELECT, 0, next);
+        jamMessageHandler(0, JAM_SONGINFO, next, &nextInfo);
+        jamMessageHandler(0, JAM_PLAY, 0, 0);
+        printf("song:     %s / %s\n", nextInfo.title, nextInfo.composer);
+        printf("switch:   %.3f ms\n", (hostNanos() - t0) / 1000000.0);
+        run();
+    }
+    jamMessageHandler(0, JAM_STOP, 0, 0);
+    jamMessageHandler(0, JAM_DEACTIVATE, 0, 0);
+    jamMessageHandler(0, JAM_DEINIT, 0, 0);
+    return true;
+}
+#endif
+
+// ------------------------------------------------------------------------------------------
+// mxPlay
+// ------------------------------------------------------------------------------------------
+#ifdef PLUGIN_MXP
+extern struct SAudioPlugin mx_plugin;
+
+static bool play(uint8* buf, uint32 size, uint8* next) {
+    // mxPlay does not tell about the next module, next is not used
+    static struct SModuleParameter module;
+    printf("plugin:   %s\n", mx_plugin.pSInfo->pReplayName);
+    if (mx_plugin.Init() != MXP_OK) {
+        printf("init failed\n");
+        return false;
+    }
+
+    uint64_t t0 = hostNanos();
+    module.p = (char*) buf;
+    module.size = size;
+    mx_plugin.inBuffer.pModule = &module;
+    if (mx_plugin.RegisterModule() != MXP_OK) {
+        printf("register module failed\n");
+        return false;
+    }
+    mx_plugin.PlayTime();
+    uint32 playtime = mx_plugin.inBuffer.value;
+    mx_plugin.Songs();
+    uint32 songs = mx_plugin.inBuffer.value;
+    mx_plugin.inBuffer.value = 0;
+    if (mx_plugin.Set() != MXP_OK) {
+        printf("set failed\n");
+        mx_plugin.UnregisterModule();
+        return false;
+    }
+    printf("song:     %u ms, %u songs\n", (unsigned int)playtime, (unsigned int)songs);
+    printf("load:     %.3f ms\n", (hostNanos() - t0) / 1000000.0);
+
+    uint64_t end = simNow + (optSeconds * 1000000000ULL);
+    while (simNow < end) {
+        simRun(SIM_STEP_NS);
+        if (mx_plugin.Feed() != MXP_OK) {
+            printf("finished\n");
+            break;
+        }
+    }
+    mx_plugin.Unset();
+    mx_plugin.UnregisterModule();
+    return true;
+}
+#endif
+
+// ------------------------------------------------------------------------------------------
+int main(int argc, char** argv) {
+    if (!parseArgs(argc, argv)) {
+        printf("usage: %s [-t seconds] [-s slowdown] [-r trace] [-c cpu] [-m iwkb] [-v] [-n next] file\n", argv[0]);
+        return 1;
+    }
+
+    uint32 size = 0;
+    uint8* buf = fileLoad(optFile, &size);
+    if (!buf) {
+        printf("cannot read %s\n", optFile);
+        return 1;
+    }
+
+    uint32 nextSize = 0;
+    uint8* next = optNext ? fileLoad(optNext, &nextSize) : 0;
+    if (optNext && !next) {
+        printf("cannot read %s\n", optNext);
+        return 1;
+    }
+
+    simDevInit(optTrace);
+    bool ok = play(buf, size, next);
+    simDevClose();
+    __real_free(buf);
+    if (next) {
+        __real_free(next);
+    }
+
+    simDevStats* dev;
+    int devs = simDevStatsGet(&dev);
+    printf("time:     %.3f s\n", simNow / 1000000000.0);
+    printf("heap:     %u peak, %u leaked, %u allocations\n",
+        (unsigned int)simHeapPeak, (unsigned int)simHeapNow, (unsigned int)simHeapAllocs);
+    printf("timer:    %u calls, %.1f us avg, %.1f us max, %u skipped\n",
+        (unsigned int)simTimerStats.calls,
+        simTimerStats.calls ? (simTimerStats.cpu / 1000.0) / simTimerStats.calls : 0.0,
+        simTimerStats.cpumax / 1000.0,
+        (unsigned int)simTimerStats.skips);
+    for (int i=0; i<devs; i++) {
+        if (dev[i].reads || dev[i].writes) {
+            printf("io:       %-10s %u reads, %u writes\n", dev[i].name, (unsigned int)dev[i].reads, (unsigned int)dev[i].writes);
+        }
+    }
+#ifdef MX_PROFILE
+    for (int i=-1; i<MX_PROF_PROBES; i++) {
+        printf("profile:  %s\n", mxProfReport(i));
+    }
+#endif
+    return ok ? 0 : 1;
+}
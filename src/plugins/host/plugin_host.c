@@ -0,0 +1,416 @@
+//-------------------------------------------------------------------------------------
+// Host stand-in for plugin.c, pluginA.S and crt0_jam.S / crt0_mxp.S
+//
+// Timer A and the scheduler tasks run on a simulated clock that only moves
+// when simRun or one of the delay calls advances it. Interrupts fire from
+// simRun, never in the middle of plugin code. An interrupt occupies the
+// simulated cpu for its host cpu time times simSlowdown, ticks falling in
+// that window are dropped like the real vector does when it is locked.
+//-------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "host.h"
+#include "mint/cookie.h"
+
+uint64_t simNow = 0;
+uint32   simSlowdown = 0;
+long     simCpu = 30;
+long     simMch = 0x00030000;
+simIsrStats simTimerStats;
+
+#define NS_PER_SEC          1000000000ULL
+
+uint64_t hostNanos() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ((uint64_t)ts.tv_sec * NS_PER_SEC) + ts.tv_nsec;
+}
+
+// ------------------------------------------------------------------------------------------
+// cookies and system calls
+// ------------------------------------------------------------------------------------------
+int Getcookie(long cookie, long *val) {
+    switch (cookie) {
+        case C__CPU: *val = simCpu; return C_FOUND;
+        case C__MCH: *val = simMch; return C_FOUND;
+    }
+    return C_NOTFOUND;
+}
+
+void delay(unsigned long milliseconds) {
+    simNow += (uint64_t)milliseconds * 1000000;
+}
+
+uint16 mxDisableInterrupts() {
+    return 0;
+}
+
+void mxRestoreInterrupts(uint16 oldsr) {
+}
+
+// ------------------------------------------------------------------------------------------
+// heap accounting, linked with --wrap for malloc, calloc, realloc and free
+// ------------------------------------------------------------------------------------------
+uint32 simHeapNow = 0;
+uint32 simHeapPeak = 0;
+uint32 simHeapAllocs = 0;
+
+extern void* __real_realloc(void* ptr, size_t size);
+
+#define HEAP_HDR    16
+
+void* __wrap_malloc(size_t size) {
+    uint8* p = __real_malloc(size + HEAP_HDR);
+    if (!p) {
+        return 0;
+    }
+    *((size_t*)p) = size;
+    simHeapNow += size;
+    simHeapPeak = (simHeapNow > simHeapPeak) ? simHeapNow : simHeapPeak;
+    simHeapAllocs++;
+    return p + HEAP_HDR;
+}
+
+void __wrap_free(void* ptr) {
+    if (ptr) {
+        uint8* p = (uint8*)ptr - HEAP_HDR;
+        simHeapNow -= *((size_t*)p);
+        __real_free(p);
+    }
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    void* p = __wrap_malloc(n * size);
+    if (p) {
+        memset(p, 0, n * size);
+    }
+    return p;
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    if (!ptr) {
+        return __wrap_malloc(size);
+    }
+    uint8* p = (uint8*)ptr - HEAP_HDR;
+    size_t old = *((size_t*)p);
+    p = __real_realloc(p, size + HEAP_HDR);
+    if (!p) {
+        return 0;
+    }
+    *((size_t*)p) = size;
+    simHeapNow += size - old;
+    simHeapPeak = (simHeapNow > simHeapPeak) ? simHeapNow : simHeapPeak;
+    return p + HEAP_HDR;
+}
+
+// ------------------------------------------------------------------------------------------
+// Timer A
+// ------------------------------------------------------------------------------------------
+void(*mxTimerAFunc)(void) = 0;
+volatile uint32 mxTimerATicks = 0;
+volatile uint32 mxTimerALock = 0;
+volatile uint32 mxTimerAOld = 0;
+volatile uint32 mxTimerASkips = 0;
+volatile uint32 mxTimerAMissed = 0;
+static uint32 mxTimerALost = 0;
+
+void mxTimerAVec() {
+}
+
+static bool tasksActive = false;
+static void taskClear();
+
+void mxUnhookTimerA() {
+    mxTimerAFunc = 0;
+    taskClear();
+}
+
+bool mxDisableTimerA() {
+    if (mxTimerALock) {
+        return false;
+    }
+    mxTimerALock = 1;
+    return true;
+}
+
+void mxRestoreTimerA(bool enable) {
+    mxTimerALock = enable ? 0 : 1;
+}
+
+static uint64_t isrEnter() {
+    mxTimerATicks++;
+    mxTimerALock = 1;
+    mxTimerAMissed = mxTimerALost;
+    mxTimerALost = 0;
+    return hostNanos();
+}
+
+static uint64_t isrLeave(uint64_t t0) {
+    // the vector is locked for as long as the target would have been busy
+    uint64_t cost = hostNanos() - t0;
+    simTimerStats.calls++;
+    simTimerStats.cpu += cost;
+    simTimerStats.cpumax = (cost > simTimerStats.cpumax) ? cost : simTimerStats.cpumax;
+    mxTimerALock = 0;
+    return simNow + (cost * simSlowdown);
+}
+
+static void isrDropUntil(uint64_t* next, uint64_t period, uint64_t end) {
+    while (*next <= end) {
+        mxTimerATicks++;
+        mxTimerALost++;
+        mxTimerASkips++;
+        simTimerStats.skips++;
+        *next += period;
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// Timer A tasks
+// ------------------------------------------------------------------------------------------
+typedef struct {
+    void(*func)(void);
+    uint64_t period;                    // ns, 0 for one-shot
+    uint64_t deadline;
+    uint32 runs;
+    uint32 cpu;                         // MX_TIMESTAMP_HZ units
+} simTask;
+static simTask tasks[MX_TIMERTASKS];
+
+static void taskClear() {
+    for (int i=0; i<MX_TIMERTASKS; i++) {
+        tasks[i].func = 0;
+    }
+    tasksActive = false;
+}
+
+static uint64_t taskPeriod(uint32 period) {
+    return ((uint64_t)period * NS_PER_SEC) / ((uint64_t)MX_TIMESTAMP_HZ << 8);
+}
+
+int16 mxAddTimerTask(void(*func)(void), uint32 period, bool oneshot) {
+    if ((func == null) || (period == 0)) {
+        return -1;
+    }
+    if (!tasksActive) {
+        tasksActive = true;
+#ifdef MX_PROFILE
+        mxProfReset();
+#endif
+    }
+    for (int i=0; i<MX_TIMERTASKS; i++) {
+        if (tasks[i].func == null) {
+            tasks[i].period = oneshot ? 0 : taskPeriod(period);
+            tasks[i].deadline = simNow + taskPeriod(period);
+            tasks[i].runs = 0;
+            tasks[i].cpu = 0;
+            tasks[i].func = func;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void mxSetTimerTaskPeriod(int16 task, uint32 period) {
+    if ((task >= 0) && (task < MX_TIMERTASKS) && tasks[task].period && period) {
+        uint64_t p = taskPeriod(period);
+        tasks[task].deadline = tasks[task].deadline - tasks[task].period + p;
+        tasks[task].period = p;
+    }
+}
+
+void mxRemoveTimerTask(int16 task) {
+    if ((task >= 0) && (task < MX_TIMERTASKS)) {
+        tasks[task].func = null;
+    }
+    // the target scheduler unhooks once it finds no tasks left
+    bool idle = true;
+    for (int i=0; i<MX_TIMERTASKS; i++) {
+        idle = tasks[i].func ? false : idle;
+    }
+    tasksActive = idle ? false : tasksActive;
+}
+
+#ifdef MX_PROFILE
+uint32 mxTimerTaskUsage(int16 task, uint32* runs) {
+    if ((task < 0) || (task >= MX_TIMERTASKS)) {
+        return 0;
+    }
+    if (runs) {
+        *runs = tasks[task].runs;
+    }
+    return tasks[task].cpu;
+}
+#endif
+
+static void taskRun(simTask* t) {
+    void(*func)(void) = t->func;
+    uint32 missed = 0;
+    if (t->period) {
+        t->deadline += t->period;
+        while (t->deadline <= simNow) {
+            if (++missed == MX_TASK_CATCHUP) {
+                t->deadline = simNow + t->period;
+                break;
+            }
+            t->deadline += t->period;
+        }
+    } else {
+        t->func = null;
+    }
+    uint64_t t0 = isrEnter();
+    mxTimerAMissed = missed;
+    MX_PROF_BEGIN(MX_PROF_VEC);
+    func();
+    MX_PROF_END(MX_PROF_VEC);
+    uint64_t cost = hostNanos() - t0;
+    uint64_t end = isrLeave(t0);
+    t->cpu += (uint32)(((cost * simSlowdown) * MX_TIMESTAMP_HZ) / NS_PER_SEC);
+    t->runs++;
+    for (int i=0; i<MX_TIMERTASKS; i++) {
+        if (tasks[i].func && tasks[i].period) {
+            isrDropUntil(&tasks[i].deadline, tasks[i].period, end);
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// clock
+// ------------------------------------------------------------------------------------------
+void simRun(uint64_t ns) {
+    uint64_t end = simNow + ns;
+    while (1) {
+        // next event, the earliest task
+        uint64_t next = end + 1;
+        simTask* task = 0;
+        for (int i=0; i<MX_TIMERTASKS; i++) {
+            if (tasks[i].func && (tasks[i].deadline < next)) {
+                next = tasks[i].deadline;
+                task = &tasks[i];
+            }
+        }
+        if (next > end) {
+            break;
+        }
+        simNow = (next > simNow) ? next : simNow;
+        taskRun(task);
+    }
+    simNow = (end > simNow) ? end : simNow;
+}
+
+uint32 mxTimestamp() {
+    return (uint32)((simNow * MX_TIMESTAMP_HZ) / NS_PER_SEC);
+}
+
+void mxCalibrateDelay() {
+}
+
+void mxDelay(uint32 us) {
+    simNow += (uint64_t)us * 1000;
+}
+
+// ------------------------------------------------------------------------------------------
+// isa
+// ------------------------------------------------------------------------------------------
+uint32 mxIsaDirect = 0;
+bool mxIsaDirectSwap = false;
+void(*mxIsaOutp)(uint16 port, uint8 data) = simOutp;
+void(*mxIsaOutpw)(uint16 port, uint16 data) = simOutpw;
+uint8(*mxIsaInp)(uint16 port) = simInp;
+uint16(*mxIsaInpw)(uint16 port) = simInpw;
+
+static void simOutpBuf(uint16 port, const uint8* buf, int count) {
+    while (count--) {
+        simOutp(port, *buf++);
+    }
+}
+
+static void simOutpwBuf(uint16 port, const uint16* buf, int count) {
+    while (count--) {
+        simOutpw(port, *buf++);
+    }
+}
+
+void(*mxIsaOutpBuf)(uint16 port, const uint8* buf, int count) = simOutpBuf;
+void(*mxIsaOutpwBuf)(uint16 port, const uint16* buf, int count) = simOutpwBuf;
+
+uint32 mxIsaInit() {
+    // any non zero base, the ports never touch memory on the host
+    return 0x00F00000;
+}
+
+uint16 mxIsaPort(const char* dev_id, uint8 dev_idx, uint8 port_idx, uint16 fallback) {
+    return fallback;
+}
+
+uint8 mxIsaIrq(const char* dev_id, uint8 dev_idx, uint8 irq_idx, uint8 fallback) {
+    return fallback;
+}
+
+bool mxHookIsaInterrupt(void(*func)(void), uint16 inum) {
+    // no isa_bios, the drivers fall back to Timer A
+    return false;
+}
+
+void mxUnhookIsaInterrupt() {
+}
+
+// ------------------------------------------------------------------------------------------
+// crt0
+// ------------------------------------------------------------------------------------------
+#ifdef PLUGIN_JAM
+uint32 jamLibInited = 0;
+uint32 jamHookLog = 0;
+uint32 jamHookAlert = 0;
+uint32 jamHookNextSong = 0;
+bool simVerbose = false;
+
+void jamCallHookLog(char* msg) {
+    if (simVerbose) {
+        fputs(msg, stdout);
+    }
+}
+
+void jamCallHookAlert(char* msg) {
+    fputs(msg, stdout);
+}
+
+void jamCallHookNextSong() {
+}
+#endif
+
+#ifdef PLUGIN_MXP
+extern int mx_register_module();
+extern int mx_get_playtime();
+extern int mx_get_songs();
+extern int mx_init();
+extern int mx_set();
+extern int mx_feed();
+extern int mx_unset();
+extern int mx_unregister_module();
+extern int mx_pause();
+extern int mx_mute();
+extern const struct SInfo mx_info;
+extern const struct SExtension mx_extensions[];
+extern const struct SParameter mx_settings[];
+
+struct SAudioPlugin mx_plugin = {
+    { 'M', 'X', 'P', '2' },
+    { 0 },
+    mx_register_module,
+    mx_get_playtime,
+    mx_get_songs,
+    mx_init,
+    mx_set,
+    mx_feed,
+    mx_unset,
+    mx_unregister_module,
+    mx_pause,
+    mx_mute,
+    (struct SInfo*) &mx_info,
+    (struct SExtension*) mx_extensions,
+    (struct SParameter*) mx_settings,
+};
+#endif
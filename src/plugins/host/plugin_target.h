@@ -0,0 +1,32 @@
+//-------------------------------------------------------------------------------------
+// plugin.c itself, for the benchmarks that time its routines
+//
+// plugin_host.c replaces it in the host builds. The MFP and BIOS calls
+// it makes are stubbed out here along with pluginA.S, nothing that uses
+// them may be called.
+//-------------------------------------------------------------------------------------
+#ifndef _HOST_PLUGIN_TARGET_H_
+#define _HOST_PLUGIN_TARGET_H_
+
+#define MFP_TIMERA          13
+#define XB_TIMERA           0
+#define Jdisint(i)
+#define Jenabint(i)
+#define Setexc(v, f)        0
+#define Xbtimer(t, c, d, f)
+#include "plugin.c"
+
+// pluginA.S, libcmini and the cookie jar
+void(*mxTimerAFunc)(void);
+volatile uint32 mxTimerATicks;
+volatile uint32 mxTimerALock;
+volatile uint32 mxTimerAOld;
+volatile uint32 mxTimerASkips;
+volatile uint32 mxTimerAMissed;
+volatile uint32 mxTimerALost;
+void mxTimerAVec() { }
+int mxTimerAVecLock() { return 0; }
+int Getcookie(long cookie, long *val) { return C_NOTFOUND; }
+void delay(unsigned long milliseconds) { }
+
+#endif // _HOST_PLUGIN_TARGET_H_
@@ -0,0 +1,81 @@
+//-------------------------------------------------------------------------------------
+// InterWave voice frequency test, see calcfc in devwiw.c
+//
+// Runs calcfc over every mcpCPitch note, the mcpCPitch6848 periods and
+// a spread of mcpCPitchFix values for several sample rates and master
+// pitches on both chip types, and compares each result with the
+// expression it replaced. Exits non zero on the first few mismatches.
+//-------------------------------------------------------------------------------------
+#include <stdio.h>
+#include "mod/ims/devw/devwiw.c"
+
+static const unsigned long rates[] = { 1000, 4181, 8363, 11025, 16726, 22050, 33452, 44100, 48000, 96000 };
+static const unsigned short masters[] = { 1, 128, 256, 300, 512, 4096, 0xffff };
+static const unsigned char chans[] = { 14, 24, 32 };
+
+static unsigned long tested = 0;
+static unsigned long failed = 0;
+
+static unsigned long reference(const iwchan* c)
+{
+    unsigned long b=c->samprate*masterfreq;
+    if (iwType == GUSTYPE_AMD) {
+        return umuldivrnd(c->orgfreq, b, c->orgdiv)/11025;
+    }
+    return umuldivrnd(umuldivrnd(c->orgfreq, b, c->orgdiv), activechans, 154350);
+}
+
+static void check(iwchan* c, unsigned long freq, unsigned long div)
+{
+    c->orgfreq=freq;
+    c->orgdiv=div;
+    unsigned long want=reference(c);
+    // the second call takes the cached value
+    for (int i=0; i<2; i++) {
+        unsigned long got=calcfc(c);
+        tested++;
+        if (got != want) {
+            if (failed++ < 8) {
+                printf("mismatch: type %d chans %d rate %lu master %u freq %lu div %lu: %lu, want %lu\n",
+                    iwType, activechans, c->samprate, masterfreq, freq, div, got, want);
+            }
+        }
+    }
+}
+
+static void sweep(iwchan* c)
+{
+    for (int note=-0x8000; note<0x8000; note++) {
+        unsigned long div=mcpGetFreq8363(-note);
+        check(c, 8363, div ? div : 256);
+        // alternating with another base frequency drops the cached terms
+        check(c, 6848, (note & 0xffff) ? (note & 0xffff) : 256);
+    }
+    for (unsigned long f=1; f<0x1000000; f+=(f>>4)+1) {
+        check(c, f, 0x10000);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    iwchan c;
+    for (int type=GUSTYPE_GF1; type<=GUSTYPE_AMD; type++) {
+        iwType=type;
+        for (int n=0; n<sizeof(chans)/sizeof(chans[0]); n++) {
+            activechans=chans[n];
+            if ((type == GUSTYPE_AMD) && n) {
+                break;
+            }
+            for (int r=0; r<sizeof(rates)/sizeof(rates[0]); r++) {
+                for (int m=0; m<sizeof(masters)/sizeof(masters[0]); m++) {
+                    memset(&c, 0, sizeof(c));
+                    c.samprate=rates[r];
+                    masterfreq=masters[m];
+                    sweep(&c);
+                }
+            }
+        }
+    }
+    printf("calcfc: %lu values, %lu mismatches\n", tested, failed);
+    return failed ? 1 : 0;
+}
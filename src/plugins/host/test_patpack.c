@@ -0,0 +1,116 @@
+//-------------------------------------------------------------------------------------
+// Packed pattern test, see xmpPackPattern and xmpUnpackRow in xmrtns.c
+//
+// Packs synthetic patterns of several densities and shapes, unpacks
+// every row again and compares it with the source. Also reports the
+// packed size against the 5 bytes per cell the patterns took before, for
+// the shapes songs use: 64 to 256 rows of 4 to 64 channels.
+//-------------------------------------------------------------------------------------
+#include <stdio.h>
+#include <string.h>
+#include "mod/ims/core/arena.h"
+#include "mod/ims/playxm/xmplay.h"
+
+static unsigned long seed = 1;
+static int failed = 0;
+
+static unsigned long rnd(unsigned long n)
+{
+    seed = seed * 1103515245 + 12345;
+    return ((seed >> 8) & 0xffffff) % n;
+}
+
+// percent of cells with a note, volume column and effect
+typedef struct { const char* name; int note; int vol; int fx; } profile;
+static const profile profiles[] = {
+    { "empty",      0,   0,   0 },
+    { "sparse",     15,  5,   10 },
+    { "typical",    30,  25,  25 },
+    { "busy",       60,  50,  60 },
+    { "full",       100, 100, 100 },
+    { "noise",      -1,  -1,  -1 },      // every byte random
+};
+
+static void makepattern(unsigned char (*p)[5], int cells, const profile* pr)
+{
+    for (int i=0; i<cells; i++) {
+        if (pr->note < 0) {
+            for (int k=0; k<5; k++) {
+                p[i][k] = rnd(256);
+            }
+            continue;
+        }
+        memset(p[i], 0, 5);
+        if (rnd(100) < pr->note) {
+            p[i][0] = rnd(97) + 1;
+            p[i][1] = rnd(32) + 1;
+        }
+        if (rnd(100) < pr->vol) {
+            p[i][2] = rnd(0x50) + 0x10;
+        }
+        if (rnd(100) < pr->fx) {
+            p[i][3] = rnd(36);
+            p[i][4] = rnd(256);
+        }
+    }
+}
+
+static void roundtrip(const profile* pr, int rows, int nchan, unsigned long* raw, unsigned long* packed)
+{
+    unsigned char (*src)[5] = malloc(rows * nchan * 5);
+    unsigned char (*row)[5] = malloc(nchan * 5);
+    arena ar;
+    ar_init(&ar, 0);
+    makepattern(src, rows * nchan, pr);
+
+    unsigned long size = 0;
+    unsigned char* pat = xmpPackPattern(&ar, src, rows, nchan, &size);
+    if (!pat) {
+        printf("%s %dx%d: pack failed\n", pr->name, rows, nchan);
+        failed++;
+    } else {
+        for (int r=0; r<rows; r++) {
+            xmpUnpackRow(pat, r, nchan, row);
+            if (memcmp(row, src[r * nchan], nchan * 5)) {
+                if (failed++ < 8) {
+                    printf("%s %dx%d: row %d differs\n", pr->name, rows, nchan, r);
+                }
+            }
+        }
+        if ((rows >= 64) && (nchan >= 4)) {
+            *raw += rows * nchan * 5;
+            *packed += size;
+        }
+    }
+    ar_free(&ar);
+    free(row);
+    free(src);
+}
+
+int main(int argc, char** argv)
+{
+    static const int chans[] = { 1, 4, 8, 16, 32, 64 };
+    static const int rows[] = { 1, 16, 64, 128, 256 };
+    printf("%-10s %10s %10s %6s\n", "profile", "5 bytes", "packed", "ratio");
+    for (int p=0; p<sizeof(profiles)/sizeof(profiles[0]); p++) {
+        unsigned long raw = 0;
+        unsigned long packed = 0;
+        for (int c=0; c<sizeof(chans)/sizeof(chans[0]); c++) {
+            for (int r=0; r<sizeof(rows)/sizeof(rows[0]); r++) {
+                roundtrip(&profiles[p], rows[r], chans[c], &raw, &packed);
+            }
+        }
+        printf("%-10s %10lu %10lu %5lu%%\n", profiles[p].name, raw, packed, raw ? (packed * 100 + raw / 2) / raw : 0);
+    }
+    // a pattern without rows has no row table
+    arena ar;
+    ar_init(&ar, 0);
+    unsigned char cell[1][5] = { { 0 } };
+    if (xmpPackPattern(&ar, cell, 0, 1, 0)) {
+        printf("0 rows: packed\n");
+        failed++;
+    }
+    ar_free(&ar);
+    printf("patterns: %d failures\n", failed);
+    return failed ? 1 : 0;
+}
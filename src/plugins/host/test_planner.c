@@ -0,0 +1,134 @@
+//-------------------------------------------------------------------------------------
+// Sample reduction planner test, see planreduce in smpman.c
+//
+// Runs the planner on synthetic samples with made up usage statistics
+// and checks which reduction it picked:
+//  - a sample the song never triggers is dropped before anything else
+//  - without usage statistics nothing is dropped
+//  - halving a sample comes first, even when it is the most used one,
+//    when all it cuts off is played above the output nyquist
+//-------------------------------------------------------------------------------------
+#include <stdio.h>
+#include "mod/ims/dev/smpman.c"
+
+#define TESTLEN     16384
+
+static int failed = 0;
+
+static void makesample(sampleinfo *s, unsigned long rate, unsigned long seed)
+{
+    memset(s, 0, sizeof(*s));
+    s->type=0;
+    s->length=TESTLEN;
+    s->samprate=rate;
+    s->ptr=malloc(TESTLEN+SAMPEND);
+    // noise, so halving the rate has a measurable cost
+    unsigned char *p=(unsigned char*)s->ptr;
+    for (int i=0; i<TESTLEN+SAMPEND; i++) {
+        seed=seed*1103515245+12345;
+        p[i]=(seed>>16)&0xff;
+    }
+}
+
+static void expect(const char *test, sampleinfo *s, int i, unsigned long length, unsigned long rate)
+{
+    if ((s[i].length!=length)||(s[i].samprate!=rate)) {
+        printf("%s: sample %d is %lu at %lu hz, want %lu at %lu hz\n",
+            test, i, (unsigned long)s[i].length, (unsigned long)s[i].samprate, length, rate);
+        failed++;
+    }
+}
+
+static void release(sampleinfo *s, int n)
+{
+    for (int i=0; i<n; i++) {
+        free(s[i].ptr);
+    }
+}
+
+static void testdrop()
+{
+    // three samples, room for two, the middle one is never played
+    sampleinfo s[3];
+    sampleusage use[3]={ { 10, 0 }, { 0, 0 }, { 5, 0 } };
+    for (int i=0; i<3; i++) {
+        makesample(&s[i], 8363, i+1);
+    }
+    mcpSampUsage=use;
+    if (!planreduce(s, 3, 2*(TESTLEN+SAMPEND)+100, 0)) {
+        printf("drop: no plan\n");
+        failed++;
+    }
+    expect("drop", s, 0, TESTLEN, 8363);
+    expect("drop", s, 1, 0, 8363);
+    expect("drop", s, 2, TESTLEN, 8363);
+    mcpSampUsage=0;
+    release(s, 3);
+}
+
+static void testnousage()
+{
+    // the same without statistics, a sample is halved instead
+    sampleinfo s[3];
+    for (int i=0; i<3; i++) {
+        makesample(&s[i], 8363, i+1);
+    }
+    mcpSampUsage=0;
+    if (!planreduce(s, 3, 2*(TESTLEN+SAMPEND)+100, 0)) {
+        printf("no usage: no plan\n");
+        failed++;
+    }
+    int dropped=0;
+    unsigned long total=0;
+    for (int i=0; i<3; i++) {
+        dropped+=(s[i].length==0);
+        total+=s[i].length+SAMPEND;
+    }
+    if (dropped||(total>2*(TESTLEN+SAMPEND)+100)) {
+        printf("no usage: %d dropped, %lu bytes\n", dropped, total);
+        failed++;
+    }
+    release(s, 3);
+}
+
+static void testnyquist()
+{
+    // sample 0 is played a lot, at 48000 hz an octave up, so the band
+    // above 12000 hz that halving cuts lands above 22050 hz. sample 1 is
+    // rarely played at its 8363 hz. one of them has to be halved.
+    sampleinfo s[2];
+    sampleusage use[2]={ { 100, 12<<8 }, { 1, 0 } };
+    makesample(&s[0], 48000, 1);
+    makesample(&s[1], 8363, 2);
+    mcpSampUsage=use;
+    if (!planreduce(s, 2, 2*(TESTLEN+SAMPEND)-1000, 0)) {
+        printf("nyquist: no plan\n");
+        failed++;
+    }
+    expect("nyquist", s, 0, TESTLEN/2, 24000);
+    expect("nyquist", s, 1, TESTLEN, 8363);
+
+    // with sample 0 played at its own rate the rarely used one goes first
+    release(s, 2);
+    use[0].maxpitch=0;
+    makesample(&s[0], 16726, 1);
+    makesample(&s[1], 8363, 2);
+    if (!planreduce(s, 2, 2*(TESTLEN+SAMPEND)-1000, 0)) {
+        printf("nyquist: no plan\n");
+        failed++;
+    }
+    expect("below nyquist", s, 0, TESTLEN, 16726);
+    expect("below nyquist", s, 1, TESTLEN/2, 4181);
+    mcpSampUsage=0;
+    release(s, 2);
+}
+
+int main(int argc, char** argv)
+{
+    mcpSampBanks[0]=0;
+    testdrop();
+    testnousage();
+    testnyquist();
+    printf("planner: %d failures\n", failed);
+    return failed ? 1 : 0;
+}
@@ -46,10 +46,13 @@
 
 // -----------------------------------------------------------------------
 static MD_MIDIFile* midi = 0;
+static MD_MIDIFile* midiNext = 0;       // song opened ahead of time, see jamOnPreload
+static uint8* midiNextPtr = 0;
 static void (*midiWrite)(uint8* buf, uint16 size) = 0;
 static uint32 midiTimerTargetHz;
-static uint32 midiTimerRealHz;
 static uint32 midiMicrosPerTick;
+static volatile uint32 midiTicks;
+static int16 midiTimerTask = -1;
 static uint16 savBuf[23*2*12];
 
 // -----------------------------------------------------------------------
@@ -145,25 +148,58 @@ void midiSysexHandler(MD_sysex_event *pev) {
 }
 
 static void midiUpdate_timerA() {
+    midiTicks += 1 + mxTimerAMissed;
     if (midi) {
-        MD_Update(midi, mxTimerATicks * midiMicrosPerTick);
+        MX_PROF_BEGIN(MX_PROF_PLAYER);
+        MD_Update(midi, midiTicks * midiMicrosPerTick);
+        MX_PROF_END(MX_PROF_PLAYER);
     }
 }
 
+static void midiStartTimer() {
+    // a scheduler task so other timer clients can run alongside
+    if (midiTimerTask < 0) {
+        midiMicrosPerTick = 1000000 / midiTimerTargetHz;
+        midiTimerTask = mxAddTimerTask(midiUpdate_timerA, MX_TASK_PERIOD(midiTimerTargetHz), false);
+    }
+}
+
+static void midiStopTimer() {
+    mxRemoveTimerTask(midiTimerTask);
+    midiTimerTask = -1;
+}
+
 static void midiUnload() {
     if (midi) {
-        mxUnhookTimerA();
+        midiStopTimer();
         MD_Close(midi);
         midi = null;
     }
 }
 
+static void midiDrop() {
+    // never played, nothing to silence
+    if (midiNext) {
+        mxFree(midiNext);
+    }
+    midiNext = null;
+    midiNextPtr = null;
+}
+
 static bool midiLoad(uint8* buf) {
     midiUnload();
-    midi = MD_OpenBuffer(buf);
+    if (buf && (buf == midiNextPtr)) {
+        midi = midiNext;
+        midiNext = null;
+        midiNextPtr = null;
+    } else {
+        midiDrop();
+        midi = MD_OpenBuffer(buf);
+    }
     if (midi) {
         midi->_midiHandler = midiEventHandler;
         midi->_sysexHandler = midiSysexHandler;
+        dbg("mem: %s", mxMemReport());
     }
     return midi ? true : false;
 }
@@ -171,6 +207,8 @@ static bool midiLoad(uint8* buf) {
 
 static bool pluginInit() {
     midi = 0;
+    midiNext = 0;
+    midiNextPtr = 0;
     midiWrite = 0;
 
     // pick a timer frequency based on cpu model
@@ -239,6 +277,7 @@ const struct SExtension mx_extensions[] = {
 };
 
 const struct SParameter mx_settings[] = {
+    MX_PROF_PARAMETER
     { NULL, 0, NULL, NULL }
 };
 
@@ -265,8 +304,7 @@ int mx_get_songs() {
 
 int mx_set() {
     if (midi) {
-        midiTimerRealHz = mxHookTimerA(midiUpdate_timerA, midiTimerTargetHz);
-        midiMicrosPerTick = 1000000 / midiTimerRealHz;
+        midiStartTimer();
         MD_Restart(midi);
         return MXP_OK;
     }
@@ -276,7 +314,7 @@ int mx_set() {
 int mx_unset() {
     if (midi) {
         MD_Pause(midi, true);
-        mxUnhookTimerA();
+        midiStopTimer();
         return MXP_OK;
     }
     return MXP_ERROR;
@@ -343,8 +381,8 @@ jamPluginInfo info = {
     0x1F,                       // support
     0,                          // datastart
     1,                          // supportsNextSongHook
-    0,                          // supportsName
-    0,                          // supportsComposer
+    1,                          // supportsName
+    1,                          // supportsComposer
     1,                          // supportsSongCount
     1,                          // supportsPreselect
     0,                          // supportsComment
@@ -363,10 +401,133 @@ void jamOnPluginStop() {
     midiUnload();
 }
 
+static uint32 rd32be(const uint8* p) {
+    return ((uint32)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static const uint8* smfVarLen(const uint8* p, const uint8* end, uint32* v) {
+    *v = 0;
+    while (p < end) {
+        uint8 c = *p++;
+        *v = (*v << 7) | (c & 0x7F);
+        if (!(c & 0x80)) {
+            break;
+        }
+    }
+    return p;
+}
+
+static void smfText(char* out, const uint8* in, uint32 len) {
+    uint32 n = (len < 255) ? len : 255;
+    for (uint32 i = 0; i < n; i++) {
+        out[i] = ((in[i] < 0x20) || (in[i] > 0x7E)) ? ' ' : in[i];
+    }
+    out[n] = 0;
+}
+
+bool jamOnProbe(uint8* songData, jamSongInfo* songInfo) {
+    // a walk over the events for meta text and length, nothing is sent
+    static struct { uint32 tick; uint32 tempo; } tempos[64];
+    int ntempos = 0;
+    if (memcmp(songData, "MThd", 4) != 0) {
+        return false;
+    }
+    uint16 ntracks = (songData[10] << 8) | songData[11];
+    int16 division = (songData[12] << 8) | songData[13];
+    const uint8* p = songData + 8 + rd32be(&songData[4]);
+    songInfo->title[0] = 0;
+    songInfo->composer[0] = 0;
+
+    uint32 endtick = 0;
+    for (uint16 t = 0; (t < ntracks) && (memcmp(p, "MTrk", 4) == 0); t++) {
+        const uint8* q = p + 8;
+        const uint8* end = q + rd32be(&p[4]);
+        p = end;
+        uint32 tick = 0;
+        uint8 status = 0;
+        while (q < end) {
+            uint32 dt, len;
+            q = smfVarLen(q, end, &dt);
+            tick += dt;
+            if (q >= end) {
+                break;
+            }
+            if (*q == 0xFF) {
+                uint8 type = q[1];
+                q = smfVarLen(q + 2, end, &len);
+                if (type == 0x2F) {
+                    break;
+                }
+                // the tempo map is in the first track
+                if ((type == 0x51) && (len == 3) && (t == 0) && (ntempos < 64)) {
+                    tempos[ntempos].tick = tick;
+                    tempos[ntempos].tempo = (q[0] << 16) | (q[1] << 8) | q[2];
+                    ntempos++;
+                } else if ((type == 0x03) && (t == 0) && !songInfo->title[0]) {
+                    smfText(songInfo->title, q, len);
+                } else if ((type == 0x02) && !songInfo->composer[0]) {
+                    smfText(songInfo->composer, q, len);
+                }
+                q += len;
+            } else if ((*q == 0xF0) || (*q == 0xF7)) {
+                q = smfVarLen(q + 1, end, &len);
+                q += len;
+            } else {
+                if (*q & 0x80) {
+                    status = *q++;
+                } else if (!status) {
+                    break;
+                }
+                q += (((status & 0xF0) == 0xC0) || ((status & 0xF0) == 0xD0)) ? 1 : 2;
+            }
+        }
+        if (tick > endtick) {
+            endtick = tick;
+        }
+    }
+
+    uint32 ms = 0;
+    if (division < 0) {
+        // smpte, frames per second times ticks per frame
+        uint32 tps = (uint32)(-(division >> 8)) * (division & 0xFF);
+        ms = tps ? ((endtick / tps) * 1000) : 0;
+    } else if (division > 0) {
+        uint32 tempo = 500000;
+        uint32 last = 0;
+        for (int i = 0; i <= ntempos; i++) {
+            uint32 tick = (i < ntempos) ? tempos[i].tick : endtick;
+            tick = (tick < endtick) ? tick : endtick;
+            uint32 d = (tick > last) ? (tick - last) : 0;
+            ms += ((d / division) * (tempo / 1000)) + (((d % division) * (tempo / 1000)) / division);
+            last = (tick > last) ? tick : last;
+            if (i < ntempos) {
+                tempo = tempos[i].tempo;
+            }
+        }
+    }
+    songInfo->playtime_min[0] = (ms / 1000) / 60;
+    songInfo->playtime_sec[0] = (ms / 1000) % 60;
+    songInfo->isYMsong = 1;
+    songInfo->songCount = 1;
+    return true;
+}
+
 void jamOnLoad(uint8* songData) {
     midiLoad(songData);
 }
 
+void jamOnPreload(uint8* songData) {
+    // parse the headers of the next song while this one plays
+    if (songData != midiNextPtr) {
+        midiDrop();
+    }
+    if ((songData == null) || midiNext || !mxMemRoom(sizeof(MD_MIDIFile))) {
+        return;
+    }
+    midiNext = MD_OpenBuffer(songData);
+    midiNextPtr = midiNext ? songData : null;
+}
+
 void jamOnInfo(jamSongInfo* songInfo) {
     songInfo->isYMsong = 1;
     songInfo->songCount = 0;
@@ -377,8 +538,7 @@ void jamOnInfo(jamSongInfo* songInfo) {
 
 void jamOnPlay() {
     if (midi) {
-        midiTimerRealHz = mxHookTimerA(midiUpdate_timerA, midiTimerTargetHz);
-        midiMicrosPerTick = 1000000 / midiTimerRealHz;
+        midiStartTimer();
         MD_Restart(midi);
     }
 }
@@ -386,7 +546,7 @@ void jamOnPlay() {
 void jamOnStop() {
     if (midi) {
         MD_Pause(midi, true);
-        mxUnhookTimerA();
+        midiStopTimer();
     }
 }
 
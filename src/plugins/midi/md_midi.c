@@ -778,7 +778,7 @@ MD_MIDIFile* MD_OpenFile(const char* filename) {
     }
     int32 fsize = lseek(fhandle, 0, SEEK_END);
     lseek(fhandle, 0, SEEK_SET);
-    MD_MIDIFile* mf = malloc(sizeof(MD_MIDIFile) + fsize);
+    MD_MIDIFile* mf = mxAlloc(sizeof(MD_MIDIFile) + fsize, MX_MEM_SONG);
     if (!mf) {
         err("Failed to allocate midi file");
         close(fhandle);
@@ -792,14 +792,14 @@ MD_MIDIFile* MD_OpenFile(const char* filename) {
     close(fhandle);
     if (!mf_init(mf)) {
         err("Failed to init midi file");
-        free(mf);
+        mxFree(mf);
         mf = null;
     }
     return mf;
 }
 
 MD_MIDIFile* MD_OpenBuffer(uint8* buffer) {
-    MD_MIDIFile* mf = malloc(sizeof(MD_MIDIFile));
+    MD_MIDIFile* mf = mxAlloc(sizeof(MD_MIDIFile), MX_MEM_PLAYER);
     if (!mf) {
         err("Failed to allocate midi file");
         return null;
@@ -810,7 +810,7 @@ MD_MIDIFile* MD_OpenBuffer(uint8* buffer) {
     mf->_fd._pos = 0;
     if (!mf_init(mf)) {
         err("Failed to init midi file");
-        free(mf);
+        mxFree(mf);
         mf = null;
     }
     return mf;
@@ -819,6 +819,6 @@ MD_MIDIFile* MD_OpenBuffer(uint8* buffer) {
 void MD_Close(MD_MIDIFile* mf) {
     dbg("Closing midi file");
     MD_Pause(mf, true);
-    free(mf);
+    mxFree(mf);
 }
 
@@ -0,0 +1,68 @@
+// minimal per-module arena allocator
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "plugin.h"
+
+#define ARENA_MINBLOCK  (16 * 1024UL)
+
+void ar_init(arena* ar, unsigned long hint) {
+    ar->blocks = 0;
+    ar->hint = (hint < ARENA_MINBLOCK) ? ARENA_MINBLOCK : hint;
+    ar->count = 0;
+}
+
+void* ar_alloc(arena* ar, unsigned long size) {
+    size = (size + 3) & ~3UL;
+    // the first block with room, so the tails of older blocks still get used
+    arenablock* b = ar->blocks;
+    while (b && ((b->size - b->used) < size)) {
+        b = b->next;
+    }
+    if (!b) {
+        // first block is sized from the hint, later ones a quarter of it
+        unsigned long bsize = ar->blocks ? (ar->hint >> 2) : ar->hint;
+        if (bsize < ARENA_MINBLOCK) {
+            bsize = ARENA_MINBLOCK;
+        }
+        if (bsize < size) {
+            bsize = size;
+        }
+        // module structures and patterns are read every tick, fast ram if there is any
+        b = mxAlloc(sizeof(arenablock) + bsize, MX_MEM_SONG);
+        if (!b) {
+            return 0;
+        }
+        b->next = ar->blocks;
+        b->size = bsize;
+        b->used = 0;
+        ar->blocks = b;
+    }
+    void* p = (unsigned char*)(b + 1) + b->used;
+    b->used += size;
+    ar->count++;
+    memset(p, 0, size);
+    return p;
+}
+
+void ar_free(arena* ar) {
+    arenablock* b = ar->blocks;
+    while (b) {
+        arenablock* next = b->next;
+        mxFree(b);
+        b = next;
+    }
+    ar->blocks = 0;
+    ar->count = 0;
+}
+
+void ar_stats(arena* ar, unsigned long* used, unsigned long* slack, unsigned long* count) {
+    *used = 0;
+    *slack = 0;
+    for (arenablock* b = ar->blocks; b; b = b->next) {
+        *used += b->used;
+        *slack += b->size - b->used;
+    }
+    *count = ar->count;
+}
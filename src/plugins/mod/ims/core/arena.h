@@ -0,0 +1,26 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+// per-module arena: blocks are carved linearly and released in one go.
+// an allocation takes the first block with room, newest first
+
+typedef struct arenablock_t
+{
+    struct arenablock_t* next;
+    unsigned long size;
+    unsigned long used;
+} arenablock;
+
+typedef struct
+{
+    arenablock* blocks;
+    unsigned long hint;
+    unsigned long count;
+} arena;
+
+void ar_init(arena* ar, unsigned long hint);
+void* ar_alloc(arena* ar, unsigned long size);
+void ar_free(arena* ar);
+void ar_stats(arena* ar, unsigned long* used, unsigned long* slack, unsigned long* count);
+
+#endif
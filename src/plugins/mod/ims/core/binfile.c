@@ -61,6 +61,17 @@ void bf_read(binfile* bf, void* dst, unsigned long len)
     bf->pos += len;
 }
 
+void* bf_ref(binfile* bf, unsigned long len, int write) {
+    // only whole, word aligned blocks are handed out, everything else is copied
+    unsigned char* p = &(bf->data[bf->pos]);
+    if (!(bf->flags & BF_REF) || (write && !(bf->flags & BF_WRITABLE)))
+        return 0;
+    if (((unsigned long)p & 1) || ((bf->pos + len) > bf->len))
+        return 0;
+    bf->pos += len;
+    return p;
+}
+
 void bf_seekcur(binfile* bf, long offs) {
     bf->pos += offs;
 }
@@ -69,14 +80,41 @@ void bf_seek(binfile* bf, long pos) {
     bf->pos = pos;
 }
 
+long bf_tell(binfile* bf) {
+    return bf->pos;
+}
+
+long bf_length(binfile* bf) {
+    return bf->len;
+}
+
+signed char bf_getc(binfile* bf) {
+    return (signed char)bf->data[bf->pos++];
+}
+
+unsigned char bf_getuc(binfile* bf) {
+    return bf->data[bf->pos++];
+}
+
+short bf_gets(binfile* bf) {
+    return (short)bf_getus(bf);
+}
+
+unsigned short bf_getus(binfile* bf) {
+    unsigned short v = bf->data[bf->pos] | (bf->data[bf->pos + 1] << 8);
+    bf->pos += 2;
+    return v;
+}
+
+unsigned long bf_getul(binfile* bf) {
+    return (unsigned long)bf_getl(bf);
+}
+
 long bf_getl(binfile* bf) {
-    unsigned long le;
-    bf_read(bf, &le, 4);
-    unsigned long be =
-        ((le & 0xff000000) >> 24) |
-        ((le & 0x00ff0000) >>  8) |
-        ((le & 0x0000ff00) <<  8) |
-        ((le & 0x000000ff) << 24);
-    return be;
+    // byte by byte like bf_getus, so it reads little endian on any host
+    unsigned char* p = &bf->data[bf->pos];
+    unsigned long v = p[0] | (p[1] << 8) | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+    bf->pos += 4;
+    return v;
 }
 
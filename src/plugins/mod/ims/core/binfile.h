@@ -1,6 +1,9 @@
 #ifndef __BINFILE_H
 #define __BINFILE_H
 
+#define BF_REF      4   // data outlives the module, loaders may point into it
+#define BF_WRITABLE 8   // referenced data may be converted in place
+
 typedef struct
 {
     unsigned char* data;
@@ -9,6 +12,11 @@ typedef struct
     long flags;
 } binfile;
 
+// 32 bit fields of records read whole with bf_read, word aligned as on
+// the m68k so the record has the same layout on any host
+typedef unsigned long bf_ulong __attribute__((aligned(2)));
+typedef long bf_long __attribute__((aligned(2)));
+
 long bf_load(binfile* bf, const char* filename);
 long bf_init(binfile* bf, unsigned long len);
 long bf_initref(binfile* bf, unsigned char* data, unsigned long len);
@@ -17,9 +25,19 @@ long bf_initref(binfile* bf, unsigned char* data, unsigned long len);
 int bf_eof(binfile* bf);
 
 void bf_read(binfile* bf, void* dst, unsigned long len);
+void* bf_ref(binfile* bf, unsigned long len, int write);
 void bf_seekcur(binfile* bf, long offs);
 
 void bf_seek(binfile* bf, long pos);
+long bf_tell(binfile* bf);
+long bf_length(binfile* bf);
+
+// little endian reads, returned in native order
+signed char bf_getc(binfile* bf);
+unsigned char bf_getuc(binfile* bf);
+short bf_gets(binfile* bf);
+unsigned short bf_getus(binfile* bf);
 long bf_getl(binfile* bf);
+unsigned long bf_getul(binfile* bf);
 
 #endif
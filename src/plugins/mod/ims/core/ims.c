@@ -136,6 +136,7 @@ int imsInit(imsinitstruct *is)
   mcpSet(-1, mcpMasterChorus, res.chorus*64/100);
   mcpSet(-1, mcpMasterFilter, res.intrplt?1:0);
   mcpSet(-1, mcpMasterSurround, res.surround?1:0);
+  mcpSet(-1, mcpMasterReleaseSamples, is->releasesamples);
 
   return 1;
 }
@@ -162,4 +163,5 @@ void imsFillDefaults(imsinitstruct *is)
   is->reverb=0;
   is->chorus=0;
   is->surround=0;
+  is->releasesamples=0;
 }
\ No newline at end of file
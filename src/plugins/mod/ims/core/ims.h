@@ -18,6 +18,7 @@ typedef struct
   int surround;
   int bufsize;
   int pollmin;
+  int releasesamples;
 } imsinitstruct;
 
 void imsFillDefaults(imsinitstruct* is);
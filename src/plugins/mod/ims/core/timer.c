@@ -26,15 +26,23 @@ static void (*tmTimerRoutine)();
 static volatile long tmCounter;
 static volatile long tmTimerRate;
 static volatile long tmTicker;
+static int tmTask = -1;
 
 
-static inline unsigned long DosTimerToHz(int timerval) {
-    return 1193180UL / timerval;
+static inline unsigned long DosTimerToPeriod(int timerval) {
+    // 1193180 Hz pit counts to a timer task period
+    return umuldiv(timerval, (unsigned long)MX_TIMESTAMP_HZ << 8, 1193180UL);
 }
 
+#define TM_CATCHUP  4
+
 void tmTimerHandler() {
-    tmTicker += tmTimerRate;
-    tmTimerRoutine();
+    // run for ticks the vector had to drop too, within reason
+    unsigned long n = 1 + ((mxTimerAMissed < TM_CATCHUP) ? mxTimerAMissed : TM_CATCHUP);
+    while (n--) {
+        tmTicker += tmTimerRate;
+        tmTimerRoutine();
+    }
 }
 
 int tmInit(void (*rout)(), int timerval, int stk)
@@ -43,9 +51,9 @@ int tmInit(void (*rout)(), int timerval, int stk)
     tmTicker=-timerval;
     tmTimerRate=timerval;
 
-    int hz = DosTimerToHz(timerval);
-    mxHookTimerA(tmTimerHandler, hz);
-    return 1;
+    // a scheduler task, its period is kept exact on average
+    tmTask = mxAddTimerTask(tmTimerHandler, DosTimerToPeriod(timerval), false);
+    return (tmTask >= 0) ? 1 : 0;
 }
 
 void tmSetNewRate(int timerval)
@@ -54,8 +62,7 @@ void tmSetNewRate(int timerval)
     tmCounter = 0;
     tmTicker = -timerval;
     tmTimerRate = timerval;
-    int hz = DosTimerToHz(timerval);
-    mxChangeTimerA(hz);
+    mxSetTimerTaskPeriod(tmTask, DosTimerToPeriod(timerval));
     mxRestoreInterrupts(sr);
 }
 
@@ -81,5 +88,6 @@ int tmGetTimer()
 
 void tmClose()
 {
-    mxUnhookTimerA();
+    mxRemoveTimerTask(tmTask);
+    tmTask = -1;
 }
@@ -17,7 +17,18 @@ int mcpNChan;
 
 void (*mcpIdle)();
 
+unsigned short *mcpSampOrder;
+int mcpSampOrderNum;
+int mcpSampPreload;
+
+mcpcachekey mcpCacheKey;
+const char *mcpCacheDir;
+
+sampleusage *mcpSampUsage;
+unsigned long mcpSampBanks[4];
+
 int (*mcpLoadSamples)(sampleinfo* si, int n);
+int (*mcpPreloadSamples)(sampleinfo* si, int n);
 int (*mcpOpenPlayer)(int, void (*p)());
 void (*mcpClosePlayer)();
 void (*mcpSet)(int ch, int opt, int val);
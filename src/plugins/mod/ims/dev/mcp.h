@@ -31,6 +31,7 @@ enum
   mcpSampRedRate2=0x40000000,
   mcpSampRedRate4=0x20000000,
   mcpSampRedStereo=0x10000000,
+  mcpSampRef=0x08000000,        // ptr points into the module buffer and is not owned
 };
 
 enum
@@ -45,10 +46,16 @@ enum
   mcpCBass, mcpCTreble, mcpCReverb, mcpCChorus, mcpCMute, mcpCStatus,
   mcpCInstrument, mcpCLoop, mcpCDirect, mcpCFilterFreq, mcpCFilterRez,
   mcpGTimer, mcpGCmdTimer,
-  mcpGRestrict
+  mcpGRestrict,
+  mcpGRegWrites, mcpGRegSkips,
+  mcpGTicks, mcpGTickJitter, mcpGTickJitterMax,
+  mcpMasterReleaseSamples
 };
 
 int mcpReduceSamples(sampleinfo *s, int n, long m, int o);
+unsigned long mcpChecksum(const void *buf, unsigned long len);
+void mcpDropCache();
+void mcpGroupSamples(const sampleinfo *s, int n, const unsigned long *hash, short *leader, const void *(*image)(int smp, unsigned long idx));
 enum
 {
   mcpRedAlways16Bit=1,
@@ -57,6 +64,8 @@ enum
   mcpRedToMono=8,
   mcpRedTo8Bit=16,
   //mcpRedToFloat=32,
+  mcpRedKeepRef=64,             // device writes the loop/end fixups of mcpSampRef samples itself
+  mcpRedShare=128,              // device keeps one copy per mcpGroupSamples group
 };
 
 
@@ -68,6 +77,11 @@ enum
 extern int mcpNChan;
 
 extern int (*mcpLoadSamples)(sampleinfo* si, int n);
+// optional: prepare the samples of the module that plays next and upload
+// them into free card memory from mcpIdle, without touching the module
+// playing. A later mcpLoadSamples of the same samples finds them there.
+// n=0 drops a preload, 0 is returned when it is not done.
+extern int (*mcpPreloadSamples)(sampleinfo* si, int n);
 extern int (*mcpOpenPlayer)(int, void (*p)());
 extern void (*mcpClosePlayer)();
 extern void (*mcpSet)(int ch, int opt, int val);
@@ -87,6 +101,41 @@ extern int mcpMixPoll;
 
 extern void (*mcpIdle)();
 
+// optional hint for mcpLoadSamples: sample indices in order of first use.
+// the first mcpSampPreload entries are needed as soon as playback starts,
+// the device may upload the rest later from mcpIdle.
+extern unsigned short *mcpSampOrder;
+extern int mcpSampOrderNum;
+extern int mcpSampPreload;
+
+// optional hint for mcpReduceSamples: identity of the module as loaded,
+// after the loaders delta decoded its sample data in place. when set, the
+// reduced samples are cached in mcpCacheDir and later loads of the same
+// module skip the conversion. a device that can not use what came back
+// calls mcpDropCache so the next load plans again.
+typedef struct
+{
+  unsigned long sum;            // mcpChecksum, names the cache file. 0 for no cache
+  unsigned long size;           // bytes the loader consumed
+  unsigned long hash;           // second hash of the same bytes, independent of sum
+} mcpcachekey;
+extern mcpcachekey mcpCacheKey;
+extern const char *mcpCacheDir;
+int mcpCacheReady();
+void mcpCacheKeyOf(mcpcachekey *key, const void *buf, unsigned long len);
+
+// optional hints for mcpReduceSamples: how each sample is used by the
+// song, so the planner degrades rarely used samples first and drops
+// unused ones, and the free bytes per card memory bank for devices
+// where a sample can not cross banks.
+typedef struct
+{
+  unsigned short count;         // times triggered, 0 when never used
+  signed short maxpitch;        // highest playback pitch relative to samprate, 8.8 semitones
+} sampleusage;
+extern sampleusage *mcpSampUsage;
+extern unsigned long mcpSampBanks[4];
+
 
 int mcpGetFreq6848(int note);
 int mcpGetFreq8363(int note);
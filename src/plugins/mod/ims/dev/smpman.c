@@ -20,6 +20,8 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include "mint/osbind.h"
 #include "mcp.h"
 
 #define SAMPEND 8
@@ -36,19 +38,37 @@ static int stereosizefac(int type)
   return (type&mcpSampStereo)?1:0;
 }
 
+// samples referencing the module buffer are copied before they are changed
+static int ownsample(sampleinfo *s, long bytes)
+{
+  if (!(s->type&mcpSampRef))
+    return 1;
+  void *p=malloc(bytes);
+  if (!p)
+    return 0;
+  memcpy(p, s->ptr, s->length<<sampsizefac(s->type));
+  s->ptr=p;
+  s->type&=~mcpSampRef;
+  return 1;
+}
+
 static void sampto8(sampleinfo *s)
 {
+  if (!ownsample(s, (s->length+SAMPEND)<<sampsizefac(s->type)))
+    return;
   s->type&=~mcpSamp16Bit;
   s->type|=mcpSampRedBits;
   int l=(s->length+SAMPEND)<<sampsizefac(s->type);
   int i;
   for (i=0; i<l; i++)
-    ((char *)s->ptr)[i]=((char *)s->ptr)[2*i+1];
+    ((char *)s->ptr)[i]=((char *)s->ptr)[2*i];   // high byte, big endian
   s->ptr=realloc(s->ptr,(s->length+SAMPEND)<<sampsizefac(s->type));
 }
 
 static void samptomono(sampleinfo *s)
 {
+  if (!ownsample(s, (s->length+SAMPEND)<<sampsizefac(s->type)))
+    return;
   s->type&=~mcpSampStereo;
   s->type|=mcpSampRedStereo;
   int i;
@@ -168,6 +188,10 @@ static int expandsmp(sampleinfo *s, int nopingpongloops)
   if (newlen<2)
     newlen=2;
 
+  if ((s->type&mcpSampRef)&&(newlen==s->length))
+    return 1;
+  if (!ownsample(s, (newlen+SAMPEND)<<sampsizefac(s->type)))
+    return 0;
   s->ptr=realloc(s->ptr, (newlen+SAMPEND)<<sampsizefac(s->type));
   if (!s->ptr)
     return 0;
@@ -316,12 +340,21 @@ static int expandsmp(sampleinfo *s, int nopingpongloops)
   return 1;
 }
 
-static int repairsmp(sampleinfo *s)
+static int repairsmp(sampleinfo *s, int keepref)
 {
   int i;
+  if ((s->type&mcpSampRef)&&keepref)
+  {
+    repairloop(s);
+    return 1;
+  }
+  if (!ownsample(s, (s->length+SAMPEND)<<sampsizefac(s->type)))
+    return 0;
   s->ptr=realloc(s->ptr, (s->length+SAMPEND)<<sampsizefac(s->type));
   if (!s->ptr)
     return 0;
+  if (!s->length)
+    return 1;
 
   repairloop(s);
 
@@ -381,19 +414,9 @@ static int repairsmp(sampleinfo *s)
 unsigned long getpitch(const void *ptr, unsigned long len)
 {
     unsigned long edx = 0;
-    unsigned char* data = (unsigned char*) ptr;
+    const signed char* data = (const signed char*) ptr;
     for (int i=0; i<len-1; i++)
-    {
-        char al = data[i+0] ^ 0x80;
-        char ah = data[i+1] ^ 0x80;
-        unsigned short ax;
-        if (ah > al) {
-            ax = al - ah;
-        } else {
-            ax = 0x100 | (al - ah);
-        }
-        edx += abstab[ax];
-    }
+        edx += abstab[0x100 + data[i+0] - data[i+1]];
     return edx;
 }
 /*
@@ -417,22 +440,12 @@ unsigned long getpitch(const void *ptr, unsigned long len)
 
 unsigned long getpitch16(const void *ptr, unsigned long len)
 {
+    // high bytes only, samples are big endian here
     unsigned long edx = 0;
-    unsigned char* data = (unsigned char*) ptr;
+    const signed char* data = (const signed char*) ptr;
     for (int i=0; i<len-3; i += 2)
-    {
-        char al = data[i+1] ^ 0x80;
-        char ah = data[i+3] ^ 0x80;
-        unsigned short ax;
-        if (ah > al) {
-            ax = al - ah;
-        } else {
-            ax = 0x100 | (al - ah);
-        }
-        edx += abstab[ax];
-    }
+        edx += abstab[0x100 + data[i+0] - data[i+2]];
     return edx;
-
 }
 /*
 #pragma aux getpitch16 parm [esi] [edi] value [edx] modify [eax ebx] = \
@@ -455,6 +468,8 @@ unsigned long getpitch16(const void *ptr, unsigned long len)
 static void dividefrq(sampleinfo *s)
 {
   int i;
+  if (!ownsample(s, (s->length+SAMPEND)<<sampsizefac(s->type)))
+    return;
   if (sampsizefac(s->type)==2)
     for (i=0; i<(s->length>>1); i++)
       ((long*)s->ptr)[i]=((long*)s->ptr)[2*i];
@@ -477,181 +492,379 @@ static void dividefrq(sampleinfo *s)
   s->ptr=realloc(s->ptr, (s->length+SAMPEND)<<sampsizefac(s->type));
 }
 
-static int totalsmpsize(sampleinfo *samples, int nsamp, int always16bit)
+// The reduction planner replaces the global reduce16/reducestereo/reducefrq
+// passes: it repeatedly applies the single per sample reduction with the
+// lowest damage per byte saved until the samples fit. damage is scaled by
+// how often a sample is triggered (mcpSampUsage), so large but rarely used
+// samples give up quality first and unused ones are dropped outright.
+
+#define PLANNYQUIST 22050       // output nyquist of the card mixer
+#define PLANMAXWEIGHT 4096
+
+enum
 {
-  int i;
-  int curdif=0;
-  if (always16bit)
-    for (i=0; i<nsamp; i++)
-      curdif+=(samples[i].length+SAMPEND)<<stereosizefac(samples[i].type);
-  else
-    for (i=0; i<nsamp; i++)
-      curdif+=(samples[i].length+SAMPEND)<<sampsizefac(samples[i].type);
-  return curdif;
-}
+  planNone, planDrop, planTo8, planMono, planRate
+};
 
-static int reduce16(sampleinfo *samples, int samplenum, unsigned long *redpars, int memmax)
+static const char *plannames[]={ "none", "drop", "8bit", "mono", "rate/2" };
+
+typedef struct
 {
-  int i;
-  signed long curdif=-memmax;
-  signed long totdif=0;
-  for (i=0; i<samplenum; i++)
-  {
-    sampleinfo *s=&samples[i];
-    if (s->type&mcpSamp16Bit)
-      redpars[i]=(s->length+SAMPEND)<<stereosizefac(s->type);
-    else
-      redpars[i]=0;
-    totdif+=redpars[i];
-    curdif+=(s->length+SAMPEND)<<sampsizefac(s->type);
-  }
+  long size;
+  unsigned long weight;
+  unsigned long hf;
+  unsigned long ratefac;
+  char measured;
+  char placed;
+  char used;
+  char high;
+  // summed over the samples sharing one copy, in the group leader
+  unsigned long gweight;
+  char gused;
+  char ghigh;
+} planentry;
 
-  if (curdif>totdif)
-  {
-    for (i=0; i<samplenum; i++)
-      if (samples[i].type&mcpSamp16Bit)
-        sampto8(&samples[i]);
+static long plansize(sampleinfo *s, int always16bit)
+{
+  return (s->length+SAMPEND)<<(always16bit?stereosizefac(s->type):sampsizefac(s->type));
+}
+
+static int dropsample(sampleinfo *s)
+{
+  void *p=malloc(SAMPEND);
+  if (!p)
     return 0;
-  }
+  memset(p, 0, SAMPEND);
+  if (!(s->type&mcpSampRef))
+    free(s->ptr);
+  s->ptr=p;
+  s->type&=~(mcpSampRef|mcpSamp16Bit|mcpSampStereo|mcpSampLoop|mcpSampBiDi|mcpSampSLoop|mcpSampSBiDi);
+  s->length=s->loopstart=s->loopend=s->sloopstart=s->sloopend=0;
+  return 1;
+}
+
+// Samples with the same data can share one copy in card memory even when
+// their loops differ, as long as the loop fixups written over the data
+// agree. Of the two elements past the end only loops ending there care,
+// a sample that just stops at its end may share with one looping there.
+static int loopsattail(const sampleinfo *s)
+{
+  return ((s->type&mcpSampLoop)&&(s->loopend==s->length))||((s->type&mcpSampSLoop)&&(s->sloopend==s->length));
+}
 
-  while (curdif>0)
+static int sameelem(int fac, int a, int b, unsigned long idx, const void *(*image)(int smp, unsigned long idx))
+{
+  unsigned char v[8];
+  memcpy(v, image(a, idx), 1<<fac);
+  return !memcmp(v, image(b, idx), 1<<fac);
+}
+
+void mcpGroupSamples(const sampleinfo *s, int n, const unsigned long *hash, short *leader, const void *(*image)(int smp, unsigned long idx))
+{
+  const int mask=mcpSamp16Bit|mcpSampStereo|mcpSampFloat|mcpSampBigEndian|mcpSampRef;
+  int i, j, k;
+  for (i=0; i<n; i++)
   {
-    int fit=0;
-    int best=0;
-    long bestdif=0;
-    for (i=0; i<samplenum; i++)
+    const sampleinfo *a=&s[i];
+    int fac=sampsizefac(a->type);
+    leader[i]=i;
+    if (!a->length)
+      continue;
+    for (j=0; j<i; j++)
     {
-      if (curdif<=redpars[i])
+      const sampleinfo *b=&s[j];
+      if ((leader[j]!=j)||(hash[j]!=hash[i])||(b->length!=a->length)||((b->type^a->type)&mask))
+        continue;
+      if (memcmp(a->ptr, b->ptr, a->length<<fac))
+        continue;
+      unsigned long fix[8]={ a->loopend, a->loopend+1, a->sloopend, a->sloopend+1, b->loopend, b->loopend+1, b->sloopend, b->sloopend+1 };
+      for (k=0; k<8; k++)
+        if ((fix[k]<a->length)&&!sameelem(fac, i, j, fix[k], image))
+          break;
+      if (k<8)
+        continue;
+      int ta=loopsattail(a);
+      int tb=loopsattail(b);
+      if (ta&&tb&&!(sameelem(fac, i, j, a->length, image)&&sameelem(fac, i, j, a->length+1, image)))
+        continue;
+      // the group keeps the end of a sample looping there
+      if (ta&&!tb)
       {
-        if (!fit||(bestdif>redpars[i]))
-        {
-          fit=1;
-          bestdif=redpars[i];
-          best=i;
-        }
+        for (k=0; k<i; k++)
+          if (leader[k]==j)
+            leader[k]=i;
       }
       else
-      {
-        if (!fit&&(bestdif<redpars[i]))
-        {
-          bestdif=redpars[i];
-          best=i;
-        }
-      }
+        leader[i]=j;
+      break;
     }
-    sampto8(&samples[best]);
-    curdif-=redpars[best];
-    redpars[best]=0;
   }
-  return 1;
 }
 
-static int reducestereo(sampleinfo *samples, int samplenum, unsigned long *redpars, int memmax)
+// sample data as repairsmp leaves it, for grouping before the repair
+static const sampleinfo *planimg;
+
+static const void *planimage(int smp, unsigned long idx)
 {
+  static unsigned char v[8];
+  const sampleinfo *s=&planimg[smp];
+  int fac=sampsizefac(s->type);
+  unsigned long from[6];
+  unsigned long to[6];
+  int n=0;
+  to[n]=s->length; from[n++]=s->length-1;
+  to[n]=s->length+1; from[n++]=s->length-1;
+  if ((s->type&mcpSampSLoop)&&!(s->type&mcpSampSBiDi))
+  {
+    to[n]=s->sloopend; from[n++]=s->sloopstart;
+    to[n]=s->sloopend+1; from[n++]=s->sloopstart+1;
+  }
+  if ((s->type&mcpSampLoop)&&!(s->type&mcpSampBiDi))
+  {
+    to[n]=s->loopend; from[n++]=s->loopstart;
+    to[n]=s->loopend+1; from[n++]=s->loopstart+1;
+  }
+  // follow the writes backwards to the element they were copied from
   int i;
-  signed long curdif=-memmax;
-  signed long totdif=0;
-  for (i=0; i<samplenum; i++)
+  for (i=n-1; i>=0; i--)
+    if (to[i]==idx)
+      idx=from[i];
+  memcpy(v, (const char*)s->ptr+(idx<<fac), 1<<fac);
+  return v;
+}
+
+static void plangroup(sampleinfo *samples, planentry *pe, int n, unsigned long *hash, short *lead, int opt)
+{
+  int i;
+  if (opt&mcpRedShare)
   {
-    sampleinfo *s=&samples[i];
-    if (s->type&mcpSampStereo)
-      redpars[i]=s->length+SAMPEND;
-    else
-      redpars[i]=0;
-    totdif+=redpars[i];
-    curdif+=(s->length+SAMPEND)<<stereosizefac(s->type);
+    planimg=samples;
+    mcpGroupSamples(samples, n, hash, lead, planimage);
   }
+  else
+    for (i=0; i<n; i++)
+      lead[i]=i;
 
-  if (curdif>totdif)
+  for (i=0; i<n; i++)
   {
-    for (i=0; i<samplenum; i++)
-      if (samples[i].type&mcpSampStereo)
-        samptomono(&samples[i]);
+    planentry *e=&pe[i];
+    e->high=e->ratefac&&(umuldiv(samples[i].samprate, e->ratefac, 8363*4)>=PLANNYQUIST);
+    e->size=(lead[i]==i)?plansize(&samples[i], opt&mcpRedAlways16Bit):0;
+    e->gweight=e->weight;
+    e->gused=e->used;
+    e->ghigh=e->high;
+  }
+  for (i=0; i<n; i++)
+    if (lead[i]!=i)
+    {
+      planentry *g=&pe[lead[i]];
+      g->gweight+=pe[i].weight;
+      if (g->gweight>PLANMAXWEIGHT)
+        g->gweight=PLANMAXWEIGHT;
+      g->gused|=pe[i].used;
+      g->ghigh&=pe[i].high;
+    }
+}
+
+static int planfits(planentry *pe, int n, unsigned long memmax)
+{
+  unsigned long total=0;
+  int i;
+  for (i=0; i<n; i++)
+    total+=pe[i].size;
+  if (total>memmax)
     return 0;
+  if (!mcpSampBanks[0])
+    return 1;
+
+  // samples can not cross banks: place largest first into the bank with
+  // the least room that still holds it, the same way the device uploads them
+  unsigned long room[4];
+  memcpy(room, mcpSampBanks, sizeof(room));
+  for (i=0; i<n; i++)
+    pe[i].placed=0;
+  while (1)
+  {
+    int big=-1;
+    for (i=0; i<n; i++)
+      if (!pe[i].placed&&((big<0)||(pe[i].size>pe[big].size)))
+        big=i;
+    if (big<0)
+      return 1;
+    int b, best=-1;
+    for (b=0; b<4; b++)
+      if ((room[b]>=pe[big].size)&&((best<0)||(room[b]<room[best])))
+        best=b;
+    if (best<0)
+      return 0;
+    room[best]-=pe[big].size;
+    pe[big].placed=1;
   }
+}
 
-  while (curdif>0)
+static unsigned long plancost(sampleinfo *s, planentry *e, int what, long *saved, int opt)
+{
+  long newsize;
+  unsigned long damage;
+  switch (what)
   {
-    int fit=0;
-    int best=0;
-    long bestdif=0;
-    for (i=0; i<samplenum; i++)
+  case planDrop:
+    if (!mcpSampUsage||e->gused||!s->length)
+      return 0xFFFFFFFF;
+    newsize=SAMPEND;
+    damage=0;
+    break;
+  case planTo8:
+    if (!(s->type&mcpSamp16Bit)||(opt&mcpRedAlways16Bit))
+      return 0xFFFFFFFF;
+    newsize=e->size>>1;
+    damage=16;
+    break;
+  case planMono:
+    if (!(s->type&mcpSampStereo))
+      return 0xFFFFFFFF;
+    newsize=e->size>>1;
+    damage=32;
+    break;
+  case planRate:
+    if ((s->length<1024)||(s->type&mcpSampRedRate4))
+      return 0xFFFFFFFF;
+    newsize=e->size-((s->length-(s->length>>1))<<(sampsizefac(s->type)));
+    if (e->ghigh)
+      damage=0;   // what is cut off is played above the output nyquist anyway
+    else
     {
-      if (curdif<=redpars[i])
-      {
-        if (!fit||(bestdif>redpars[i]))
-        {
-          fit=1;
-          bestdif=redpars[i];
-          best=i;
-        }
-      }
-      else
+      if (!e->measured)
       {
-        if (!fit&&(bestdif<redpars[i]))
-        {
-          bestdif=redpars[i];
-          best=i;
-        }
+        e->hf=((s->type&mcpSamp16Bit)?getpitch16(s->ptr, s->length<<1):getpitch(s->ptr, s->length))/s->length;
+        e->measured=1;
       }
+      damage=64+((e->hf<PLANMAXWEIGHT)?e->hf:PLANMAXWEIGHT);
     }
-    samptomono(&samples[best]);
-    curdif-=redpars[best];
-    redpars[best]=0;
+    break;
+  default:
+    return 0xFFFFFFFF;
   }
-  return 1;
+  *saved=e->size-newsize;
+  if (*saved<=0)
+    return 0xFFFFFFFF;
+  __uint64_t cost=(((__uint64_t)damage*e->gweight)<<20)/(*saved);
+  return (cost<0xFFFFFFFE)?cost:0xFFFFFFFE;
 }
 
-static int reducefrq(sampleinfo *samples, int samplenum, unsigned long *redpars, int memmax)
+static int planreduce(sampleinfo *samples, int n, unsigned long memmax, int opt)
 {
-  int i;
+  planentry *pe=malloc(n*(sizeof(planentry)+sizeof(unsigned long)+sizeof(short)));
+  if (!pe)
+    return 0;
+  unsigned long *hash=(unsigned long*)(pe+n);
+  short *lead=(short*)(hash+n);
 
+  int i;
   for (i=-0x100; i<0x100; i++)
     abstab[i+0x100]=i*i/16;
 
-  signed long curdif=-memmax;
-  for (i=0; i<samplenum; i++)
+  for (i=0; i<n; i++)
   {
     sampleinfo *s=&samples[i];
-    curdif+=s->length+SAMPEND;
-    if (s->length<1024)
-      redpars[i]=0xFFFFFFFF;
-    else
-      if (s->type&mcpSamp16Bit)
-        redpars[i]=getpitch16(s->ptr, s->length)/s->length;
-      else
-        redpars[i]=getpitch(s->ptr, s->length)/s->length;
+    planentry *e=&pe[i];
+    e->weight=1;
+    e->ratefac=0;
+    e->measured=0;
+    e->hf=0;
+    e->used=0;
+    if (mcpSampUsage)
+    {
+      e->weight=(mcpSampUsage[i].count<PLANMAXWEIGHT)?(mcpSampUsage[i].count+1):PLANMAXWEIGHT;
+      if (mcpSampUsage[i].count)
+      {
+        e->ratefac=mcpGetFreq8363(mcpSampUsage[i].maxpitch);
+        e->used=1;
+      }
+    }
+    if (opt&mcpRedShare)
+      hash[i]=mcpChecksum(s->ptr, s->length<<sampsizefac(s->type));
   }
+  plangroup(samples, pe, n, hash, lead, opt);
 
-  while (curdif>0)
+  int steps=0;
+  while (!planfits(pe, n, memmax))
   {
     int best=-1;
-    unsigned long bestpitch=0xFFFFFFFF;
-    for (i=0; i<samplenum; i++)
-      if (redpars[i]<bestpitch)
+    int bestwhat=planNone;
+    unsigned long bestcost=0xFFFFFFFF;
+    long bestsaved=0;
+    for (i=0; i<n; i++)
+    {
+      int what;
+      if (lead[i]!=i)
+        continue;
+      for (what=planDrop; what<=planRate; what++)
       {
-        bestpitch=redpars[i];
-        best=i;
+        long saved;
+        unsigned long cost=plancost(&samples[i], &pe[i], what, &saved, opt);
+        if ((cost<bestcost)||((cost==bestcost)&&(cost!=0xFFFFFFFF)&&(saved>bestsaved)))
+        {
+          best=i;
+          bestwhat=what;
+          bestcost=cost;
+          bestsaved=saved;
+        }
       }
-    if (best==-1)
+    }
+    if (best<0)
+    {
+      dbg("plan: no fit after %d steps", steps);
+      free(pe);
       return 0;
-    sampleinfo *s=&samples[best];
-    curdif-=s->length+SAMPEND;
-    dividefrq(s);
-    curdif+=s->length+SAMPEND;
+    }
 
-    if ((s->length<1024)||(s->type&mcpSampRedRate4))
-      redpars[best]=0xFFFFFFFF;
-    else
-      if (s->type&mcpSamp16Bit)
-        redpars[best]=(getpitch16(s->ptr, s->length)/s->length)<<1;
-      else
-        redpars[best]=(getpitch(s->ptr, s->length)/s->length)<<1;
+    // the samples sharing a copy get the same reduction and stay shared
+    int k;
+    for (k=0; k<n; k++)
+    {
+      if (lead[k]!=best)
+        continue;
+      sampleinfo *s=&samples[k];
+      switch (bestwhat)
+      {
+      case planDrop:
+        if (!dropsample(s))
+        {
+          free(pe);
+          return 0;
+        }
+        break;
+      case planTo8:
+        sampto8(s);
+        break;
+      case planMono:
+        samptomono(s);
+        break;
+      case planRate:
+        dividefrq(s);
+        pe[k].hf<<=1;
+        break;
+      }
+      if (opt&mcpRedShare)
+        hash[k]=mcpChecksum(s->ptr, s->length<<sampsizefac(s->type));
+    }
+    plangroup(samples, pe, n, hash, lead, opt);
+    steps++;
+    dbg("plan: smp %d %s, saves %ld, cost %ld", best, plannames[bestwhat], bestsaved, bestcost);
   }
 
+  unsigned long total=0;
+  int shared=0;
+  for (i=0; i<n; i++)
+  {
+    total+=pe[i].size;
+    shared+=(lead[i]!=i);
+  }
+  dbg("plan: %ld of %ld bytes after %d steps, %d samples shared", total, memmax, steps, shared);
+  free(pe);
   return 1;
 }
-
 static int convertsample(sampleinfo *s)
 {
   if (s->loopstart>=s->loopend)
@@ -659,6 +872,9 @@ static int convertsample(sampleinfo *s)
 
   int i;
 
+  if ((s->type&(mcpSampBigEndian|mcpSampDelta|mcpSampUnsigned))&&!ownsample(s, (s->length+SAMPEND)<<sampsizefac(s->type)))
+    return 0;
+
   if ((s->type&(mcpSampBigEndian|mcpSamp16Bit))==(mcpSampBigEndian|mcpSamp16Bit))
   {
     int l=s->length<<sampsizefac(s->type);
@@ -732,6 +948,223 @@ static int convertsample(sampleinfo *s)
   return 1;
 }
 
+unsigned long mcpChecksum(const void *buf, unsigned long len)
+{
+  // fletcher style running sums, a few instructions per long on a 68000
+  unsigned long a=len;
+  unsigned long b=0;
+  const unsigned char *c=(const unsigned char*)buf;
+  if (!((unsigned long)c&1))
+  {
+    const unsigned long *p=(const unsigned long*)c;
+    unsigned long l;
+    for (l=len>>2; l; l--)
+    {
+      a+=*p++;
+      b+=a;
+    }
+    c=(const unsigned char*)p;
+    len&=3;
+  }
+  while (len--)
+  {
+    a+=*c++;
+    b+=a;
+  }
+  a^=(b<<16)|(b>>16);
+  return a?a:1;
+}
+
+void mcpCacheKeyOf(mcpcachekey *key, const void *buf, unsigned long len)
+{
+  // mcpChecksum, and in the same pass a rotate and xor hash. one is a sum,
+  // the other linear over bits, so data that fools one rarely fools both
+  unsigned long a=len;
+  unsigned long b=0;
+  unsigned long h=~len;
+  unsigned long l=len;
+  const unsigned char *c=(const unsigned char*)buf;
+  if (!((unsigned long)c&1))
+  {
+    const unsigned long *p=(const unsigned long*)c;
+    for (l=len>>2; l; l--)
+    {
+      unsigned long v=*p++;
+      a+=v;
+      b+=a;
+      h=((h<<7)|(h>>25))^v;
+    }
+    c=(const unsigned char*)p;
+    l=len&3;
+  }
+  while (l--)
+  {
+    a+=*c;
+    b+=a;
+    h=((h<<7)|(h>>25))^*c++;
+  }
+  a^=(b<<16)|(b>>16);
+  key->sum=a?a:1;
+  key->size=len;
+  key->hash=h;
+}
+
+int mcpCacheReady()
+{
+  // the module is only hashed for the cache when there is one
+  if (!mcpCacheDir)
+    return 0;
+  long attr=Fattrib(mcpCacheDir, 0, 0);
+  return (attr>=0)&&(attr&FA_DIR);
+}
+
+// reduced samples are cached on disk, keyed by mcpCacheKey and the
+// reduction parameters, the bank sizes included as the plan depends on
+// them. the file is named after the checksum, its size and second hash
+// have to match too. samples still referencing the module buffer after
+// the reduction are not stored, only their sampleinfo.
+
+#define CACHEMAGIC 0x4D584333 // MXC3
+
+typedef struct
+{
+  unsigned long magic;
+  mcpcachekey key;
+  long mem;
+  long opt;
+  long n;
+  unsigned long banks[4];
+} cachehdr;
+
+typedef struct
+{
+  sampleinfo s;
+  unsigned long bytes;
+} cacheent;
+
+static int cachename(char *name, int size)
+{
+  static const char hex[]="0123456789ABCDEF";
+  int l=strlen(mcpCacheDir);
+  if ((l+14)>size)
+    return 0;
+  memcpy(name, mcpCacheDir, l);
+  if (l&&(name[l-1]!='\\'))
+    name[l++]='\\';
+  int i;
+  for (i=0; i<8; i++)
+    name[l++]=hex[(mcpCacheKey.sum>>(28-4*i))&15];
+  strcpy(name+l, ".MXC");
+  return 1;
+}
+
+static int cacheload(sampleinfo *samples, int n, long mem, int opt)
+{
+  char name[128];
+  if (!mcpCacheKey.sum||!mcpCacheDir||!cachename(name, sizeof(name)))
+    return 0;
+  long fh=Fopen(name, 0);
+  if (fh<0)
+    return 0;
+
+  int i;
+  cachehdr hdr;
+  cacheent *ent=malloc(n*sizeof(cacheent));
+  void **ptr=malloc(n*sizeof(void*));
+  if (ptr)
+    memset(ptr, 0, n*sizeof(void*));
+  int ok=ent&&ptr&&(Fread(fh, sizeof(hdr), &hdr)==sizeof(hdr));
+  ok=ok&&(hdr.magic==CACHEMAGIC)&&!memcmp(&hdr.key, &mcpCacheKey, sizeof(hdr.key))&&(hdr.mem==mem)&&(hdr.opt==opt)&&(hdr.n==n);
+  ok=ok&&!memcmp(hdr.banks, mcpSampBanks, sizeof(hdr.banks));
+  ok=ok&&(Fread(fh, n*sizeof(cacheent), ent)==(n*sizeof(cacheent)));
+  for (i=0; ok&&(i<n); i++)
+  {
+    if (!ent[i].bytes)
+    {
+      ok=(samples[i].type&mcpSampRef)&&(samples[i].length==ent[i].s.length);
+      continue;
+    }
+    ptr[i]=malloc(ent[i].bytes);
+    ok=ptr[i]&&(Fread(fh, ent[i].bytes, ptr[i])==ent[i].bytes);
+  }
+  Fclose(fh);
+
+  // only touch the samples once everything has been read
+  for (i=0; ptr&&(i<n); i++)
+  {
+    if (!ok)
+      free(ptr[i]);
+    else
+    {
+      void *p=samples[i].ptr;
+      if (ptr[i])
+      {
+        if (!(samples[i].type&mcpSampRef))
+          free(p);
+        p=ptr[i];
+      }
+      samples[i]=ent[i].s;
+      samples[i].ptr=p;
+    }
+  }
+  free(ent);
+  free(ptr);
+  return ok;
+}
+
+static void cachesave(sampleinfo *samples, int n, long mem, int opt)
+{
+  char name[128];
+  if (!mcpCacheKey.sum||!mcpCacheDir||!cachename(name, sizeof(name)))
+    return;
+
+  // nothing to gain when every sample is used straight from the module
+  int i;
+  for (i=0; i<n; i++)
+    if (!(samples[i].type&mcpSampRef))
+      break;
+  if (i==n)
+    return;
+
+  long fh=Fcreate(name, 0);
+  if (fh<0)
+    return;
+
+  cachehdr hdr;
+  hdr.magic=CACHEMAGIC;
+  hdr.key=mcpCacheKey;
+  hdr.mem=mem;
+  hdr.opt=opt;
+  hdr.n=n;
+  memcpy(hdr.banks, mcpSampBanks, sizeof(hdr.banks));
+  int ok=(Fwrite(fh, sizeof(hdr), &hdr)==sizeof(hdr));
+  for (i=0; ok&&(i<n); i++)
+  {
+    cacheent ent;
+    ent.s=samples[i];
+    ent.s.ptr=0;
+    ent.bytes=(samples[i].type&mcpSampRef)?0:((samples[i].length+SAMPEND)<<sampsizefac(samples[i].type));
+    ok=(Fwrite(fh, sizeof(ent), &ent)==sizeof(ent));
+  }
+  for (i=0; ok&&(i<n); i++)
+  {
+    if (samples[i].type&mcpSampRef)
+      continue;
+    long bytes=(samples[i].length+SAMPEND)<<sampsizefac(samples[i].type);
+    ok=(Fwrite(fh, bytes, samples[i].ptr)==bytes);
+  }
+  Fclose(fh);
+  if (!ok)
+    Fdelete(name);
+}
+
+void mcpDropCache()
+{
+  char name[128];
+  if (mcpCacheKey.sum&&mcpCacheDir&&cachename(name, sizeof(name)))
+    Fdelete(name);
+}
+
 int mcpReduceSamples(sampleinfo *si, int n, long mem, int opt)
 {
   sampleinfo *samples=si;
@@ -740,6 +1173,12 @@ int mcpReduceSamples(sampleinfo *si, int n, long mem, int opt)
 
     dbg("mcpReduceSamples %d", n);
 
+  if (cacheload(si, n, mem, opt))
+  {
+    dbg("sample cache hit %08lx", mcpCacheKey.sum);
+    return 1;
+  }
+
   int i;
   for (i=0; i<samplenum; i++)
   {
@@ -759,21 +1198,14 @@ int mcpReduceSamples(sampleinfo *si, int n, long mem, int opt)
       if ((samples[i].type&mcpSamp16Bit)&&((opt&mcpRedTo8Bit)||((samples[i].length+SAMPEND)>(128*1024))))
         sampto8(&samples[i]);
 
-  if (totalsmpsize(samples, samplenum, opt&mcpRedAlways16Bit)>memmax)
-  {
-    unsigned long *redpars=malloc(sizeof(unsigned long)*samplenum);
-    if (!redpars)
-      return 0;
-    if ((opt&mcpRedAlways16Bit)||!reduce16(samples, samplenum, redpars, memmax))
-      if (!reducestereo(samples, samplenum, redpars, memmax))
-        if (!reducefrq(samples, samplenum, redpars, memmax))
-          return 0;
-    free(redpars);
-  }
+  if (!planreduce(samples, samplenum, memmax, opt))
+    return 0;
 
   for (i=0; i<samplenum; i++)
-    if (!repairsmp(&samples[i]))
+    if (!repairsmp(&samples[i], opt&mcpRedKeepRef))
       return 0;
+
+  cachesave(si, n, mem, opt);
 /*
   if (opt&mcpRedToFloat)
    for (i=0; i<samplenum; i++)
@@ -59,8 +59,6 @@ static unsigned long bufferpos;
 
 static unsigned long iwMem[4];
 static unsigned long memsize;
-static unsigned long largestbank;
-static unsigned long lbsize;
 
 static unsigned short linvol[513];
 
@@ -74,6 +72,31 @@ static char rfxchans[4] = { 0xc0, 0xc0 ,0x30, 0x30};
 static int  rpanning[4] = {0x152, 0xAB,0x200,0x000};
 static char pan2chan[4] = { 0xA0, 0x30, 0x30, 0x50};
 
+static unsigned long regwrites;
+static unsigned long regskips;
+
+// Shadow copies of the per-voice registers that processtick() writes
+// every tick. Writes of unchanged values are suppressed and counted.
+#define SHADOW_VOLDOWN  0xFFFE
+
+typedef struct
+{
+    unsigned short freq;
+    unsigned short vol;
+    unsigned short voll;
+    unsigned short volr;
+    unsigned short effvol;
+    unsigned short effchan;
+    unsigned short pan;
+} iwshadow;
+
+static iwshadow shadow[32];
+
+static void shadowreset()
+{
+    memset(shadow, 0xff, sizeof(shadow));
+}
+
 
 static inline unsigned short _disableint() {
     if (useiwtimer) {
@@ -107,8 +130,8 @@ static inline void delayIW(unsigned int len) {
 
 static unsigned char inpIW(unsigned short p)                { return inp(iwPort+p); }
 static void outpIW(unsigned short p, unsigned char v)       { outp(iwPort+p,v); delayIW(4); }
-static void outIW(unsigned char c, unsigned char v)         { outp(iwPort+0x103, c); delayIW(4); outp(iwPort+0x105, v); delayIW(4); }
-static void outwIW(unsigned char c, unsigned short v)       { outp(iwPort+0x103, c); delayIW(4); outpw(iwPort+0x104, v); delayIW(4); }
+static void outIW(unsigned char c, unsigned char v)         { outp(iwPort+0x103, c); delayIW(4); outp(iwPort+0x105, v); delayIW(4); regwrites++; }
+static void outwIW(unsigned char c, unsigned short v)       { outp(iwPort+0x103, c); delayIW(4); outpw(iwPort+0x104, v); delayIW(4); regwrites++; }
 static unsigned char inIW(unsigned char c)                  { outp(iwPort+0x103, c); delayIW(4); return inp(iwPort+0x105); }
 static unsigned short inwIW(unsigned char c)                { outp(iwPort+0x103, c); delayIW(4); return inpw(iwPort+0x104);}
 
@@ -121,6 +144,7 @@ static void outdIW(unsigned char c, unsigned char v) {
         outp(iwPort+0x105, v);
         delayIW(8);
         outp(iwPort+0x105, v);
+        regwrites++;
     }
 }
 
@@ -510,6 +534,7 @@ static void initiw(char enhmode,char chans)
     activechans = chans;
 
     resetIW();
+    shadowreset();
     setenhmode(enhmode);
 
     outIW(0x41, 0x00);
@@ -604,6 +629,7 @@ typedef struct
     unsigned char fxsend;
 
     unsigned char inited;
+    unsigned char rampwait;
     signed char chstatus;
     signed short nextsample;
     signed long nextpos;
@@ -619,6 +645,14 @@ typedef struct
     unsigned char pause;
     unsigned char wasplaying;
 
+    unsigned char fcvalid;
+    unsigned long fcfreq;
+    unsigned long fcrate;
+    unsigned long fcmul;
+    unsigned long fcrem;
+    unsigned long fcdiv;
+    unsigned long fcval;
+
     void *smpptr;
 }  iwchan;
 
@@ -634,13 +668,81 @@ typedef struct
     unsigned long samprate;
     int type;
     unsigned char redlev;
+    unsigned char pending;
     void *ptr;
+    // loop and end fixups of a sample still in the module buffer,
+    // written over the sample data in DRAM.
+    unsigned char nfix;
+    unsigned char fix[6][2];
+    unsigned long fixidx[6];
 } iwsample;
 
 static unsigned long mempos[4];
 static iwsample samples[MAXSAMPLES];
 static unsigned short samplenum;
 
+// Samples uploaded to DRAM stay there after a module is unloaded and are
+// reused when a later module contains a sample with identical content.
+// Entries are kept sorted by DRAM address.
+#define MAXCACHED   512
+
+typedef struct
+{
+    unsigned long hash;
+    unsigned long sum;
+    unsigned long bytes;
+    unsigned long pos;
+    unsigned long size;
+    unsigned long lastuse;
+    unsigned char bank;
+    unsigned char pending;              // 1 background upload, 2 preload
+} iwcached;
+
+static iwcached cache[MAXCACHED];
+static unsigned short cachenum;
+static unsigned long cachegen;
+static unsigned short cacheevicted;
+static unsigned long smphash[MAXSAMPLES];
+static unsigned long smpsum[MAXSAMPLES];
+
+// Samples of one module with the same data share a single copy in DRAM,
+// see mcpGroupSamples. smplead is the sample holding the copy.
+static unsigned long smpbody[MAXSAMPLES];
+static short smplead[MAXSAMPLES];
+
+// Samples that are not needed right away are uploaded from mcpIdle
+// in order of first use, a few chunks per call.
+#define IDLECHUNK   4096
+#define IDLECHUNKS  4
+
+static unsigned short pendq[MAXSAMPLES];
+static unsigned short pendnum;
+static unsigned short pendcur;
+static unsigned long pendoffs;
+static unsigned char pendok;
+
+// The module that plays next is prepared by PreloadSamples while another
+// one plays. Its samples that are not resident go to DRAM the module
+// playing does not use, uploaded from mcpIdle after the background upload.
+// The load that follows finds them in the cache.
+static sampleinfo *presil;
+static unsigned short presn;
+static unsigned short preq[MAXSAMPLES];
+static unsigned short prenum;
+static unsigned short precur;
+static unsigned long preoffs;
+static unsigned char preok;
+static iwsample presmp;
+
+// Optionally the host copy of a sample is freed once its upload has been
+// read back and verified. Nothing on the host side reads sample data after
+// that, the mixer interface gets a null sample pointer.
+static unsigned char releasesamples;
+static sampleinfo *loadsil;
+static unsigned char smphit[MAXSAMPLES];
+static unsigned long hostbytes;
+static unsigned long hostpeak;
+
 static unsigned char channelnum;
 static void (*playerproc)();
 static iwchan channels[32];
@@ -662,6 +764,13 @@ static unsigned long amplify;
 
 static unsigned char paused;
 
+// Tick timing against the system timestamp, for whichever timer drives
+// playback: deviation of each tick period from the nominal one in us.
+static unsigned long tickstamp;
+static unsigned long tickcount;
+static unsigned long ticklate;
+static unsigned long tickmaxlate;
+
 static void *dmaxfer;
 static unsigned long dmaleft;
 static unsigned long dmapos;
@@ -707,35 +816,162 @@ static void fadevoldown()
 }
 
 
+static void shfreq(int i, unsigned short frq)
+{
+    if (shadow[i].freq==frq) {
+        regskips++;
+        return;
+    }
+    shadow[i].freq=frq;
+    setfreq(frq);
+}
+
+static void shfadevol(int i, unsigned short v)
+{
+    if (shadow[i].vol==v) {
+        regskips+=2;
+        return;
+    }
+    shadow[i].vol=v;
+    fadevol(v);
+}
+
+static void shfadevoldown(int i)
+{
+    if (shadow[i].vol==SHADOW_VOLDOWN) {
+        regskips+=3;
+        return;
+    }
+    shadow[i].vol=SHADOW_VOLDOWN;
+    fadevoldown();
+}
+
+static void shrelvol(int i, unsigned short voll, unsigned short volr)
+{
+    if (shadow[i].voll==voll) {
+        regskips+=2;
+    } else {
+        shadow[i].voll=voll;
+        setrelvoll(voll,0);
+    }
+    if (shadow[i].volr==volr) {
+        regskips+=2;
+    } else {
+        shadow[i].volr=volr;
+        setrelvolr(volr,0);
+    }
+}
+
+static void sheffect(int i, unsigned short vol, unsigned char ch)
+{
+    if (shadow[i].effvol==vol) {
+        regskips+=2;
+    } else {
+        shadow[i].effvol=vol;
+        seteffvol(vol);
+    }
+    if (shadow[i].effchan==ch) {
+        regskips++;
+    } else {
+        shadow[i].effchan=ch;
+        seteffchan(ch);
+    }
+}
+
+static void shpan(int i, unsigned char pan)
+{
+    if (shadow[i].pan==pan) {
+        regskips++;
+        return;
+    }
+    shadow[i].pan=pan;
+    setpan(pan);
+}
+
+
+// Frequency control value for a voice, bit-identical to
+//   AMD: umuldivrnd(orgfreq, samprate*masterfreq, orgdiv)/11025
+//   GF1: umuldivrnd(umuldivrnd(orgfreq, samprate*masterfreq, orgdiv), activechans, 154350)
+// orgfreq*samprate*masterfreq is split into mul*11025+rem whenever one of
+// its inputs changes. A new orgdiv then only costs a 32bit divide:
+//   (mul*11025+rem+orgdiv/2)/(orgdiv*11025) = mul/orgdiv + (0 or 1)
+// and an unchanged voice costs nothing at all.
+static unsigned long calcfc(iwchan *c)
+{
+    unsigned long b=c->samprate*masterfreq;
+    if (!c->fcvalid||(c->fcfreq!=c->orgfreq)||(c->fcrate!=b)) {
+        __uint64_t p=c->orgfreq*(__uint64_t)b;
+        c->fcvalid=((p/11025)>>32)?2:1;     // 2: too wide for the 32bit path
+        c->fcfreq=c->orgfreq;
+        c->fcrate=b;
+        c->fcmul=(unsigned long)(p/11025);
+        c->fcrem=(unsigned long)(p%11025);
+        c->fcdiv=0;
+        c->fcval=0;
+    }
+    unsigned long d=c->orgdiv;
+    if (d==c->fcdiv) {
+        return c->fcval;
+    }
+    c->fcdiv=d;
+
+    if (iwType == GUSTYPE_AMD) {
+        if ((c->fcvalid==1)&&(d<0x40000000)) {
+            unsigned long q=c->fcmul/d;
+            unsigned long e=d-(c->fcmul-q*d);
+            // q<389566 guarantees the original 32bit intermediate did not wrap
+            if (q<389566) {
+                if ((e<=0x10000)&&((11025*e)<=(c->fcrem+(d>>1)))) {
+                    q++;
+                }
+                c->fcval=q;
+                return q;
+            }
+        }
+        c->fcval=umuldivrnd(c->orgfreq, b, d)/11025;
+    } else {
+        unsigned long f=umuldivrnd(c->orgfreq, b, d);
+        if (f<=(0xFFFFFFFFUL-77175)/activechans) {
+            c->fcval=(f*activechans+77175)/154350;
+        } else {
+            c->fcval=umuldivrnd(f, activechans, 154350);
+        }
+    }
+    return c->fcval;
+}
+
+
 static void processtick()
 {
+    // Voices that are retriggered are stopped and ramped down first.
+    // The new sample/position is committed once the ramp has finished,
+    // which is usually on the next tick. We never wait on the chip here.
     for (int i=0; i<channelnum; i++) {
         iwchan *c=&channels[i];
-        if (c->inited&&(c->chstatus||(c->nextpos!=-1))) {
+        if (c->inited&&!c->rampwait&&(c->chstatus||(c->nextpos!=-1))) {
             selvoc(i);
             setmode(c->mode|3);
             fadevoldown();
+            shadow[i].vol=SHADOW_VOLDOWN;
+            c->rampwait=1;
         }
         c->chstatus=0;
     }
 
     for (int i=0; i<channelnum; i++) {
+        iwchan *c=&channels[i];
         selvoc(i);
-#if 1
-        if (!getvmode() & 1) {
-            iwchan *c=&channels[i];
-            if (c->inited && c->chstatus) {
-                while (!(getvmode()&1));
+        if (c->rampwait) {
+            if (!(getvmode()&1)) {
+                // still ramping, keep the pending changes for next tick
+                continue;
             }
+            c->rampwait=0;
+        }
+        if (c->inited&&(c->nextsample!=-1)&&samples[c->nextsample].pending) {
+            // not uploaded yet, the note is dropped
+            c->inited=0;
         }
-#else
-        while (!getvmode() & 1);
-#endif        
-    }
-
-    for (int i=0; i<channelnum; i++) {
-        iwchan *c=&channels[i];
-        selvoc(i);
         if (c->inited) {
             if (c->nextsample!=-1) {
                 iwsample *s=&samples[c->nextsample];
@@ -765,8 +1001,7 @@ static void processtick()
                 c->cursamp=c->nextsample;
                 setbank(c->bank>>bit16);
                 setmode(c->mode|3);
-                setrelvoll(c->voll,0);
-                setrelvolr(c->volr,0);
+                shrelvol(i, c->voll, c->volr);
             }
 
             if (c->nextpos!=-1) {
@@ -846,28 +1081,26 @@ static void processtick()
             if (!(getmode()&1)) {
                 if (iwType == GUSTYPE_AMD) {
                     if (c->pause) {
-                        fadevoldown();
+                        shfadevoldown(i);
                     } else {
-                        fadevol(linvol[c->volume]);
-                        setrelvoll(c->voll,0);
-                        setrelvolr(c->volr,0);
-                        seteffvol(linvol[c->reverb]);
-                        seteffchan(pan2chan[c->fxsend]);
+                        shfadevol(i, linvol[c->volume]);
+                        shrelvol(i, c->voll, c->volr);
+                        sheffect(i, linvol[c->reverb], pan2chan[c->fxsend]);
                     }
-                    setfreq(umuldivrnd(c->orgfreq, c->samprate*masterfreq, c->orgdiv)/11025);
+                    shfreq(i, calcfc(c));
                 } else {
                     int v = c->voll + c->volr;
                     if (v) {
-                        setpan((15*c->volr+v/2)/v);
+                        shpan(i, (15*c->volr+v/2)/v);
                     }
-                    fadevol(c->pause?0:linvol[v]);
-                    setfreq(umuldivrnd(umuldivrnd(c->orgfreq, c->samprate*masterfreq, c->orgdiv), activechans, 154350));
+                    shfadevol(i, c->pause?0:linvol[v]);
+                    shfreq(i, calcfc(c));
                 }
             } else {
-                fadevoldown();
+                shfadevoldown(i);
             }
         } else {
-            fadevoldown();
+            shfadevoldown(i);
         }
 
         c->nextsample=-1;
@@ -887,11 +1120,7 @@ void doupload8(const void *buf, unsigned long iwpos, unsigned long maxlen, unsig
         outp(port+0x103, 0x43);                 // lo word address
         outpw(port+0x104, iwpos & 0xffff);
         outp(port+0x103, 0x51);                 // auto incrementing writes
-        unsigned short* ptr = (unsigned short*)buf;
-        unsigned short* end = (unsigned short*)((unsigned long)buf + maxlen);
-        while (ptr < end) {
-            outpw(port+0x104, *ptr++);          // write word
-        }
+        outpw_buf(port+0x104, (const unsigned short*)buf, (maxlen + 1) >> 1);
     }
 }
 #define doupload16 doupload8
@@ -944,6 +1173,22 @@ static void slowupload()
     }
 }
 
+static void ticktime()
+{
+    unsigned long now=mxTimestamp();
+    if (tickstamp) {
+        unsigned long us=umuldiv(now-tickstamp, 1000000, MX_TIMESTAMP_HZ);
+        unsigned long nominal=umuldiv(65536, 1000000, orgspeed*relspeed);
+        unsigned long dev=(us>nominal) ? (us-nominal) : (nominal-us);
+        ticklate+=dev;
+        if (dev>tickmaxlate) {
+            tickmaxlate=dev;
+        }
+        tickcount++;
+    }
+    tickstamp=now;
+}
+
 static void irqrout()
 {
     while (1)
@@ -975,8 +1220,13 @@ static void irqrout()
                 }
 
                 if (!((gtimerpos-gtimerlen)>>8)) {
+                    ticktime();
+                    MX_PROF_BEGIN(MX_PROF_DEVICE);
                     processtick();
+                    MX_PROF_END(MX_PROF_DEVICE);
+                    MX_PROF_BEGIN(MX_PROF_PLAYER);
                     playerproc();
+                    MX_PROF_END(MX_PROF_PLAYER);
                     cmdtimerpos+=umuldiv(gtimerlen, 256*65536, 12615*3600);
                     gtimerlen=umuldiv(256, 12615*256*256, orgspeed*relspeed);
                 }
@@ -1013,19 +1263,20 @@ static void timerrout()
     }
 
     if (stimerpos==stimerlen) {
+        ticktime();
         unsigned short sr = _disableint();
+        MX_PROF_BEGIN(MX_PROF_DEVICE);
         processtick();
+        MX_PROF_END(MX_PROF_DEVICE);
         _restoreint(sr);
+        MX_PROF_BEGIN(MX_PROF_PLAYER);
         playerproc();
+        MX_PROF_END(MX_PROF_PLAYER);
         cmdtimerpos+=stimerlen;
         stimerlen=umuldiv(256, 1193046*256, orgspeed*relspeed);
     }
 }
 
-static void voidtimer()
-{
-}
-
 static void calcfxvols()
 {
     if (iwType == GUSTYPE_GF1) {
@@ -1137,8 +1388,18 @@ static int LoadSamplesGF1(sampleinfo *sil, int n)
     s->type=si->type;
     s->redlev=(si->type&mcpSampRedRate4)?2:(si->type&mcpSampRedRate2)?1:0;
     int bit16=!!(si->type&mcpSamp16Bit);
+    unsigned long bytes=(s->length+2)<<bit16;
+    if (bit16) {
+      // 16-bit samples are addressed in words within a 256k block
+      mempos[0]=(mempos[0]+1)&~1UL;
+      if ((mempos[0]>>18)!=((mempos[0]+bytes-1)>>18))
+        mempos[0]=(mempos[0]+0x3FFFF)&~0x3FFFFUL;
+      s->pos=mempos[0];
+    }
+    if ((mempos[0]+bytes)>iwMem[0])
+      return 0;
     s->bank = 0;
-    mempos[0]+=(s->length+2)<<bit16;
+    mempos[0]+=bytes;
     if (s->loopstart==s->loopend)
       s->type&=~mcpSampLoop;
     dma16bit=bit16;
@@ -1159,47 +1420,590 @@ static int LoadSamplesGF1(sampleinfo *sil, int n)
 }
 
 
-static int LoadSamples(sampleinfo *sil, int n)
+static void samplehash(const void *ptr, unsigned long bytes, unsigned long *hash, unsigned long *sum)
 {
-    if (iwType == GUSTYPE_GF1) {
-        return LoadSamplesGF1(sil, n);
+    unsigned long h=5381;
+    unsigned long c=0;
+    const unsigned long *p=(const unsigned long*)ptr;
+    const unsigned long *e=p+(bytes>>2);
+    while (p<e) {
+        h=(h<<5)+h+*p++;
+        c+=h;
+    }
+    const unsigned char *b=(const unsigned char*)e;
+    for (int i=0; i<(bytes&3); i++) {
+        h=(h<<5)+h+*b++;
+        c+=h;
+    }
+    *hash=h;
+    *sum=c;
+}
+
+static int cachefind(unsigned long bytes, unsigned long hash, unsigned long sum)
+{
+    for (int i=0; i<cachenum; i++) {
+        if ((cache[i].bytes==bytes)&&(cache[i].hash==hash)&&(cache[i].sum==sum)) {
+            return i;
+        }
     }
-    dbgprintf("LoadSamples %d", n);
-    unsigned long samplen[MAXSAMPLES];
-    if (n>MAXSAMPLES) {
+    return -1;
+}
+
+static int cachealloc(unsigned long size)
+{
+    // best fit: the smallest free gap that holds the sample, so the
+    // large gaps stay free for large samples. Samples never cross a
+    // bank, which also keeps 16-bit samples inside their 8MB window.
+    int ins=-1;
+    unsigned char insbank=0;
+    unsigned long inspos=0;
+    unsigned long gap=0;
+    int i=0;
+    if (cachenum>=MAXCACHED) {
+        return -1;
+    }
+    for (unsigned char b=0; b<4; b++) {
+        unsigned long p=0;
+        while (1) {
+            int last=(i>=cachenum)||(cache[i].bank!=b);
+            unsigned long end=last ? iwMem[b] : cache[i].pos;
+            if ((end>p)&&((end-p)>=size)&&((ins<0)||((end-p)<gap))) {
+                gap=end-p;
+                ins=i;
+                insbank=b;
+                inspos=p;
+            }
+            if (last) {
+                break;
+            }
+            p=cache[i].pos+cache[i].size;
+            i++;
+        }
+    }
+    if (ins<0) {
+        return -1;
+    }
+    memmove(&cache[ins+1], &cache[ins], (cachenum-ins)*sizeof(iwcached));
+    cachenum++;
+    cache[ins].bank=insbank;
+    cache[ins].pos=inspos;
+    cache[ins].size=size;
+    return ins;
+}
+
+static int cacheevict()
+{
+    // drop the least recently used sample not used by the current module
+    int idx=-1;
+    for (int i=0; i<cachenum; i++) {
+        if ((cache[i].lastuse!=cachegen)&&((idx<0)||(cache[i].lastuse<cache[idx].lastuse))) {
+            idx=i;
+        }
+    }
+    if (idx<0) {
         return 0;
     }
+    cachenum--;
+    memmove(&cache[idx], &cache[idx+1], (cachenum-idx)*sizeof(iwcached));
+    cacheevicted++;
+    return 1;
+}
 
-    for (int sc=0; sc<n; sc++) {
-        samplen[sc] = (sil[sc].type & mcpSamp16Bit) ? (sil[sc].length << 1) : sil[sc].length;
+static void cachereport()
+{
+#ifdef DEBUG
+    int i=0;
+    for (unsigned char b=0; b<4; b++) {
+        if (!iwMem[b]) {
+            continue;
+        }
+        unsigned long p=0;
+        unsigned long avail=0;
+        unsigned long largest=0;
+        int gaps=0;
+        while (1) {
+            int last=(i>=cachenum)||(cache[i].bank!=b);
+            unsigned long end=last ? iwMem[b] : cache[i].pos;
+            if (end>p) {
+                avail+=end-p;
+                gaps++;
+                if ((end-p)>largest) {
+                    largest=end-p;
+                }
+            }
+            if (last) {
+                break;
+            }
+            p=cache[i].pos+cache[i].size;
+            i++;
+        }
+        // fragmentation is the part of free memory not in the largest gap
+        dbgprintf("bank %d: %ld kb free of %ld kb, largest gap %ld kb, %d gaps, %ld%% fragmented", b, avail/1024, iwMem[b]/1024, largest/1024, gaps, avail ? (100-(largest*100)/avail) : 0);
     }
+#endif
+}
 
-    int largestsample=0;
-    for (int sa=0; sa<n; sa++) {
-        if (samplen[sa]>samplen[largestsample]) {
-            largestsample=sa;
+
+static void setsample(iwsample *s, sampleinfo *si, unsigned char bank, unsigned long pos)
+{
+    s->pos=pos;
+    s->length=si->length;
+    s->loopstart=si->loopstart;
+    s->loopend=si->loopend;
+    s->sloopstart=si->sloopstart;
+    s->sloopend=si->sloopend;
+    s->samprate=si->samprate;
+    s->type=si->type;
+    s->redlev=(si->type&mcpSampRedRate4) ? 2 : (si->type&mcpSampRedRate2) ? 1 : 0;
+    s->bank=bank;
+    s->pending=0;
+    s->ptr=si->ptr;
+}
+
+
+static unsigned long samplebytes(iwsample *s)
+{
+    return (s->length+2)<<((s->type&mcpSamp16Bit) ? 1 : 0);
+}
+
+
+static const unsigned char *fixelem(iwsample *s, const sampleinfo *si, unsigned long idx)
+{
+    for (int k=0; k<s->nfix; k++) {
+        if (s->fixidx[k]==idx) {
+            return s->fix[k];
         }
     }
+    return (const unsigned char*)si->ptr+(idx<<((si->type&mcpSamp16Bit) ? 1 : 0));
+}
 
-    if (!mcpReduceSamples(sil, n, memsize-samplen[largestsample], mcpRedToMono)) {
-        dbgprintf("reduce %d fail", n);
+
+static void addfix(iwsample *s, const sampleinfo *si, unsigned long idx, const unsigned char *v)
+{
+    int k;
+    for (k=0; (k<s->nfix)&&(s->fixidx[k]!=idx); k++);
+    if (k==s->nfix) {
+        s->fixidx[s->nfix++]=idx;
+    }
+    s->fix[k][0]=v[0];
+    s->fix[k][1]=(si->type&mcpSamp16Bit) ? v[1] : 0;
+}
+
+
+static void samplefixups(iwsample *s, const sampleinfo *si)
+{
+    // what repairsmp in smpman writes within the uploaded length
+    s->nfix=0;
+    if (!(si->type&mcpSampRef)) {
+        return;
+    }
+    unsigned char v[2]={0,0};
+    memcpy(v, fixelem(s, si, si->length-1), (si->type&mcpSamp16Bit) ? 2 : 1);
+    addfix(s, si, si->length, v);
+    addfix(s, si, si->length+1, v);
+    if ((si->type&mcpSampSLoop)&&!(si->type&mcpSampSBiDi)) {
+        addfix(s, si, si->sloopend, fixelem(s, si, si->sloopstart));
+        addfix(s, si, si->sloopend+1, fixelem(s, si, si->sloopstart+1));
+    }
+    if ((si->type&mcpSampLoop)&&!(si->type&mcpSampBiDi)) {
+        addfix(s, si, si->loopend, fixelem(s, si, si->loopstart));
+        addfix(s, si, si->loopend+1, fixelem(s, si, si->loopstart+1));
+    }
+}
+
+
+static void samplekey(iwsample *s, const sampleinfo *si, unsigned long bytes, unsigned long *hash, unsigned long *sum)
+{
+    if (si->type&mcpSampRef) {
+        // same image in DRAM means same data and same fixups
+        samplehash(si->ptr, si->length<<((si->type&mcpSamp16Bit) ? 1 : 0), hash, sum);
+        for (int k=0; k<s->nfix; k++) {
+            *hash=(*hash<<5)+*hash+((s->fixidx[k]<<16)^(s->fix[k][0]<<8)^s->fix[k][1]);
+            *sum+=*hash;
+        }
+    } else {
+        samplehash(si->ptr, bytes, hash, sum);
+    }
+}
+
+
+static int comparesample(iwsample *s, const void *src, unsigned long offs, unsigned long len)
+{
+    // read back from DRAM and compare against the host copy
+    const unsigned short *ptr=(const unsigned short*)src;
+    unsigned long pos=(s->pos+offs)|(s->bank<<22);
+    int ok=1;
+    short sr = _disableint();
+    unsigned char lmci=inIW(0x53);
+    outIW(0x53,(lmci|0x01)&0x4D);           // enable auto increment
+    outp(iwPort+0x103, 0x44);               // hi byte address
+    outp(iwPort+0x105, (pos>>16));
+    outp(iwPort+0x103, 0x43);               // lo word address
+    outpw(iwPort+0x104, pos & 0xffff);
+    outp(iwPort+0x103, 0x51);               // auto incrementing reads
+    for (unsigned long i=0; i<(len>>1); i++) {
+        if (inpw(iwPort+0x104)!=ptr[i]) {
+            ok=0;
+            break;
+        }
+    }
+    outIW(0x53,lmci);                       // disable auto increment
+    if (ok&&(len&1)) {
+        ok=(peekIW(pos+len-1)==((const unsigned char*)ptr)[len-1]);
+    }
+    _restoreint(sr);
+    return ok;
+}
+
+
+static int uploadrange(iwsample *s, const void *src, unsigned long offs, unsigned long len)
+{
+    for (int tries=0; tries<2; tries++) {
+        dma16bit=(s->type&mcpSamp16Bit) ? 1 : 0;
+        dmaleft=len;
+        dmaxfer=(void*)src;
+        dmapos=(s->pos+offs)|(s->bank<<22);
+        short sr = _disableint();
+        slowupload();
+        _restoreint(sr);
+        if (!releasesamples||comparesample(s, src, offs, len)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+static int uploadsample(iwsample *s, unsigned long offs, unsigned long len)
+{
+    if (!(s->type&mcpSampRef)) {
+        return uploadrange(s, (char*)s->ptr+offs, offs, len);
+    }
+    // the module buffer holds the bare sample, fixups go on top of it
+    int bit16=(s->type&mcpSamp16Bit) ? 1 : 0;
+    unsigned long databytes=s->length<<bit16;
+    int ok=1;
+    if (offs<databytes) {
+        ok=uploadrange(s, (char*)s->ptr+offs, offs, ((offs+len)>databytes) ? (databytes-offs) : len);
+    }
+    for (int k=0; k<s->nfix; k++) {
+        unsigned long p=s->fixidx[k]<<bit16;
+        if ((p>=offs)&&(p<(offs+len))&&!uploadrange(s, s->fix[k], p, 1<<bit16)) {
+            ok=0;
+        }
+    }
+    return ok;
+}
+
+
+static void releasesample(int sa)
+{
+    iwsample *s=&samples[sa];
+    if (!releasesamples||!s->ptr||(s->type&mcpSampRef)) {
+        return;
+    }
+    hostbytes-=samplebytes(s);
+    free(loadsil[sa].ptr);
+    loadsil[sa].ptr=0;
+    s->ptr=0;
+}
+
+
+static void sampleresident(int sa, int ok)
+{
+    iwsample *s=&samples[sa];
+    s->pending=0;
+    for (int i=0; i<samplenum; i++) {
+        // samples sharing this upload are resident with it
+        if ((samples[i].pending==3)&&(samples[i].bank==s->bank)&&(samples[i].pos==s->pos)) {
+            samples[i].pending=0;
+            if (ok) {
+                releasesample(i);
+            }
+        }
+    }
+    for (int i=0; i<cachenum; i++) {
+        if ((cache[i].bank==s->bank)&&(cache[i].pos==s->pos)) {
+            cache[i].pending=0;
+            if (!ok) {
+                // DRAM does not hold what the hash says, never match it
+                cache[i].bytes=0;
+            }
+        }
+    }
+    if (ok) {
+        releasesample(sa);
+    } else {
+        dbgprintf("sample %d failed verify, keeping host copy", sa);
+    }
+}
+
+
+static void queuesample(int sa, int now)
+{
+    iwsample *s=&samples[sa];
+    if (s->pending!=1) {
+        return;
+    }
+    if (now) {
+        sampleresident(sa, uploadsample(s, 0, samplebytes(s)));
+    } else {
+        s->pending=2;
+        pendq[pendnum++]=sa;
+    }
+}
+
+
+static const void *loadimage(int smp, unsigned long idx)
+{
+    return fixelem(&samples[smp], &loadsil[smp], idx);
+}
+
+
+static void preloaddrop()
+{
+    // a half uploaded sample must not be found by a later load
+    for (int i=0; i<cachenum; i++) {
+        if (cache[i].pending==2) {
+            cachenum--;
+            memmove(&cache[i], &cache[i+1], (cachenum-i)*sizeof(iwcached));
+            i--;
+        }
+    }
+    presil=0;
+    presn=0;
+    prenum=0;
+    precur=0;
+    preoffs=0;
+}
+
+
+static int preloadplace(int sa)
+{
+    // DRAM for a sample of the next module, from free memory or samples no
+    // module uses. 0 when it is resident by now, -1 when there is no room
+    sampleinfo *si=&presil[sa];
+    unsigned long bytes=(si->length+2)<<((si->type&mcpSamp16Bit) ? 1 : 0);
+    unsigned long hash, sum;
+    samplefixups(&presmp, si);
+    samplekey(&presmp, si, bytes, &hash, &sum);
+    int idx=cachefind(bytes, hash, sum);
+    if (idx>=0) {
+        cache[idx].lastuse=cachegen;
         return 0;
     }
+    unsigned long size=(bytes+1)&~1UL;
+    idx=cachealloc(size);
+    while ((idx<0)&&cacheevict()) {
+        idx=cachealloc(size);
+    }
+    if (idx<0) {
+        return -1;
+    }
+    iwcached *e=&cache[idx];
+    e->hash=hash;
+    e->sum=sum;
+    e->bytes=bytes;
+    e->lastuse=cachegen;
+    e->pending=2;
+    setsample(&presmp, si, e->bank, e->pos);
+    return 1;
+}
 
-    samplenum=n;
 
-    mempos[0]=0; mempos[1]=0; mempos[2]=0; mempos[3]=0;
-    while(1)
-    {
-        largestbank=0;
-        lbsize=iwMem[0]-mempos[0];
-        for (unsigned char b=1; b<4; b++) {
-            if ((iwMem[b]-mempos[b])>lbsize) {
-                lbsize=iwMem[b]-mempos[b];
-                largestbank=b;
+static void preloadresident()
+{
+    for (int i=0; i<cachenum; i++) {
+        if ((cache[i].pending==2)&&(cache[i].bank==presmp.bank)&&(cache[i].pos==presmp.pos)) {
+            cache[i].pending=0;
+            if (!preok) {
+                cache[i].bytes=0;
+            }
+        }
+    }
+}
+
+
+static void PreloadIdle()
+{
+    for (int i=0; (i<IDLECHUNKS)&&(precur<prenum); i++) {
+        if (!preoffs) {
+            int r=preloadplace(preq[precur]);
+            if (r<0) {
+                // the module playing keeps its samples, the rest is uploaded on load
+                dbgprintf("preload: no room for sample %d, %d not uploaded", preq[precur], prenum-precur);
+                prenum=precur;
+                break;
+            }
+            if (!r) {
+                precur++;
+                continue;
             }
+            preok=1;
         }
+        unsigned long bytes=samplebytes(&presmp);
+        unsigned long len=bytes-preoffs;
+        if (len>IDLECHUNK) {
+            len=IDLECHUNK;
+        }
+        if (!uploadsample(&presmp, preoffs, len)) {
+            preok=0;
+        }
+        preoffs+=len;
+        if (preoffs>=bytes) {
+            preloadresident();
+            precur++;
+            preoffs=0;
+        }
+    }
+    if (precur>=prenum) {
+        dbgprintf("preload done");
+        cachereport();
+        mcpIdle=0;
+    }
+}
+
+
+static int PreloadSamples(sampleinfo *sil, int n)
+{
+    if (mcpIdle==PreloadIdle) {
+        mcpIdle=0;
+    }
+    preloaddrop();
+    if (!n||(iwType==GUSTYPE_GF1)||(n>MAXSAMPLES)) {
+        return 0;
+    }
+    dbgprintf("PreloadSamples %d", n);
 
+    // planned like LoadSamples does, which then takes the samples as they are
+    memcpy(mcpSampBanks, iwMem, sizeof(mcpSampBanks));
+    int ok=mcpReduceSamples(sil, n, memsize, mcpRedToMono|mcpRedKeepRef|mcpRedShare);
+    memset(mcpSampBanks, 0, sizeof(mcpSampBanks));
+    if (!ok) {
+        dbgprintf("reduce %d fail", n);
+        return 0;
+    }
+    presil=sil;
+    presn=n;
+
+    // samples still resident stay, the others are queued in order of first use
+    for (int i=0; i<n; i++) {
+        int sa=(mcpSampOrderNum==n) ? mcpSampOrder[i] : i;
+        sampleinfo *si=&sil[sa];
+        unsigned long bytes=(si->length+2)<<((si->type&mcpSamp16Bit) ? 1 : 0);
+        unsigned long hash, sum;
+        samplefixups(&presmp, si);
+        samplekey(&presmp, si, bytes, &hash, &sum);
+        int idx=cachefind(bytes, hash, sum);
+        if (idx>=0) {
+            cache[idx].lastuse=cachegen;
+        } else {
+            preq[prenum++]=sa;
+        }
+    }
+    dbgprintf("preload: %d resident, %d queued", n-prenum, prenum);
+    if (prenum&&!mcpIdle) {
+        mcpIdle=PreloadIdle;
+    }
+    return 1;
+}
+
+
+static void UploadIdle()
+{
+    for (int i=0; (i<IDLECHUNKS)&&(pendcur<pendnum); i++) {
+        iwsample *s=&samples[pendq[pendcur]];
+        unsigned long bytes=samplebytes(s);
+        unsigned long len=bytes-pendoffs;
+        if (len>IDLECHUNK) {
+            len=IDLECHUNK;
+        }
+        if (!pendoffs) {
+            pendok=1;
+        }
+        if (!uploadsample(s, pendoffs, len)) {
+            pendok=0;
+        }
+        pendoffs+=len;
+        if (pendoffs>=bytes) {
+            sampleresident(pendq[pendcur], pendok);
+            pendcur++;
+            pendoffs=0;
+        }
+    }
+    if (pendcur>=pendnum) {
+        dbgprintf("background upload done, host samples: %ld kb peak, %ld kb resident", hostpeak/1024, hostbytes/1024);
+        mcpIdle=(precur<prenum) ? PreloadIdle : 0;
+    }
+}
+
+
+static int UploadSamples(sampleinfo *sil, int n)
+{
+    static unsigned long samplen[MAXSAMPLES];
+    int hits=0;
+    int misses=0;
+    int shared=0;
+    unsigned long hitbytes=0;
+    unsigned long sharedbytes=0;
+    unsigned long missbytes=0;
+    cacheevicted=0;
+    cachegen++;
+
+    // anything left over from an unfinished background upload is invalid
+    mcpIdle=0;
+    pendnum=0;
+    pendcur=0;
+    pendoffs=0;
+    loadsil=sil;
+    hostbytes=0;
+    for (int i=0; i<cachenum; i++) {
+        if (cache[i].pending) {
+            cachenum--;
+            memmove(&cache[i], &cache[i+1], (cachenum-i)*sizeof(iwcached));
+            i--;
+        }
+    }
+
+    for (int sa=0; sa<n; sa++) {
+        sampleinfo *si=&sil[sa];
+        int bit16=(si->type&mcpSamp16Bit) ? 1 : 0;
+        samplefixups(&samples[sa], si);
+        smpbody[sa]=mcpChecksum(si->ptr, si->length<<bit16);
+    }
+    mcpGroupSamples(sil, n, smpbody, smplead, loadimage);
+
+    // samples still resident from an earlier module are not sent again
+    for (int sa=0; sa<n; sa++) {
+        sampleinfo *si=&sil[sa];
+        int bit16=(si->type&mcpSamp16Bit) ? 1 : 0;
+        samplen[sa]=(si->length+2)<<bit16;
+        smphit[sa]=0;
+        if (!(si->type&mcpSampRef)) {
+            hostbytes+=samplen[sa];
+        }
+        if (smplead[sa]!=sa) {
+            sharedbytes+=samplen[sa];
+            samplen[sa]=0;
+            shared++;
+            continue;
+        }
+        samplekey(&samples[sa], si, samplen[sa], &smphash[sa], &smpsum[sa]);
+        int idx=cachefind(samplen[sa], smphash[sa], smpsum[sa]);
+        if (idx>=0) {
+            smphit[sa]=1;
+            cache[idx].lastuse=cachegen;
+            setsample(&samples[sa], si, cache[idx].bank, cache[idx].pos);
+            hitbytes+=samplen[sa];
+            samplen[sa]=0;
+            hits++;
+        }
+    }
+
+    // the rest is placed largest first
+    while(1)
+    {
+        int largestsample=0;
         for (int sa=0; sa<n; sa++) {
             if (samplen[sa]>samplen[largestsample]) {
                 largestsample=sa;
@@ -1207,36 +2011,107 @@ static int LoadSamples(sampleinfo *sil, int n)
         }
 
         if (!samplen[largestsample]) {
-            return 1;
+            break;
         }
 
-        if (samplen[largestsample]>lbsize) {
+        // uploads are not DMA, word alignment is enough for 16-bit samples
+        unsigned long size=(samplen[largestsample]+1)&~1UL;
+        int idx=cachealloc(size);
+        while ((idx<0)&&cacheevict()) {
+            idx=cachealloc(size);
+        }
+        if (idx<0) {
             return 0;
         }
 
-        sampleinfo *si=&sil[largestsample];
-        iwsample *s=&samples[largestsample];
-        s->pos=mempos[largestbank];
-        s->length=si->length;
-        s->loopstart=si->loopstart;
-        s->loopend=si->loopend;
-        s->sloopstart=si->sloopstart;
-        s->sloopend=si->sloopend;
-        s->samprate=si->samprate;
-        s->type=si->type;
-        s->redlev=(si->type&mcpSampRedRate4) ? 2 : (si->type&mcpSampRedRate2) ? 1 : 0;
-        int bit16=(si->type&mcpSamp16Bit) ? 1 : 0;
-        s->bank=largestbank;
-        mempos[largestbank]+=(((s->length+2)<<bit16)+31)&~31UL;
-        dma16bit=bit16;
-        dmaleft=(s->length+2)<<dma16bit;
-        dmaxfer=si->ptr;
-        dmapos=s->pos|(s->bank<<22);
-        short sr = _disableint();
-        slowupload();
-        _restoreint(sr);
+        iwcached *e=&cache[idx];
+        e->hash=smphash[largestsample];
+        e->sum=smpsum[largestsample];
+        e->bytes=samplen[largestsample];
+        e->lastuse=cachegen;
+        e->pending=1;
+
+        setsample(&samples[largestsample], &sil[largestsample], e->bank, e->pos);
+        samples[largestsample].pending=1;
+        missbytes+=samplen[largestsample];
         samplen[largestsample]=0;
-        s->ptr=si->ptr;
+        misses++;
+    }
+
+    // the others play from the copy of their group
+    for (int sa=0; sa<n; sa++) {
+        int ld=smplead[sa];
+        if (ld!=sa) {
+            setsample(&samples[sa], &sil[sa], samples[ld].bank, samples[ld].pos);
+            samples[sa].pending=samples[ld].pending ? 3 : 0;
+            smphit[sa]=smphit[ld];
+        }
+    }
+
+    // upload what is needed right away and queue the rest in order of first use
+    for (int i=0; i<mcpSampOrderNum; i++) {
+        if (mcpSampOrder[i]<n) {
+            queuesample(smplead[mcpSampOrder[i]], i<mcpSampPreload);
+        }
+    }
+    for (int sa=0; sa<n; sa++) {
+        queuesample(sa, !mcpSampOrder);
+    }
+    if (pendnum) {
+        mcpIdle=UploadIdle;
+    }
+
+    // resident samples from the cache were verified when they were uploaded
+    hostpeak=hostbytes;
+    for (int sa=0; sa<n; sa++) {
+        if (smphit[sa]) {
+            releasesample(sa);
+        }
+    }
+
+    dbgprintf("sample cache: %d hits (%ld kb), %d shared (%ld kb), %d misses (%ld kb), %d evicted, %d queued", hits, hitbytes/1024, shared, sharedbytes/1024, misses, missbytes/1024, cacheevicted, pendnum);
+    dbgprintf("host samples: %ld kb peak, %ld kb resident", hostpeak/1024, hostbytes/1024);
+    cachereport();
+    return 1;
+}
+
+
+static int LoadSamples(sampleinfo *sil, int n)
+{
+    if (iwType == GUSTYPE_GF1) {
+        return LoadSamplesGF1(sil, n);
+    }
+    dbgprintf("LoadSamples %d", n);
+    int preloaded=(sil==presil)&&(n==presn);
+    preloaddrop();
+    if (n>MAXSAMPLES) {
+        return 0;
+    }
+
+    // the planner checks the fit per bank instead of keeping the size
+    // of the largest sample in reserve for fragmentation. A preloaded
+    // module was reduced by PreloadSamples already.
+    if (!preloaded) {
+        memcpy(mcpSampBanks, iwMem, sizeof(mcpSampBanks));
+        int ok=mcpReduceSamples(sil, n, memsize, mcpRedToMono|mcpRedKeepRef|mcpRedShare);
+        memset(mcpSampBanks, 0, sizeof(mcpSampBanks));
+        if (!ok) {
+            dbgprintf("reduce %d fail", n);
+            return 0;
+        }
+    }
+
+    samplenum=n;
+
+    if (!UploadSamples(sil, n)) {
+        // fragmented by samples kept for this module, start over from a clean slate
+        dbgprintf("sample cache flush");
+        cachenum=0;
+        if (!UploadSamples(sil, n)) {
+            // a cached plan would fail the same way every time
+            mcpDropCache();
+            return 0;
+        }
     }
     return 1;
 }
@@ -1332,6 +2207,7 @@ static void Pause(int p)
         }
         stimerpos=0;
         gtimerpos=0;
+        tickstamp=0;
         paused=0;
         if (useiwtimer) {
             settimer(0x04);
@@ -1457,6 +2333,9 @@ static void SET(int ch, int opt, int val)
         case mcpMasterFilter:
             filter=val;
             break;
+        case mcpMasterReleaseSamples:
+            releasesamples=val;
+            break;
     }
 }
 
@@ -1476,6 +2355,16 @@ static int GET(int ch, int opt)
                 return tmGetTimer();
         case mcpGCmdTimer:
             return umulshr16(cmdtimerpos, 3600);
+        case mcpGRegWrites:
+            return regwrites;
+        case mcpGRegSkips:
+            return regskips;
+        case mcpGTicks:
+            return tickcount;
+        case mcpGTickJitter:
+            return ticklate;
+        case mcpGTickJitterMax:
+            return tickmaxlate;
     }
     return 0;
 }
@@ -1502,14 +2391,19 @@ static int OpenPlayer(int chan, void (*proc)())
     delayIW(10);
 
     cmdtimerpos=0;
+    tickstamp=0;
+    tickcount=0;
+    ticklate=0;
+    tickmaxlate=0;
     if (useiwtimer && irqInit(iwIRQ, irqrout, 1, 8192)) {
-        // ultrasound timer
+        // ultrasound timer, timer a stays free
+        dbgprintf("ticks from interwave timer, irq %d", iwIRQ);
         gtimerlen=umuldiv(256, 12615*256*256, orgspeed*relspeed);
         gtimerpos=gtoldlen=gtimerlen;
         settimerlen(((gtimerpos>>8)<=256)?(256-(gtimerpos>>8)):0);
         settimer(0x04);
-        tmInit(voidtimer, 65536, 256);
     } else {
+        dbgprintf("ticks from mfp timer a");
         // system timer
         useiwtimer = false;
         stimerlen=umuldiv(256, 1193046*256, orgspeed*relspeed);
@@ -1527,9 +2421,10 @@ static void ClosePlayer()
 {
     mcpNChan=0;
 
-    tmClose();
     if (useiwtimer) {
         irqClose();
+    } else {
+        tmClose();
     }
 
     initiw(1,0);
@@ -1554,6 +2449,7 @@ static int initu(const deviceinfo *c)
 
     iwPort=c->port;
     iwIRQ=c->irq;
+    cachenum=0;
 
     channelnum=0;
     filter=0;
@@ -1581,6 +2477,7 @@ static int initu(const deviceinfo *c)
     }
 
     mcpLoadSamples=LoadSamples;
+    mcpPreloadSamples=PreloadSamples;
     mcpOpenPlayer=OpenPlayer;
     mcpClosePlayer=ClosePlayer;
     mcpSet=SET;
@@ -8,18 +8,21 @@
 //    -first release
 
 #include <string.h>
+#include <stdlib.h>
 #include "binfile.h"
 #include "mcp.h"
 #include "gmdplay.h"
 #include "err.h"
 
-static inline void putcmd(unsigned char *&p, unsigned char c, unsigned char d)
+static inline void putcmd(unsigned char **pp, unsigned char c, unsigned char d)
 {
+  unsigned char *p=*pp;
   *p++=c;
   *p++=d;
+  *pp=p;
 }
 
-extern "C" int mpLoad669(gmdmodule &m, binfile &file)
+int mpLoad669(gmdmodule *m, binfile *file)
 {
   mpReset(m);
 
@@ -35,57 +38,60 @@ extern "C" int mpLoad669(gmdmodule &m, binfile &file)
     unsigned char patlen[0x80];
   } hdr;
 
-  file.read(&hdr, sizeof(hdr));
-  if ((hdr.sig!=*(unsigned short*)"if")&&(hdr.sig!=*(unsigned short*)"JN"))
+  bf_read(file, &hdr, 497);
+  if (memcmp(&hdr.sig, "if", 2)&&memcmp(&hdr.sig, "JN", 2))
     return errFormSig;
 
-  memcpy(m.name, hdr.msg, 31);
-  m.name[31]=0;
+  memcpy(m->name, hdr.msg, 31);
+  m->name[31]=0;
 
   int t;
-  m.channum=8;
-  m.instnum=hdr.insnum;
-  m.sampnum=hdr.insnum;
-  m.modsampnum=hdr.insnum;
-  m.options=0;
-  m.loopord=hdr.loop;
-
-  m.patnum=0x80;
+  m->channum=8;
+  m->instnum=hdr.insnum;
+  m->sampnum=hdr.insnum;
+  m->modsampnum=hdr.insnum;
+  m->options=0;
+  m->loopord=hdr.loop;
+
+  m->patnum=0x80;
   for (t=0x7F; t>=0; t--)
   {
     if (hdr.orders[t]<hdr.patnum)
       break;
-    m.patnum--;
+    m->patnum--;
   }
-  if (!m.patnum)
+  if (!m->patnum)
     return errFormMiss;
-  m.ordnum=m.patnum;
-  m.endord=m.patnum;
+  m->ordnum=m->patnum;
+  m->endord=m->patnum;
 
-  m.tracknum=m.patnum*9;
+  m->tracknum=m->patnum*9;
 
-  m.message=new char *[4];
-  char *msg=new char [111];
-  if (!mpAllocInstruments(m, m.instnum)||!mpAllocTracks(m, m.tracknum)||!mpAllocPatterns(m, m.patnum)||!mpAllocSamples(m, m.sampnum)||!mpAllocModSamples(m, m.modsampnum)||!m.message||!msg||!mpAllocOrders(m, m.ordnum))
+  // tables and packed tracks share one arena, roughly 2 bytes per track row
+  ar_init(&m->heap, m->tracknum*(sizeof(gmdtrack)+128)+m->patnum*sizeof(gmdpattern)+m->instnum*(sizeof(gmdinstrument)+sizeof(gmdsample)+sizeof(sampleinfo)));
+
+  m->message=malloc((4)*sizeof(char *));
+  char *msg=malloc(111);
+  if (!mpAllocInstruments(m, m->instnum)||!mpAllocTracks(m, m->tracknum)||!mpAllocPatterns(m, m->patnum)||!mpAllocSamples(m, m->sampnum)||!mpAllocModSamples(m, m->modsampnum)||!m->message||!msg||!mpAllocOrders(m, m->ordnum))
     return errAllocMem;
 
-  m.message[0]=msg;
-  m.message[1]=msg+37;
-  m.message[2]=msg+74;
-  m.message[3]=0;
-  memcpy(m.message[0], hdr.msg, 36);
-  m.message[0][36]=0;
-  memcpy(m.message[1], hdr.msg+36, 36);
-  m.message[1][36]=0;
-  memcpy(m.message[2], hdr.msg+72, 36);
-  m.message[2][36]=0;
+  m->message[0]=msg;
+  m->message[1]=msg+37;
+  m->message[2]=msg+74;
+  m->message[3]=0;
+  memcpy(m->message[0], hdr.msg, 36);
+  m->message[0][36]=0;
+  memcpy(m->message[1], hdr.msg+36, 36);
+  m->message[1][36]=0;
+  memcpy(m->message[2], hdr.msg+72, 36);
+  m->message[2][36]=0;
 
   int i,j;
-  for (i=0; i<m.ordnum; i++)
-    m.orders[i]=i;
+  for (i=0; i<m->ordnum; i++)
+    m->orders[i]=i;
 
   gmdpattern *pp;
-  for (pp=m.patterns, t=0; t<m.patnum; pp++, t++)
+  for (pp=m->patterns, t=0; t<m->patnum; pp++, t++)
   {
     pp->patlen=hdr.patlen[hdr.orders[t]]+1;
     for (i=0; i<8; i++)
@@ -93,7 +99,7 @@ extern "C" int mpLoad669(gmdmodule &m, binfile &file)
     pp->gtrack=t*9+8;
   }
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
     struct
     {
@@ -103,49 +109,53 @@ extern "C" int mpLoad669(gmdmodule &m, binfile &file)
       unsigned long loopend;
     } sins;
 
-    file.read(&sins, sizeof(sins));
+    // 25 byte records, the longs are not word aligned
+    bf_read(file, sins.name, 13);
+    sins.length=bf_getul(file);
+    sins.loopstart=bf_getul(file);
+    sins.loopend=bf_getul(file);
 
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
 
-    memcpy(ip.name, sins.name, 13);
+    memcpy(ip->name, sins.name, 13);
     if (!sins.length)
       continue;
 
     for (j=0; j<128; j++)
-      ip.samples[j]=i;
-
-    *sp.name=0;
-    sp.handle=i;
-    sp.normnote=0;
-    sp.stdvol=-1;
-    sp.stdpan=-1;
-    sp.opt=0;
-
-    sip.length=sins.length;
-    sip.loopstart=sins.loopstart;
-    sip.loopend=sins.loopend;
-    sip.samprate=8448; // ??
-    sip.type=((sins.loopend<=sins.length)?mcpSampLoop:0)|mcpSampUnsigned;
+      ip->samples[j]=i;
+
+    *sp->name=0;
+    sp->handle=i;
+    sp->normnote=0;
+    sp->stdvol=-1;
+    sp->stdpan=-1;
+    sp->opt=0;
+
+    sip->length=sins.length;
+    sip->loopstart=sins.loopstart;
+    sip->loopend=sins.loopend;
+    sip->samprate=8448; // ??
+    sip->type=((sins.loopend<=sins.length)?mcpSampLoop:0)|mcpSampUnsigned;
   }
 
-  unsigned char *buffer=new unsigned char[0x600*hdr.patnum];
-  unsigned char *temptrack=new unsigned char [2000];
+  unsigned char *buffer=malloc(0x600*hdr.patnum);
+  unsigned char *temptrack=malloc(2000);
   if (!temptrack||!buffer)
     return errAllocMem;
 
   char chanused[8];
   memset(chanused, 0, 8);
 
-  file.read(buffer, 0x600*hdr.patnum);
+  bf_read(file, buffer, 0x600*hdr.patnum);
 
   unsigned char commands[8];
   unsigned char data[8];
   for (t=0; t<8; t++)
     commands[t]=0xFF;
 
-  for (t=0; t<m.patnum; t++)
+  for (t=0; t<m->patnum; t++)
   {
     short j;
     for (j=0; j<8; j++)
@@ -194,26 +204,26 @@ extern "C" int mpLoad669(gmdmodule &m, binfile &file)
 
         if ((bp[0]!=0xFF)||(pan!=-1))
         {
-          unsigned char &act=*cp;
+          unsigned char *act=cp;
           *cp++=cmdPlayNote;
           if (ins!=-1)
           {
-            act|=cmdPlayIns;
+            *act|=cmdPlayIns;
             *cp++=ins;
           }
           if (nte!=-1)
           {
-            act|=cmdPlayNte;
+            *act|=cmdPlayNte;
             *cp++=nte;
           }
           if (vol!=-1)
           {
-            act|=cmdPlayVol;
+            *act|=cmdPlayVol;
             *cp++=vol;
           }
           if (pan!=-1)
           {
-            act|=cmdPlayPan;
+            *act|=cmdPlayPan;
             *cp++=pan;
           }
         }
@@ -221,19 +231,19 @@ extern "C" int mpLoad669(gmdmodule &m, binfile &file)
         switch (commands[j])
         {
         case 0:
-          putcmd(cp, cmdPitchSlideUp, data[j]);
+          putcmd(&cp, cmdPitchSlideUp, data[j]);
           break;
         case 1:
-          putcmd(cp, cmdPitchSlideDown, data[j]);
+          putcmd(&cp, cmdPitchSlideDown, data[j]);
           break;
         case 2:
-          putcmd(cp, cmdPitchSlideToNote, data[j]);
+          putcmd(&cp, cmdPitchSlideToNote, data[j]);
           break;
         case 3:
-          putcmd(cp, cmdRowPitchSlideUp, data[j]<<2); // correct? down? both?
+          putcmd(&cp, cmdRowPitchSlideUp, data[j]<<2); // correct? down? both?
           break;
         case 4:
-          putcmd(cp, cmdPitchVibrato, (data[j]<<4)|1);
+          putcmd(&cp, cmdPitchVibrato, (data[j]<<4)|1);
           break;
         }
 
@@ -245,18 +255,18 @@ extern "C" int mpLoad669(gmdmodule &m, binfile &file)
         }
       }
 
-      gmdtrack &trk=m.tracks[t*9+j];
+      gmdtrack *trk=&m->tracks[t*9+j];
       unsigned short len=tp-temptrack;
 
       if (!len)
-        trk.ptr=trk.end=0;
+        trk->ptr=trk->end=0;
       else
       {
-        trk.ptr=new unsigned char[len];
-        trk.end=trk.ptr+len;
-        if (!trk.ptr)
+        trk->ptr=ar_alloc(&m->heap, len);
+        trk->end=trk->ptr+len;
+        if (!trk->ptr)
           return errAllocMem;
-        memcpy(trk.ptr, temptrack, len);
+        memcpy(trk->ptr, temptrack, len);
       }
     }
 
@@ -271,8 +281,8 @@ extern "C" int mpLoad669(gmdmodule &m, binfile &file)
       if (!row)
       {
         if (!t)
-          putcmd(cp, cmdSpeed, 78);
-        putcmd(cp, cmdTempo, hdr.tempo[hdr.orders[t]]);
+          putcmd(&cp, cmdSpeed, 78);
+        putcmd(&cp, cmdTempo, hdr.tempo[hdr.orders[t]]);
       }
 
       unsigned char q;
@@ -280,7 +290,7 @@ extern "C" int mpLoad669(gmdmodule &m, binfile &file)
       {
         if ((bp[2]>>4)==5)
           if (bp[2]&0xF)
-            putcmd(cp, cmdTempo, bp[2]&0xF);
+            putcmd(&cp, cmdTempo, bp[2]&0xF);
       }
 
       if (cp!=(tp+2))
@@ -291,45 +301,45 @@ extern "C" int mpLoad669(gmdmodule &m, binfile &file)
       }
     }
 
-    gmdtrack &trk=m.tracks[t*9+8];
+    gmdtrack *trk=&m->tracks[t*9+8];
     unsigned short len=tp-temptrack;
 
     if (!len)
-      trk.ptr=trk.end=0;
+      trk->ptr=trk->end=0;
     else
     {
-      trk.ptr=new unsigned char[len+8];
-      trk.end=trk.ptr+len;
-      if (!trk.ptr)
+      trk->ptr=ar_alloc(&m->heap, len+8);
+      trk->end=trk->ptr+len;
+      if (!trk->ptr)
         return errAllocMem;
-      memcpy(trk.ptr, temptrack, len);
+      memcpy(trk->ptr, temptrack, len);
     }
   }
-  delete buffer;
-  delete temptrack;
+  free(buffer);
+  free(temptrack);
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
 
-    if (sp.handle==0xFFFF)
+    if (sp->handle==0xFFFF)
       continue;
 
-    sip.ptr=new char [sip.length];
-    if (!sip.ptr)
+    sip->ptr=malloc(sip->length);
+    if (!sip->ptr)
       return errAllocMem;
-    file.read(sip.ptr, sip.length);
+    bf_read(file, sip->ptr, sip->length);
   }
 
-//  for (i=m.channum-1; i>=0; i--)
+//  for (i=m->channum-1; i>=0; i--)
 //  {
 //    if (chanused[i])
 //      break;
-//    m.channum--;
+//    m->channum--;
 //  }
-// if (!m.channum)
+// if (!m->channum)
 //    return MP_LOADFILE;
 
   return errOk;
@@ -10,15 +10,18 @@
 // ENVELOPES & SUSTAIN!!!
 
 #include <string.h>
+#include <stdlib.h>
 #include "binfile.h"
 #include "mcp.h"
 #include "gmdplay.h"
 #include "err.h"
 
-static inline void putcmd(unsigned char *&p, unsigned char c, unsigned char d)
+static inline void putcmd(unsigned char **pp, unsigned char c, unsigned char d)
 {
+  unsigned char *p=*pp;
   *p++=c;
   *p++=d;
+  *pp=p;
 }
 
 static const unsigned char envsin[513]=
@@ -30,22 +33,22 @@ static const unsigned char envsin[513]=
 };
 
 
-extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
+int mpLoadAMS(gmdmodule *m, binfile *file)
 {
   mpReset(m);
 
   unsigned char sig[8];
-  file.read(sig, 8);
+  bf_read(file, sig, 8);
   if (!memcmp(sig, "Extreme", 7))
     return errFormOldVer;
   if (memcmp(sig, "AMShdr\x1A", 7))
     return errFormSig;
 
-  file.read(m.name, sig[7]);
-  m.name[sig[7]]=0;
+  bf_read(file, m->name, sig[7]);
+  m->name[sig[7]]=0;
 
   unsigned short filever;
-  filever=file.gets();
+  filever=bf_gets(file);
   if ((filever!=0x201)&&(filever!=0x202))
     return errFormOldVer;
 
@@ -78,7 +81,13 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
 //                         Pack byte samples
 //                         MIDI channels are used in tune.
     } oldhdr;
-    file.read(&oldhdr, sizeof(oldhdr));
+    // the file layout is packed, read field by field
+    oldhdr.ins=bf_getc(file);
+    oldhdr.pat=bf_getus(file);
+    oldhdr.pos=bf_getus(file);
+    oldhdr.bpm=bf_getc(file);
+    oldhdr.speed=bf_getc(file);
+    oldhdr.flags=bf_getc(file);
     hdr.ins=oldhdr.ins;
     hdr.pat=oldhdr.pat;
     hdr.pos=oldhdr.pos;
@@ -87,25 +96,35 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
     hdr.flags=(oldhdr.flags&0xC0)|0x20;
   }
   else
-    file.read(&hdr, sizeof(hdr));
+  {
+    hdr.ins=bf_getc(file);
+    hdr.pat=bf_getus(file);
+    hdr.pos=bf_getus(file);
+    hdr.bpm=bf_getus(file);
+    hdr.speed=bf_getc(file);
+    hdr.defchn=bf_getc(file);
+    hdr.defcmd=bf_getc(file);
+    hdr.defrow=bf_getc(file);
+    hdr.flags=bf_getus(file);
+  }
 
-  m.options=((hdr.flags&0x40)?MOD_EXPOFREQ:0)|MOD_EXPOPITCHENV;
+  m->options=((hdr.flags&0x40)?MOD_EXPOFREQ:0)|MOD_EXPOPITCHENV;
 
-  m.channum=32;
-  m.instnum=hdr.ins;
-  m.envnum=hdr.ins*3;
-  m.patnum=hdr.pat+1;
-  m.ordnum=hdr.pos;
-  m.endord=hdr.pos;
-  m.tracknum=33*hdr.pat+1;
-  m.loopord=0;
+  m->channum=32;
+  m->instnum=hdr.ins;
+  m->envnum=hdr.ins*3;
+  m->patnum=hdr.pat+1;
+  m->ordnum=hdr.pos;
+  m->endord=hdr.pos;
+  m->tracknum=33*hdr.pat+1;
+  m->loopord=0;
 
   unsigned short *ordlist;
-  ordlist=new unsigned short[hdr.pos];
-  sampleinfo **smps=new sampleinfo *[m.instnum];
-  gmdsample **msmps=new gmdsample *[m.instnum];
-  int *instsampnum=new int [m.instnum];
-  if (!ordlist||!mpAllocInstruments(m, m.instnum)||!mpAllocPatterns(m, m.patnum)||!mpAllocTracks(m, m.tracknum)||!mpAllocEnvelopes(m, m.envnum)||!smps||!msmps||!mpAllocOrders(m, m.ordnum)||!instsampnum)
+  ordlist=malloc((hdr.pos)*sizeof(unsigned short));
+  sampleinfo **smps=malloc((m->instnum)*sizeof(sampleinfo *));
+  gmdsample **msmps=malloc((m->instnum)*sizeof(gmdsample *));
+  int *instsampnum=malloc((m->instnum)*sizeof(int));
+  if (!ordlist||!mpAllocInstruments(m, m->instnum)||!mpAllocPatterns(m, m->patnum)||!mpAllocTracks(m, m->tracknum)||!mpAllocEnvelopes(m, m->envnum)||!smps||!msmps||!mpAllocOrders(m, m->ordnum)||!instsampnum)
     return errAllocMem;
 
   int i,j,t;
@@ -113,29 +132,29 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
   unsigned char namelen;
   unsigned char shadowedby[256];
 
-  m.sampnum=0;
-  m.modsampnum=0;
-  for (i=0; i<m.instnum; i++)
+  m->sampnum=0;
+  m->modsampnum=0;
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
+    gmdinstrument *ip=&m->instruments[i];
     smps[i]=0;
     msmps[i]=0;
     shadowedby[i]=0;
 
     unsigned char smpnum;
-    namelen=file.getc();
+    namelen=bf_getc(file);
 
-    file.read(ip.name, namelen);
-    ip.name[namelen]=0;
+    bf_read(file, ip->name, namelen);
+    ip->name[namelen]=0;
 
-    smpnum=file.getc();
+    smpnum=bf_getc(file);
     instsampnum[i]=smpnum;
 
     if (!smpnum)
       continue;
 
-    msmps[i]=new gmdsample[smpnum];
-    smps[i]=new sampleinfo[smpnum];
+    msmps[i]=malloc((smpnum)*sizeof(gmdsample));
+    smps[i]=malloc((smpnum)*sizeof(sampleinfo));
     if (!smps[i]||!msmps[i])
       return errAllocMem;
 
@@ -155,18 +174,18 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
     } envs[3];
     unsigned short envflags;
 
-    file.read(samptab, 120);
+    bf_read(file, samptab, 120);
     for (j=0; j<3; j++)
     {
-      file.read(&envs[j], 5);
-      file.read(envs[j].data, envs[j].points*3);
+      bf_read(file, &envs[j], 5);
+      bf_read(file, envs[j].data, envs[j].points*3);
     }
 
     unsigned char vibsweep=0;
     unsigned char shadowinst;
     unsigned short volfade;
 
-    shadowinst=file.getc();
+    shadowinst=bf_getc(file);
     if (filever==0x201)
     {
       vibsweep=shadowinst;
@@ -174,8 +193,8 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
     }
     shadowedby[i]=shadowinst;
 
-    volfade=file.gets();
-    envflags=file.gets();
+    volfade=bf_gets(file);
+    envflags=bf_gets(file);
 
     unsigned char pchint=(volfade>>12)&3;
     volfade&=0xFFF;
@@ -190,7 +209,7 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
         for (t=1; t<envs[j].points; t++)
           envlen+=((envs[j].data[t][1]&1)<<8)|envs[j].data[t][0];
 
-        unsigned char *env=new unsigned char [envlen+1];
+        unsigned char *env=malloc(envlen+1);
         if (!env)
           return errAllocMem;
 
@@ -238,15 +257,15 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
             lend+=((envs[j].data[t][1]&1)<<8)|envs[j].data[t][0];
         }
 
-        m.envelopes[i*3+j].env=env;
-        m.envelopes[i*3+j].len=envlen;
-        m.envelopes[i*3+j].type=0;
-        m.envelopes[i*3+j].speed=envs[j].speed;
+        m->envelopes[i*3+j].env=env;
+        m->envelopes[i*3+j].len=envlen;
+        m->envelopes[i*3+j].type=0;
+        m->envelopes[i*3+j].speed=envs[j].speed;
         if (sus!=-1)
         {
-          m.envelopes[i*3+j].sloops=sus;
-          m.envelopes[i*3+j].sloope=sus+1;
-          m.envelopes[i*3+j].type=mpEnvSLoop;
+          m->envelopes[i*3+j].sloops=sus;
+          m->envelopes[i*3+j].sloope=sus+1;
+          m->envelopes[i*3+j].type=mpEnvSLoop;
         }
         if (lst!=-1)
         {
@@ -254,43 +273,43 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
           {
             if (lend<sus)
             {
-              m.envelopes[i*3+j].sloops=lst;
-              m.envelopes[i*3+j].sloope=lend;
-              m.envelopes[i*3+j].type=mpEnvSLoop;
+              m->envelopes[i*3+j].sloops=lst;
+              m->envelopes[i*3+j].sloope=lend;
+              m->envelopes[i*3+j].type=mpEnvSLoop;
             }
           }
           else
           {
-            m.envelopes[i*3+j].loops=lst;
-            m.envelopes[i*3+j].loope=lend;
-            m.envelopes[i*3+j].type=mpEnvLoop;
+            m->envelopes[i*3+j].loops=lst;
+            m->envelopes[i*3+j].loope=lend;
+            m->envelopes[i*3+j].type=mpEnvLoop;
           }
         }
       }
 
-    memset(ip.samples, -1, 128*2);
+    memset(ip->samples, -1, 128*2);
 
-    for (j=0; j<smpnum; j++, m.sampnum++, m.modsampnum++)
+    for (j=0; j<smpnum; j++, m->sampnum++, m->modsampnum++)
     {
-      gmdsample &sp=msmps[i][j];
-      sampleinfo &sip=smps[i][j];
+      gmdsample *sp=&msmps[i][j];
+      sampleinfo *sip=&smps[i][j];
 
       int k;
       for (k=0; k<116; k++)
         if (samptab[k]==j)
-          ip.samples[k+12]=m.modsampnum;
-
-      sp.handle=0xFFFF;
-      sp.volenv=0xFFFF;
-      sp.panenv=0xFFFF;
-      sp.pchenv=0xFFFF;
-      sp.volfade=0xFFFF;
-
-      namelen=file.getc();
-      file.read(sp.name, namelen);
-      sp.name[namelen]=0;
-      sip.length=file.getl();
-      if (!sip.length)
+          ip->samples[k+12]=m->modsampnum;
+
+      sp->handle=0xFFFF;
+      sp->volenv=0xFFFF;
+      sp->panenv=0xFFFF;
+      sp->pchenv=0xFFFF;
+      sp->volfade=0xFFFF;
+
+      namelen=bf_getc(file);
+      bf_read(file, sp->name, namelen);
+      sp->name[namelen]=0;
+      sip->length=bf_getl(file);
+      if (!sip->length)
         continue;
       struct
       {
@@ -303,56 +322,65 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
         unsigned char vol;
 	unsigned char flags; // bit 6: direction
       } amssmp;
-      file.read(&amssmp, sizeof(amssmp));
-
-      sp.stdpan=(amssmp.panfine&0xF0)?((amssmp.panfine>>4)*0x11):-1;
-      sp.stdvol=amssmp.vol*2;
-      sp.normnote=-amssmp.relnote*256-((signed char)(amssmp.panfine<<4))*2;
-      sp.opt=(amssmp.flags&0x04)?MP_OFFSETDIV2:0;
-
-      sp.volfade=volfade;
-      sp.pchint=pchint;
-      sp.volenv=m.envelopes[3*i+0].env?(3*i+0):-1;
-      sp.panenv=m.envelopes[3*i+1].env?(3*i+1):-1;
-      sp.pchenv=m.envelopes[3*i+2].env?(3*i+2):-1;
-
-      sip.loopstart=amssmp.loopstart;
-      sip.loopend=amssmp.loopend;
-      sip.samprate=amssmp.rate;
-      sip.type=((amssmp.flags&0x04)?mcpSamp16Bit:0)|((amssmp.flags&0x08)?mcpSampLoop:0)|((amssmp.flags&0x10)?mcpSampBiDi:0);
+      amssmp.loopstart=bf_getul(file);
+      amssmp.loopend=bf_getul(file);
+      amssmp.samprate=bf_getus(file);
+      amssmp.panfine=bf_getc(file);
+      amssmp.rate=bf_getus(file);
+      amssmp.relnote=bf_getc(file);
+      amssmp.vol=bf_getc(file);
+      amssmp.flags=bf_getc(file);
+
+      sp->stdpan=(amssmp.panfine&0xF0)?((amssmp.panfine>>4)*0x11):-1;
+      sp->stdvol=amssmp.vol*2;
+      sp->normnote=-amssmp.relnote*256-((signed char)(amssmp.panfine<<4))*2;
+      sp->opt=(amssmp.flags&0x04)?MP_OFFSETDIV2:0;
+
+      sp->volfade=volfade;
+      sp->pchint=pchint;
+      sp->volenv=m->envelopes[3*i+0].env?(3*i+0):-1;
+      sp->panenv=m->envelopes[3*i+1].env?(3*i+1):-1;
+      sp->pchenv=m->envelopes[3*i+2].env?(3*i+2):-1;
+
+      sip->loopstart=amssmp.loopstart;
+      sip->loopend=amssmp.loopend;
+      sip->samprate=amssmp.rate;
+      sip->type=((amssmp.flags&0x04)?(mcpSamp16Bit|mcpSampBigEndian):0)|((amssmp.flags&0x08)?mcpSampLoop:0)|((amssmp.flags&0x10)?mcpSampBiDi:0);
     }
   }
 
-  namelen=file.getc();
-  file.read(m.composer, namelen);
-  m.composer[namelen]=0;
+  namelen=bf_getc(file);
+  bf_read(file, m->composer, namelen);
+  m->composer[namelen]=0;
   for (i=0; i<32; i++)
   {
-    namelen=file.getc();
-    file.seekcur(namelen);
+    namelen=bf_getc(file);
+    bf_seekcur(file, namelen);
   }
 
   unsigned long packlen;
-  packlen=file.getl();
-  file.seekcur(packlen-4);
+  packlen=bf_getl(file);
+  bf_seekcur(file, packlen-4);
 
-  file.read(ordlist, 2*hdr.pos);
+  bf_read(file, ordlist, 2*hdr.pos);
+  for (i=0; i<hdr.pos; i++)
+    ims_swap16(&ordlist[i]);
 
-  for (i=0; i<m.ordnum; i++)
-    m.orders[i]=(ordlist[i]<hdr.pat)?ordlist[i]:hdr.pat;
+  for (i=0; i<m->ordnum; i++)
+    m->orders[i]=(ordlist[i]<hdr.pat)?ordlist[i]:hdr.pat;
 
   for (i=0; i<32; i++)
-    m.patterns[hdr.pat].tracks[i]=m.tracknum-1;
-  m.patterns[hdr.pat].gtrack=m.tracknum-1;
-  m.patterns[hdr.pat].patlen=64;
+    m->patterns[hdr.pat].tracks[i]=m->tracknum-1;
+  m->patterns[hdr.pat].gtrack=m->tracknum-1;
+  m->patterns[hdr.pat].patlen=64;
 
-  unsigned char *temptrack=new unsigned char[4000];
+  unsigned char *temptrack=malloc(4000);
   unsigned int buflen=0;
   unsigned char *buffer=0;
   if (!temptrack)
     return errAllocMem;
 
-  m.channum=1;
+  m->channum=1;
 
   for (t=0; t<hdr.pat; t++)
   {
@@ -360,36 +388,36 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
     unsigned char maxrow;
     unsigned char chan;
     unsigned char maxcmd;
-    patlen=file.getl();
-    maxrow=file.getc();
-    chan=file.getc();
-    namelen=file.getc();
+    patlen=bf_getl(file);
+    maxrow=bf_getc(file);
+    chan=bf_getc(file);
+    namelen=bf_getc(file);
     patlen-=3+namelen;
     char patname[11];
-    file.read(patname, namelen);
+    bf_read(file, patname, namelen);
     patname[namelen]=0;
     maxcmd=chan>>5;
     chan&=0x1F;
     chan++;
-    if (chan>m.channum)
-      m.channum=chan;
+    if (chan>m->channum)
+      m->channum=chan;
 
-    gmdpattern &pp=m.patterns[t];
+    gmdpattern *pp=&m->patterns[t];
     for (i=0; i<32; i++)
-      pp.tracks[i]=t*33+i;
-    pp.gtrack=t*33+32;
-    pp.patlen=maxrow+1;
-    strcpy(pp.name, patname);
+      pp->tracks[i]=t*33+i;
+    pp->gtrack=t*33+32;
+    pp->patlen=maxrow+1;
+    strcpy(pp->name, patname);
 
     if (patlen>buflen)
     {
       buflen=patlen;
-      delete buffer;
-      buffer=new unsigned char[buflen];
+      free(buffer);
+      buffer=malloc(buflen);
       if (!buffer)
 	return errAllocMem;
     }
-    file.read(buffer, patlen);
+    bf_read(file, buffer, patlen);
 
     for (i=0; i<chan; i++)
     {
@@ -462,40 +490,40 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
 	unsigned char *cp=tp+2;
 
         if ((ordlist[0]==t)&&!row)
-          putcmd(cp, cmdPlayNote|cmdPlayPan, (i&1)?0xC0:0x40);
+          putcmd(&cp, cmdPlayNote|cmdPlayPan, (i&1)?0xC0:0x40);
 
         if (ins||nte||(vol!=-1)||(pan!=-1))
         {
-          unsigned char &act=*cp;
+          unsigned char *act=cp;
           *cp++=cmdPlayNote;
           if (ins)
           {
-            act|=cmdPlayIns;
+            *act|=cmdPlayIns;
             *cp++=ins-1;
           }
           if (nte>=2)
           {
-            act|=cmdPlayNte;
+            *act|=cmdPlayNte;
             *cp++=(nte+10)|(noteporta?0x80:0);
           }
           if (vol!=-1)
           {
-            act|=cmdPlayVol;
+            *act|=cmdPlayVol;
             *cp++=vol;
 	  }
           if (pan!=-1)
           {
-            act|=cmdPlayPan;
+            *act|=cmdPlayPan;
             *cp++=pan;
           }
 	  if (delaynote!=-1)
           {
-            act|=cmdPlayDelay;
+            *act|=cmdPlayDelay;
             *cp++=delaynote;
           }
 
           if (nte==1)
-	    putcmd(cp, cmdKeyOff, 0);
+	    putcmd(&cp, cmdKeyOff, 0);
         }
 
         for (j=0; j<cmdnum; j++)
@@ -505,54 +533,54 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
           {
           case 0x0:
             if (data)
-              putcmd(cp, cmdArpeggio, data);
+              putcmd(&cp, cmdArpeggio, data);
             break;
           case 0x1:
-            putcmd(cp, cmdPitchSlideUp, data);
+            putcmd(&cp, cmdPitchSlideUp, data);
             break;
           case 0x2:
-            putcmd(cp, cmdPitchSlideDown, data);
+            putcmd(&cp, cmdPitchSlideDown, data);
             break;
           case 0x3:
-            putcmd(cp, cmdPitchSlideToNote, data);
+            putcmd(&cp, cmdPitchSlideToNote, data);
             break;
           case 0x4:
-            putcmd(cp, cmdPitchVibrato, data);
+            putcmd(&cp, cmdPitchVibrato, data);
             break;
           case 0x5:
-            putcmd(cp, cmdPitchSlideToNote, 0);
+            putcmd(&cp, cmdPitchSlideToNote, 0);
             if (!data)
-              putcmd(cp, cmdSpecial, cmdContVolSlide);
+              putcmd(&cp, cmdSpecial, cmdContVolSlide);
             else
             if (data&0xF0)
-              putcmd(cp, cmdVolSlideUp, (data>>4)<<2);
+              putcmd(&cp, cmdVolSlideUp, (data>>4)<<2);
             else
-              putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+              putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
             break;
           case 0x6:
-            putcmd(cp, cmdPitchVibrato, 0);
+            putcmd(&cp, cmdPitchVibrato, 0);
             if (!data)
-              putcmd(cp, cmdSpecial, cmdContVolSlide);
+              putcmd(&cp, cmdSpecial, cmdContVolSlide);
             else
             if (data&0xF0)
-              putcmd(cp, cmdVolSlideUp, (data>>4)<<2);
+              putcmd(&cp, cmdVolSlideUp, (data>>4)<<2);
             else
-              putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+              putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
             break;
           case 0x7:
-            putcmd(cp, cmdVolVibrato, data);
+            putcmd(&cp, cmdVolVibrato, data);
             break;
           case 0x9:
-            putcmd(cp, cmdOffset, data);
+            putcmd(&cp, cmdOffset, data);
             break;
           case 0xA:
             if (!data)
-              putcmd(cp, cmdSpecial, cmdContVolSlide);
+              putcmd(&cp, cmdSpecial, cmdContVolSlide);
             else
             if (data&0xF0)
-              putcmd(cp, cmdVolSlideUp, (data>>4)<<2);
+              putcmd(&cp, cmdVolSlideUp, (data>>4)<<2);
             else
-              putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+              putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
             break;
           case 0xE:
             cmds[j][0]=data>>4;
@@ -560,79 +588,79 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
             switch (cmds[j][0])
 	    {
             case 0x1:
-              putcmd(cp, cmdRowPitchSlideUp, data<<4);
+              putcmd(&cp, cmdRowPitchSlideUp, data<<4);
               break;
             case 0x2:
-              putcmd(cp, cmdRowPitchSlideDown, data<<4);
+              putcmd(&cp, cmdRowPitchSlideDown, data<<4);
               break;
             case 0x3:
-              putcmd(cp, cmdSpecial, data?cmdGlissOn:cmdGlissOff);
+              putcmd(&cp, cmdSpecial, data?cmdGlissOn:cmdGlissOff);
               break;
             case 0x4:
               if (data<4)
-                putcmd(cp, cmdPitchVibratoSetWave, data);
+                putcmd(&cp, cmdPitchVibratoSetWave, data);
               break;
             case 0x7:
               if (data<4)
-                putcmd(cp, cmdVolVibratoSetWave, data);
+                putcmd(&cp, cmdVolVibratoSetWave, data);
               break;
             case 0x8:
               if (!(data&0x0F))
-                putcmd(cp, cmdSetLoop, 0);
+                putcmd(&cp, cmdSetLoop, 0);
               break;
             case 0x9:
               if (data)
-                putcmd(cp, cmdRetrig, data);
+                putcmd(&cp, cmdRetrig, data);
               break;
             case 0xA:
-              putcmd(cp, cmdRowVolSlideUp, data<<2);
+              putcmd(&cp, cmdRowVolSlideUp, data<<2);
               break;
             case 0xB:
-              putcmd(cp, cmdRowVolSlideDown, data<<2);
+              putcmd(&cp, cmdRowVolSlideDown, data<<2);
               break;
             case 0xC:
-              putcmd(cp, cmdNoteCut, data);
+              putcmd(&cp, cmdNoteCut, data);
 	      break;
             }
             break;
 
           case 0x11:
-            putcmd(cp, cmdRowPitchSlideUp, data<<2);
+            putcmd(&cp, cmdRowPitchSlideUp, data<<2);
             break;
           case 0x12:
-            putcmd(cp, cmdRowPitchSlideDown, data<<2);
+            putcmd(&cp, cmdRowPitchSlideDown, data<<2);
             break;
           case 0x13:
-            putcmd(cp, cmdRetrig, data);
+            putcmd(&cp, cmdRetrig, data);
             break;
           case 0x15:
-            putcmd(cp, cmdPitchSlideToNote, 0);
+            putcmd(&cp, cmdPitchSlideToNote, 0);
             if (!data)
-              putcmd(cp, cmdSpecial, cmdContVolSlide);
+              putcmd(&cp, cmdSpecial, cmdContVolSlide);
             else
             if (data&0xF0)
-              putcmd(cp, cmdVolSlideUp, (data>>4)<<1);
+              putcmd(&cp, cmdVolSlideUp, (data>>4)<<1);
             else
-              putcmd(cp, cmdVolSlideDown, (data&0xF)<<1);
+              putcmd(&cp, cmdVolSlideDown, (data&0xF)<<1);
             break;
           case 0x16:
-            putcmd(cp, cmdPitchVibrato, 0);
+            putcmd(&cp, cmdPitchVibrato, 0);
             if (!data)
-              putcmd(cp, cmdSpecial, cmdContVolSlide);
+              putcmd(&cp, cmdSpecial, cmdContVolSlide);
             else
             if (data&0xF0)
-              putcmd(cp, cmdVolSlideUp, (data>>4)<<1);
+              putcmd(&cp, cmdVolSlideUp, (data>>4)<<1);
             else
-              putcmd(cp, cmdVolSlideDown, (data&0xF)<<1);
+              putcmd(&cp, cmdVolSlideDown, (data&0xF)<<1);
             break;
           case 0x18:
             if (!data)
-              putcmd(cp, cmdPanSlide, 0);
+              putcmd(&cp, cmdPanSlide, 0);
             else
             if (data&0xF0)
-              putcmd(cp, cmdPanSlide, data>>4);
+              putcmd(&cp, cmdPanSlide, data>>4);
             else
-              putcmd(cp, cmdPanSlide, -(data&0xF));
+              putcmd(&cp, cmdPanSlide, -(data&0xF));
 /*
             if ((data&0x0F)&&(data&0xF0))
               break;
@@ -640,17 +668,17 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
               data=-(data>>4)*4;
             else
               data=data*4;
-            putcmd(cp, cmdPanSlide, data);
+            putcmd(&cp, cmdPanSlide, data);
             break;
 */
           case 0x1A:
             if (!data)
-              putcmd(cp, cmdSpecial, cmdContVolSlide);
+              putcmd(&cp, cmdSpecial, cmdContVolSlide);
             else
             if (data&0xF0)
-              putcmd(cp, cmdVolSlideUp, (data>>4)<<1);
+              putcmd(&cp, cmdVolSlideUp, (data>>4)<<1);
             else
-              putcmd(cp, cmdVolSlideDown, (data&0xF)<<1);
+              putcmd(&cp, cmdVolSlideDown, (data&0xF)<<1);
             break;
           case 0x1E:
             cmds[j][0]=data>>4;
@@ -658,24 +686,24 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
             switch (cmds[j][0])
 	    {
             case 0x1:
-              putcmd(cp, cmdRowPitchSlideUp, data<<4);
+              putcmd(&cp, cmdRowPitchSlideUp, data<<4);
               break;
             case 0x2:
-              putcmd(cp, cmdRowPitchSlideDown, data<<4);
+              putcmd(&cp, cmdRowPitchSlideDown, data<<4);
               break;
             case 0xA:
-              putcmd(cp, cmdRowVolSlideUp, data<<1);
+              putcmd(&cp, cmdRowVolSlideUp, data<<1);
               break;
             case 0xB:
-              putcmd(cp, cmdRowVolSlideDown, data<<1);
+              putcmd(&cp, cmdRowVolSlideDown, data<<1);
               break;
             }
             break;
           case 0x1C:
-            putcmd(cp, cmdChannelVol, (data<=0x7F)?(data<<1):0xFF);
+            putcmd(&cp, cmdChannelVol, (data<=0x7F)?(data<<1):0xFF);
             break;
           case 0x20:
-            putcmd(cp, cmdKeyOff, data);
+            putcmd(&cp, cmdKeyOff, data);
             break;
           }
         }
@@ -688,18 +716,18 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
         }
       }
 
-      gmdtrack &trk=m.tracks[t*33+i];
+      gmdtrack *trk=&m->tracks[t*33+i];
       unsigned short len=tp-temptrack;
 
       if (!len)
-        trk.ptr=trk.end=0;
+        trk->ptr=trk->end=0;
       else
       {
-	trk.ptr=new unsigned char[len];
-        trk.end=trk.ptr+len;
-        if (!trk.ptr)
+	trk->ptr=ar_alloc(&m->heap, len);
+        trk->end=trk->ptr+len;
+        if (!trk->ptr)
           return errAllocMem;
-        memcpy(trk.ptr, temptrack, len);
+        memcpy(trk->ptr, temptrack, len);
       }
     }
 
@@ -711,10 +739,10 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
     if (ordlist[0]==t)
     {
       if (hdr.bpm&0xFF00)
-        putcmd(cp, cmdSpeed, hdr.bpm>>8);
+        putcmd(&cp, cmdSpeed, hdr.bpm>>8);
       if (hdr.bpm&0xFF)
-        putcmd(cp, cmdFineSpeed, hdr.bpm);
-      putcmd(cp, cmdTempo, hdr.speed);
+        putcmd(&cp, cmdFineSpeed, hdr.bpm);
+      putcmd(&cp, cmdTempo, hdr.speed);
     }
 
     unsigned short row=0;
@@ -763,97 +791,99 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
         switch (cmds[j][0])
         {
         case 0xB:
-          putcmd(cp, cmdGoto, data);
+          putcmd(&cp, cmdGoto, data);
           break;
 	case 0xD:
-          putcmd(cp, cmdBreak, (data&0x0F)+(data>>4)*10);
+          putcmd(&cp, cmdBreak, (data&0x0F)+(data>>4)*10);
           break;
 	case 0x1D:
-          putcmd(cp, cmdBreak, data);
+          putcmd(&cp, cmdBreak, data);
           break;
         case 0xE:
           switch (data>>4)
           {
           case 0x6:
-            putcmd(cp, cmdSetChan, curchan);
-            putcmd(cp, cmdPatLoop, data&0xF);
+            putcmd(&cp, cmdSetChan, curchan);
+            putcmd(&cp, cmdPatLoop, data&0xF);
             break;
           case 0xE:
-            putcmd(cp, cmdPatDelay, data&0xF);
+            putcmd(&cp, cmdPatDelay, data&0xF);
             break;
           }
 	  break;
         case 0xF:
           if (data)
+          {
             if (data<0x20)
-              putcmd(cp, cmdTempo, data);
+              putcmd(&cp, cmdTempo, data);
             else
-              putcmd(cp, cmdSpeed, data);
+              putcmd(&cp, cmdSpeed, data);
+          }
           break;
         case 0x1F:
           if (data<10)
-            putcmd(cp, cmdFineSpeed, data);
+            putcmd(&cp, cmdFineSpeed, data);
           break;
         case 0x2A:
           if ((data&0x0F)&&(data&0xF0))
             break;
-          putcmd(cp, cmdSetChan, curchan);
+          putcmd(&cp, cmdSetChan, curchan);
           if (data&0xF0)
-            putcmd(cp, cmdGlobVolSlide, (data>>4)<<2);
+            putcmd(&cp, cmdGlobVolSlide, (data>>4)<<2);
           else
-            putcmd(cp, cmdGlobVolSlide, -(data<<2));
+            putcmd(&cp, cmdGlobVolSlide, -(data<<2));
         case 0x2C:
-          putcmd(cp, cmdGlobVol, data*2);
+          putcmd(&cp, cmdGlobVol, data*2);
           break;
         }
       }
     }
 
-    gmdtrack &trk=m.tracks[t*33+32];
+    gmdtrack *trk=&m->tracks[t*33+32];
     unsigned short len=tp-temptrack;
 
     if (!len)
-      trk.ptr=trk.end=0;
+      trk->ptr=trk->end=0;
     else
     {
-      trk.ptr=new unsigned char[len];
-      trk.end=trk.ptr+len;
-      if (!trk.ptr)
+      trk->ptr=ar_alloc(&m->heap, len);
+      trk->end=trk->ptr+len;
+      if (!trk->ptr)
         return errAllocMem;
-      memcpy(trk.ptr, temptrack, len);
+      memcpy(trk->ptr, temptrack, len);
     }
   }
 
-  delete ordlist;
-  delete temptrack;
-  delete buffer;
+  free(ordlist);
+  free(temptrack);
+  free(buffer);
 
-  if (!mpAllocSamples(m, m.sampnum)||!mpAllocModSamples(m, m.modsampnum))
+  if (!mpAllocSamples(m, m->sampnum)||!mpAllocModSamples(m, m->modsampnum))
     return errAllocMem;
 
-  m.sampnum=0;
-  m.modsampnum=0;
+  m->sampnum=0;
+  m->modsampnum=0;
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
+    gmdinstrument *ip=&m->instruments[i];
     for (j=0; j<instsampnum[i]; j++)
     {
-      m.modsamples[m.modsampnum++]=msmps[i][j];
-      m.samples[m.sampnum++]=smps[i][j];
+      m->modsamples[m->modsampnum++]=msmps[i][j];
+      m->samples[m->sampnum++]=smps[i][j];
     }
-    delete msmps[i];
-    delete smps[i];
+    free(msmps[i]);
+    free(smps[i]);
   }
 
-  delete smps;
-  delete msmps;
+  free(smps);
+  free(msmps);
 
   int sampnum=0;
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
+    gmdinstrument *ip=&m->instruments[i];
     if (shadowedby[i])
     {
       sampnum+=instsampnum[i];
@@ -861,22 +891,22 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
     }
     for (j=0; j<instsampnum[i]; j++)
     {
-      sampleinfo &sip=m.samples[sampnum++];
-      if (!sip.length)
+      sampleinfo *sip=&m->samples[sampnum++];
+      if (!sip->length)
         continue;
 
       unsigned long packlena,packlenb;
       unsigned char packbyte;
 
-      packlena=file.getl();
-      packlenb=file.getl();
-      packbyte=file.getc();
+      packlena=bf_getl(file);
+      packlenb=bf_getl(file);
+      packbyte=bf_getc(file);
 
-      unsigned char *packb=new unsigned char[((packlenb>packlena)?packlenb:packlena)+16];
-      unsigned char *smpp=new unsigned char[packlena+16];
+      unsigned char *packb=malloc(((packlenb>packlena)?packlenb:packlena)+16);
+      unsigned char *smpp=malloc(packlena+16);
       if (!smpp||!packb)
         return errAllocMem;
-      file.read(packb, packlenb);
+      bf_read(file, packb, packlenb);
       long p1,p2;
       p1=p2=0;
 
@@ -924,24 +954,24 @@ extern "C" int mpLoadAMS(gmdmodule &m, binfile &file)
         smpp[p1++]=cursmp;
       }
 
-      delete packb;
+      free(packb);
 
-      sip.ptr=smpp;
-      m.modsamples[sampnum-1].handle=sampnum-1;
+      sip->ptr=smpp;
+      m->modsamples[sampnum-1].handle=sampnum-1;
     }
   }
 
 
-//  for (i=0; i<m.instnum; i++)
+//  for (i=0; i<m->instnum; i++)
 //    if (shadowedby[i])
 //    {
-//      for (j=0; j<m.instruments[i].sampnum; j++)
+//      for (j=0; j<m->instruments[i].sampnum; j++)
 //      {
-//        m.modsamples[m.instruments[i].samples[j]].handle=m.modsamples[m.instruments[shadowedby[i]-1].samples[j]].handle;
+//        m->modsamples[m->instruments[i].samples[j]].handle=m->modsamples[m->instruments[shadowedby[i]-1].samples[j]].handle;
 //      }
 //    }
 
-  delete instsampnum;
+  free(instsampnum);
 
   return errOk;
 }
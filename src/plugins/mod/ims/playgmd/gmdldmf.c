@@ -8,11 +8,25 @@
 //    -first release
 
 #include <string.h>
+#include <stdlib.h>
 #include "binfile.h"
 #include "mcp.h"
 #include "gmdplay.h"
 #include "err.h"
 
+// chunk ids as returned by bf_getl, and little endian words from memory
+#define DMFSIG(s) ((unsigned long)(s)[0]|((unsigned long)(s)[1]<<8)|((unsigned long)(s)[2]<<16)|((unsigned long)(s)[3]<<24))
+
+static inline unsigned short dmfgetw(const unsigned char *p)
+{
+  return p[0]|(p[1]<<8);
+}
+
+static inline unsigned long dmfgetl(const unsigned char *p)
+{
+  return DMFSIG(p);
+}
+
 static const unsigned char *ibuf;
 static unsigned long bitbuf;
 static char bitnum;
@@ -36,7 +50,7 @@ static short huff[255][3];
 static void readtree()
 {
   huff[nodenum][2]=readbitsdmf(7);
-  short (&node)[3]=huff[lastnode];
+  short *node=huff[lastnode];
   unsigned char left=readbitsdmf(1);
   unsigned char right=readbitsdmf(1);
   lastnode=++nodenum;
@@ -60,7 +74,7 @@ static void readtree()
 static void unpack0(unsigned char *ob, const void *ib, unsigned long len)
 {
   ibuf=(const unsigned char*)ib;
-  bitbuf=*(long*)ibuf;
+  bitbuf=dmfgetl(ibuf);
   ibuf+=4;
   bitnum=32;
 
@@ -78,27 +92,29 @@ static void unpack0(unsigned char *ob, const void *ib, unsigned long len)
   }
 }
 
-static inline void putcmd(unsigned char *&p, unsigned char c, unsigned char d)
+static inline void putcmd(unsigned char **pp, unsigned char c, unsigned char d)
 {
+  unsigned char *p=*pp;
   *p++=c;
   *p++=d;
+  *pp=p;
 }
 
-static void calctempo(unsigned short rpm, unsigned char &tempo, unsigned char &bpm)
+static void calctempo(unsigned short rpm, unsigned char *tempo, unsigned char *bpm)
 {
-  for (tempo=30; tempo>1; tempo--)
-    if ((rpm*tempo/24)<256)
+  for (*tempo=30; *tempo>1; (*tempo)--)
+    if ((rpm**tempo/24)<256)
       break;
-  bpm=rpm*tempo/24;
+  *bpm=rpm**tempo/24;
 }
 
-extern "C" int mpLoadDMF(gmdmodule &m, binfile &file)
+int mpLoadDMF(gmdmodule *m, binfile *file)
 {
   mpReset(m);
 
   struct
   {
-    unsigned long sig;
+    bf_ulong sig;
     unsigned char ver;
     char tracker[8];
     char name[30];
@@ -106,122 +122,124 @@ extern "C" int mpLoadDMF(gmdmodule &m, binfile &file)
     char date[3];
   } hdr;
 
-  file.read(&hdr, sizeof(hdr));
-  if (hdr.sig!=*(unsigned long*)"DDMF")
+  bf_read(file, &hdr, sizeof(hdr));
+  if (memcmp(&hdr.sig, "DDMF", 4))
     return errFormSig;
 
   if (hdr.ver<5)
     return errFormOldVer;
 
-  m.options=MOD_TICK0|MOD_EXPOFREQ;
+  m->options=MOD_TICK0|MOD_EXPOFREQ;
 
-  memcpy(m.name, hdr.name, 30);
-  m.name[30]=0;
+  memcpy(m->name, hdr.name, 30);
+  m->name[30]=0;
 
-  memcpy(m.composer, hdr.composer, 20);
-  m.composer[20]=0;
+  memcpy(m->composer, hdr.composer, 20);
+  m->composer[20]=0;
 
   unsigned long sig;
   unsigned long next;
 
-  sig=file.getl();
-  next=file.getl();
+  sig=bf_getl(file);
+  next=bf_getl(file);
 
-  if (sig==*(unsigned long*)"INFO")
+  if (sig==DMFSIG("INFO"))
   {
-    file.seekcur(next);
-    sig=file.getl();
-    next=file.getl();
+    bf_seekcur(file, next);
+    sig=bf_getl(file);
+    next=bf_getl(file);
   }
 
-  if (sig==*(unsigned long*)"CMSG")
+  if (sig==DMFSIG("CMSG"))
   {
-    file.getc();
+    bf_getc(file);
     unsigned short msglen=(next-1)/40;
 
     if (msglen)
     {
-      m.message=new char *[msglen+1];
-      if (!m.message)
+      m->message=malloc((msglen+1)*sizeof(char *));
+      if (!m->message)
         return errAllocMem;
-      *m.message=new char [msglen*41];
-      if (!*m.message)
+      *m->message=malloc(msglen*41);
+      if (!*m->message)
         return errAllocMem;
       short t;
       for (t=0; t<msglen; t++)
       {
-        m.message[t]=*m.message+t*41;
-        file.read(m.message[t], 40);
+        m->message[t]=*m->message+t*41;
+        bf_read(file, m->message[t], 40);
         short i;
         for (i=0; i<40; i++)
-          if (!m.message[t][i])
-            m.message[t][i]=' ';
-        m.message[t][40]=0;
+          if (!m->message[t][i])
+            m->message[t][i]=' ';
+        m->message[t][40]=0;
       }
-      m.message[msglen]=0;
+      m->message[msglen]=0;
     }
 
-    sig=file.getl();
-    next=file.getl();
+    sig=bf_getl(file);
+    next=bf_getl(file);
   }
 
 
 
-  if ((sig!=*(unsigned long*)"SEQU")||(next&1))
+  if ((sig!=DMFSIG("SEQU"))||(next&1))
     return errFormStruc;
 
   unsigned short ordloop,ordnum;
-  unsigned short *orders=new unsigned short [next-4]; // maybe too much...
+  short i;
+  unsigned short *orders=malloc((next-4)*sizeof(unsigned short)); // maybe too much...
   if (!orders)
     return errAllocMem;
-  ordloop=file.gets();
-  ordnum=file.gets();
-  file.read(orders, next-4);
+  ordloop=bf_gets(file);
+  ordnum=bf_gets(file);
+  bf_read(file, orders, next-4);
   ordnum++;
+  for (i=0; i<(next-4)/2; i++)
+    ims_swap16(&orders[i]);
 
   if (2*ordnum>(next-4))
     ordnum=(next-4)/2;
   if (ordloop>=ordnum)
     ordloop=0;
 
-  sig=file.getl();
-  next=file.getl();
+  sig=bf_getl(file);
+  next=bf_getl(file);
 
-  if (sig!=*(unsigned long*)"PATT")
+  if (sig!=DMFSIG("PATT"))
     return errFormStruc;
 
   unsigned short patnum;
   unsigned char chnnum;
-  patnum=file.gets();
-  chnnum=file.getc();
-  m.channum=chnnum;
+  patnum=bf_gets(file);
+  chnnum=bf_getc(file);
+  m->channum=chnnum;
 
-  unsigned char *patbuf=new unsigned char [next-3];
-  unsigned char **patadr=new unsigned char *[patnum];
-  unsigned char (*temptrack)[3000]=new unsigned char[m.channum+1][3000];
+  unsigned char *patbuf=malloc(next-3);
+  unsigned char **patadr=malloc((patnum)*sizeof(unsigned char *));
+  unsigned char (*temptrack)[3000]=malloc((m->channum+1)*sizeof(unsigned char[3000]));
   if (!patbuf||!patadr||!temptrack)
     return errAllocMem;
-  file.read(patbuf, next-3);
+  bf_read(file, patbuf, next-3);
 
 // get the pattern start adresses
   unsigned char *curadr=patbuf;
-  short i;
   for (i=0; i<patnum; i++)
   {
     patadr[i]=curadr;
-    curadr+=8+*(unsigned long*)(curadr+4);
+    curadr+=8+dmfgetl(curadr+4);
   }
 
 //get the new order number
   unsigned short nordnum=0;
   for (i=0; i<ordnum; i++)
-    nordnum+=(*(unsigned short*)(patadr[orders[i]]+2)>256)?2:1;
+    nordnum+=(dmfgetw(patadr[orders[i]]+2)>256)?2:1;
 
 //relocate orders
   unsigned short curord=nordnum;
   for (i=ordnum-1; i>=0; i--)
   {
-    if (*(unsigned short*)(patadr[orders[i]]+2)>256)
+    if (dmfgetw(patadr[orders[i]]+2)>256)
     {
       curord-=2;
       orders[curord]=orders[i];
@@ -234,17 +252,17 @@ extern "C" int mpLoadDMF(gmdmodule &m, binfile &file)
   }
   ordnum=nordnum;
 
-  m.patnum=ordnum;
-  m.ordnum=ordnum;
-  m.endord=m.patnum;
-  m.loopord=ordloop;
-  m.tracknum=ordnum*(m.channum+1);
+  m->patnum=ordnum;
+  m->ordnum=ordnum;
+  m->endord=m->patnum;
+  m->loopord=ordloop;
+  m->tracknum=ordnum*(m->channum+1);
 
-  if (!mpAllocTracks(m, m.tracknum)||!mpAllocPatterns(m, m.patnum)||!mpAllocOrders(m, m.ordnum))
+  if (!mpAllocTracks(m, m->tracknum)||!mpAllocPatterns(m, m->patnum)||!mpAllocOrders(m, m->ordnum))
     return errAllocMem;
 
-  for (i=0; i<m.ordnum; i++)
-    m.orders[i]=i;
+  for (i=0; i<m->ordnum; i++)
+    m->orders[i]=i;
 
   unsigned char speed=125;
   unsigned char ttype=1;
@@ -269,7 +287,7 @@ extern "C" int mpLoadDMF(gmdmodule &m, binfile &file)
       pbeat=(*pp++)>>4;
       if (!pbeat)
         pbeat=8;
-      len=*(unsigned short*)pp;
+      len=dmfgetw(pp);
       pp+=6;
       memset(nextinfobyte, 0, 33);
       if (len>256)
@@ -280,13 +298,13 @@ extern "C" int mpLoadDMF(gmdmodule &m, binfile &file)
     else
       rownum=len-256;
 
-    m.patterns[i].patlen=rownum;
+    m->patterns[i].patlen=rownum;
 
     unsigned char *(tp[33]);
-    for (j=0; j<=m.channum; j++)
+    for (j=0; j<=m->channum; j++)
       tp[j]=temptrack[j];
 
-    for (j=voc; j<m.channum; j++)
+    for (j=voc; j<m->channum; j++)
     {
       *tp[j]++=0;
       *tp[j]++=2;
@@ -296,17 +314,17 @@ extern "C" int mpLoadDMF(gmdmodule &m, binfile &file)
 
     for (row=0; row<rownum; row++)
     {
-      if (!nextinfobyte[m.channum])
+      if (!nextinfobyte[m->channum])
       {
         unsigned char info=*pp++;
         if (info&0x80)
-          nextinfobyte[m.channum]=*pp++;
+          nextinfobyte[m->channum]=*pp++;
         info&=~0x80;
         unsigned char data;
         if (info)
           data=*pp++;
 
-        unsigned char *cp=tp[m.channum]+2;
+        unsigned char *cp=tp[m->channum]+2;
 
         unsigned char tempochange=!row&&ttype&&!(orders[i]&0x8000);
 
@@ -333,22 +351,22 @@ extern "C" int mpLoadDMF(gmdmodule &m, binfile &file)
           unsigned char tempo;
           unsigned char bpm;
           if (ttype&&pbeat)
-            calctempo(speed*pbeat, tempo, bpm);
+            calctempo(speed*pbeat, &tempo, &bpm);
           else
-            calctempo((speed+1)*15, tempo, bpm);
-          putcmd(cp, cmdTempo, tempo);
-          putcmd(cp, cmdSpeed, bpm);
+            calctempo((speed+1)*15, &tempo, &bpm);
+          putcmd(&cp, cmdTempo, tempo);
+          putcmd(&cp, cmdSpeed, bpm);
         }
 
-        if (cp!=(tp[m.channum]+2))
+        if (cp!=(tp[m->channum]+2))
         {
-          tp[m.channum][0]=row;
-          tp[m.channum][1]=cp-tp[m.channum]-2;
-          tp[m.channum]=cp;
+          tp[m->channum][0]=row;
+          tp[m->channum][1]=cp-tp[m->channum]-2;
+          tp[m->channum]=cp;
         }
       }
       else
-        nextinfobyte[m.channum]--;
+        nextinfobyte[m->channum]--;
 
       for (j=0; j<voc; j++)
         if (!nextinfobyte[j])
@@ -395,101 +413,101 @@ extern "C" int mpLoadDMF(gmdmodule &m, binfile &file)
 
           if (cmds[0]||(cmds[1]&&(cmds[1]!=255))||cmds[2]||(cmds[7]==7))
           {
-            unsigned char &act=*cp;
+            unsigned char *act=cp;
              *cp++=cmdPlayNote;
             if (cmds[0])
             {
-              act|=cmdPlayIns;
+              *act|=cmdPlayIns;
               *cp++=cmds[0]-1;
             }
             if (cmds[1]&&(cmds[1]!=255))
             {
-              act|=cmdPlayNte;
+              *act|=cmdPlayNte;
               *cp++=cmds[1]+23;
             }
             if (cmds[2])
             {
-              act|=cmdPlayVol;
+              *act|=cmdPlayVol;
               *cp++=cmds[2]-1;
             }
             if (cmds[7]==7)
             {
-              act|=cmdPlayPan;
+              *act|=cmdPlayPan;
               *cp++=cmds[8];
             }
           }
           if (cmds[1]==255)
-            putcmd(cp, cmdKeyOff, 0);
+            putcmd(&cp, cmdKeyOff, 0);
 
           switch (cmds[3])
           {
           case 1:
-            putcmd(cp, cmdKeyOff, 0); // falsch!
+            putcmd(&cp, cmdKeyOff, 0); // falsch!
             break;
           case 2:
-            putcmd(cp, cmdSetLoop, 0);
+            putcmd(&cp, cmdSetLoop, 0);
             break;
           case 6:
-            putcmd(cp, cmdOffset, cmds[4]);
+            putcmd(&cp, cmdOffset, cmds[4]);
             break;
           }
 
           switch (cmds[5])
           {
           case 1:
-            putcmd(cp, cmdRowPitchSlideDMF, cmds[6]);
+            putcmd(&cp, cmdRowPitchSlideDMF, cmds[6]);
             break;
           case 3:
-            putcmd(cp, cmdArpeggio, cmds[6]);
+            putcmd(&cp, cmdArpeggio, cmds[6]);
             break;
           case 4:
-            putcmd(cp, cmdPitchSlideUDMF, cmds[6]);
+            putcmd(&cp, cmdPitchSlideUDMF, cmds[6]);
             break;
           case 5:
-            putcmd(cp, cmdPitchSlideDDMF, cmds[6]);
+            putcmd(&cp, cmdPitchSlideDDMF, cmds[6]);
             break;
           case 6:
-            putcmd(cp, cmdPitchSlideNDMF, cmds[6]);
+            putcmd(&cp, cmdPitchSlideNDMF, cmds[6]);
             break;
           case 8:
-            putcmd(cp, cmdPitchVibratoSinDMF, cmds[6]);
+            putcmd(&cp, cmdPitchVibratoSinDMF, cmds[6]);
             break;
           case 9:
-            putcmd(cp, cmdPitchVibratoTrgDMF, cmds[6]);
+            putcmd(&cp, cmdPitchVibratoTrgDMF, cmds[6]);
             break;
           case 10:
-            putcmd(cp, cmdPitchVibratoRecDMF, cmds[6]);
+            putcmd(&cp, cmdPitchVibratoRecDMF, cmds[6]);
             break;
           case 12:
-            putcmd(cp, cmdKeyOff, 0); // falsch!
+            putcmd(&cp, cmdKeyOff, 0); // falsch!
             break;
           }
 
           switch (cmds[7])
           {
           case 1:
-            putcmd(cp, cmdVolSlideUDMF, cmds[8]);
+            putcmd(&cp, cmdVolSlideUDMF, cmds[8]);
             break;
           case 2:
-            putcmd(cp, cmdVolSlideDDMF, cmds[8]);
+            putcmd(&cp, cmdVolSlideDDMF, cmds[8]);
             break;
           case 4:
-            putcmd(cp, cmdVolVibratoSinDMF, cmds[8]);
+            putcmd(&cp, cmdVolVibratoSinDMF, cmds[8]);
             break;
           case 5:
-            putcmd(cp, cmdVolVibratoTrgDMF, cmds[8]);
+            putcmd(&cp, cmdVolVibratoTrgDMF, cmds[8]);
             break;
           case 6:
-            putcmd(cp, cmdVolVibratoRecDMF, cmds[8]);
+            putcmd(&cp, cmdVolVibratoRecDMF, cmds[8]);
             break;
           case 8:
-            putcmd(cp, cmdPanSlideLDMF, cmds[8]);
+            putcmd(&cp, cmdPanSlideLDMF, cmds[8]);
             break;
           case 9:
-            putcmd(cp, cmdPanSlideRDMF, cmds[8]);
+            putcmd(&cp, cmdPanSlideRDMF, cmds[8]);
             break;
           case 10:
-            putcmd(cp, cmdPanVibratoSinDMF, cmds[8]);
+            putcmd(&cp, cmdPanVibratoSinDMF, cmds[8]);
             break;
           }
 
@@ -504,153 +522,157 @@ extern "C" int mpLoadDMF(gmdmodule &m, binfile &file)
           nextinfobyte[j]--;
     }
 
-    for (j=0; j<m.channum; j++)
+    for (j=0; j<m->channum; j++)
     {
-      m.patterns[i].tracks[j]=i*(m.channum+1)+j;
+      m->patterns[i].tracks[j]=i*(m->channum+1)+j;
 
-      gmdtrack &trk=m.tracks[i*(m.channum+1)+j];
+      gmdtrack *trk=&m->tracks[i*(m->channum+1)+j];
       unsigned short tlen=tp[j]-temptrack[j];
 
       if (!tlen)
-        trk.ptr=trk.end=0;
+        trk->ptr=trk->end=0;
       else
       {
-        trk.ptr=new unsigned char[tlen];
-        trk.end=trk.ptr+tlen;
-        if (!trk.ptr)
+        trk->ptr=ar_alloc(&m->heap, tlen);
+        trk->end=trk->ptr+tlen;
+        if (!trk->ptr)
           return errAllocMem;
-        memcpy(trk.ptr, temptrack[j], tlen);
+        memcpy(trk->ptr, temptrack[j], tlen);
       }
     }
 
-    m.patterns[i].gtrack=i*(m.channum+1)+m.channum;
+    m->patterns[i].gtrack=i*(m->channum+1)+m->channum;
 
-    gmdtrack &trk=m.tracks[i*(m.channum+1)+m.channum];
-    unsigned short tlen=tp[m.channum]-temptrack[m.channum];
+    gmdtrack *trk=&m->tracks[i*(m->channum+1)+m->channum];
+    unsigned short tlen=tp[m->channum]-temptrack[m->channum];
 
     if (!tlen)
-      trk.ptr=trk.end=0;
+      trk->ptr=trk->end=0;
     else
     {
-      trk.ptr=new unsigned char[tlen];
-      trk.end=trk.ptr+tlen;
-      if (!trk.ptr)
+      trk->ptr=ar_alloc(&m->heap, tlen);
+      trk->end=trk->ptr+tlen;
+      if (!trk->ptr)
         return errAllocMem;
-      memcpy(trk.ptr, temptrack[m.channum], tlen);
+      memcpy(trk->ptr, temptrack[m->channum], tlen);
     }
   }
 
-  delete temptrack;
-  delete patbuf;
-  delete patadr;
-  delete orders;
+  free(temptrack);
+  free(patbuf);
+  free(patadr);
+  free(orders);
 
-  sig=file.getl();
-  next=file.getl();
+  sig=bf_getl(file);
+  next=bf_getl(file);
 
 // inst!!
 
-  if ((sig!=*(unsigned long*)"SMPI"))
+  if ((sig!=DMFSIG("SMPI")))
     return errFormStruc;
 
-  m.modsampnum=m.sampnum=m.instnum=file.getc();
+  m->modsampnum=m->sampnum=m->instnum=bf_getc(file);
 
-  if (!mpAllocInstruments(m, m.instnum)||!mpAllocSamples(m, m.sampnum)||!mpAllocModSamples(m, m.modsampnum))
+  if (!mpAllocInstruments(m, m->instnum)||!mpAllocSamples(m, m->sampnum)||!mpAllocModSamples(m, m->modsampnum))
     return errAllocMem;
 
   unsigned char smppack[256];
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
 
     unsigned char namelen;
-    namelen=file.getc();
+    namelen=bf_getc(file);
     if (namelen>31)
     {
-      file.read(ip.name, 31);
-      file.seekcur(namelen-31);
+      bf_read(file, ip->name, 31);
+      bf_seekcur(file, namelen-31);
       namelen=31;
     }
     else
-      file.read(ip.name, namelen);
-    ip.name[namelen]=0;
+      bf_read(file, ip->name, namelen);
+    ip->name[namelen]=0;
     struct
     {
-      unsigned long length;
-      unsigned long loopstart;
-      unsigned long loopend;
+      bf_ulong length;
+      bf_ulong loopstart;
+      bf_ulong loopend;
       unsigned short freq;
       unsigned char vol;
       unsigned char type;
       unsigned char filler[10];
-      unsigned long crc32;
+      bf_ulong crc32;
     } smp;
-    file.read(&smp, sizeof(smp)-((hdr.ver<8)?8:0));
+    bf_read(file, &smp, sizeof(smp)-((hdr.ver<8)?8:0));
+    ims_swap32(&smp.length);
+    ims_swap32(&smp.loopstart);
+    ims_swap32(&smp.loopend);
+    ims_swap16(&smp.freq);
     smppack[i]=!!(smp.type&0x04);
     unsigned char bit16=!!(smp.type&0x02);
     if (smp.type&0x88)
       return errFormSupp; // can't do this
     if (bit16&&smppack[i])
       return errFormSupp; // don't want 16 bit packed samples..
-    sip.length=smp.length>>bit16;
-    sip.loopstart=smp.loopstart>>bit16;
-    sip.loopend=smp.loopend>>bit16;
-    sip.samprate=smp.freq;
-    sip.type=((smp.type&4)?mcpSampDelta:0)|(bit16?mcpSamp16Bit:0)|((smp.type&1)?mcpSampLoop:0);
+    sip->length=smp.length>>bit16;
+    sip->loopstart=smp.loopstart>>bit16;
+    sip->loopend=smp.loopend>>bit16;
+    sip->samprate=smp.freq;
+    sip->type=((smp.type&4)?mcpSampDelta:0)|(bit16?(mcpSamp16Bit|mcpSampBigEndian):0)|((smp.type&1)?mcpSampLoop:0);
 
     if (!smp.length)
       continue;
 
     int j;
     for (j=0; j<128; j++)
-      ip.samples[j]=i;
-    *sp.name=0;
-    sp.handle=i;
-    sp.normnote=0;
-    sp.stdvol=smp.vol?smp.vol:-1;
-    sp.stdpan=-1;
-    sp.opt=bit16?MP_OFFSETDIV2:0;
+      ip->samples[j]=i;
+    *sp->name=0;
+    sp->handle=i;
+    sp->normnote=0;
+    sp->stdvol=smp.vol?smp.vol:-1;
+    sp->stdpan=-1;
+    sp->opt=bit16?MP_OFFSETDIV2:0;
   }
 
-  sig=file.getl();
-  next=file.getl();
+  sig=bf_getl(file);
+  next=bf_getl(file);
 
-  if ((sig!=*(unsigned long*)"SMPD"))
+  if ((sig!=DMFSIG("SMPD")))
     return errFormStruc;
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
 
     unsigned long len;
-    len=file.getl();
+    len=bf_getl(file);
 
-    if (sp.handle==0xFFFF)
+    if (sp->handle==0xFFFF)
     {
-      file.seekcur(len);
+      bf_seekcur(file, len);
       continue;
     }
 
-    unsigned char *smpp=new unsigned char[len];
+    unsigned char *smpp=malloc(len);
     if (!smpp)
       return errAllocMem;
-    file.read(smpp, len);
+    bf_read(file, smpp, len);
     if (smppack[i])
     {
-      unsigned char *dbuf=new unsigned char[sip.length+16];
+      unsigned char *dbuf=malloc(sip->length+16);
       if (!dbuf)
         return errAllocMem;
-      unpack0(dbuf, smpp, sip.length);
-      delete smpp;
+      unpack0(dbuf, smpp, sip->length);
+      free(smpp);
       smpp=dbuf;
     }
 
-    sip.ptr=smpp;
+    sip->ptr=smpp;
   }
 
   return errOk;
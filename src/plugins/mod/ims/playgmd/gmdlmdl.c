@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "binfile.h"
 #include "mcp.h"
 #include "gmdplay.h"
@@ -68,20 +69,22 @@ static short vibsintab[256]=
    -400,  -350,  -301,  -251,  -201,  -151,  -100,   -50};
 */
 
-static inline void putcmd(unsigned char *&p, unsigned char c, unsigned char d)
+static inline void putcmd(unsigned char **pp, unsigned char c, unsigned char d)
 {
+  unsigned char *p=*pp;
   *p++=c;
   *p++=d;
+  *pp=p;
 }
 
-extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
+int mpLoadMDL(gmdmodule *m, binfile *file)
 {
   mpReset(m);
 
-  if (file.getul()!=0x4C444D44)
+  if (bf_getul(file)!=0x4C444D44)
     return errFormSig;
 
-  if ((file.getuc()&0x10)!=0x10)
+  if ((bf_getuc(file)&0x10)!=0x10)
   {
     dbgprintf("file version too old\n");
     return errFormSig;
@@ -89,10 +92,10 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
 
   unsigned long blklen;
 
-  if (file.getus()!=0x4E49)
+  if (bf_getus(file)!=0x4E49)
     return errFormStruc;
 
-  blklen=file.getul();
+  blklen=bf_getul(file);
   struct
   {
     char name[32];
@@ -105,73 +108,77 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
     unsigned char pan[32];
   } mdlhead;
 
-  file.read(&mdlhead, 91);
+  bf_read(file, &mdlhead, 91);
+  ims_swap16(&mdlhead.ordnum);
+  ims_swap16(&mdlhead.repstart);
   int i,j,k;
   for (i=0; i<32; i++)
     if (mdlhead.pan[i]&0x80)
       break;
-  m.channum=i;
-  memcpy(m.name, mdlhead.name, 31);
-  m.name[32]=0;
-  memcpy(m.composer, mdlhead.composer, 20);
-  m.composer[20]=0;
-  m.ordnum=mdlhead.ordnum;
-  m.endord=m.ordnum;
-  m.loopord=mdlhead.repstart;
-  m.options=MOD_EXPOFREQ|MP_OFFSETDIV2;
+  m->channum=i;
+  memcpy(m->name, mdlhead.name, 31);
+  m->name[31]=0;
+  memcpy(m->composer, mdlhead.composer, 20);
+  m->composer[20]=0;
+  m->ordnum=mdlhead.ordnum;
+  m->endord=m->ordnum;
+  m->loopord=mdlhead.repstart;
+  m->options=MOD_EXPOFREQ|MP_OFFSETDIV2;
 
   unsigned char ordtab[256];
   if (mdlhead.ordnum>256)
     return errFormSupp;
 
-  file.read(ordtab, mdlhead.ordnum);
-  file.seekcur(8*m.channum); // channames
-  file.seekcur(blklen-8*m.channum-91-mdlhead.ordnum);
+  bf_read(file, ordtab, mdlhead.ordnum);
+  bf_seekcur(file, 8*m->channum); // channames
+  bf_seekcur(file, blklen-8*m->channum-91-mdlhead.ordnum);
 
   unsigned short blktype;
-  blktype=file.getus();
-  blklen=file.getul();
+  blktype=bf_getus(file);
+  blklen=bf_getul(file);
 
   if (blktype==0x454D)
   {
-    file.seekcur(blklen);
-    blktype=file.getus();
-    blklen=file.getul();
+    bf_seekcur(file, blklen);
+    blktype=bf_getus(file);
+    blklen=bf_getul(file);
 //songmessage; every line is closed with the CR-char (13). A
 //0-byte stands at the end of the whole text.
   }
 
   if (blktype!=0x4150)
     return errFormStruc;
-  unsigned char patnum=file.getuc();
+  unsigned char patnum=bf_getuc(file);
 
-  m.patnum=patnum+1;
-  m.tracknum=patnum*(m.channum+1)+1;
+  m->patnum=patnum+1;
+  m->tracknum=patnum*(m->channum+1)+1;
 
-  if (!mpAllocPatterns(m, m.patnum)||!mpAllocOrders(m, m.ordnum)||!mpAllocTracks(m, m.tracknum))
+  if (!mpAllocPatterns(m, m->patnum)||!mpAllocOrders(m, m->ordnum)||!mpAllocTracks(m, m->tracknum))
     return errAllocMem;
 
   for (j=0; j<patnum; j++)
   {
-    unsigned char chnn=file.getc();
-    m.patterns[j].patlen=file.getc()+1;
-    file.read(m.patterns[j].name, 16);
-    m.patterns[j].name[16]=0;
-    memset(m.patterns[j].tracks, 0, 32*2);
-    file.read(m.patterns[j].tracks, 2*chnn);
+    unsigned char chnn=bf_getc(file);
+    m->patterns[j].patlen=bf_getc(file)+1;
+    bf_read(file, m->patterns[j].name, 16);
+    m->patterns[j].name[16]=0;
+    memset(m->patterns[j].tracks, 0, 32*2);
+    bf_read(file, m->patterns[j].tracks, 2*chnn);
+    for (i=0; i<chnn; i++)
+      ims_swap16(&m->patterns[j].tracks[i]);
   }
 
-  if (file.getus()!=0x5254)
+  if (bf_getus(file)!=0x5254)
     return errFormStruc;
-  blklen=file.getul();
+  blklen=bf_getul(file);
 
-  unsigned short ntracks=file.getus();
+  unsigned short ntracks=bf_getus(file);
 
-  unsigned char **trackends=new unsigned char *[ntracks+1];
-  unsigned char **trackptrs=new unsigned char *[ntracks+1];
-  unsigned char *trackbuf=new unsigned char [blklen-2-2*ntracks];
-  unsigned char (*patdata)[256][6]=new unsigned char [m.channum][256][6];
-  unsigned char *temptrack=new unsigned char [3000];
+  unsigned char **trackends=malloc((ntracks+1)*sizeof(unsigned char *));
+  unsigned char **trackptrs=malloc((ntracks+1)*sizeof(unsigned char *));
+  unsigned char *trackbuf=malloc(blklen-2-2*ntracks);
+  unsigned char (*patdata)[256][6]=malloc((m->channum)*sizeof(unsigned char[256][6]));
+  unsigned char *temptrack=malloc(3000);
 
   if (!trackends||!trackptrs||!trackbuf||!patdata||!temptrack)
     return errAllocMem;
@@ -181,28 +188,28 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
   int tpos=0;
   for (i=0; i<ntracks; i++)
   {
-    int l=file.getus();
+    int l=bf_getus(file);
     trackptrs[1+i]=trackbuf+tpos;
-    file.read(trackbuf+tpos, l);
+    bf_read(file, trackbuf+tpos, l);
     tpos+=l;
     trackends[1+i]=trackbuf+tpos;
   }
 
-  for (i=0; i<m.ordnum; i++)
-    m.orders[i]=(ordtab[i]<patnum)?ordtab[i]:patnum;
+  for (i=0; i<m->ordnum; i++)
+    m->orders[i]=(ordtab[i]<patnum)?ordtab[i]:patnum;
 
   for (i=0; i<32; i++)
-    m.patterns[patnum].tracks[i]=m.tracknum-1;
-  m.patterns[patnum].gtrack=m.tracknum-1;
-  m.patterns[patnum].patlen=64;
+    m->patterns[patnum].tracks[i]=m->tracknum-1;
+  m->patterns[patnum].gtrack=m->tracknum-1;
+  m->patterns[patnum].patlen=64;
 
   for (j=0; j<patnum; j++)
   {
-    memset(patdata, 0, m.channum*256*6);
-    for (i=0; i<m.channum; i++)
+    memset(patdata, 0, m->channum*256*6);
+    for (i=0; i<m->channum; i++)
     {
-      unsigned char *trkptr=trackptrs[m.patterns[j].tracks[i]];
-      unsigned char *endptr=trackends[m.patterns[j].tracks[i]];
+      unsigned char *trkptr=trackptrs[m->patterns[j].tracks[i]];
+      unsigned char *endptr=trackends[m->patterns[j].tracks[i]];
       int row=0;
       while (trkptr<endptr)
       {
@@ -230,17 +237,17 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
       }
     }
 
-    for (i=0; i<m.channum; i++)
-      m.patterns[j].tracks[i]=j*(m.channum+1)+i;
-    m.patterns[j].gtrack=j*(m.channum+1)+m.channum;
+    for (i=0; i<m->channum; i++)
+      m->patterns[j].tracks[i]=j*(m->channum+1)+i;
+    m->patterns[j].gtrack=j*(m->channum+1)+m->channum;
 
-    for (i=0; i<m.channum; i++)
+    for (i=0; i<m->channum; i++)
     {
       unsigned char *tp=temptrack;
       unsigned char *buf=patdata[i][0];
 
       int row;
-      for (row=0; row<m.patterns[j].patlen; row++, buf+=6)
+      for (row=0; row<m->patterns[j].patlen; row++, buf+=6)
       {
         unsigned char *cp=tp+2;
 
@@ -270,7 +277,7 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         }
 
         if (!row&&(j==ordtab[0]))
-          putcmd(cp, cmdPlayNote|cmdPlayPan, mdlhead.pan[i]*2);
+          putcmd(&cp, cmdPlayNote|cmdPlayPan, mdlhead.pan[i]*2);
 
         if (command1==0x8)
           pan=data1*2;
@@ -283,41 +290,41 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
 
         if ((ins!=-1)||nte||(vol!=-1)||(pan!=-1))
         {
-          unsigned char &act=*cp;
+          unsigned char *act=cp;
           *cp++=cmdPlayNote;
           if (ins!=-1)
           {
-            act|=cmdPlayIns;
+            *act|=cmdPlayIns;
             *cp++=ins;
           }
           if (nte&&(nte!=255))
           {
-            act|=cmdPlayNte;
+            *act|=cmdPlayNte;
             *cp++=nte+11;
           }
           if (vol!=-1)
           {
-            act|=cmdPlayVol;
+            *act|=cmdPlayVol;
             *cp++=vol;
           }
           if (pan!=-1)
           {
-            act|=cmdPlayPan;
+            *act|=cmdPlayPan;
             *cp++=pan;
           }
           if (command1==0xDE)
           {
-            act|=cmdPlayDelay;
+            *act|=cmdPlayDelay;
             *cp++=data1;
           }
           else if (command2==0xDE)
           {
-            act|=cmdPlayDelay;
+            *act|=cmdPlayDelay;
             *cp++=data2;
           }
 
           if (nte==255)
-            putcmd(cp, cmdKeyOff, 0);
+            putcmd(&cp, cmdKeyOff, 0);
         }
 
 //E8x - Set Sample Status
@@ -326,64 +333,64 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         {
         case 0x1:
           if (!data1)
-            putcmd(cp, cmdSpecial, cmdContMixPitchSlideUp);
+            putcmd(&cp, cmdSpecial, cmdContMixPitchSlideUp);
           else
           if (data1<0xE0)
-            putcmd(cp, cmdPitchSlideUp, data1);
+            putcmd(&cp, cmdPitchSlideUp, data1);
           else
           if (data1<0xF0)
-            putcmd(cp, cmdRowPitchSlideUp, (data1&0xF)<<1);
+            putcmd(&cp, cmdRowPitchSlideUp, (data1&0xF)<<1);
           else
-            putcmd(cp, cmdRowPitchSlideUp, (data1&0xF)<<4);
+            putcmd(&cp, cmdRowPitchSlideUp, (data1&0xF)<<4);
           break;
         case 0x2:
           if (!data1)
-            putcmd(cp, cmdSpecial, cmdContMixPitchSlideDown);
+            putcmd(&cp, cmdSpecial, cmdContMixPitchSlideDown);
           else
           if (data1<0xE0)
-            putcmd(cp, cmdPitchSlideDown, data1);
+            putcmd(&cp, cmdPitchSlideDown, data1);
           else
           if (data1<0xF0)
-            putcmd(cp, cmdRowPitchSlideDown, (data1&0xF)<<1);
+            putcmd(&cp, cmdRowPitchSlideDown, (data1&0xF)<<1);
           else
-            putcmd(cp, cmdRowPitchSlideDown, (data1&0xF)<<4);
+            putcmd(&cp, cmdRowPitchSlideDown, (data1&0xF)<<4);
           break;
         case 0x3:
-          putcmd(cp, cmdPitchSlideToNote, data1);
+          putcmd(&cp, cmdPitchSlideToNote, data1);
           break;
         case 0x4:
-          putcmd(cp, cmdPitchVibrato, data1);
+          putcmd(&cp, cmdPitchVibrato, data1);
           break;
         case 0x5:
-          putcmd(cp, cmdArpeggio, data1);
+          putcmd(&cp, cmdArpeggio, data1);
           break;
         case 0x1E:
-          putcmd(cp, cmdRowPanSlide, -data1*2);
+          putcmd(&cp, cmdRowPanSlide, -data1*2);
           break;
         case 0x2E:
-          putcmd(cp, cmdRowPanSlide, data1*2);
+          putcmd(&cp, cmdRowPanSlide, data1*2);
           break;
         case 0x3E:
-          putcmd(cp, cmdSpecial, data1?cmdGlissOn:cmdGlissOff);
+          putcmd(&cp, cmdSpecial, data1?cmdGlissOn:cmdGlissOff);
           break;
         case 0x4E:
           if (data1<4)
-            putcmd(cp, cmdPitchVibratoSetWave, data1);
+            putcmd(&cp, cmdPitchVibratoSetWave, data1);
           break;
         case 0x7E:
           if (data1<4)
-            putcmd(cp, cmdVolVibratoSetWave, data1);
+            putcmd(&cp, cmdVolVibratoSetWave, data1);
           break;
         case 0x9E:
-          putcmd(cp, cmdRetrig, data1);
+          putcmd(&cp, cmdRetrig, data1);
           break;
         case 0xCE:
-          putcmd(cp, cmdNoteCut, data1);
+          putcmd(&cp, cmdNoteCut, data1);
           break;
         case 0xFE:
           if (ofs&0xF00)
-            putcmd(cp, cmdOffsetHigh, ofs>>8);
-          putcmd(cp, cmdOffset, ofs);
+            putcmd(&cp, cmdOffsetHigh, ofs>>8);
+          putcmd(&cp, cmdOffset, ofs);
           break;
         }
 
@@ -391,50 +398,50 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         {
         case 0x1:
           if (data2<0xE0)
-            putcmd(cp, cmdVolSlideUp, data2);
+            putcmd(&cp, cmdVolSlideUp, data2);
           else
           if (data2<0xF0)
-            putcmd(cp, cmdRowVolSlideUp, data2&0xF);
+            putcmd(&cp, cmdRowVolSlideUp, data2&0xF);
           else
-            putcmd(cp, cmdRowVolSlideUp, (data2&0xF)<<2);
+            putcmd(&cp, cmdRowVolSlideUp, (data2&0xF)<<2);
           break;
         case 0x2:
           if (data2<0xE0)
-            putcmd(cp, cmdVolSlideDown, data2);
+            putcmd(&cp, cmdVolSlideDown, data2);
           else
           if (data2<0xF0)
-            putcmd(cp, cmdRowVolSlideDown, data2&0xF);
+            putcmd(&cp, cmdRowVolSlideDown, data2&0xF);
           else
-            putcmd(cp, cmdRowVolSlideDown, (data2&0xF)<<2);
+            putcmd(&cp, cmdRowVolSlideDown, (data2&0xF)<<2);
           break;
         case 0x4:
-          putcmd(cp, cmdVolVibrato, data2);
+          putcmd(&cp, cmdVolVibrato, data2);
           break;
         case 0x5:
-          putcmd(cp, cmdTremor, data2);
+          putcmd(&cp, cmdTremor, data2);
           break;
         case 0x1E:
-          putcmd(cp, cmdRowPanSlide, -data2*2);
+          putcmd(&cp, cmdRowPanSlide, -data2*2);
           break;
         case 0x2E:
-          putcmd(cp, cmdRowPanSlide, data2*2);
+          putcmd(&cp, cmdRowPanSlide, data2*2);
           break;
         case 0x3E:
-          putcmd(cp, cmdSpecial, data1?cmdGlissOn:cmdGlissOff);
+          putcmd(&cp, cmdSpecial, data1?cmdGlissOn:cmdGlissOff);
           break;
         case 0x4E:
           if (data2<4)
-            putcmd(cp, cmdPitchVibratoSetWave, data2);
+            putcmd(&cp, cmdPitchVibratoSetWave, data2);
           break;
         case 0x7E:
           if (data2<4)
-            putcmd(cp, cmdVolVibratoSetWave, data2);
+            putcmd(&cp, cmdVolVibratoSetWave, data2);
           break;
         case 0x9E:
-          putcmd(cp, cmdRetrig, data2);
+          putcmd(&cp, cmdRetrig, data2);
           break;
         case 0xCE:
-          putcmd(cp, cmdNoteCut, data2);
+          putcmd(&cp, cmdNoteCut, data2);
           break;
         }
 
@@ -446,18 +453,18 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         }
       }
 
-      gmdtrack &trk=m.tracks[j*(m.channum+1)+i];
+      gmdtrack *trk=&m->tracks[j*(m->channum+1)+i];
       unsigned short len=tp-temptrack;
 
       if (!len)
-        trk.ptr=trk.end=0;
+        trk->ptr=trk->end=0;
       else
       {
-        trk.ptr=new unsigned char[len];
-        trk.end=trk.ptr+len;
-        if (!trk.ptr)
+        trk->ptr=ar_alloc(&m->heap, len);
+        trk->end=trk->ptr+len;
+        if (!trk->ptr)
           return errAllocMem;
-        memcpy(trk.ptr, temptrack, len);
+        memcpy(trk->ptr, temptrack, len);
       }
     }
 
@@ -465,21 +472,21 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
     unsigned char *buf=**patdata;
 
     int row;
-    for (row=0; row<m.patterns[j].patlen; row++, buf+=6)
+    for (row=0; row<m->patterns[j].patlen; row++, buf+=6)
     {
       unsigned char *cp=tp+2;
       if (!row&&(j==ordtab[0]))
       {
         if (mdlhead.speed!=6)
-          putcmd(cp, cmdTempo, mdlhead.speed);
+          putcmd(&cp, cmdTempo, mdlhead.speed);
         if (mdlhead.bpm!=125)
-          putcmd(cp, cmdSpeed, mdlhead.bpm);
+          putcmd(&cp, cmdSpeed, mdlhead.bpm);
         if (mdlhead.mainvol!=255)
-          putcmd(cp, cmdGlobVol, mdlhead.mainvol);
+          putcmd(&cp, cmdGlobVol, mdlhead.mainvol);
       }
 
       int q;
-      for (q=0; q<m.channum; q++)
+      for (q=0; q<m->channum; q++)
       {
         unsigned char command1=buf[256*6*q+3]&0xF;
         unsigned char command2=buf[256*6*q+3]>>4;
@@ -490,78 +497,78 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         {
         case 0x7:
           if (data1)
-            putcmd(cp, cmdSpeed, data1);
+            putcmd(&cp, cmdSpeed, data1);
           break;
         case 0xB:
-          putcmd(cp, cmdGoto, data1);
+          putcmd(&cp, cmdGoto, data1);
           break;
         case 0xD:
-          putcmd(cp, cmdBreak, (data1&0x0F)+(data1>>4)*10);
+          putcmd(&cp, cmdBreak, (data1&0x0F)+(data1>>4)*10);
           break;
         case 0xE:
           switch (data1>>4)
           {
           case 0x6:
-            putcmd(cp, cmdSetChan, q);
-            putcmd(cp, cmdPatLoop, data1&0xF);
+            putcmd(&cp, cmdSetChan, q);
+            putcmd(&cp, cmdPatLoop, data1&0xF);
             break;
           case 0xE:
-            putcmd(cp, cmdPatDelay, data1&0xF);
+            putcmd(&cp, cmdPatDelay, data1&0xF);
             break;
           case 0xA:
-            putcmd(cp, cmdGlobVolSlide, data1&0xF);
+            putcmd(&cp, cmdGlobVolSlide, data1&0xF);
             break;
           case 0xB:
-            putcmd(cp, cmdSetChan, q);
-            putcmd(cp, cmdGlobVolSlide, -(data1&0xF));
+            putcmd(&cp, cmdSetChan, q);
+            putcmd(&cp, cmdGlobVolSlide, -(data1&0xF));
             break;
           }
           break;
         case 0xF:
           if (data1)
-            putcmd(cp, cmdTempo, data1);
+            putcmd(&cp, cmdTempo, data1);
           break;
         case 0xC:
-          putcmd(cp, cmdGlobVol, data1);
+          putcmd(&cp, cmdGlobVol, data1);
           break;
         }
         switch (command2)
         {
         case 0x7:
           if (data2)
-            putcmd(cp, cmdSpeed, data2);
+            putcmd(&cp, cmdSpeed, data2);
           break;
         case 0xB:
-          putcmd(cp, cmdGoto, data2);
+          putcmd(&cp, cmdGoto, data2);
           break;
         case 0xD:
-          putcmd(cp, cmdBreak, (data2&0x0F)+(data2>>4)*10);
+          putcmd(&cp, cmdBreak, (data2&0x0F)+(data2>>4)*10);
           break;
         case 0xE:
           switch (data2>>4)
           {
           case 0x6:
-            putcmd(cp, cmdSetChan, q);
-            putcmd(cp, cmdPatLoop, data2&0xF);
+            putcmd(&cp, cmdSetChan, q);
+            putcmd(&cp, cmdPatLoop, data2&0xF);
             break;
           case 0xE:
-            putcmd(cp, cmdPatDelay, data2&0xF);
+            putcmd(&cp, cmdPatDelay, data2&0xF);
             break;
           case 0xA:
-            putcmd(cp, cmdGlobVolSlide, data2&0xF);
+            putcmd(&cp, cmdGlobVolSlide, data2&0xF);
             break;
           case 0xB:
-            putcmd(cp, cmdSetChan, q);
-            putcmd(cp, cmdGlobVolSlide, -(data2&0xF));
+            putcmd(&cp, cmdSetChan, q);
+            putcmd(&cp, cmdGlobVolSlide, -(data2&0xF));
             break;
           }
           break;
         case 0xF:
           if (data2)
-            putcmd(cp, cmdTempo, data2);
+            putcmd(&cp, cmdTempo, data2);
           break;
         case 0xC:
-          putcmd(cp, cmdGlobVol, data2);
+          putcmd(&cp, cmdGlobVol, data2);
           break;
         }
       }
@@ -574,60 +581,60 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
       }
     }
 
-    gmdtrack &trk=m.tracks[j*(m.channum+1)+m.channum];
+    gmdtrack *trk=&m->tracks[j*(m->channum+1)+m->channum];
     unsigned short len=tp-temptrack;
 
     if (!len)
-      trk.ptr=trk.end=0;
+      trk->ptr=trk->end=0;
     else
     {
-      trk.ptr=new unsigned char[len];
-      trk.end=trk.ptr+len;
-      if (!trk.ptr)
+      trk->ptr=ar_alloc(&m->heap, len);
+      trk->end=trk->ptr+len;
+      if (!trk->ptr)
         return errAllocMem;
-      memcpy(trk.ptr, temptrack, len);
+      memcpy(trk->ptr, temptrack, len);
     }
   }
-  delete temptrack;
-  delete trackends;
-  delete trackptrs;
-  delete trackbuf;
-  delete patdata;
+  free(temptrack);
+  free(trackends);
+  free(trackptrs);
+  free(trackbuf);
+  free(patdata);
 
-  if (file.getus()!=0x4949)
+  if (bf_getus(file)!=0x4949)
     return errFormStruc;
-  blklen=file.getul();
+  blklen=bf_getul(file);
 
-  int inssav=file.getuc();
+  int inssav=bf_getuc(file);
 
-  m.instnum=255;
-  m.modsampnum=0;
-  m.envnum=192;
+  m->instnum=255;
+  m->modsampnum=0;
+  m->envnum=192;
 
-//  envelope **envs=new envelope *[255];
-  gmdsample **msmps=new gmdsample *[255];
-  int *inssampnum=new int [255];
-//  int *insenvnum=new int [255];
-   if (/*!envs||!insenvnum||*/!inssampnum||!msmps||!mpAllocInstruments(m, m.instnum))
+//  envelope **envs=malloc((255)*sizeof(envelope *));
+  gmdsample **msmps=malloc((255)*sizeof(gmdsample *));
+  int *inssampnum=malloc((255)*sizeof(int));
+//  int *insenvnum=malloc((255)*sizeof(int));
+   if (/*!envs||!insenvnum||*/!inssampnum||!msmps||!mpAllocInstruments(m, m->instnum))
     return errAllocMem;
 
   int maxins=0;
 
-  memset(msmps, 0, 4*255);
+  memset(msmps, 0, 255*sizeof(*msmps));
 //  memset(envs, 0, 4*255);
-  memset(inssampnum, 0, 4*255);
+  memset(inssampnum, 0, 255*sizeof(*inssampnum));
 //  memset(insenvnum, 0, 4*255);
 
   for (j=0; j<inssav; j++)
   {
-    unsigned char insnum=file.getuc()-1;
-    gmdinstrument &ip=m.instruments[insnum];
-
-    inssampnum[j]=file.getuc();
-    file.read(ip.name, 32);
-    ip.name[31]=0;
-    msmps[j]=new gmdsample [inssampnum[j]];
-//    envs[insnum]=new envelope [inssampnum[j]];
+    unsigned char insnum=bf_getuc(file)-1;
+    gmdinstrument *ip=&m->instruments[insnum];
+
+    inssampnum[j]=bf_getuc(file);
+    bf_read(file, ip->name, 32);
+    ip->name[31]=0;
+    msmps[j]=malloc((inssampnum[j])*sizeof(gmdsample));
+//    envs[insnum]=malloc((inssampnum[j)*sizeof(envelope))];
     if (!msmps[j]/*||!envs[insnum]*/)
       return errAllocMem;
 
@@ -650,44 +657,45 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         unsigned char res1;
         unsigned char pchenv;
       } mdlmsmp;
-      file.read(&mdlmsmp, sizeof(mdlmsmp));
+      bf_read(file, &mdlmsmp, sizeof(mdlmsmp));
+      ims_swap16(&mdlmsmp.fadeout);
       if ((mdlmsmp.highnote+12)>128)
         mdlmsmp.highnote=128-12;
       while (note<(mdlmsmp.highnote+12))
-        ip.samples[note++]=m.modsampnum;
-      m.modsampnum++;
-
-      gmdsample &sp=msmps[j][i];
-      *sp.name=0;
-      sp.handle=mdlmsmp.smp-1;
-      sp.normnote=0;
-      sp.stdvol=(mdlmsmp.volenv&0x40)?mdlmsmp.vol:-1;
-      sp.stdpan=(mdlmsmp.panenv&0x40)?mdlmsmp.pan*2:-1;
-      sp.opt=0;
-      sp.volfade=mdlmsmp.fadeout;
-      sp.vibspeed=0;
-      sp.vibdepth=mdlmsmp.vibdep*4;
-      sp.vibrate=mdlmsmp.vibspd<<7;
-      sp.vibsweep=0xFFFF/(mdlmsmp.vibswp+1);
-      sp.vibtype=mdlmsmp.vibfrm;
-      sp.pchint=4;
-      sp.volenv=(mdlmsmp.volenv&0x80)?(mdlmsmp.volenv&0x3F):0xFFFF;
-      sp.panenv=(mdlmsmp.panenv&0x80)?(64+(mdlmsmp.panenv&0x3F)):0xFFFF;
-      sp.pchenv=(mdlmsmp.pchenv&0x80)?(128+(mdlmsmp.pchenv&0x3F)):0xFFFF;;
+        ip->samples[note++]=m->modsampnum;
+      m->modsampnum++;
+
+      gmdsample *sp=&msmps[j][i];
+      *sp->name=0;
+      sp->handle=mdlmsmp.smp-1;
+      sp->normnote=0;
+      sp->stdvol=(mdlmsmp.volenv&0x40)?mdlmsmp.vol:-1;
+      sp->stdpan=(mdlmsmp.panenv&0x40)?mdlmsmp.pan*2:-1;
+      sp->opt=0;
+      sp->volfade=mdlmsmp.fadeout;
+      sp->vibspeed=0;
+      sp->vibdepth=mdlmsmp.vibdep*4;
+      sp->vibrate=mdlmsmp.vibspd<<7;
+      sp->vibsweep=0xFFFF/(mdlmsmp.vibswp+1);
+      sp->vibtype=mdlmsmp.vibfrm;
+      sp->pchint=4;
+      sp->volenv=(mdlmsmp.volenv&0x80)?(mdlmsmp.volenv&0x3F):0xFFFF;
+      sp->panenv=(mdlmsmp.panenv&0x80)?(64+(mdlmsmp.panenv&0x3F)):0xFFFF;
+      sp->pchenv=(mdlmsmp.pchenv&0x80)?(128+(mdlmsmp.pchenv&0x3F)):0xFFFF;;
 /*
       if (mdlmsmp.vibdep&&mdlmsmp.vibspd)
       {
-        sp.vibenv=m.envnum++;
-
-        envelope &ep=envs[insnum][insenvnum[j]++];
-        ep.speed=0;
-        ep.opt=0;
-        ep.len=512;
-        ep.sustain=-1;
-        ep.loops=0;
-        ep.loope=512;
-        ep.env=new unsigned char [512];
-        if (!ep.env)
+        sp->vibenv=m->envnum++;
+
+        envelope *ep=&envs[insnum][insenvnum[j]++];
+        ep->speed=0;
+        ep->opt=0;
+        ep->len=512;
+        ep->sustain=-1;
+        ep->loops=0;
+        ep->loope=512;
+        ep->env=malloc(512);
+        if (!ep->env)
           return errAllocMem;
         unsigned char ph=0;
         for (k=0; k<512; k++)
@@ -696,16 +704,16 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
           switch (mdlmsmp.vibfrm)
           {
           case 0:
-            ep.env[k]=128+((mdlmsmp.vibdep*vibsintab[ph])>>10);
+            ep->env[k]=128+((mdlmsmp.vibdep*vibsintab[ph])>>10);
             break;
           case 1:
-            ep.env[k]=128+((mdlmsmp.vibdep*(64-(ph&128)))>>5);
+            ep->env[k]=128+((mdlmsmp.vibdep*(64-(ph&128)))>>5);
             break;
           case 2:
-            ep.env[k]=128+((mdlmsmp.vibdep*(128-ph))>>6);
+            ep->env[k]=128+((mdlmsmp.vibdep*(128-ph))>>6);
             break;
           case 3:
-            ep.env[k]=128+((mdlmsmp.vibdep*(ph-128))>>6);
+            ep->env[k]=128+((mdlmsmp.vibdep*(ph-128))>>6);
             break;
           }
         }
@@ -714,32 +722,32 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
     }
   }
 
-  m.sampnum=255;
-  if (!mpAllocModSamples(m, m.modsampnum)||!mpAllocEnvelopes(m, m.envnum)||!mpAllocSamples(m, m.sampnum))
+  m->sampnum=255;
+  if (!mpAllocModSamples(m, m->modsampnum)||!mpAllocEnvelopes(m, m->envnum)||!mpAllocSamples(m, m->sampnum))
     return errAllocMem;
 
   int smpnum=0;
 //  int envnum=192;
   for (j=0; j<255; j++)
   {
-    memcpy(m.modsamples+smpnum, msmps[j], sizeof (*m.modsamples)*inssampnum[j]);
+    memcpy(m->modsamples+smpnum, msmps[j], sizeof (*m->modsamples)*inssampnum[j]);
     smpnum+=inssampnum[j];
 //!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 //    for (i=0; i<insenvnum[j]; i++)
-//      memcpy(&m.envelopes[envnum++], &envs[j][i], sizeof (*m.envelopes));
-    delete msmps[j];
+//      memcpy(&m->envelopes[envnum++], &envs[j][i], sizeof (*m->envelopes));
+    free(msmps[j]);
 //    delete envs[j];
   }
-  delete msmps;
-//  delete envs;
-  delete inssampnum;
-//  delete insenvnum;
+  free(msmps);
+//  free(envs);
+  free(inssampnum);
+//  free(insenvnum);
 
-  blktype=file.getus();
-  blklen=file.getul();
+  blktype=bf_getus(file);
+  blklen=bf_getul(file);
   if (blktype==0x4556)
   {
-    unsigned char envnum=file.getuc();
+    unsigned char envnum=bf_getuc(file);
     for (i=0; i<envnum; i++)
     {
       struct
@@ -749,13 +757,13 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         unsigned char sus;
         unsigned char loop;
       } env;
-      file.read(&env, sizeof(env));
+      bf_read(file, &env, 33);
       if (env.env[0][0]!=1)
         continue;
-      gmdenvelope &e=m.envelopes[env.num];
+      gmdenvelope *e=&m->envelopes[env.num];
 
-      e.type=((env.sus&16)?mpEnvSLoop:0)|((env.sus&32)?mpEnvLoop:0);
-      e.speed=0;
+      e->type=((env.sus&16)?mpEnvSLoop:0)|((env.sus&32)?mpEnvLoop:0);
+      e->speed=0;
       int k,l;
       l=-1;
       for (j=0; j<15; j++)
@@ -764,42 +772,42 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
           break;
         l+=env.env[j][0];
         if ((env.loop&15)==j)
-          e.loops=l;
+          e->loops=l;
         if ((env.loop>>4)==j)
-          e.loope=l;
+          e->loope=l;
         if ((env.sus&15)==j)
         {
-          e.sloops=l;
-          e.sloope=l+1;
+          e->sloops=l;
+          e->sloope=l+1;
         }
       }
-      if ((e.type&mpEnvSLoop)&&(e.type&mpEnvLoop)&&(e.sloope>e.loope))
+      if ((e->type&mpEnvSLoop)&&(e->type&mpEnvLoop)&&(e->sloope>e->loope))
       {
-        e.sloops=e.loops;
-        e.sloope=e.loope;
+        e->sloops=e->loops;
+        e->sloope=e->loope;
       }
-      e.len=l;
-      e.env=new unsigned char [l+1];
-      if (!e.env)
+      e->len=l;
+      e->env=malloc(l+1);
+      if (!e->env)
         return errAllocMem;
       l=1;
-      e.env[0]=env.env[0][1]<<2;
+      e->env[0]=env.env[0][1]<<2;
       for (j=0; j<15; j++)
       {
         if (!env.env[j+1][0])
           break;
         for (k=1; k<=env.env[j+1][0]; k++)
-          e.env[l++]=4*env.env[j][1]+4*k*(env.env[j+1][1]-env.env[j][1])/env.env[j+1][0];
+          e->env[l++]=4*env.env[j][1]+4*k*(env.env[j+1][1]-env.env[j][1])/env.env[j+1][0];
       }
     }
 
-    blktype=file.getus();
-    blklen=file.getul();
+    blktype=bf_getus(file);
+    blklen=bf_getul(file);
   }
 
   if (blktype==0x4550)
   {
-    unsigned char envnum=file.getuc();
+    unsigned char envnum=bf_getuc(file);
     for (i=0; i<envnum; i++)
     {
       struct
@@ -809,13 +817,13 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         unsigned char sus;
         unsigned char loop;
       } env;
-      file.read(&env, sizeof(env));
+      bf_read(file, &env, 33);
       if (env.env[0][0]!=1)
         continue;
-      gmdenvelope &e=m.envelopes[64+env.num];
+      gmdenvelope *e=&m->envelopes[64+env.num];
 
-      e.type=((env.sus&16)?mpEnvSLoop:0)|((env.sus&32)?mpEnvLoop:0);
-      e.speed=0;
+      e->type=((env.sus&16)?mpEnvSLoop:0)|((env.sus&32)?mpEnvLoop:0);
+      e->speed=0;
       int k,l;
       l=-1;
       for (j=0; j<15; j++)
@@ -824,42 +832,42 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
           break;
         l+=env.env[j][0];
         if ((env.loop&15)==j)
-          e.loops=l;
+          e->loops=l;
         if ((env.loop>>4)==j)
-          e.loope=l;
+          e->loope=l;
         if ((env.sus&15)==j)
         {
-          e.sloops=l;
-          e.sloope=l+1;
+          e->sloops=l;
+          e->sloope=l+1;
         }
       }
-      if ((e.type&mpEnvSLoop)&&(e.type&mpEnvLoop)&&(e.sloope>e.loope))
+      if ((e->type&mpEnvSLoop)&&(e->type&mpEnvLoop)&&(e->sloope>e->loope))
       {
-        e.sloops=e.loops;
-        e.sloope=e.loope;
+        e->sloops=e->loops;
+        e->sloope=e->loope;
       }
-      e.len=l;
-      e.env=new unsigned char [l+1];
-      if (!e.env)
+      e->len=l;
+      e->env=malloc(l+1);
+      if (!e->env)
         return errAllocMem;
       l=1;
-      e.env[0]=env.env[0][1]<<2;
+      e->env[0]=env.env[0][1]<<2;
       for (j=0; j<15; j++)
       {
         if (!env.env[j+1][0])
           break;
         for (k=1; k<=env.env[j+1][0]; k++)
-          e.env[l++]=4*env.env[j][1]+4*k*(env.env[j+1][1]-env.env[j][1])/env.env[j+1][0];
+          e->env[l++]=4*env.env[j][1]+4*k*(env.env[j+1][1]-env.env[j][1])/env.env[j+1][0];
       }
     }
 
-    blktype=file.getus();
-    blklen=file.getul();
+    blktype=bf_getus(file);
+    blklen=bf_getul(file);
   }
 
   if (blktype==0x4546)
   {
-    unsigned char envnum=file.getuc();
+    unsigned char envnum=bf_getuc(file);
     for (i=0; i<envnum; i++)
     {
       struct
@@ -869,13 +877,13 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         unsigned char sus;
         unsigned char loop;
       } env;
-      file.read(&env, sizeof(env));
+      bf_read(file, &env, 33);
       if (env.env[0][0]!=1)
         continue;
-      gmdenvelope &e=m.envelopes[128+env.num];
+      gmdenvelope *e=&m->envelopes[128+env.num];
 
-      e.type=((env.sus&32)?mpEnvLoop:0)|((env.sus&16)?mpEnvSLoop:0);
-      e.speed=0;
+      e->type=((env.sus&32)?mpEnvLoop:0)|((env.sus&16)?mpEnvSLoop:0);
+      e->speed=0;
       int k,l;
       l=-1;
       for (j=0; j<15; j++)
@@ -884,43 +892,43 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
           break;
         l+=env.env[j][0];
         if ((env.loop&15)==j)
-          e.loops=l;
+          e->loops=l;
         if ((env.loop>>4)==j)
-          e.loope=l;
+          e->loope=l;
         if ((env.sus&15)==j)
         {
-          e.sloops=l;
-          e.sloope=l+1;
+          e->sloops=l;
+          e->sloope=l+1;
         }
       }
-      if ((e.type&mpEnvSLoop)&&(e.type&mpEnvLoop)&&(e.sloope>e.loope))
+      if ((e->type&mpEnvSLoop)&&(e->type&mpEnvLoop)&&(e->sloope>e->loope))
       {
-        e.sloops=e.loops;
-        e.sloope=e.loope;
+        e->sloops=e->loops;
+        e->sloope=e->loope;
       }
-      e.len=l;
-      e.env=new unsigned char [l+1];
-      if (!e.env)
+      e->len=l;
+      e->env=malloc(l+1);
+      if (!e->env)
         return errAllocMem;
       l=1;
-      e.env[0]=env.env[0][1]<<2;
+      e->env[0]=env.env[0][1]<<2;
       for (j=0; j<15; j++)
       {
         if (!env.env[j+1][0])
           break;
         for (k=1; k<=env.env[j+1][0]; k++)
-          e.env[l++]=4*env.env[j][1]+4*k*(env.env[j+1][1]-env.env[j][1])/env.env[j+1][0];
+          e->env[l++]=4*env.env[j][1]+4*k*(env.env[j+1][1]-env.env[j][1])/env.env[j+1][0];
       }
     }
 
-    blktype=file.getus();
-    blklen=file.getul();
+    blktype=bf_getus(file);
+    blklen=bf_getul(file);
   }
 
   if (blktype!=0x5349)
     return errFormStruc;
 
-  int smpsav=file.getuc();
+  int smpsav=bf_getuc(file);
 
   unsigned char packtype[255];
   memset(packtype, 0xFF, 255);
@@ -939,7 +947,16 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
       unsigned char vol;
       unsigned char opt;
     } mdlsmp;
-    file.read(&mdlsmp, sizeof(mdlsmp));
+    // the file layout is packed, read field by field
+    mdlsmp.num=bf_getuc(file);
+    bf_read(file, mdlsmp.name, 32);
+    bf_read(file, mdlsmp.filename, 8);
+    mdlsmp.rate=bf_getul(file);
+    mdlsmp.len=bf_getul(file);
+    mdlsmp.loopstart=bf_getul(file);
+    mdlsmp.replen=bf_getul(file);
+    mdlsmp.vol=bf_getuc(file);
+    mdlsmp.opt=bf_getuc(file);
 
     mdlsmp.name[31]=0;
     if (mdlsmp.opt&1)
@@ -949,58 +966,60 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
       mdlsmp.replen>>=1;
     }
 
-    for (j=0; j<m.modsampnum; j++)
-      if (m.modsamples[j].handle==(mdlsmp.num-1))
-        strcpy(m.modsamples[j].name, mdlsmp.name);
+    for (j=0; j<m->modsampnum; j++)
+      if (m->modsamples[j].handle==(mdlsmp.num-1))
+        strcpy(m->modsamples[j].name, mdlsmp.name);
 
-    sampleinfo &sip=m.samples[mdlsmp.num-1];
+    sampleinfo *sip=&m->samples[mdlsmp.num-1];
 
-    sip.ptr=0;
-    sip.length=mdlsmp.len;
-    sip.loopstart=mdlsmp.loopstart;
-    sip.loopend=mdlsmp.loopstart+mdlsmp.replen;
-    sip.samprate=mdlsmp.rate;
-    sip.type=((mdlsmp.opt&1)?mcpSamp16Bit:0)|(mdlsmp.replen?mcpSampLoop:0)|((mdlsmp.opt&2)?mcpSampBiDi:0);
+    sip->ptr=0;
+    sip->length=mdlsmp.len;
+    sip->loopstart=mdlsmp.loopstart;
+    sip->loopend=mdlsmp.loopstart+mdlsmp.replen;
+    sip->samprate=mdlsmp.rate;
+    sip->type=((mdlsmp.opt&1)?mcpSamp16Bit:0)|(mdlsmp.replen?mcpSampLoop:0)|((mdlsmp.opt&2)?mcpSampBiDi:0);
 
     packtype[mdlsmp.num-1]=(mdlsmp.opt>>2)&3;
   }
 
-  if (file.getus()!=0x4153)
+  if (bf_getus(file)!=0x4153)
     return errFormStruc;
-  blklen=file.getul();
+  blklen=bf_getul(file);
 
   for (i=0; i<255; i++)
   {
     if (packtype[i]==255)
       continue;
 
-    sampleinfo &sip=m.samples[i];
-    int bit16=!!(sip.type&mcpSamp16Bit);
+    sampleinfo *sip=&m->samples[i];
+    int bit16=!!(sip->type&mcpSamp16Bit);
 
-    sip.ptr=new unsigned char [(sip.length+8)<<bit16];
-    if (!sip.ptr)
+    sip->ptr=malloc((sip->length+8)<<bit16);
+    if (!sip->ptr)
       return errAllocMem;
 
     if (packtype[i]==0)
     {
-      file.read(sip.ptr, sip.length<<bit16);
+      bf_read(file, sip->ptr, sip->length<<bit16);
+      if (bit16)
+        sip->type|=mcpSampBigEndian;
       continue;
     }
 
-    unsigned long packlen=file.getul();
-    unsigned char *packbuf=new unsigned char [packlen+4];
+    unsigned long packlen=bf_getul(file);
+    unsigned char *packbuf=malloc(packlen+4);
 
     if (!packbuf)
       return errAllocMem;
-    file.read(packbuf, packlen);
+    bf_read(file, packbuf, packlen);
 
-    bitbuf=*(unsigned long*)packbuf;
+    bitbuf=packbuf[0]|(packbuf[1]<<8)|((unsigned long)packbuf[2]<<16)|((unsigned long)packbuf[3]<<24);
     bitnum=32;
     ibuf=packbuf+4;
 
     unsigned char dlt=0;
     bit16=packtype[i]==2;
-    for (j=0; j<sip.length; j++)
+    for (j=0; j<sip->length; j++)
     {
       unsigned char lowbyte;
       if (bit16)
@@ -1021,12 +1040,12 @@ extern "C" int mpLoadMDL(gmdmodule &m, binfile &file)
         byte=~byte;
       dlt+=byte;
       if (!bit16)
-        ((unsigned char*)sip.ptr)[j]=dlt;
+        ((unsigned char*)sip->ptr)[j]=dlt;
       else
-        ((unsigned short*)sip.ptr)[j]=(dlt<<8)|lowbyte;
+        ((unsigned short*)sip->ptr)[j]=(dlt<<8)|lowbyte;
     }
 
-    delete packbuf;
+    free(packbuf);
   }
 
   return errOk;
@@ -8,24 +8,27 @@
 //    -first release
 
 #include <string.h>
+#include <stdlib.h>
 #include "binfile.h"
 #include "mcp.h"
 #include "gmdplay.h"
 #include "err.h"
 
-static inline void putcmd(unsigned char *&p, unsigned char c, unsigned char d)
+static inline void putcmd(unsigned char **pp, unsigned char c, unsigned char d)
 {
+  unsigned char *p=*pp;
   *p++=c;
   *p++=d;
+  *pp=p;
 }
 
-extern "C" int mpLoadMTM(gmdmodule &m, binfile &file)
+int mpLoadMTM(gmdmodule *m, binfile *file)
 {
   mpReset(m);
 
   struct
   {
-    unsigned long sig;
+    bf_ulong sig;
     char name[20];
     unsigned short trknum;
     unsigned char patnum;
@@ -38,7 +41,10 @@ extern "C" int mpLoadMTM(gmdmodule &m, binfile &file)
     char pan[32];
   } header;
 
-  file.read(&header, 66);
+  bf_read(file, &header, 66);
+  ims_swap32(&header.sig);
+  ims_swap16(&header.trknum);
+  ims_swap16(&header.comlen);
 
   if ((header.sig&0xFFFFFF)!=0x4D544D)
     return errFormSig;
@@ -46,38 +52,43 @@ extern "C" int mpLoadMTM(gmdmodule &m, binfile &file)
   if ((header.sig&0xFF000000)!=0x10000000)
     return errFormOldVer;
 
-  memcpy(m.name, header.name, 20);
-  m.name[20]=0;
-
-  m.options=0;
-  m.channum=header.channum;
-  m.modsampnum=m.sampnum=m.instnum=header.insnum;
-  m.ordnum=header.ordnum+1;
-  m.patnum=header.ordnum+1;
-  m.endord=m.patnum;
-  m.tracknum=(header.channum+1)*(header.patnum+1);
-  m.loopord=0;
-
-  if (!mpAllocInstruments(m, m.instnum)||!mpAllocPatterns(m, m.patnum)||!mpAllocTracks(m, m.tracknum)||!mpAllocSamples(m, m.sampnum)||!mpAllocModSamples(m, m.modsampnum)||!mpAllocOrders(m, m.ordnum))
+  memcpy(m->name, header.name, 20);
+  m->name[20]=0;
+
+  m->options=0;
+  m->channum=header.channum;
+  m->modsampnum=m->sampnum=m->instnum=header.insnum;
+  m->ordnum=header.ordnum+1;
+  m->patnum=header.ordnum+1;
+  m->endord=m->patnum;
+  m->tracknum=(header.channum+1)*(header.patnum+1);
+  m->loopord=0;
+
+  // tables and packed tracks share one arena, roughly 2 bytes per track row
+  ar_init(&m->heap, m->tracknum*(sizeof(gmdtrack)+128)+m->patnum*sizeof(gmdpattern)+m->instnum*(sizeof(gmdinstrument)+sizeof(gmdsample)+sizeof(sampleinfo)));
+  if (!mpAllocInstruments(m, m->instnum)||!mpAllocPatterns(m, m->patnum)||!mpAllocTracks(m, m->tracknum)||!mpAllocSamples(m, m->sampnum)||!mpAllocModSamples(m, m->modsampnum)||!mpAllocOrders(m, m->ordnum))
     return errAllocMem;
 
   int i,t;
-  for (i=0; i<m.ordnum; i++)
-    m.orders[i]=i;
+  for (i=0; i<m->ordnum; i++)
+    m->orders[i]=i;
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
     struct
     {
       char name[22];
-      unsigned long length;
-      unsigned long loopstart;
-      unsigned long loopend;
+      bf_ulong length;
+      bf_ulong loopstart;
+      bf_ulong loopend;
       signed char finetune;
       unsigned char volume;
       char attr; //1=16 bit
     } mi;
-    file.read(&mi, sizeof(mi));
+    bf_read(file, &mi, 37);
+    ims_swap32(&mi.length);
+    ims_swap32(&mi.loopstart);
+    ims_swap32(&mi.loopend);
 
     if (mi.length<4)
       mi.length=0;
@@ -92,59 +103,62 @@ extern "C" int mpLoadMTM(gmdmodule &m, binfile &file)
     if (mi.finetune&0x08)
       mi.finetune|=0xF0;
 
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
 
-    memcpy(ip.name, mi.name, 22);
-    ip.name[22]=0;
+    memcpy(ip->name, mi.name, 22);
+    ip->name[22]=0;
     if (!mi.length)
       continue;
     for (t=0; t<128; t++)
-      ip.samples[t]=i;
-    *sp.name=0;
-    sp.handle=i;
-    sp.normnote=-mi.finetune*32;
-    sp.stdvol=(mi.volume>=0x3F)?0xFF:(mi.volume<<2);
-    sp.stdpan=-1;
-    sp.opt=0;
-
-    sip.loopstart=mi.loopstart;
-    sip.loopend=mi.loopend;
-    sip.length=mi.length;
-    sip.samprate=8363;
-    sip.type=((mi.loopend)?mcpSampLoop:0)|((mi.attr&1)?mcpSamp16Bit:0)|mcpSampUnsigned;
+      ip->samples[t]=i;
+    *sp->name=0;
+    sp->handle=i;
+    sp->normnote=-mi.finetune*32;
+    sp->stdvol=(mi.volume>=0x3F)?0xFF:(mi.volume<<2);
+    sp->stdpan=-1;
+    sp->opt=0;
+
+    sip->loopstart=mi.loopstart;
+    sip->loopend=mi.loopend;
+    sip->length=mi.length;
+    sip->samprate=8363;
+    sip->type=((mi.loopend)?mcpSampLoop:0)|((mi.attr&1)?mcpSamp16Bit:0)|mcpSampUnsigned;
   }
 
   unsigned char orders[128];
 
-  file.read(orders, 128);
+  bf_read(file, orders, 128);
 
   gmdpattern *pp;
-  for (pp=m.patterns, t=0; t<m.patnum; pp++, t++)
+  for (pp=m->patterns, t=0; t<m->patnum; pp++, t++)
   {
     pp->patlen=header.patlen;
-    for (i=0; i<m.channum; i++)
-      pp->tracks[i]=orders[t]*(m.channum+1)+i;
-    pp->gtrack=orders[t]*(m.channum+1)+m.channum;
+    for (i=0; i<m->channum; i++)
+      pp->tracks[i]=orders[t]*(m->channum+1)+i;
+    pp->gtrack=orders[t]*(m->channum+1)+m->channum;
   }
 
-  unsigned long filetracks=file.tell();
+  unsigned long filetracks=bf_tell(file);
 
-  unsigned char *temptrack=new unsigned char[2000];
-  unsigned char *tbuffer=new unsigned char[192*header.trknum+192];
-  unsigned short (*trackseq)[32]=new unsigned short[header.patnum+1][32];
+  unsigned char *temptrack=malloc(2000);
+  unsigned char *tbuffer=malloc(192*header.trknum+192);
+  unsigned short (*trackseq)[32]=malloc((header.patnum+1)*sizeof(unsigned short[32]));
   if (!tbuffer||!temptrack||!trackseq)
     return errAllocMem;
 
   memset(tbuffer, 0, 192);
-  file.read(tbuffer+192, 192*header.trknum);
-  file.read(trackseq, 64*(header.patnum+1));
+  bf_read(file, tbuffer+192, 192*header.trknum);
+  bf_read(file, trackseq, 64*(header.patnum+1));
+  for (t=0; t<=header.patnum; t++)
+    for (i=0; i<32; i++)
+      ims_swap16(&trackseq[t][i]);
 
   for (t=0; t<=header.patnum; t++)
   {
     unsigned char *buffer[32];
-    for (i=0; i<m.channum; i++)
+    for (i=0; i<m->channum; i++)
     {
       buffer[i]=tbuffer+192*trackseq[t][i];
 
@@ -202,126 +216,126 @@ extern "C" int mpLoadMTM(gmdmodule &m, binfile &file)
 
         if ((ins!=-1)||(nte!=-1)||(vol!=-1)||(pan!=-1))
         {
-          unsigned char &act=*cp;
+          unsigned char *act=cp;
           *cp++=cmdPlayNote;
           if (ins!=-1)
           {
-            act|=cmdPlayIns;
+            *act|=cmdPlayIns;
             *cp++=ins;
           }
           if (nte!=-1)
           {
-            act|=cmdPlayNte;
+            *act|=cmdPlayNte;
             *cp++=nte;
           }
           if (vol!=-1)
           {
-            act|=cmdPlayVol;
+            *act|=cmdPlayVol;
             *cp++=vol;
           }
           if (pan!=-1)
           {
-            act|=cmdPlayPan;
+            *act|=cmdPlayPan;
             *cp++=pan;
           }
           if (command==0xDE)
           {
-            act|=cmdPlayDelay;
+            *act|=cmdPlayDelay;
             *cp++=data;
           }
         }
 
         if (pansrnd)
-          putcmd(cp, cmdPanSurround, 0);
+          putcmd(&cp, cmdPanSurround, 0);
 
         switch (command)
         {
         case 0x0:
           if (data)
-            putcmd(cp, cmdArpeggio, data);
+            putcmd(&cp, cmdArpeggio, data);
           break;
         case 0x1:
           if (data)
-            putcmd(cp, cmdPitchSlideUp, data);
+            putcmd(&cp, cmdPitchSlideUp, data);
           break;
         case 0x2:
           if (data)
-            putcmd(cp, cmdPitchSlideDown, data);
+            putcmd(&cp, cmdPitchSlideDown, data);
           break;
         case 0x3:
-          putcmd(cp, cmdPitchSlideToNote, data);
+          putcmd(&cp, cmdPitchSlideToNote, data);
           break;
         case 0x4:
-          putcmd(cp, cmdPitchVibrato, data);
+          putcmd(&cp, cmdPitchVibrato, data);
           break;
         case 0x5:
           if ((data&0x0F)&&(data&0xF0))
             data=0;
-          putcmd(cp, cmdPitchSlideToNote, 0);
+          putcmd(&cp, cmdPitchSlideToNote, 0);
           if (data&0xF0)
-            putcmd(cp, cmdVolSlideUp, (data>>4)<<2);
+            putcmd(&cp, cmdVolSlideUp, (data>>4)<<2);
           else
           if (data&0x0F)
-            putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
           break;
         case 0x6:
           if ((data&0x0F)&&(data&0xF0))
             data=0;
-          putcmd(cp, cmdPitchVibrato, 0);
+          putcmd(&cp, cmdPitchVibrato, 0);
           if (data&0xF0)
-            putcmd(cp, cmdVolSlideUp, (data>>4)<<2);
+            putcmd(&cp, cmdVolSlideUp, (data>>4)<<2);
           else
           if (data&0x0F)
-            putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
           break;
         case 0x7:
-          putcmd(cp, cmdVolVibrato, data);
+          putcmd(&cp, cmdVolVibrato, data);
           break;
         case 0x9:
-          putcmd(cp, cmdOffset, data);
+          putcmd(&cp, cmdOffset, data);
           break;
         case 0xA:
           if ((data&0x0F)&&(data&0xF0))
             data=0;
           if (data&0xF0)
-            putcmd(cp, cmdVolSlideUp, (data>>4)<<2);
+            putcmd(&cp, cmdVolSlideUp, (data>>4)<<2);
           else
           if (data&0x0F)
-            putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
           break;
         case 0x1E:
           if (data)
-            putcmd(cp, cmdRowPitchSlideUp, data<<4);
+            putcmd(&cp, cmdRowPitchSlideUp, data<<4);
           break;
         case 0x2E:
           if (data)
-            putcmd(cp, cmdRowPitchSlideDown, data<<4);
+            putcmd(&cp, cmdRowPitchSlideDown, data<<4);
           break;
         case 0x3E:
-          putcmd(cp, cmdSpecial, data?cmdGlissOn:cmdGlissOff);
+          putcmd(&cp, cmdSpecial, data?cmdGlissOn:cmdGlissOff);
           break;
         case 0x4E:
           if (data<4)
-            putcmd(cp, cmdPitchVibratoSetWave, data);
+            putcmd(&cp, cmdPitchVibratoSetWave, data);
           break;
         case 0x7E:
           if (data<4)
-            putcmd(cp, cmdVolVibratoSetWave, data);
+            putcmd(&cp, cmdVolVibratoSetWave, data);
           break;
         case 0x9E:
           if (data)
-            putcmd(cp, cmdRetrig, data);
+            putcmd(&cp, cmdRetrig, data);
           break;
         case 0xAE:
           if (data)
-            putcmd(cp, cmdRowVolSlideUp, data<<2);
+            putcmd(&cp, cmdRowVolSlideUp, data<<2);
           break;
         case 0xBE:
           if (data)
-            putcmd(cp, cmdRowVolSlideDown, data<<2);
+            putcmd(&cp, cmdRowVolSlideDown, data<<2);
           break;
         case 0xCE:
-          putcmd(cp, cmdNoteCut, data);
+          putcmd(&cp, cmdNoteCut, data);
           break;
         }
 
@@ -333,18 +347,18 @@ extern "C" int mpLoadMTM(gmdmodule &m, binfile &file)
         }
       }
 
-      gmdtrack &trk=m.tracks[t*(m.channum+1)+i];
+      gmdtrack *trk=&m->tracks[t*(m->channum+1)+i];
       unsigned short len=tp-temptrack;
 
       if (!len)
-        trk.ptr=trk.end=0;
+        trk->ptr=trk->end=0;
       else
       {
-        trk.ptr=new unsigned char[len];
-        trk.end=trk.ptr+len;
-        if (!trk.ptr)
+        trk->ptr=ar_alloc(&m->heap, len);
+        trk->end=trk->ptr+len;
+        if (!trk->ptr)
           return errAllocMem;
-        memcpy(trk.ptr, temptrack, len);
+        memcpy(trk->ptr, temptrack, len);
       }
     }
 
@@ -354,7 +368,7 @@ extern "C" int mpLoadMTM(gmdmodule &m, binfile &file)
     for (row=0; row<64; row++)
     {
       unsigned char *cp=tp+2;
-      for (i=0; i<m.channum; i++)
+      for (i=0; i<m->channum; i++)
       {
         buf=buffer[i]+row*3;
         unsigned char command=buf[1]&0xF;
@@ -367,26 +381,28 @@ extern "C" int mpLoadMTM(gmdmodule &m, binfile &file)
         switch (command)
         {
         case 0xB:
-          putcmd(cp, cmdGoto, data);
+          putcmd(&cp, cmdGoto, data);
           break;
         case 0xD:
           if (data>=0x64)
             data=0;
-          putcmd(cp, cmdBreak, (data&0xF)+(data>>4)*10);
+          putcmd(&cp, cmdBreak, (data&0xF)+(data>>4)*10);
           break;
         case 0x6E:
-          putcmd(cp, cmdSetChan, i);
-          putcmd(cp, cmdPatLoop, data);
+          putcmd(&cp, cmdSetChan, i);
+          putcmd(&cp, cmdPatLoop, data);
           break;
         case 0xEE:
-          putcmd(cp, cmdPatDelay, data);
+          putcmd(&cp, cmdPatDelay, data);
           break;
         case 0xF:
           if (data)
+          {
             if (data<0x20)
-              putcmd(cp, cmdTempo, data);
+              putcmd(&cp, cmdTempo, data);
             else
-              putcmd(cp, cmdSpeed, data);
+              putcmd(&cp, cmdSpeed, data);
+          }
           break;
         }
       }
@@ -399,61 +415,63 @@ extern "C" int mpLoadMTM(gmdmodule &m, binfile &file)
       }
     }
 
-    gmdtrack &trk=m.tracks[t*(m.channum+1)+m.channum];
+    gmdtrack *trk=&m->tracks[t*(m->channum+1)+m->channum];
     unsigned short len=tp-temptrack;
 
     if (!len)
-      trk.ptr=trk.end=0;
+      trk->ptr=trk->end=0;
     else
     {
-      trk.ptr=new unsigned char[len];
-      trk.end=trk.ptr+len;
-      if (!trk.ptr)
+      trk->ptr=ar_alloc(&m->heap, len);
+      trk->end=trk->ptr+len;
+      if (!trk->ptr)
         return errAllocMem;
-      memcpy(trk.ptr, temptrack, len);
+      memcpy(trk->ptr, temptrack, len);
     }
   }
 
-  delete temptrack;
-  delete tbuffer;
-  delete trackseq;
+  free(temptrack);
+  free(tbuffer);
+  free(trackseq);
 
   if (header.comlen&&!(header.comlen%40))
   {
     header.comlen/=40;
-    m.message=new char *[header.comlen+1];
-    if (!m.message)
+    m->message=malloc((header.comlen+1)*sizeof(char *));
+    if (!m->message)
       return errAllocMem;
-    *m.message=new char [header.comlen*41];
-    if (!*m.message)
+    *m->message=malloc(header.comlen*41);
+    if (!*m->message)
       return errAllocMem;
     for (t=0; t<header.comlen; t++)
     {
-      m.message[t]=m.message[0]+t*41;
-      file.read(m.message[t], 40);
+      m->message[t]=m->message[0]+t*41;
+      bf_read(file, m->message[t], 40);
       short xxx;
       for (xxx=0; xxx<40; xxx++)
-        if (!m.message[t][xxx])
-          m.message[t][xxx]=' ';
-      m.message[t][40]=0;
+        if (!m->message[t][xxx])
+          m->message[t][xxx]=' ';
+      m->message[t][40]=0;
     }
-    m.message[header.comlen]=0;
+    m->message[header.comlen]=0;
   }
   else
-    file.seekcur(header.comlen);
+    bf_seekcur(file, header.comlen);
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
-    if (sp.handle==0xFFFF)
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
+    if (sp->handle==0xFFFF)
       continue;
-    unsigned long l=sip.length<<(!!(sip.type&mcpSamp16Bit));
-    sip.ptr=new char[l+16];
-    if (!sip.ptr)
+    unsigned long l=sip->length<<(!!(sip->type&mcpSamp16Bit));
+    sip->ptr=malloc(l+16);
+    if (!sip->ptr)
       return errAllocMem;
-    file.read(sip.ptr, l);
+    bf_read(file, sip->ptr, l);
+    if (sip->type&mcpSamp16Bit)
+      sip->type|=mcpSampBigEndian;
   }
 
   return errOk;
@@ -8,15 +8,18 @@
 //    -first release
 
 #include <string.h>
+#include <stdlib.h>
 #include "binfile.h"
 #include "mcp.h"
 #include "gmdplay.h"
 #include "err.h"
 
-static inline void putcmd(unsigned char *&p, unsigned char c, unsigned char d)
+static inline void putcmd(unsigned char **pp, unsigned char c, unsigned char d)
 {
+  unsigned char *p=*pp;
   *p++=c;
   *p++=d;
+  *pp=p;
 }
 
 static inline unsigned short swapw(unsigned short a)
@@ -29,56 +32,57 @@ static inline unsigned long swapl(unsigned long a)
   return ((a&0xFF)<<24)|((a&0xFF00)<<8)|((a&0xFF0000)>>8)|((a&0xFF000000)>>24);
 }
 
-extern "C" int mpLoadOKT(gmdmodule &m, binfile &file)
+int mpLoadOKT(gmdmodule *m, binfile *file)
 {
   mpReset(m);
 
   unsigned char sig[8];
 
-  file.read(sig, 8);
+  bf_read(file, sig, 8);
   if (memcmp(sig, "OKTASONG", 8))
     return errFormSig;
 
-  *m.name=0;
-  m.message=0;
+  *m->name=0;
+  m->message=0;
 
-  m.options=MOD_TICK0;
+  m->options=MOD_TICK0;
   unsigned long blen;
 
-  file.read(sig, 4);
+  bf_read(file, sig, 4);
   if (memcmp(sig, "CMOD", 4))
     return errFormStruc;
-  blen=swapl(file.getl());
+  blen=swapl(bf_getl(file));
   if (blen!=8)
     return errFormStruc;
 
   unsigned short cflags[4];
   unsigned char cflag2[8];
-  file.read(cflags, 8);
   int i,t;
+  for (i=0; i<4; i++)
+    cflags[i]=swapw(bf_getus(file));
   t=0;
   for (i=0; i<4; i++)
   {
-    cflag2[t]=(swapw(cflags[i])&1)|((i+i+i)&2);
+    cflag2[t]=(cflags[i]&1)|((i+i+i)&2);
     if (cflag2[t++]&1)
-      cflag2[t++]=(swapw(cflags[i])&1)|((i+i+i)&2);
+      cflag2[t++]=(cflags[i]&1)|((i+i+i)&2);
   }
-  m.channum=t;
+  m->channum=t;
 
-  file.read(sig, 4);
+  bf_read(file, sig, 4);
   if (memcmp(sig, "SAMP", 4))
     return errFormStruc;
-  blen=swapl(file.getl());
+  blen=swapl(bf_getl(file));
   if (blen&31)
     return errFormStruc;
   blen>>=5;
 
-  m.modsampnum=m.sampnum=m.instnum=blen;
+  m->modsampnum=m->sampnum=m->instnum=blen;
 
-  if (!mpAllocInstruments(m, m.instnum)||!mpAllocSamples(m, m.sampnum)||!mpAllocModSamples(m, m.modsampnum))
+  if (!mpAllocInstruments(m, m->instnum)||!mpAllocSamples(m, m->sampnum)||!mpAllocModSamples(m, m->modsampnum))
     return errAllocMem;
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
     struct
     {
@@ -90,10 +94,17 @@ extern "C" int mpLoadOKT(gmdmodule &m, binfile &file)
       unsigned char vol;
       short pad2;
     } mi;
-    file.read(&mi, sizeof(mi));
-    unsigned long length=swapl(mi.length);
-    unsigned long loopstart=swapw(mi.repstart);
-    unsigned long looplength=swapw(mi.replen);
+    // big endian, read field by field
+    bf_read(file, mi.name, 20);
+    mi.length=swapl(bf_getul(file));
+    mi.repstart=swapw(bf_getus(file));
+    mi.replen=swapw(bf_getus(file));
+    mi.pad1=bf_getc(file);
+    mi.vol=bf_getuc(file);
+    mi.pad2=bf_gets(file);
+    unsigned long length=mi.length;
+    unsigned long loopstart=mi.repstart;
+    unsigned long looplength=mi.replen;
     if (length<4)
       length=0;
     if (looplength<4)
@@ -104,119 +115,119 @@ extern "C" int mpLoadOKT(gmdmodule &m, binfile &file)
       if ((loopstart+looplength)>length)
         looplength=length-loopstart;
 
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
 
-    memcpy(ip.name, mi.name, 20);
-    ip.name[20]=0;
+    memcpy(ip->name, mi.name, 20);
+    ip->name[20]=0;
     if (!length)
       continue;
 
     for (t=0; t<128; t++)
-      ip.samples[t]=i;
-
-    *ip.name=0;
-    sp.handle=i;
-    sp.normnote=0;
-    sp.stdvol=(mi.vol>0x3F)?0xFF:(mi.vol<<2);
-    sp.stdpan=-1;
-    sp.opt=0;
-
-    sip.length=length;
-    sip.loopstart=loopstart;
-    sip.loopend=loopstart+looplength;
-    sip.samprate=8363;
-    sip.type=looplength?mcpSampLoop:0;
+      ip->samples[t]=i;
+
+    *ip->name=0;
+    sp->handle=i;
+    sp->normnote=0;
+    sp->stdvol=(mi.vol>0x3F)?0xFF:(mi.vol<<2);
+    sp->stdpan=-1;
+    sp->opt=0;
+
+    sip->length=length;
+    sip->loopstart=loopstart;
+    sip->loopend=loopstart+looplength;
+    sip->samprate=8363;
+    sip->type=looplength?mcpSampLoop:0;
   }
 
-  file.read(sig, 4);
+  bf_read(file, sig, 4);
   if (memcmp(sig, "SPEE", 4))
     return errFormStruc;
-  blen=swapl(file.getl());
+  blen=swapl(bf_getl(file));
   if (blen!=2)
     return errFormStruc;
   unsigned short orgticks;
-  orgticks=swapw(file.gets());
+  orgticks=swapw(bf_gets(file));
 
-  file.read(sig, 4);
+  bf_read(file, sig, 4);
   if (memcmp(sig, "SLEN", 4))
     return errFormStruc;
-  blen=swapl(file.getl());
+  blen=swapl(bf_getl(file));
   if (blen!=2)
     return errFormStruc;
   unsigned short pn;
-  pn=swapw(file.gets());
+  pn=swapw(bf_gets(file));
 
-  file.read(sig, 4);
+  bf_read(file, sig, 4);
   if (memcmp(sig, "PLEN", 4))
     return errFormStruc;
-  blen=swapl(file.getl());
+  blen=swapl(bf_getl(file));
   if (blen!=2)
     return errFormStruc;
   unsigned short ordn;
-  ordn=swapw(file.gets());
+  ordn=swapw(bf_gets(file));
 
-  file.read(sig, 4);
+  bf_read(file, sig, 4);
   if (memcmp(sig, "PATT", 4))
     return errFormStruc;
-  blen=swapl(file.getl());
+  blen=swapl(bf_getl(file));
   if (blen>128)
     return errFormStruc;
   unsigned char orders[128];
-  file.read(orders, blen);
+  bf_read(file, orders, blen);
   if (blen<ordn)
     ordn=blen;
-  m.loopord=0;
+  m->loopord=0;
 
-  m.patnum=ordn;
-  m.ordnum=ordn;
-  m.endord=m.patnum;
-  m.tracknum=pn*(m.channum+1);
+  m->patnum=ordn;
+  m->ordnum=ordn;
+  m->endord=m->patnum;
+  m->tracknum=pn*(m->channum+1);
 
-  if (!mpAllocPatterns(m, m.patnum)||!mpAllocTracks(m, m.tracknum)||!mpAllocOrders(m, m.ordnum))
+  if (!mpAllocPatterns(m, m->patnum)||!mpAllocTracks(m, m->tracknum)||!mpAllocOrders(m, m->ordnum))
     return errAllocMem;
 
-  for (i=0; i<m.ordnum; i++)
-    m.orders[i]=i;
+  for (i=0; i<m->ordnum; i++)
+    m->orders[i]=i;
 
   gmdpattern *pp;
-  for (pp=m.patterns, t=0; t<m.patnum; pp++, t++)
+  for (pp=m->patterns, t=0; t<m->patnum; pp++, t++)
   {
-    for (i=0; i<m.channum; i++)
-      pp->tracks[i]=orders[t]*(m.channum+1)+i;
-    pp->gtrack=orders[t]*(m.channum+1)+m.channum;
+    for (i=0; i<m->channum; i++)
+      pp->tracks[i]=orders[t]*(m->channum+1)+i;
+    pp->gtrack=orders[t]*(m->channum+1)+m->channum;
   }
 
-  unsigned char *temptrack=new unsigned char[3000];
-  unsigned char *buffer=new unsigned char[1024*m.channum];
+  unsigned char *temptrack=malloc(3000);
+  unsigned char *buffer=malloc(1024*m->channum);
   if (!buffer||!temptrack)
     return errAllocMem;
 
   for (t=0; t<pn; t++)
   {
-    file.read(sig, 4);
+    bf_read(file, sig, 4);
     if (memcmp(sig, "PBOD", 4))
       return errFormStruc;
-    blen=swapl(file.getl());
+    blen=swapl(bf_getl(file));
     unsigned short patlen;
-    patlen=swapw(file.gets());
-    if ((blen!=(2+4*m.channum*patlen))||(patlen>256))
+    patlen=swapw(bf_gets(file));
+    if ((blen!=(2+4*m->channum*patlen))||(patlen>256))
       return errFormStruc;
 
     short q;
-    for (q=0; q<m.patnum; q++)
+    for (q=0; q<m->patnum; q++)
       if (t==orders[q])
-        m.patterns[q].patlen=patlen;
+        m->patterns[q].patlen=patlen;
 
-    file.read(buffer, 4*m.channum*patlen);
-    for (q=0; q<m.channum; q++)
+    bf_read(file, buffer, 4*m->channum*patlen);
+    for (q=0; q<m->channum; q++)
     {
       unsigned char *tp=temptrack;
       unsigned char *buf=buffer+4*q;
 
       unsigned char row;
-      for (row=0; row<patlen; row++, buf+=m.channum*4)
+      for (row=0; row<patlen; row++, buf+=m->channum*4)
       {
         unsigned char *cp=tp+2;
 
@@ -237,26 +248,26 @@ extern "C" int mpLoadOKT(gmdmodule &m, binfile &file)
         }
         if ((ins!=-1)||(nte!=-1)||(vol!=-1)||(pan!=-1))
         {
-          unsigned char &act=*cp;
+          unsigned char *act=cp;
           *cp++=cmdPlayNote;
           if (ins!=-1)
           {
-            act|=cmdPlayIns;
+            *act|=cmdPlayIns;
             *cp++=ins;
           }
           if (nte!=-1)
           {
-            act|=cmdPlayNte;
+            *act|=cmdPlayNte;
             *cp++=nte;
           }
           if (vol!=-1)
           {
-            act|=cmdPlayVol;
+            *act|=cmdPlayVol;
             *cp++=vol;
           }
           if (pan!=-1)
           {
-            act|=cmdPlayPan;
+            *act|=cmdPlayPan;
             *cp++=pan;
           }
         }
@@ -273,25 +284,25 @@ extern "C" int mpLoadOKT(gmdmodule &m, binfile &file)
           break;
         case 31:
           if (data<=0x50)
-            putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
           else
           if (data<=0x60)
-            putcmd(cp, cmdVolSlideUp, (data&0xF)<<2);
+            putcmd(&cp, cmdVolSlideUp, (data&0xF)<<2);
           else
           if (data<=0x70)
-            putcmd(cp, cmdRowVolSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdRowVolSlideDown, (data&0xF)<<2);
           else
           if (data<=0x80)
-            putcmd(cp, cmdRowVolSlideUp, (data&0xF)<<2);
+            putcmd(&cp, cmdRowVolSlideUp, (data&0xF)<<2);
           break;
         case 27: //release!!!
-          putcmd(cp, cmdSetLoop, 0);
+          putcmd(&cp, cmdSetLoop, 0);
           break;
         case 0x1:
-          putcmd(cp, cmdPitchSlideDown, data);
+          putcmd(&cp, cmdPitchSlideDown, data);
           break;
         case 0x2:
-          putcmd(cp, cmdPitchSlideUp, data);
+          putcmd(&cp, cmdPitchSlideUp, data);
           break;
         }
 
@@ -302,18 +313,18 @@ extern "C" int mpLoadOKT(gmdmodule &m, binfile &file)
           tp=cp;
         }
       }
-      gmdtrack &trk=m.tracks[t*(m.channum+1)+q];
+      gmdtrack *trk=&m->tracks[t*(m->channum+1)+q];
       unsigned short len=tp-temptrack;
 
       if (!len)
-        trk.ptr=trk.end=0;
+        trk->ptr=trk->end=0;
       else
       {
-        trk.ptr=new unsigned char[len];
-        trk.end=trk.ptr+len;
-        if (!trk.ptr)
+        trk->ptr=ar_alloc(&m->heap, len);
+        trk->end=trk->ptr+len;
+        if (!trk->ptr)
           return errAllocMem;
-        memcpy(trk.ptr, temptrack, len);
+        memcpy(trk->ptr, temptrack, len);
       }
     }
 
@@ -325,9 +336,9 @@ extern "C" int mpLoadOKT(gmdmodule &m, binfile &file)
       unsigned char *cp=tp+2;
 
       if (!row&&(t==orders[0]))
-        putcmd(cp, cmdTempo, orgticks);
+        putcmd(&cp, cmdTempo, orgticks);
 
-      for (q=0; q<m.channum; q++, buf+=4)
+      for (q=0; q<m->channum; q++, buf+=4)
       {
         unsigned char command=buf[2];
         unsigned char data=buf[3];
@@ -335,11 +346,11 @@ extern "C" int mpLoadOKT(gmdmodule &m, binfile &file)
         switch (command)
         {
         case 25:
-          putcmd(cp, cmdGoto, data);
+          putcmd(&cp, cmdGoto, data);
           break;
         case 28:
           if (data)
-            putcmd(cp, cmdTempo, data);
+            putcmd(&cp, cmdTempo, data);
           break;
         }
       }
@@ -352,46 +363,46 @@ extern "C" int mpLoadOKT(gmdmodule &m, binfile &file)
       }
     }
 
-    gmdtrack &trk=m.tracks[t*(m.channum+1)+m.channum];
+    gmdtrack *trk=&m->tracks[t*(m->channum+1)+m->channum];
     unsigned short len=tp-temptrack;
 
     if (!len)
-      trk.ptr=trk.end=0;
+      trk->ptr=trk->end=0;
     else
     {
-      trk.ptr=new unsigned char[len];
-      trk.end=trk.ptr+len;
-      if (!trk.ptr)
+      trk->ptr=ar_alloc(&m->heap, len);
+      trk->end=trk->ptr+len;
+      if (!trk->ptr)
         return errAllocMem;
-      memcpy(trk.ptr, temptrack, len);
+      memcpy(trk->ptr, temptrack, len);
     }
   }
-  delete temptrack;
-  delete buffer;
+  free(temptrack);
+  free(buffer);
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
-    if (sp.handle==0xFFFF)
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
+    if (sp->handle==0xFFFF)
       continue;
 
-    file.read(sig, 4);
+    bf_read(file, sig, 4);
     if (memcmp(sig, "SBOD", 4))
       return errFormStruc;
-    blen=swapl(file.getl());
+    blen=swapl(bf_getl(file));
 
-    sip.ptr=new char [blen+8];
-    if (!sip.ptr)
+    sip->ptr=malloc(blen+8);
+    if (!sip->ptr)
       return errAllocMem;
-    file.read(sip.ptr, blen);
-    if (sip.length>blen)
-      sip.length=blen;
-    if (sip.loopend>blen)
-      sip.loopend=blen;
-    if (sip.loopstart>=sip.loopend)
-      sip.type&=~mcpSampLoop;
+    bf_read(file, sip->ptr, blen);
+    if (sip->length>blen)
+      sip->length=blen;
+    if (sip->loopend>blen)
+      sip->loopend=blen;
+    if (sip->loopstart>=sip->loopend)
+      sip->type&=~mcpSampLoop;
   }
 
   return errOk;
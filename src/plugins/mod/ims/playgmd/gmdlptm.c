@@ -8,18 +8,21 @@
 //    -first release
 
 #include <string.h>
+#include <stdlib.h>
 #include "binfile.h"
 #include "mcp.h"
 #include "gmdplay.h"
 #include "err.h"
 
-static inline void putcmd(unsigned char *&p, unsigned char c, unsigned char d)
+static inline void putcmd(unsigned char **pp, unsigned char c, unsigned char d)
 {
+  unsigned char *p=*pp;
   *p++=c;
   *p++=d;
+  *pp=p;
 }
 
-extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
+int mpLoadPTM(gmdmodule *m, binfile *file)
 {
   mpReset(m);
 
@@ -27,7 +30,7 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
   {
     char name[28];
     unsigned char end;
-    unsigned short type;
+    unsigned char type[2];      // not word aligned in the file
     unsigned char d1;
     unsigned short orders,ins,pats,chan,flags,d2;
     char magic[4];
@@ -35,62 +38,71 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
     unsigned char channels[32];
   } hdr;
 
-  file.read(&hdr, sizeof(hdr));
+  bf_read(file, &hdr, sizeof(hdr));
   if (memcmp(hdr.magic, "PTMF", 4))
     return errFormSig;
+  ims_swap16(&hdr.orders);
+  ims_swap16(&hdr.ins);
+  ims_swap16(&hdr.pats);
+  ims_swap16(&hdr.chan);
+  ims_swap16(&hdr.flags);
 
-  memcpy(m.name, hdr.name, 28);
-  m.name[28]=0;
+  memcpy(m->name, hdr.name, 28);
+  m->name[28]=0;
 
   short t;
-  m.channum=hdr.chan;
-  m.modsampnum=m.sampnum=m.instnum=hdr.ins;
-  m.patnum=hdr.orders;
-  m.ordnum=hdr.orders;
-  m.endord=m.patnum;
-  m.tracknum=hdr.pats*(m.channum+1)+1;
-  m.options=MOD_S3M;
-  m.loopord=0;
+  m->channum=hdr.chan;
+  m->modsampnum=m->sampnum=m->instnum=hdr.ins;
+  m->patnum=hdr.orders;
+  m->ordnum=hdr.orders;
+  m->endord=m->patnum;
+  m->tracknum=hdr.pats*(m->channum+1)+1;
+  m->options=MOD_S3M;
+  m->loopord=0;
 
   unsigned char orders[256];
+  int i,j;
 
-  file.read(orders, 256);
+  bf_read(file, orders, 256);
 
-  if (!m.patnum)
+  if (!m->patnum)
     return errFormMiss;
 
   unsigned short patpara[129];
-  file.read(patpara, 256);
+  bf_read(file, patpara, 256);
+  for (i=0; i<128; i++)
+    ims_swap16(&patpara[i]);
 
-  if (!mpAllocInstruments(m, m.instnum)||!mpAllocTracks(m, m.tracknum)||!mpAllocPatterns(m, m.patnum)||!mpAllocSamples(m, m.sampnum)||!mpAllocModSamples(m, m.modsampnum)||!mpAllocOrders(m, m.ordnum))
-    return errAllocMem;
+  // tables and packed tracks share one arena, roughly 2 bytes per track row
+  ar_init(&m->heap, m->tracknum*(sizeof(gmdtrack)+128)+m->patnum*sizeof(gmdpattern)+m->instnum*(sizeof(gmdinstrument)+sizeof(gmdsample)+sizeof(sampleinfo)));
 
-  int i,j;
+  if (!mpAllocInstruments(m, m->instnum)||!mpAllocTracks(m, m->tracknum)||!mpAllocPatterns(m, m->patnum)||!mpAllocSamples(m, m->sampnum)||!mpAllocModSamples(m, m->modsampnum)||!mpAllocOrders(m, m->ordnum))
+    return errAllocMem;
 
-  for (i=0; i<m.ordnum; i++)
-    m.orders[i]=i;
+  for (i=0; i<m->ordnum; i++)
+    m->orders[i]=i;
 
   gmdpattern *pp;
-  for (pp=m.patterns, t=0; t<m.patnum; pp++, t++)
+  for (pp=m->patterns, t=0; t<m->patnum; pp++, t++)
   {
     pp->patlen=64;
     if ((orders[t]!=255)&&(orders[t]<hdr.pats))
     {
-      for (i=0; i<m.channum; i++)
-        pp->tracks[i]=orders[t]*(m.channum+1)+i;
-      pp->gtrack=orders[t]*(m.channum+1)+m.channum;
+      for (i=0; i<m->channum; i++)
+        pp->tracks[i]=orders[t]*(m->channum+1)+i;
+      pp->gtrack=orders[t]*(m->channum+1)+m->channum;
     }
     else
     {
-      for (i=0; i<m.channum; i++)
-        pp->tracks[i]=m.tracknum-1;
-      pp->gtrack=m.tracknum-1;
+      for (i=0; i<m->channum; i++)
+        pp->tracks[i]=m->tracknum-1;
+      pp->gtrack=m->tracknum-1;
     }
   }
 
   unsigned long inspos[256];
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
     struct
     {
@@ -99,20 +111,26 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
       unsigned char volume;
       unsigned short samprate;
       unsigned short d1;
-      unsigned long offset;
-      unsigned long length;
-      unsigned long loopstart;
-      unsigned long loopend;
-      unsigned long d2;
-      unsigned long d3;
-      unsigned long d4;
+      bf_ulong offset;
+      bf_ulong length;
+      bf_ulong loopstart;
+      bf_ulong loopend;
+      bf_ulong d2;
+      bf_ulong d3;
+      bf_ulong d4;
       unsigned char d5;
       unsigned char d7;
       char name[28];
-      long magic;
+      bf_long magic;
     } sins;
 
-    file.read(&sins, sizeof(sins));
+    bf_read(file, &sins, sizeof(sins));
+    ims_swap16(&sins.samprate);
+    ims_swap32(&sins.offset);
+    ims_swap32(&sins.length);
+    ims_swap32(&sins.loopstart);
+    ims_swap32(&sins.loopend);
+    ims_swap32((unsigned long*)&sins.magic);
     if ((sins.magic!=0x534D5450)&&(sins.magic!=0))
       return errFormStruc;
     if (!i)
@@ -125,56 +143,56 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
       sins.loopstart>>=1;
       sins.loopend>>=1;
     }
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
 
-    memcpy(ip.name, sins.name, 28);
-    ip.name[28]=0;
+    memcpy(ip->name, sins.name, 28);
+    ip->name[28]=0;
     if (!(sins.type&3))
       continue;
     if ((sins.type&3)!=1)
       continue;
 
     for (j=0; j<128; j++)
-      ip.samples[j]=i;
-
-    memcpy(sp.name, sins.dosname, 12);
-    sp.name[13]=0;
-    sp.handle=i;
-    sp.normnote=-mcpGetNote8363(sins.samprate);
-    sp.stdvol=(sins.volume>0x3F)?0xFF:(sins.volume<<2);
-    sp.stdpan=-1;
-    sp.opt=(sins.type&0x10)?MP_OFFSETDIV2:0;
-
-    sip.length=sins.length;
-    sip.loopstart=sins.loopstart;
-    sip.loopend=sins.loopend;
-    sip.samprate=8363;
-    sip.type=((sins.type&4)?mcpSampLoop:0)|((sins.type&8)?mcpSampBiDi:0)|((sins.type&0x10)?mcpSamp16Bit:0);
+      ip->samples[j]=i;
+
+    memcpy(sp->name, sins.dosname, 12);
+    sp->name[13]=0;
+    sp->handle=i;
+    sp->normnote=-mcpGetNote8363(sins.samprate);
+    sp->stdvol=(sins.volume>0x3F)?0xFF:(sins.volume<<2);
+    sp->stdpan=-1;
+    sp->opt=(sins.type&0x10)?MP_OFFSETDIV2:0;
+
+    sip->length=sins.length;
+    sip->loopstart=sins.loopstart;
+    sip->loopend=sins.loopend;
+    sip->samprate=8363;
+    sip->type=((sins.type&4)?mcpSampLoop:0)|((sins.type&8)?mcpSampBiDi:0)|((sins.type&0x10)?mcpSamp16Bit:0);
   }
 
   unsigned short bufSize=1024;
-  unsigned char *buffer=new unsigned char[bufSize];
-  unsigned char *temptrack=new unsigned char [2000];
+  unsigned char *buffer=malloc(bufSize);
+  unsigned char *temptrack=malloc(2000);
   if (!temptrack||!buffer)
     return errAllocMem;
 
   for (t=0; t<hdr.pats; t++)
   {
-    file.seek(patpara[t]*16);
+    bf_seek(file, patpara[t]*16);
     unsigned short patSize=(patpara[t+1]-patpara[t])*16;
     if (patSize>bufSize)
     {
       bufSize=patSize;
-      delete buffer;
-      buffer=new unsigned char[bufSize];
+      free(buffer);
+      buffer=malloc(bufSize);
       if (!buffer)
         return errAllocMem;
     }
-    file.read(buffer, patSize);
+    bf_read(file, buffer, patSize);
 
-    for (j=0; j<m.channum; j++)
+    for (j=0; j<m->channum; j++)
     {
       unsigned char *bp=buffer;
       unsigned char *tp=temptrack;
@@ -192,9 +210,9 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
         {
           if (setorgpan)
           {
-            putcmd(cp, cmdPlayNote|cmdPlayPan, hdr.channels[j]*0x11);
-            putcmd(cp, cmdVolVibratoSetWave, 0x10);
-            putcmd(cp, cmdPitchVibratoSetWave, 0x10);
+            putcmd(&cp, cmdPlayNote|cmdPlayPan, hdr.channels[j]*0x11);
+            putcmd(&cp, cmdVolVibratoSetWave, 0x10);
+            putcmd(&cp, cmdPitchVibratoSetWave, 0x10);
             setorgpan=0;
           }
 
@@ -225,8 +243,8 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
         {
           setorgpan=0;
           pan=hdr.channels[j]*0x11;
-          putcmd(cp, cmdVolVibratoSetWave, 0x10);
-          putcmd(cp, cmdPitchVibratoSetWave, 0x10);
+          putcmd(&cp, cmdVolVibratoSetWave, 0x10);
+          putcmd(&cp, cmdPitchVibratoSetWave, 0x10);
         }
 
         if (c&0x20)
@@ -238,7 +256,7 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
           else
           {
             if (nte==254)
-              putcmd(cp, cmdNoteCut, 0);
+              putcmd(&cp, cmdNoteCut, 0);
             nte=-1;
           }
         }
@@ -264,119 +282,119 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
 
         if ((ins!=-1)||(nte!=-1)||(vol!=-1)||(pan!=-1))
         {
-          unsigned char &act=*cp;
+          unsigned char *act=cp;
           *cp++=cmdPlayNote;
           if (ins!=-1)
           {
-            act|=cmdPlayIns;
+            *act|=cmdPlayIns;
             *cp++=ins;
           }
           if (nte!=-1)
           {
-            act|=cmdPlayNte;
+            *act|=cmdPlayNte;
             *cp++=nte;
           }
           if (vol!=-1)
           {
-            act|=cmdPlayVol;
+            *act|=cmdPlayVol;
             *cp++=vol;
           }
           if (pan!=-1)
           {
-            act|=cmdPlayPan;
+            *act|=cmdPlayPan;
             *cp++=pan;
           }
           if ((command==0xE)&&((data>>4)==0xD))
           {
-            act|=cmdPlayDelay;
+            *act|=cmdPlayDelay;
             *cp++=data&0xF;
           }
         }
 
 //        if (pansrnd)
-//          putcmd(cp, cmdPanSurround, 0);
+//          putcmd(&cp, cmdPanSurround, 0);
 
         switch (command)
 	{
         case 0x0:
           if (data)
-            putcmd(cp, cmdArpeggio, data);
+            putcmd(&cp, cmdArpeggio, data);
           break;
         case 0x1:
           if (!data)
-            putcmd(cp, cmdSpecial, cmdContMixPitchSlideUp);
+            putcmd(&cp, cmdSpecial, cmdContMixPitchSlideUp);
           else
           if (data<0xE0)
-            putcmd(cp, cmdPitchSlideUp, data);
+            putcmd(&cp, cmdPitchSlideUp, data);
           else
           if (data<0xF0)
-            putcmd(cp, cmdRowPitchSlideUp, (data&0xF)<<2);
+            putcmd(&cp, cmdRowPitchSlideUp, (data&0xF)<<2);
           else
-            putcmd(cp, cmdRowPitchSlideUp, (data&0xF)<<4);
+            putcmd(&cp, cmdRowPitchSlideUp, (data&0xF)<<4);
           break;
         case 0x2:
           if (!data)
-            putcmd(cp, cmdSpecial, cmdContMixPitchSlideDown);
+            putcmd(&cp, cmdSpecial, cmdContMixPitchSlideDown);
           else
           if (data<0xE0)
-            putcmd(cp, cmdPitchSlideDown, data);
+            putcmd(&cp, cmdPitchSlideDown, data);
           else
           if (data<0xF0)
-            putcmd(cp, cmdRowPitchSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdRowPitchSlideDown, (data&0xF)<<2);
           else
-            putcmd(cp, cmdRowPitchSlideDown, (data&0xF)<<4);
+            putcmd(&cp, cmdRowPitchSlideDown, (data&0xF)<<4);
           break;
         case 0x3:
-          putcmd(cp, cmdPitchSlideToNote, data);
+          putcmd(&cp, cmdPitchSlideToNote, data);
           break;
         case 0x4:
-          putcmd(cp, cmdPitchVibrato, data);
+          putcmd(&cp, cmdPitchVibrato, data);
           break;
         case 0x5:
-          putcmd(cp, cmdPitchSlideToNote, 0);
+          putcmd(&cp, cmdPitchSlideToNote, 0);
           if (!data)
-            putcmd(cp, cmdSpecial, cmdContVolSlide);
+            putcmd(&cp, cmdSpecial, cmdContVolSlide);
           if ((data&0x0F)&&(data&0xF0))
             data=0;
           if (data&0xF0)
-            putcmd(cp, cmdVolSlideUp, (data>>4)<<2);
+            putcmd(&cp, cmdVolSlideUp, (data>>4)<<2);
           else
           if (data&0x0F)
-            putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
           break;
         case 0x6:
-          putcmd(cp, cmdPitchVibrato, 0);
+          putcmd(&cp, cmdPitchVibrato, 0);
           if (!data)
-            putcmd(cp, cmdSpecial, cmdContVolSlide);
+            putcmd(&cp, cmdSpecial, cmdContVolSlide);
           if ((data&0x0F)&&(data&0xF0))
             data=0;
           if (data&0xF0)
-            putcmd(cp, cmdVolSlideUp, (data>>4)<<2);
+            putcmd(&cp, cmdVolSlideUp, (data>>4)<<2);
           else
           if (data&0x0F)
-            putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
          break;
         case 0x7:
-          putcmd(cp, cmdVolVibrato, data);
+          putcmd(&cp, cmdVolVibrato, data);
           break;
         case 0x9:
-          putcmd(cp, cmdOffset, data);
+          putcmd(&cp, cmdOffset, data);
           break;
         case 0xA:
           if (!data)
-            putcmd(cp, cmdSpecial, cmdContMixVolSlide);
+            putcmd(&cp, cmdSpecial, cmdContMixVolSlide);
           else
           if ((data&0x0F)==0x00)
-            putcmd(cp, cmdVolSlideUp, (data>>4)<<2);
+            putcmd(&cp, cmdVolSlideUp, (data>>4)<<2);
           else
           if ((data&0xF0)==0x00)
-            putcmd(cp, cmdVolSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdVolSlideDown, (data&0xF)<<2);
           else
           if ((data&0x0F)==0x0F)
-            putcmd(cp, cmdRowVolSlideUp, (data>>4)<<2);
+            putcmd(&cp, cmdRowVolSlideUp, (data>>4)<<2);
           else
           if ((data&0xF0)==0xF0)
-            putcmd(cp, cmdRowVolSlideDown, (data&0xF)<<2);
+            putcmd(&cp, cmdRowVolSlideDown, (data&0xF)<<2);
           break;
         case 0xE:
           command=data>>4;
@@ -384,44 +402,44 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
           switch (command)
           {
           case 0x1:
-            putcmd(cp, cmdRowPitchSlideUp, data<<4);
+            putcmd(&cp, cmdRowPitchSlideUp, data<<4);
             break;
           case 0x2:
-            putcmd(cp, cmdRowPitchSlideDown, data<<4);
+            putcmd(&cp, cmdRowPitchSlideDown, data<<4);
             break;
           case 0x3:
-            putcmd(cp, cmdSpecial, data?cmdGlissOn:cmdGlissOff);
+            putcmd(&cp, cmdSpecial, data?cmdGlissOn:cmdGlissOff);
             break;
           case 0x4:
             if (data<4)
-              putcmd(cp, cmdPitchVibratoSetWave, (data&3)+0x10);
+              putcmd(&cp, cmdPitchVibratoSetWave, (data&3)+0x10);
             break;
           case 0x5: // finetune
             break;
           case 0x7:
             if (data<4)
-              putcmd(cp, cmdVolVibratoSetWave, (data&3)+0x10);
+              putcmd(&cp, cmdVolVibratoSetWave, (data&3)+0x10);
             break;
           case 0x9:
             if (data)
-              putcmd(cp, cmdRetrig, data);
+              putcmd(&cp, cmdRetrig, data);
 	    break;
           case 0xA:
-	    putcmd(cp, cmdRowVolSlideUp, data<<2);
+	    putcmd(&cp, cmdRowVolSlideUp, data<<2);
             break;
           case 0xB:
-            putcmd(cp, cmdRowVolSlideDown, data<<2);
+            putcmd(&cp, cmdRowVolSlideDown, data<<2);
             break;
           case 0xC:
-            putcmd(cp, cmdNoteCut, data);
+            putcmd(&cp, cmdNoteCut, data);
 	    break;
           }
           break;
         case 0x11:
-          putcmd(cp, cmdRetrig, data);
+          putcmd(&cp, cmdRetrig, data);
 	  break;
         case 0x12:
-          putcmd(cp, cmdPitchVibratoFine, data);
+          putcmd(&cp, cmdPitchVibratoFine, data);
           break;
         case 0x13: // note slide down  xy x speed, y notecount
           break;
@@ -432,23 +450,23 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
         case 0x16: // note slide up + retrigger
           break;
         case 0x17:
-          putcmd(cp, cmdOffsetEnd, data);
+          putcmd(&cp, cmdOffsetEnd, data);
           break;
         }
       }
 
-      gmdtrack &trk=m.tracks[t*(m.channum+1)+j];
+      gmdtrack *trk=&m->tracks[t*(m->channum+1)+j];
       unsigned short len=tp-temptrack;
 
       if (!len)
-        trk.ptr=trk.end=0;
+        trk->ptr=trk->end=0;
       else
       {
-        trk.ptr=new unsigned char[len];
-        trk.end=trk.ptr+len;
-        if (!trk.ptr)
+        trk->ptr=ar_alloc(&m->heap, len);
+        trk->end=trk->ptr+len;
+        if (!trk->ptr)
           return errAllocMem;
-        memcpy(trk.ptr, temptrack, len);
+        memcpy(trk->ptr, temptrack, len);
       }
     }
 
@@ -459,9 +477,9 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
     if (t==orders[0])
     {
 //      if (hdr.it!=6)
-//        putcmd(cp, cmdTempo, hdr.it);
+//        putcmd(&cp, cmdTempo, hdr.it);
 //      if (hdr.is!=125)
-//        putcmd(cp, cmdSpeed, hdr.is);
+//        putcmd(&cp, cmdSpeed, hdr.is);
     }
 
     unsigned char row=0;
@@ -493,79 +511,83 @@ extern "C" int mpLoadPTM(gmdmodule &m, binfile &file)
         bp++;
 
       int curchan=c&0x1F;
-      if (curchan>=m.channum)
+      if (curchan>=m->channum)
         continue;
 
       switch (command)
       {
       case 0xB:
-        putcmd(cp, cmdGoto, data);
+        putcmd(&cp, cmdGoto, data);
         break;
       case 0xD:
-        putcmd(cp, cmdBreak, (data&0x0F)+(data>>4)*10);
+        putcmd(&cp, cmdBreak, (data&0x0F)+(data>>4)*10);
         break;
       case 0xE:
         switch (data>>4)
         {
         case 0x6:
-          putcmd(cp, cmdSetChan, curchan);
-          putcmd(cp, cmdPatLoop, data&0xF);
+          putcmd(&cp, cmdSetChan, curchan);
+          putcmd(&cp, cmdPatLoop, data&0xF);
           break;
         case 0xE:
-          putcmd(cp, cmdPatDelay, data&0xF);
+          putcmd(&cp, cmdPatDelay, data&0xF);
           break;
         }
         break;
       case 0xF:
         if (data)
+        {
           if (data<0x20)
-            putcmd(cp, cmdTempo, data);
+            putcmd(&cp, cmdTempo, data);
           else
-            putcmd(cp, cmdSpeed, data);
+            putcmd(&cp, cmdSpeed, data);
+        }
         break;
       case 0x10:
         data=(data>0x3F)?0xFF:(data<<2);
-        putcmd(cp, cmdGlobVol, data);
+        putcmd(&cp, cmdGlobVol, data);
         break;
       }
     }
 
-    gmdtrack &trk=m.tracks[t*(m.channum+1)+m.channum];
+    gmdtrack *trk=&m->tracks[t*(m->channum+1)+m->channum];
     unsigned short len=tp-temptrack;
 
     if (!len)
-      trk.ptr=trk.end=0;
+      trk->ptr=trk->end=0;
     else
     {
-      trk.ptr=new unsigned char[len];
-      trk.end=trk.ptr+len;
-      if (!trk.ptr)
+      trk->ptr=ar_alloc(&m->heap, len);
+      trk->end=trk->ptr+len;
+      if (!trk->ptr)
         return errAllocMem;
-      memcpy(trk.ptr, temptrack, len);
+      memcpy(trk->ptr, temptrack, len);
     }
   }
-  delete buffer;
-  delete temptrack;
+  free(buffer);
+  free(temptrack);
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
 
-    if (sp.handle==0xFFFF)
+    if (sp->handle==0xFFFF)
       continue;
-    char bit16=!!(sip.type&mcpSamp16Bit);
+    char bit16=!!(sip->type&mcpSamp16Bit);
 
-    unsigned long slen=sip.length<<bit16;
-    file.seek(inspos[i]);
-    sip.ptr=new unsigned char[slen+16];
-    if (!sip.ptr)
+    unsigned long slen=sip->length<<bit16;
+    bf_seek(file, inspos[i]);
+    sip->ptr=malloc(slen+16);
+    if (!sip->ptr)
       return errAllocMem;
-    file.read(sip.ptr, slen);
+    bf_read(file, sip->ptr, slen);
     signed char x=0;
     for (j=0; j<slen; j++)
-      ((unsigned char*)sip.ptr)[j]=x+=((unsigned char*)sip.ptr)[j];
+      ((unsigned char*)sip->ptr)[j]=x+=((unsigned char*)sip->ptr)[j];
+    if (bit16)
+      sip->type|=mcpSampBigEndian;
   }
 
   return errOk;
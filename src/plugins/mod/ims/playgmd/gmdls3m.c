@@ -24,6 +24,7 @@ static inline void putcmd(unsigned char **pp, unsigned char c, unsigned char d)
   unsigned char* p = *pp;
   *p++=c;
   *p++=d;
+  *pp=p;
 }
 
 int mpLoadS3M(gmdmodule *m, binfile *file)
@@ -38,8 +39,8 @@ int mpLoadS3M(gmdmodule *m, binfile *file)
     short orders,ins,pats,flags,cwt,ffv;
     char magic[4];
     unsigned char mv,it,is,mm,uc,dp;
-    unsigned long d2;
-    unsigned long d3;
+    bf_ulong d2;
+    bf_ulong d3;
     unsigned short special;
     unsigned char channels[32];
   } hdr;
@@ -130,6 +131,8 @@ int mpLoadS3M(gmdmodule *m, binfile *file)
   for (i=0; i<32; i++)
     defpan[i]=(defpan[i]&0x20)?((defpan[i]&0xF)*0x11):((hdr.mm&0x80)?((hdr.channels[i]&8)?0xCC:0x33):0x80);
 
+  // tables and packed tracks share one arena, roughly 2 bytes per track row
+  ar_init(&m->heap, m->tracknum*(sizeof(gmdtrack)+128)+m->patnum*sizeof(gmdpattern)+m->instnum*sizeof(gmdinstrument)+m->modsampnum*sizeof(gmdsample)+m->sampnum*sizeof(sampleinfo));
   if (!mpAllocInstruments(m, m->instnum)||!mpAllocTracks(m, m->tracknum)||!mpAllocPatterns(m, m->patnum)||!mpAllocSamples(m, m->sampnum)||!mpAllocModSamples(m, m->modsampnum)||!mpAllocOrders(m, m->ordnum))
     return errAllocMem;
 
@@ -164,17 +167,17 @@ int mpLoadS3M(gmdmodule *m, binfile *file)
       char dosname[12];
       unsigned char sampptrh;
       unsigned short sampptr;
-      unsigned long length;
-      unsigned long loopstart;
-      unsigned long loopend;
+      bf_ulong length;
+      bf_ulong loopstart;
+      bf_ulong loopend;
       unsigned char volume;
       char d1;
       unsigned char pack;
       unsigned char flag;
-      unsigned long c2spd;
+      bf_ulong c2spd;
       char d2[12];
       char name[28];
-      long magic;
+      bf_long magic;
     } sins;
 
     //file.seek((long)inspara[i]*16);
@@ -185,7 +188,6 @@ int mpLoadS3M(gmdmodule *m, binfile *file)
     ims_swap32((unsigned long*)&sins.length);
     ims_swap32((unsigned long*)&sins.loopstart);
     ims_swap32((unsigned long*)&sins.loopend);
-    ims_swap32((unsigned long*)&sins.volume);
     ims_swap32((unsigned long*)&sins.c2spd);
     ims_swap32((unsigned long*)&sins.magic);
 
@@ -515,7 +517,7 @@ int mpLoadS3M(gmdmodule *m, binfile *file)
         trk->ptr=trk->end=0;
       else
       {
-        trk->ptr=malloc(len);
+        trk->ptr=ar_alloc(&m->heap, len);
         trk->end=trk->ptr+len;
         if (!trk->ptr)
           return errAllocMem;
@@ -617,7 +619,7 @@ int mpLoadS3M(gmdmodule *m, binfile *file)
       trk->ptr=trk->end=0;
     else
     {
-      trk->ptr=malloc(len);
+      trk->ptr=ar_alloc(&m->heap, len);
       trk->end=trk->ptr+len;
       if (!trk->ptr)
         return errAllocMem;
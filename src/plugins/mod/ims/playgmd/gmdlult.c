@@ -9,25 +9,27 @@
 
 // modified for c99 and Atari by agranlund 2024
 
-
 #include <string.h>
+#include <stdlib.h>
 #include "binfile.h"
 #include "mcp.h"
 #include "gmdplay.h"
 #include "err.h"
 
-static inline void putcmd(unsigned char *&p, unsigned char c, unsigned char d)
+static inline void putcmd(unsigned char **pp, unsigned char c, unsigned char d)
 {
+  unsigned char *p=*pp;
   *p++=c;
   *p++=d;
+  *pp=p;
 }
 
-extern "C" int mpLoadULT(gmdmodule &m, binfile &file)
+int mpLoadULT(gmdmodule *m, binfile *file)
 {
   mpReset(m);
 
   char id[15];
-  file.read(id, 15);
+  bf_read(file, id, 15);
   if (memcmp(id, "MAS_UTrack_V00", 14))
     return errFormMiss;
 
@@ -36,60 +38,66 @@ extern "C" int mpLoadULT(gmdmodule &m, binfile &file)
   if (ver>3)
     return errFormOldVer;
 
-  m.options=(ver<1)?MOD_GUSVOL:0;
+  m->options=(ver<1)?MOD_GUSVOL:0;
 
-  file.read(m.name, 32);
-  m.name[31]=0;
+  bf_read(file, m->name, 32);
+  m->name[31]=0;
 
   unsigned char msglen;
-  msglen=file.getc();
+  msglen=bf_getc(file);
 
   if (msglen)
   {
-    m.message=new char *[msglen+1];
-    if (!m.message)
+    m->message=malloc((msglen+1)*sizeof(char *));
+    if (!m->message)
       return errAllocMem;
-    *m.message=new char [msglen*33];
-    if (!*m.message)
+    *m->message=malloc(msglen*33);
+    if (!*m->message)
       return errAllocMem;
     short t;
     for (t=0; t<msglen; t++)
     {
-      m.message[t]=*m.message+t*33;
-      file.read(m.message[t], 32);
-      m.message[t][32]=0;
+      m->message[t]=*m->message+t*33;
+      bf_read(file, m->message[t], 32);
+      m->message[t][32]=0;
     }
-    m.message[msglen]=0;
+    m->message[msglen]=0;
   }
 
 
   unsigned char insn;
-  insn=file.getc();
+  insn=bf_getc(file);
 
-  m.modsampnum=m.sampnum=m.instnum=insn;
+  m->modsampnum=m->sampnum=m->instnum=insn;
 
-  if (!mpAllocInstruments(m, m.instnum)||!mpAllocSamples(m, m.sampnum)||!mpAllocModSamples(m, m.modsampnum))
+  if (!mpAllocInstruments(m, m->instnum)||!mpAllocSamples(m, m->sampnum)||!mpAllocModSamples(m, m->modsampnum))
     return errAllocMem;
 
   unsigned long samplen=0;
 
   int i,j;
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
     struct
     {
       char name[32];
       char dosname[12];
-      unsigned long loopstart;
-      unsigned long loopend;
-      unsigned long sizestart;
-      unsigned long sizeend;
+      bf_ulong loopstart;
+      bf_ulong loopend;
+      bf_ulong sizestart;
+      bf_ulong sizeend;
       unsigned char vol;
       unsigned char opt;
       unsigned short c2spd;
       unsigned short finetune;
     } mi;
-    file.read(&mi, sizeof(mi)-((ver<3)?2:0));
+    bf_read(file, &mi, sizeof(mi)-((ver<3)?2:0));
+    ims_swap32(&mi.loopstart);
+    ims_swap32(&mi.loopend);
+    ims_swap32(&mi.sizestart);
+    ims_swap32(&mi.sizeend);
+    ims_swap16(&mi.c2spd);
+    ims_swap16(&mi.finetune);
     if (ver<3)
     {
       mi.finetune=mi.c2spd;
@@ -108,96 +116,96 @@ extern "C" int mpLoadULT(gmdmodule &m, binfile &file)
     if (mi.loopstart==mi.loopend)
       mi.opt&=~8;
 
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
 
-    memcpy(ip.name, mi.name, 31);
-    ip.name[31]=0;
+    memcpy(ip->name, mi.name, 31);
+    ip->name[31]=0;
     if (!length)
       continue;
     for (j=0; j<128; j++)
-      ip.samples[j]=i;
+      ip->samples[j]=i;
 
-    memcpy(sp.name, mi.dosname, 12);
-    sp.name[12]=0;
+    memcpy(sp->name, mi.dosname, 12);
+    sp->name[12]=0;
 
-    sp.handle=i;
-    sp.normnote=-mcpGetNote8363(mi.c2spd);
-    sp.stdvol=mi.vol;
-    sp.stdpan=-1;
-    sp.opt=(mi.opt&4)?MP_OFFSETDIV2:0;
+    sp->handle=i;
+    sp->normnote=-mcpGetNote8363(mi.c2spd);
+    sp->stdvol=mi.vol;
+    sp->stdpan=-1;
+    sp->opt=(mi.opt&4)?MP_OFFSETDIV2:0;
 
-    sampleinfo &sip=m.samples[i];
-    sip.length=length;
-    sip.loopstart=mi.loopstart;
-    sip.loopend=mi.loopend;
-    sip.samprate=8363;
-    sip.type=((mi.opt&8)?mcpSampLoop:0)|((mi.opt&16)?mcpSampBiDi:0)|((mi.opt&4)?mcpSamp16Bit:0);
+    sampleinfo *sip=&m->samples[i];
+    sip->length=length;
+    sip->loopstart=mi.loopstart;
+    sip->loopend=mi.loopend;
+    sip->samprate=8363;
+    sip->type=((mi.opt&8)?mcpSampLoop:0)|((mi.opt&16)?mcpSampBiDi:0)|((mi.opt&4)?mcpSamp16Bit:0);
 
-    samplen+=((mi.opt&4)?2:1)*sip.length;
+    samplen+=((mi.opt&4)?2:1)*sip->length;
   }
 
   unsigned char orders[256];
-  file.read(orders, 256);
+  bf_read(file, orders, 256);
 
   unsigned char chnn;
   unsigned char patn;
 
-  chnn=file.getc();
-  patn=file.getc();
+  chnn=bf_getc(file);
+  patn=bf_getc(file);
 
-  m.channum=chnn+1;
+  m->channum=chnn+1;
 
   unsigned char panpos[32];
 
   if (ver>=2)
-    file.read(panpos, m.channum);
+    bf_read(file, panpos, m->channum);
   else
     memcpy(panpos, "\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF\x0\xF", 32);
 
-  m.loopord=0;
+  m->loopord=0;
 
   short ordn;
   for (ordn=0; ordn<256; ordn++)
     if (orders[ordn]>patn)
       break;
 
-  m.patnum=ordn;
-  m.ordnum=ordn;
-  m.endord=m.patnum;
-  m.tracknum=(patn+1)*(m.channum+1);
+  m->patnum=ordn;
+  m->ordnum=ordn;
+  m->endord=m->patnum;
+  m->tracknum=(patn+1)*(m->channum+1);
 
-  if (!mpAllocPatterns(m, m.patnum)||!mpAllocTracks(m, m.tracknum)||!mpAllocOrders(m, m.ordnum))
+  if (!mpAllocPatterns(m, m->patnum)||!mpAllocTracks(m, m->tracknum)||!mpAllocOrders(m, m->ordnum))
     return errAllocMem;
 
-  for (i=0; i<m.ordnum; i++)
-    m.orders[i]=i;
+  for (i=0; i<m->ordnum; i++)
+    m->orders[i]=i;
 
   gmdpattern *pp;
   int t;
-  for (pp=m.patterns, t=0; t<m.patnum; pp++, t++)
+  for (pp=m->patterns, t=0; t<m->patnum; pp++, t++)
   {
     pp->patlen=64;
-    for (i=0; i<m.channum; i++)
-      pp->tracks[i]=orders[t]*(m.channum+1)+i;
-    pp->gtrack=orders[t]*(m.channum+1)+m.channum;
+    for (i=0; i<m->channum; i++)
+      pp->tracks[i]=orders[t]*(m->channum+1)+i;
+    pp->gtrack=orders[t]*(m->channum+1)+m->channum;
   }
 
-  unsigned long patlength=file.length()-file.tell()-samplen;
+  unsigned long patlength=bf_length(file)-bf_tell(file)-samplen;
 
-  unsigned char *temptrack=new unsigned char[2000];
-  unsigned char *buffer=new unsigned char[patlength];
+  unsigned char *temptrack=malloc(2000);
+  unsigned char *buffer=malloc(patlength);
   if (!buffer||!temptrack)
     return errAllocMem;
 
-  file.read(buffer, patlength);
+  bf_read(file, buffer, patlength);
 
   unsigned char *bp=buffer;
 
   unsigned char *chbp[32];
 
   int q;
-  for (q=0; q<m.channum; q++)
+  for (q=0; q<m->channum; q++)
   {
     chbp[q]=bp;
 
@@ -281,36 +289,36 @@ extern "C" int mpLoadULT(gmdmodule &m, binfile &file)
 
         if ((ins!=-1)||(nte!=-1)||(vol!=-1)||(pan!=-1))
         {
-          unsigned char &act=*cp;
+          unsigned char *act=cp;
           *cp++=cmdPlayNote;
           if (ins!=-1)
           {
-            act|=cmdPlayIns;
+            *act|=cmdPlayIns;
             *cp++=ins;
           }
           if (nte!=-1)
           {
-            act|=cmdPlayNte;
+            *act|=cmdPlayNte;
             *cp++=nte;
           }
           if (vol!=-1)
           {
-            act|=cmdPlayVol;
+            *act|=cmdPlayVol;
             *cp++=vol;
           }
           if (pan!=-1)
           {
-            act|=cmdPlayPan;
+            *act|=cmdPlayPan;
             *cp++=pan;
           }
           if (command[1]==0xDE)
           {
-            act|=cmdPlayDelay;
+            *act|=cmdPlayDelay;
             *cp++=data[1];
           }
           else if (command[0]==0xDE)
           {
-            act|=cmdPlayDelay;
+            *act|=cmdPlayDelay;
             *cp++=data[0];
           }
         }
@@ -321,49 +329,49 @@ extern "C" int mpLoadULT(gmdmodule &m, binfile &file)
         {
         case 0x1:
           if (data[f])
-            putcmd(cp, cmdPitchSlideUp, data[f]);
+            putcmd(&cp, cmdPitchSlideUp, data[f]);
           break;
         case 0x2:
           if (data[f])
-            putcmd(cp, cmdPitchSlideDown, data[f]);
+            putcmd(&cp, cmdPitchSlideDown, data[f]);
           break;
         case 0x3:
-          putcmd(cp, cmdPitchSlideToNote, data[f]);
+          putcmd(&cp, cmdPitchSlideToNote, data[f]);
           break;
         case 0x4:
-          putcmd(cp, cmdPitchVibrato, data[f]);
+          putcmd(&cp, cmdPitchVibrato, data[f]);
           break;
         case 0xA:
           if ((data[f]&0x0F)&&(data[f]&0xF0))
             data[f]=0;
           if (data[f]&0xF0)
-            putcmd(cp, cmdVolSlideUp, data[f]>>4);
+            putcmd(&cp, cmdVolSlideUp, data[f]>>4);
           else
           if (data[f]&0x0F)
-            putcmd(cp, cmdVolSlideDown, data[f]&0xF);
+            putcmd(&cp, cmdVolSlideDown, data[f]&0xF);
           break;
         case 0x1E:
           if (data[f])
-            putcmd(cp, cmdRowPitchSlideUp, data[f]<<4);
+            putcmd(&cp, cmdRowPitchSlideUp, data[f]<<4);
           break;
         case 0x2E:
           if (data[f])
-            putcmd(cp, cmdRowPitchSlideDown, data[f]<<4);
+            putcmd(&cp, cmdRowPitchSlideDown, data[f]<<4);
           break;
         case 0x9E:
           if (data[f])
-            putcmd(cp, cmdRetrig, data[f]);
+            putcmd(&cp, cmdRetrig, data[f]);
           break;
         case 0xAE:
           if (data[f])
-            putcmd(cp, cmdRowVolSlideUp, data[f]);
+            putcmd(&cp, cmdRowVolSlideUp, data[f]);
           break;
         case 0xBE:
           if (data[f])
-            putcmd(cp, cmdRowVolSlideDown, data[f]);
+            putcmd(&cp, cmdRowVolSlideDown, data[f]);
           break;
         case 0xCE:
-          putcmd(cp, cmdNoteCut, data[f]);
+          putcmd(&cp, cmdNoteCut, data[f]);
           break;
         }
         }
@@ -375,18 +383,18 @@ extern "C" int mpLoadULT(gmdmodule &m, binfile &file)
         }
       }
 
-      gmdtrack &trk=m.tracks[t*(m.channum+1)+q];
+      gmdtrack *trk=&m->tracks[t*(m->channum+1)+q];
       unsigned short len=tp-temptrack;
 
       if (!len)
-        trk.ptr=trk.end=0;
+        trk->ptr=trk->end=0;
       else
       {
-        trk.ptr=new unsigned char[len];
-        trk.end=trk.ptr+len;
-        if (!trk.ptr)
+        trk->ptr=ar_alloc(&m->heap, len);
+        trk->end=trk->ptr+len;
+        if (!trk->ptr)
           return errAllocMem;
-        memcpy(trk.ptr, temptrack, len);
+        memcpy(trk->ptr, temptrack, len);
       }
     }
   }
@@ -398,14 +406,14 @@ extern "C" int mpLoadULT(gmdmodule &m, binfile &file)
   {
     unsigned char *tp=temptrack;
 
-    for (q=0; q<m.channum; q++)
+    for (q=0; q<m->channum; q++)
       chrepn[q]=0;
     unsigned char row;
     for (row=0; row<64; row++)
     {
       unsigned char *cp=tp+2;
 
-      for (q=0; q<m.channum; q++)
+      for (q=0; q<m->channum; q++)
       {
         if (!chrepn[q])
           if (*chbp[q]==0xFC)
@@ -437,14 +445,16 @@ extern "C" int mpLoadULT(gmdmodule &m, binfile &file)
         case 0xD:
           if (data[f]>=0x64)
             data[f]=0;
-          putcmd(cp, cmdBreak, (data[f]&0xF)+(data[f]>>4)*10);
+          putcmd(&cp, cmdBreak, (data[f]&0xF)+(data[f]>>4)*10);
           break;
         case 0xF:
           if (data[f])
+          {
             if (data[f]<=0x20)
-              putcmd(cp, cmdTempo, data[f]);
+              putcmd(&cp, cmdTempo, data[f]);
             else
-              putcmd(cp, cmdSpeed, data[f]);
+              putcmd(&cp, cmdSpeed, data[f]);
+          }
           break;
         }
         }
@@ -458,38 +468,40 @@ extern "C" int mpLoadULT(gmdmodule &m, binfile &file)
       }
     }
 
-    gmdtrack &trk=m.tracks[t*(m.channum+1)+m.channum];
+    gmdtrack *trk=&m->tracks[t*(m->channum+1)+m->channum];
     unsigned short len=tp-temptrack;
 
     if (!len)
-      trk.ptr=trk.end=0;
+      trk->ptr=trk->end=0;
     else
     {
-      trk.ptr=new unsigned char[len];
-      trk.end=trk.ptr+len;
-      if (!trk.ptr)
+      trk->ptr=ar_alloc(&m->heap, len);
+      trk->end=trk->ptr+len;
+      if (!trk->ptr)
         return errAllocMem;
-      memcpy(trk.ptr, temptrack, len);
+      memcpy(trk->ptr, temptrack, len);
     }
   }
 
-  delete temptrack;
-  delete buffer;
+  free(temptrack);
+  free(buffer);
 
 
-  for (i=0; i<m.instnum; i++)
+  for (i=0; i<m->instnum; i++)
   {
-    gmdinstrument &ip=m.instruments[i];
-    gmdsample &sp=m.modsamples[i];
-    sampleinfo &sip=m.samples[i];
-    if (sp.handle==0xFFFF)
+    gmdinstrument *ip=&m->instruments[i];
+    gmdsample *sp=&m->modsamples[i];
+    sampleinfo *sip=&m->samples[i];
+    if (sp->handle==0xFFFF)
       continue;
-    unsigned long l=sip.length<<(!!(sip.type&mcpSamp16Bit));
+    unsigned long l=sip->length<<(!!(sip->type&mcpSamp16Bit));
 
-    sip.ptr=new unsigned char[l+16];
-    if (!sip.ptr)
+    sip->ptr=malloc(l+16);
+    if (!sip->ptr)
       return errAllocMem;
-    file.read(sip.ptr, l);
+    bf_read(file, sip->ptr, l);
+    if (sip->type&mcpSamp16Bit)
+      sip->type|=mcpSampBigEndian;
   }
 
   return errOk;
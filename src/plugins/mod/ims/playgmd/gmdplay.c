@@ -1587,7 +1587,7 @@ char mpPlayModule(const gmdmodule *m)
   memset(pchan, -1, sizeof(pchan));
 
   quelen=100;
-  que=malloc(quelen*4*4);
+  que=mxAlloc(quelen*4*4, MX_MEM_PLAYER);
   if (!que)
     return 0;
   querpos=0;
@@ -1607,7 +1607,8 @@ void mpStopModule()
   for (i=0; i<physchan; i++)
     mcpSet(i, mcpCReset, 0);
   mcpClosePlayer();
-  free(que);
+  mxFree(que);
+  que=0;
 }
 
 void mpGetChanInfo(unsigned char ch, chaninfo *ci)
@@ -1796,3 +1797,10 @@ int mpLoadSamples(gmdmodule *m)
 {
   return mcpLoadSamples(m->samples, m->sampnum);
 }
+
+int mpPreloadSamples(gmdmodule *m)
+{
+  if (!mcpPreloadSamples)
+    return 0;
+  return mcpPreloadSamples(m->samples, m->sampnum);
+}
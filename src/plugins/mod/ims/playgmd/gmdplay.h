@@ -3,6 +3,7 @@
 
 #include "gmdinst.h"
 #include "../core/binfile.h"
+#include "../core/arena.h"
 
 #define MP_MAXCHANNELS 32
 
@@ -54,6 +55,7 @@ typedef struct
   gmdpattern *patterns;
   char **message;
   unsigned short *orders;
+  arena heap;                   // tables and tracks, not samples
 } gmdmodule;
 
 typedef struct
@@ -100,6 +102,7 @@ void mpReduceInstruments(gmdmodule *m);
 void mpReduceMessage(gmdmodule *m);
 int mpReduceSamples(gmdmodule *m);
 int mpLoadSamples(gmdmodule *m);
+int mpPreloadSamples(gmdmodule *m);
 void mpRemoveText(gmdmodule *m);
 
 
@@ -208,6 +208,7 @@ void mpReset(gmdmodule *m)
   m->modsamples=0;
   m->envelopes=0;
   m->orders=0;
+  ar_init(&m->heap, 0);
   *(m->composer)=0;
   *(m->name)=0;
 }
@@ -218,34 +219,23 @@ void mpFree(gmdmodule *m)
   if (m->envelopes)
     for (i=0; i<m->envnum; i++)
       free(m->envelopes[i].env);
-  if (m->tracks)
-    for (i=0; i<m->tracknum; i++)
-      free(m->tracks[i].ptr);
   if (m->message)
     free(*(m->message));
   if (m->samples)
     for (i=0; i<m->sampnum; i++)
       free(m->samples[i].ptr);
-
-  free(m->tracks);
-  free(m->patterns);
   free(m->message);
-  free(m->samples);
-  free(m->envelopes);
-  free(m->instruments);
-  free(m->modsamples);
-  free(m->orders);
 
+  ar_free(&m->heap);
   mpReset(m);
 }
 
 int mpAllocInstruments(gmdmodule *m, int n)
 {
   m->instnum=n;
-  m->instruments=malloc(m->instnum*sizeof(gmdinstrument));
+  m->instruments=ar_alloc(&m->heap, m->instnum*sizeof(gmdinstrument));
   if (!m->instruments)
     return 0;
-  memset(m->instruments, 0, m->instnum*sizeof(gmdinstrument));
   int i;
   for (i=0; i<m->instnum; i++)
     memset(m->instruments[i].samples, -1, 2*128);
@@ -255,60 +245,54 @@ int mpAllocInstruments(gmdmodule *m, int n)
 int mpAllocTracks(gmdmodule *m, int n)
 {
   m->tracknum=n;
-  m->tracks=malloc(m->tracknum*sizeof(gmdtrack));
+  m->tracks=ar_alloc(&m->heap, m->tracknum*sizeof(gmdtrack));
   if (!m->tracks)
     return 0;
-  memset(m->tracks, 0, m->tracknum*sizeof(gmdtrack));
   return 1;
 }
 
 int mpAllocPatterns(gmdmodule *m, int n)
 {
   m->patnum=n;
-  m->patterns=malloc(m->patnum*sizeof(gmdpattern));
+  m->patterns=ar_alloc(&m->heap, m->patnum*sizeof(gmdpattern));
   if (!m->patterns)
     return 0;
-  memset(m->patterns, 0, m->patnum*sizeof(gmdpattern));
   return 1;
 }
 
 int mpAllocSamples(gmdmodule *m, int n)
 {
   m->sampnum=n;
-  m->samples=malloc(m->sampnum*sizeof(sampleinfo));
+  m->samples=ar_alloc(&m->heap, m->sampnum*sizeof(sampleinfo));
   if (!m->samples)
     return 0;
-  memset(m->samples, 0, m->sampnum*sizeof(sampleinfo));
   return 1;
 }
 
 int mpAllocEnvelopes(gmdmodule *m, int n)
 {
   m->envnum=n;
-  m->envelopes=malloc(m->envnum*sizeof(gmdenvelope));
+  m->envelopes=ar_alloc(&m->heap, m->envnum*sizeof(gmdenvelope));
   if (!m->envelopes)
     return 0;
-  memset(m->envelopes, 0, m->envnum*sizeof(gmdenvelope));
   return 1;
 }
 
 int mpAllocOrders(gmdmodule *m, int n)
 {
   m->ordnum=n;
-  m->orders=malloc(m->ordnum*2);
+  m->orders=ar_alloc(&m->heap, m->ordnum*2);
   if (!m->orders)
     return 0;
-  memset(m->orders, 0, m->ordnum*2);
   return 1;
 }
 
 int mpAllocModSamples(gmdmodule *m, int n)
 {
   m->modsampnum=n;
-  m->modsamples=malloc(m->modsampnum*sizeof(gmdsample));
+  m->modsamples=ar_alloc(&m->heap, m->modsampnum*sizeof(gmdsample));
   if (!m->modsamples)
     return 0;
-  memset(m->modsamples, 0, m->modsampnum*sizeof(gmdsample));
   int i;
   for (i=0; i<m->modsampnum; i++)
   {
@@ -52,6 +52,7 @@ static int loadmod(xmodule *m, binfile *file, int chan, int sig, int opt)
   m->patlens=0;
   m->patterns=0;
   m->orders=0;
+  m->inplace=0;
   m->nenv=0;
   m->linearfreq=0;
   m->ismod=!(opt&4);
@@ -63,6 +64,7 @@ static int loadmod(xmodule *m, binfile *file, int chan, int sig, int opt)
   m->ninst=31;
   m->nchan=0;
 
+  int err=0;
   switch (l)
   {
   case 0x2E4B2E4D: // m->K.
@@ -121,12 +123,16 @@ static int loadmod(xmodule *m, binfile *file, int chan, int sig, int opt)
   case 0x48433133: m->nchan=31; break;
   case 0x48433233: m->nchan=32; break;
   case 0x38544C46: // FLT8
-    return errFormSupp;
+    err=errFormSupp;
+    break;
 //    m->nchan=8;
 //    break;
   default:
     if (sig==1)
-      return errFormSig;
+    {
+      err=errFormSig;
+      break;
+    }
     m->ninst=(sig==2)?31:15;
     opt|=2;
     break;
@@ -135,14 +141,19 @@ static int loadmod(xmodule *m, binfile *file, int chan, int sig, int opt)
   if (chan)
     m->nchan=chan;
 
+  m->nsampi=m->ninst;
+  m->nsamp=m->ninst;
+  // all module structures live in one arena, the patterns are added later.
+  // set up before the first return so a failed load can always be freed
+  ar_init(&m->heap, (sizeof(xmpinstrument)+sizeof(xmpsample)+sizeof(sampleinfo))*m->ninst+128*(64*4+64*m->nchan));
+  if (err)
+    return err;
   if (!m->nchan)
     return errFormSig;
 
-  m->nsampi=m->ninst;
-  m->nsamp=m->ninst;
-  m->instruments=malloc(sizeof(xmpinstrument)*m->ninst);
-  m->samples=malloc(sizeof(xmpsample)*m->ninst);
-  m->sampleinfos=malloc(sizeof(sampleinfo)*m->ninst);
+  m->instruments=ar_alloc(&m->heap, sizeof(xmpinstrument)*m->ninst);
+  m->samples=ar_alloc(&m->heap, sizeof(xmpsample)*m->ninst);
+  m->sampleinfos=ar_alloc(&m->heap, sizeof(sampleinfo)*m->ninst);
   if (!m->instruments||!m->samples||!m->sampleinfos)
     return errAllocMem;
   memset(m->samples, 0, sizeof(*m->samples)*m->ninst);
@@ -256,29 +267,31 @@ static int loadmod(xmodule *m, binfile *file, int chan, int sig, int opt)
   if (sig)
     bf_seekcur(file, 4);
 
-  m->orders=malloc(sizeof(unsigned short)*m->nord);
-  m->patlens=malloc(sizeof(unsigned short)*m->npat);
-  m->patterns=(unsigned char (**)[5])malloc(sizeof(void*)*m->npat);
+  m->orders=ar_alloc(&m->heap, sizeof(unsigned short)*m->nord);
+  m->patlens=ar_alloc(&m->heap, sizeof(unsigned short)*m->npat);
+  m->patterns=(unsigned char **)ar_alloc(&m->heap, sizeof(void*)*m->npat);
   unsigned char *temppat=malloc(4*64*m->nchan);
-  if (!m->orders||!m->patlens||!m->patterns||!temppat)
+  unsigned char (*patbuf)[5]=malloc(64*m->nchan*5);
+  if (!m->orders||!m->patlens||!m->patterns||!temppat||!patbuf)
+  {
+    free(temppat);
+    free(patbuf);
     return errAllocMem;
+  }
+  unsigned long packedsize=0;
 
   for (i=0; i<m->nord; i++)
     m->orders[i]=orders[i];
 
   memset(m->patterns, 0, sizeof(*m->patterns)*m->npat);
 
+  // patterns are converted into a scratch buffer and stored packed
   for (i=0; i<m->npat; i++)
-  {
     m->patlens[i]=64;
-    m->patterns[i]=malloc(64*m->nchan*5);
-    if (!m->patterns[i])
-      return errAllocMem;
-  }
 
   for (i=0; i<pn; i++)
   {
-    unsigned char *dp=(unsigned char *)(m->patterns[i]);
+    unsigned char *dp=(unsigned char *)patbuf;
     unsigned char *sp=temppat;
     bf_read(file, temppat, 256*m->nchan);
     int j;
@@ -322,8 +335,17 @@ static int loadmod(xmodule *m, binfile *file, int chan, int sig, int opt)
       sp+=4;
       dp+=5;
     }
+    m->patterns[i]=xmpPackPattern(&m->heap, patbuf, 64, m->nchan, &packedsize);
+    if (!m->patterns[i])
+    {
+      free(temppat);
+      free(patbuf);
+      return errAllocMem;
+    }
   }
   free(temppat);
+  free(patbuf);
+  dbgprintf("patterns: %ld bytes packed, %ld unpacked", packedsize, (long)pn*64*m->nchan*5);
 
   for (i=0; i<m->ninst; i++)
   {
@@ -332,6 +354,14 @@ static int loadmod(xmodule *m, binfile *file, int chan, int sig, int opt)
     sampleinfo *sip=&m->sampleinfos[i];
     if (sp->handle==0xFFFF)
       continue;
+    // signed 8 bit needs no conversion, use it where it is
+    sip->ptr=bf_ref(file, sip->length, 0);
+    if (sip->ptr)
+    {
+      sip->type|=mcpSampRef;
+      sp->handle=i;
+      continue;
+    }
     sip->ptr=malloc(sip->length+8);
     if (!sip->ptr)
       return errAllocMem;
@@ -30,6 +30,7 @@ int xmpLoadModule(xmodule *m, binfile *file)
   m->patlens=0;
   m->patterns=0;
   m->orders=0;
+  m->inplace=0;
   m->ismod=0;
 
   struct //__attribute((packed))
@@ -55,26 +56,40 @@ int xmpLoadModule(xmodule *m, binfile *file)
     unsigned char ord[256];
   } head2;
 
+  int err=0;
   bf_read(file, &head1, sizeof(head1));
   ims_swap16(&head1.ver);
   ims_swap32(&head1.hdrsize);
 
   if (memcmp(head1.sig, "Extended Module: ", 17))
-    return errFormStruc;
-  if (head1.eof!=26)
-    return errFormStruc;
-  if (head1.ver<0x104)
-    return errFormOldVer;
-
-  bf_read(file, &head2, sizeof(head2));
-  ims_swap16(&head2.nord);
-  ims_swap16(&head2.loopord);
-  ims_swap16(&head2.nchan);
-  ims_swap16(&head2.npat);
-  ims_swap16(&head2.ninst);
-  ims_swap16(&head2.freqtab);
-  ims_swap16(&head2.tempo);
-  ims_swap16(&head2.bpm);
+    err=errFormStruc;
+  else if (head1.eof!=26)
+    err=errFormStruc;
+  else if (head1.ver<0x104)
+    err=errFormOldVer;
+
+  memset(&head2, 0, sizeof(head2));
+  if (!err)
+  {
+    bf_read(file, &head2, sizeof(head2));
+    ims_swap16(&head2.nord);
+    ims_swap16(&head2.loopord);
+    ims_swap16(&head2.nchan);
+    ims_swap16(&head2.npat);
+    ims_swap16(&head2.ninst);
+    ims_swap16(&head2.freqtab);
+    ims_swap16(&head2.tempo);
+    ims_swap16(&head2.bpm);
+  }
+
+  // all module structures live in one arena, sized for the fixed tables
+  // plus mostly empty patterns. blocks added later are a quarter of that.
+  // set up before the first return so a failed load can always be freed
+  ar_init(&m->heap, (sizeof(unsigned short)+sizeof(void*)+64*4+64*head2.nchan)*(head2.npat+1) +
+                    (sizeof(xmpinstrument)+2*sizeof(xmpenvelope)+16*(sizeof(xmpsample)+sizeof(sampleinfo)))*head2.ninst);
+
+  if (err)
+    return err;
 
   bf_seekcur(file, head1.hdrsize-4-sizeof(head2));
 
@@ -94,14 +109,14 @@ int xmpLoadModule(xmodule *m, binfile *file)
   m->inibpm=head2.bpm;
   m->initempo=head2.tempo;
 
-  m->orders=(unsigned short*) malloc(sizeof(unsigned short) * head2.nord);
-  m->patterns=(unsigned char (**)[5]) malloc(sizeof(void*) * (head2.npat+1));
-  m->patlens=(unsigned short*) malloc(sizeof(unsigned short) * (head2.npat+1));
-  m->instruments=(xmpinstrument*) malloc(sizeof(xmpinstrument) * head2.ninst);
-  m->envelopes=(xmpenvelope*) malloc(sizeof(xmpenvelope) * (head2.ninst*2));
-  sampleinfo **smps=(sampleinfo **)malloc(sizeof(sampleinfo*) * head2.ninst);
-  xmpsample **msmps=(xmpsample **)malloc(sizeof(xmpsample*) * head2.ninst);
-  int *instsmpnum=(int *)malloc(sizeof(int) *  head2.ninst);
+  m->orders=(unsigned short*) ar_alloc(&m->heap, sizeof(unsigned short) * head2.nord);
+  m->patterns=(unsigned char **) ar_alloc(&m->heap, sizeof(void*) * (head2.npat+1));
+  m->patlens=(unsigned short*) ar_alloc(&m->heap, sizeof(unsigned short) * (head2.npat+1));
+  m->instruments=(xmpinstrument*) ar_alloc(&m->heap, sizeof(xmpinstrument) * head2.ninst);
+  m->envelopes=(xmpenvelope*) ar_alloc(&m->heap, sizeof(xmpenvelope) * (head2.ninst*2));
+  sampleinfo **smps=(sampleinfo **)ar_alloc(&m->heap, sizeof(sampleinfo*) * head2.ninst);
+  xmpsample **msmps=(xmpsample **)ar_alloc(&m->heap, sizeof(xmpsample*) * head2.ninst);
+  int *instsmpnum=(int *)ar_alloc(&m->heap, sizeof(int) *  head2.ninst);
 
   if (!smps||!msmps||!instsmpnum||!m->instruments||!m->envelopes||!m->patterns||!m->orders||!m->patlens)
     return errAllocMem;
@@ -117,11 +132,21 @@ int xmpLoadModule(xmodule *m, binfile *file)
   for (i=0; i<head2.nord; i++)
     m->orders[i]=(head2.ord[i]<head2.npat)?head2.ord[i]:head2.npat;
 
+  // patterns are unpacked into a scratch buffer and stored packed
+  unsigned long packedsize=0;
+  unsigned long unpackedsize=0;
+  unsigned char (*patbuf)[5]=malloc(256*head2.nchan*5);
+  if (!patbuf)
+    return errAllocMem;
+
   m->patlens[head2.npat]=64;
-  m->patterns[head2.npat]=malloc(64*head2.nchan*5);
+  memset(patbuf, 0, 64*5*head2.nchan);
+  m->patterns[head2.npat]=xmpPackPattern(&m->heap, patbuf, 64, head2.nchan, &packedsize);
   if (!m->patterns[head2.npat])
+  {
+    free(patbuf);
     return errAllocMem;
-  memset(m->patterns[head2.npat], 0, 64*5*head2.nchan);
+  }
 
   for (i=0; i<head2.npat; i++)
   {
@@ -145,35 +170,58 @@ int xmpLoadModule(xmodule *m, binfile *file)
     ims_swap16(&pathead.patdata);
 
     bf_seekcur(file, (pathead.len-sizeof_pathead));
-    m->patlens[i]=pathead.rows;
-    m->patterns[i]=malloc(pathead.rows*head2.nchan*5);
-    if (!m->patterns[i])
-      return errAllocMem;
-    memset(m->patterns[i], 0, pathead.rows*head2.nchan*5);
-    if (!pathead.patdata)
+    if (pathead.rows>256)
+    {
+      free(patbuf);
+      return errFormStruc;
+    }
+    if (!pathead.rows)
+    {
+      // played as 64 empty rows, like the pattern of invalid orders
+      bf_seekcur(file, pathead.patdata);
+      m->patlens[i]=64;
+      m->patterns[i]=m->patterns[head2.npat];
       continue;
-    unsigned char *pbuf=(unsigned char*)malloc(pathead.patdata);
-    if (!pbuf)
-      return errAllocMem;
-    bf_read(file, pbuf, pathead.patdata);
-    unsigned char *pbp=pbuf;
-    unsigned char *cur=(unsigned char*)(m->patterns[i]);
-    for (j=0; j<(pathead.rows*head2.nchan); j++)
+    }
+    m->patlens[i]=pathead.rows;
+    memset(patbuf, 0, pathead.rows*head2.nchan*5);
+    if (pathead.patdata)
     {
-      unsigned char pack=(*pbp&0x80)?(*pbp++):0x1F;
-      for (k=0; k<5; k++)
+      unsigned char *pbuf=(unsigned char*)malloc(pathead.patdata);
+      if (!pbuf)
       {
-        *cur++=(pack&1)?*pbp++:0;
-        pack>>=1;
+        free(patbuf);
+        return errAllocMem;
       }
-      if (cur[-2]==0xE)
+      bf_read(file, pbuf, pathead.patdata);
+      unsigned char *pbp=pbuf;
+      unsigned char *cur=(unsigned char*)patbuf;
+      for (j=0; j<(pathead.rows*head2.nchan); j++)
       {
-        cur[-2]=36+(cur[-1]>>4);
-        cur[-1]&=0xF;
+        unsigned char pack=(*pbp&0x80)?(*pbp++):0x1F;
+        for (k=0; k<5; k++)
+        {
+          *cur++=(pack&1)?*pbp++:0;
+          pack>>=1;
+        }
+        if (cur[-2]==0xE)
+        {
+          cur[-2]=36+(cur[-1]>>4);
+          cur[-1]&=0xF;
+        }
       }
+      free(pbuf);
     }
-    free(pbuf);
+    m->patterns[i]=xmpPackPattern(&m->heap, patbuf, pathead.rows, head2.nchan, &packedsize);
+    if (!m->patterns[i])
+    {
+      free(patbuf);
+      return errAllocMem;
+    }
+    unpackedsize+=pathead.rows*head2.nchan*5;
   }
+  free(patbuf);
+  dbgprintf("patterns: %ld bytes packed, %ld unpacked", packedsize, unpackedsize);
 
 
   m->nsampi=0;
@@ -240,8 +288,8 @@ int xmpLoadModule(xmodule *m, binfile *file)
 
     bf_seekcur(file, (ins1.size-sizeof_ins1-sizeof_ins2));
 
-    smps[i]=malloc(sizeof(sampleinfo)*ins1.samp);
-    msmps[i]=malloc(sizeof(xmpsample)*ins1.samp);
+    smps[i]=ar_alloc(&m->heap, sizeof(sampleinfo)*ins1.samp);
+    msmps[i]=ar_alloc(&m->heap, sizeof(xmpsample)*ins1.samp);
     if (!smps[i]||!msmps[i])
       return errAllocMem;
     memset(msmps[i], 0, sizeof(xmpsample)*ins1.samp);
@@ -257,7 +305,7 @@ int xmpLoadModule(xmodule *m, binfile *file)
     {
       env[0].speed=0;
       env[0].type=0;
-      env[0].env=malloc(ins2.venv[ins2.vnum-1][0]+1);
+      env[0].env=ar_alloc(&m->heap, ins2.venv[ins2.vnum-1][0]+1);
       if (!env[0].env)
         return errAllocMem;
       short k, p=0, h=ins2.venv[0][1]*4;
@@ -291,7 +339,7 @@ int xmpLoadModule(xmodule *m, binfile *file)
     {
       env[1].speed=0;
       env[1].type=0;
-      env[1].env=malloc(ins2.penv[ins2.pnum-1][0]+1);
+      env[1].env=ar_alloc(&m->heap, ins2.penv[ins2.pnum-1][0]+1);
       if (!env[1].env)
         return errAllocMem;
       short k, p=0, h=ins2.penv[0][1]*4;
@@ -373,7 +421,7 @@ int xmpLoadModule(xmodule *m, binfile *file)
       sip->loopend=samp.loopstart+samp.looplen;
       sip->samprate=8363;
       sip->type=mcpSampDelta|((samp.type&16)?mcpSamp16Bit:0)|((samp.type&3)?(((samp.type&3)>=2)?(mcpSampLoop|mcpSampBiDi):mcpSampLoop):0);
-#if 1
+#if !defined(__BYTE_ORDER__) || (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
       if (sip->type & mcpSamp16Bit) {
         if (sip->type & mcpSampBigEndian) {
             sip->type &= ~mcpSampBigEndian;
@@ -391,6 +439,24 @@ int xmpLoadModule(xmodule *m, binfile *file)
       unsigned long l = (sip->type & mcpSamp16Bit) ? (sip->length << 1) : sip->length;
       if (!l)
         continue;
+      void *p=bf_ref(file, l, 1);
+      if (p)
+      {
+        // decode inside the module buffer instead of keeping a second copy
+        xmpinplace *ip=ar_alloc(&m->heap, sizeof(xmpinplace));
+        if (!ip)
+          return errAllocMem;
+        ip->ptr=p;
+        ip->length=sip->length;
+        ip->type=sip->type;
+        ip->next=m->inplace;
+        m->inplace=ip;
+        xmpDeltaInPlace(ip, 1);
+        sip->ptr=p;
+        sip->type=(sip->type&~(mcpSampDelta|mcpSampBigEndian))|mcpSampRef;
+        sp->handle=m->nsampi++;
+        continue;
+      }
       sip->ptr=malloc(l+528);
       if (!sip->ptr)
         return errAllocMem;
@@ -409,8 +475,8 @@ int xmpLoadModule(xmodule *m, binfile *file)
     m->nsamp+=ins1.samp;
   }
 
-  m->samples=malloc(sizeof(xmpsample)*m->nsamp);
-  m->sampleinfos=malloc(sizeof(sampleinfo)*m->nsampi);
+  m->samples=ar_alloc(&m->heap, sizeof(xmpsample)*m->nsamp);
+  m->sampleinfos=ar_alloc(&m->heap, sizeof(sampleinfo)*m->nsampi);
   if (!m->samples||!m->sampleinfos)
     return errAllocMem;
 
@@ -424,12 +490,7 @@ int xmpLoadModule(xmodule *m, binfile *file)
       if (smps[i][j].ptr)
         m->sampleinfos[m->nsampi++]=smps[i][j];
     }
-    free(smps[i]);
-    free(msmps[i]);
   }
-  free(smps);
-  free(msmps);
-  free(instsmpnum);
 
   return errOk;
 }
@@ -142,7 +142,8 @@ static unsigned char curtempo;
 static unsigned char tick0;
 
 static int currow;
-static unsigned char (*patptr)[5];
+static unsigned char *patptr;
+static unsigned char rowcache[256][5];
 static int patlen;
 static int curord;
 
@@ -158,7 +159,7 @@ static xmpinstrument *instruments;
 static xmpsample *samples;
 static sampleinfo *sampleinfos;
 static xmpenvelope *envelopes;
-static unsigned char (**patterns)[5];
+static unsigned char **patterns;
 static unsigned short *orders;
 static unsigned short *patlens;
 
@@ -574,6 +575,7 @@ static void xmpPlayTick()
     }
 
 
+    xmpUnpackRow(patptr, currow, nchan, rowcache);
     for (i=0; i<nchan; i++)
     {
       channel *ch=&channels[i];
@@ -587,11 +589,11 @@ static void xmpPlayTick()
       ch->notefx=0;
       ch->fx=0;
 
-      procnot=patptr[nchan*currow+i][0];
-      procins=patptr[nchan*currow+i][1];
-      procvol=patptr[nchan*currow+i][2];
-      proccmd=patptr[nchan*currow+i][3];
-      procdat=patptr[nchan*currow+i][4];
+      procnot=rowcache[i][0];
+      procins=rowcache[i][1];
+      procvol=rowcache[i][2];
+      proccmd=rowcache[i][3];
+      procdat=rowcache[i][4];
 
       if (!patdelay)
       {
@@ -1445,9 +1447,129 @@ void xmpSetLoop(int x)
   looping=x;
 }
 
+#define XMP_PRELOADTIME 3000
+
+// Walks the order list front to back and lists the samples in the order
+// they are first triggered, followed by the ones that are never used.
+// Also counts the triggers and the highest pitch of each sample for the
+// reduction planner. Returns how many samples are needed within the
+// first XMP_PRELOADTIME ms. Rows are unpacked into row, not rowcache:
+// a preload runs while the tick of the song playing uses that.
+static int xmpSampleOrder(xmodule *m, unsigned short *order, unsigned char *seen, sampleusage *use, unsigned char (*row)[5])
+{
+  unsigned char curins[256];
+  unsigned char curnote[256];
+  unsigned long time=0;
+  int tempo=m->initempo;
+  int bpm=m->inibpm;
+  int num=0;
+  int preload=-1;
+  int nch=(m->nchan<256)?m->nchan:256;
+  int o, r, c;
+
+  memset(seen, 0, m->nsampi);
+  memset(use, 0, m->nsampi*sizeof(sampleusage));
+  memset(curins, 0, sizeof(curins));
+  memset(curnote, 49, sizeof(curnote));
+
+  for (o=0; o<m->nord; o++)
+  {
+    int p=m->orders[o];
+    if ((p>=m->npat)||!m->patterns[p])
+      continue;
+    for (r=0; r<m->patlens[p]; r++)
+    {
+      if ((preload<0)&&(time>=XMP_PRELOADTIME))
+        preload=num;
+      xmpUnpackRow(m->patterns[p], r, nch, row);
+      for (c=0; c<nch; c++)
+      {
+        unsigned char *cell=row[c];
+        int note=cell[0];
+        int ins=cell[1];
+        if ((cell[3]==xmpCmdSpeed)&&cell[4])
+        {
+          if (cell[4]>=0x20)
+            bpm=cell[4];
+          else
+            tempo=cell[4];
+        }
+        if ((note==97)||(!note&&!ins))
+          continue;
+        if (ins&&(ins<=m->ninst))
+          curins[c]=ins;
+        if (note&&(note<97))
+          curnote[c]=note;
+        if (!curins[c])
+          continue;
+
+        int smp;
+        if (m->ismod)
+          smp=curins[c]-1;
+        else
+          smp=m->instruments[curins[c]-1].samples[curnote[c]-1];
+        if ((smp>=m->nsamp)||(m->samples[smp].handle>=m->nsampi))
+          continue;
+        int h=m->samples[smp].handle;
+        if (note&&(note<97))
+        {
+          // an octave of headroom for arpeggios and slides
+          long pitch=((note-1-48+12)<<8)-m->samples[smp].normnote;
+          if (!use[h].count||(pitch>use[h].maxpitch))
+            use[h].maxpitch=(pitch>0x7FFF)?0x7FFF:pitch;
+          if (use[h].count<0xFFFF)
+            use[h].count++;
+        }
+        if (!seen[h])
+        {
+          seen[h]=1;
+          order[num++]=h;
+        }
+      }
+      time+=(unsigned long)tempo*2500/(bpm?bpm:125);
+    }
+  }
+
+  if (preload<0)
+    preload=num;
+  for (o=0; o<m->nsampi; o++)
+    if (!seen[o])
+      order[num++]=o;
+  return preload;
+}
+
+static int loadsamples(xmodule *m, int (*load)(sampleinfo* si, int n))
+{
+  int nch=(m->nchan<256)?m->nchan:256;
+  sampleusage *use=malloc(m->nsampi*(sizeof(sampleusage)+sizeof(unsigned short)+1)+nch*5);
+  unsigned short *order=(unsigned short*)(use+m->nsampi);
+  unsigned char *seen=(unsigned char*)(order+m->nsampi);
+  if (use)
+  {
+    mcpSampPreload=xmpSampleOrder(m, order, seen, use, (unsigned char(*)[5])(seen+m->nsampi));
+    mcpSampOrderNum=m->nsampi;
+    mcpSampOrder=order;
+    mcpSampUsage=use;
+  }
+  int ret=load(m->sampleinfos, m->nsampi);
+  mcpSampUsage=0;
+  mcpSampOrder=0;
+  mcpSampOrderNum=0;
+  mcpSampPreload=0;
+  free(use);
+  return ret;
+}
+
 int xmpLoadSamples(xmodule *m)
 {
-  return mcpLoadSamples(m->sampleinfos, m->nsampi);
+  return loadsamples(m, mcpLoadSamples);
+}
+
+int xmpPreloadSamples(xmodule *m)
+{
+  if (!mcpPreloadSamples)
+    return 0;
+  return loadsamples(m, mcpPreloadSamples);
 }
 
 int xmpPlayModule(xmodule *m)
@@ -1491,7 +1613,7 @@ int xmpPlayModule(xmodule *m)
   }
 
   quelen=100;
-  que=malloc(sizeof(int)*quelen*4);
+  que=mxAlloc(sizeof(int)*quelen*4, MX_MEM_PLAYER);
   if (!que)
     return 0;
   querpos=0;
@@ -1516,7 +1638,8 @@ int xmpPlayModule(xmodule *m)
 void xmpStopModule()
 {
   mcpClosePlayer();
-  free(que);
+  mxFree(que);
+  que=0;
 }
 
 void xmpGetGlobInfo(int *tmp, int *bpm, int *gvol)
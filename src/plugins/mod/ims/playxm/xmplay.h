@@ -2,6 +2,7 @@
 #define __XMPLAY_H_
 
 #include "binfile.h"
+#include "arena.h"
 
 enum
 {
@@ -46,6 +47,15 @@ typedef struct
   unsigned short samples[128];
 } xmpinstrument;
 
+// sample decoded inside the module buffer, encoded again on unload
+typedef struct xmpinplace_t
+{
+  struct xmpinplace_t *next;
+  void *ptr;
+  long length;
+  unsigned long type;
+} xmpinplace;
+
 typedef struct
 {
   char name[21];
@@ -67,9 +77,11 @@ typedef struct
   xmpinstrument *instruments;
   struct sampleinfo_t *sampleinfos;
   unsigned short *patlens;
-  unsigned char (**patterns)[5];
+  unsigned char **patterns;     // packed, see xmpPackPattern
   unsigned short *orders;
   unsigned char panpos[256];
+  xmpinplace *inplace;
+  arena heap;                   // everything above except sample data
 } xmodule;
 
 typedef struct
@@ -105,6 +117,7 @@ enum
 #if 1
 
 int xmpLoadSamples(xmodule *m);
+int xmpPreloadSamples(xmodule *m);
 int xmpLoadModule(xmodule *m, binfile *f);
 int xmpLoadMOD(xmodule *m, binfile *f);
 int xmpLoadMODt(xmodule *m, binfile *f);
@@ -116,6 +129,7 @@ int xmpLoadM15t(xmodule *m, binfile *f);
 int xmpLoadWOW(xmodule *m, binfile *f);
 int xmpLoadMXM(xmodule *m, binfile *f);
 void xmpFreeModule(xmodule *m);
+void xmpDeltaInPlace(xmpinplace *s, int decode);
 
 int xmpPlayModule(xmodule *m);
 void xmpStopModule();
@@ -135,6 +149,8 @@ int xmpGetChanSamp(int);
 int xmpChanActive(int);
 void xmpGetGlobInfo(int *tmp, int *bpm, int *gvol);
 void xmpOptimizePatLens(xmodule *m);
+unsigned char *xmpPackPattern(arena *ar, unsigned char (*src)[5], int rows, int nchan, unsigned long *total);
+void xmpUnpackRow(const unsigned char *pat, int row, int nchan, unsigned char (*dst)[5]);
 int xmpGetSync(int ch, int *time);
 int xmpGetTime();
 
@@ -15,33 +15,163 @@
 #include "mcp.h"
 #include "xmplay.h"
 #include "err.h"
+#include "imsrtns.h"
+
+void xmpDeltaInPlace(xmpinplace *s, int decode)
+{
+  long i;
+  if (s->type&mcpSamp16Bit)
+  {
+    unsigned short *p=(unsigned short*)s->ptr;
+    unsigned short old=0;
+    int swap=(s->type&mcpSampBigEndian)?1:0;
+    for (i=0; i<s->length; i++)
+    {
+      unsigned short v=p[i];
+      if (decode)
+      {
+        if (swap)
+          v=swap16(v);
+        old=p[i]=old+v;
+      }
+      else
+      {
+        p[i]=v-old;
+        old=v;
+        if (swap)
+          ims_swap16(&p[i]);
+      }
+    }
+  }
+  else
+  {
+    unsigned char *p=(unsigned char*)s->ptr;
+    unsigned char old=0;
+    for (i=0; i<s->length; i++)
+    {
+      unsigned char v=p[i];
+      if (decode)
+        old=p[i]=old+v;
+      else
+      {
+        p[i]=v-old;
+        old=v;
+      }
+    }
+  }
+}
 
 void xmpFreeModule(xmodule *m)
 {
   int i;
   if (m->sampleinfos)
     for (i=0; i<m->nsampi; i++)
-      free(m->sampleinfos[i].ptr);
-  free(m->sampleinfos);
-  free(m->samples);
-  if (m->envelopes)
-    for (i=0; i<m->nenv; i++)
-      free(m->envelopes[i].env);
-  free(m->envelopes);
-  free(m->instruments);
-  if (m->patterns)
-    for (i=0; i<m->npat; i++)
-      free(m->patterns[i]);
-  free(m->patterns);
-  free(m->patlens);
-  free(m->orders);
+      if (!(m->sampleinfos[i].type&mcpSampRef))
+        free(m->sampleinfos[i].ptr);
+  xmpinplace *s;
+  for (s=m->inplace; s; s=s->next)
+    xmpDeltaInPlace(s, 0);
+  m->inplace=0;
+  ar_free(&m->heap);
+  m->sampleinfos=0;
+  m->samples=0;
+  m->envelopes=0;
+  m->instruments=0;
+  m->patterns=0;
+  m->patlens=0;
+  m->orders=0;
+}
+
+// Patterns are kept packed: a table of 32 bit row offsets followed by the
+// row data, dense patterns of many channels can pass 64KB. A cell is either
+// 0x80|mask followed by the non-zero fields in mask, or the five fields as
+// they are when the first one (note) is <0x80.
+static int xmpPackedCell(unsigned char *cell, unsigned char *pack)
+{
+  int k,n=0;
+  *pack=0x80;
+  for (k=0; k<5; k++)
+    if (cell[k])
+    {
+      *pack|=1<<k;
+      n++;
+    }
+  if ((n>=4)&&(cell[0]<0x80))
+  {
+    *pack=0;
+    return 5;
+  }
+  return n+1;
+}
+
+unsigned char *xmpPackPattern(arena *ar, unsigned char (*src)[5], int rows, int nchan, unsigned long *total)
+{
+  unsigned long size=rows*sizeof(unsigned long);
+  unsigned char pack;
+  int i,k;
+  if (rows<1)
+    return 0;
+  for (i=0; i<(rows*nchan); i++)
+    size+=xmpPackedCell(src[i], &pack);
+
+  unsigned char *pat=ar_alloc(ar, size);
+  if (!pat)
+    return 0;
+  if (total)
+    *total+=size;
+  unsigned char *dp=pat+rows*sizeof(unsigned long);
+  for (i=0; i<(rows*nchan); i++)
+  {
+    if (!(i%nchan))
+      ((unsigned long*)pat)[i/nchan]=dp-pat;
+    xmpPackedCell(src[i], &pack);
+    if (pack)
+      *dp++=pack;
+    for (k=0; k<5; k++)
+      if (!pack||src[i][k])
+        *dp++=src[i][k];
+  }
+  return pat;
+}
+
+void xmpUnpackRow(const unsigned char *pat, int row, int nchan, unsigned char (*dst)[5])
+{
+  const unsigned char *sp=pat+((const unsigned long*)pat)[row];
+  int i;
+  for (i=0; i<nchan; i++)
+  {
+    unsigned char pack=*sp;
+    if (pack&0x80)
+    {
+      sp++;
+      dst[i][0]=(pack&0x01)?*sp++:0;
+      dst[i][1]=(pack&0x02)?*sp++:0;
+      dst[i][2]=(pack&0x04)?*sp++:0;
+      dst[i][3]=(pack&0x08)?*sp++:0;
+      dst[i][4]=(pack&0x10)?*sp++:0;
+    }
+    else
+    {
+      dst[i][0]=sp[0];
+      dst[i][1]=sp[1];
+      dst[i][2]=sp[2];
+      dst[i][3]=sp[3];
+      dst[i][4]=sp[4];
+      sp+=5;
+    }
+  }
 }
 
 void xmpOptimizePatLens(xmodule *m)
 {
   unsigned char *lastrows=malloc(m->npat);
-  if (!lastrows)
+  unsigned char (*row)[5]=malloc(m->nchan*5);
+  if (!lastrows||!row)
+  {
+    free(lastrows);
+    free(row);
     return;
+  }
   memset(lastrows, 0, m->npat);
   int i,j,k;
   for (i=0; i<m->nord; i++)
@@ -53,17 +183,18 @@ void xmpOptimizePatLens(xmodule *m)
     {
       int neword=-1;
       int newrow=-1;
+      xmpUnpackRow(m->patterns[m->orders[i]], j, m->nchan, row);
       for (k=0; k<m->nchan; k++)
-        switch (m->patterns[m->orders[i]][m->nchan*j+k][3])
+        switch (row[k][3])
         {
         case xmpCmdJump:
-          neword=m->patterns[m->orders[i]][m->nchan*j+k][4];
+          neword=row[k][4];
           newrow=0;
           break;
         case xmpCmdBreak:
           if (neword==-1)
             neword=i+1;
-          newrow=m->patterns[m->orders[i]][m->nchan*j+k][4];
+          newrow=row[k][4];
           break;
         }
       if (neword!=-1)
@@ -99,4 +230,5 @@ void xmpOptimizePatLens(xmodule *m)
   for (i=0; i<m->npat; i++)
     m->patlens[i]=lastrows[i]+1;
   free(lastrows);
+  free(row);
 }
@@ -22,14 +22,15 @@ static unsigned char curtempo;
 
 static int looped;
 static int currow;
-static unsigned char (*patptr)[5];
+static unsigned char *patptr;
+static unsigned char rowcache[256][5];
 static int patlen;
 static int curord;
 
 static int nord;
 static int nchan;
 static int loopord;
-static unsigned char (**patterns)[5];
+static unsigned char **patterns;
 static unsigned short *orders;
 static unsigned short *patlens;
 
@@ -109,11 +110,12 @@ static int xmpFindTick()
     }
 
 
+    xmpUnpackRow(patptr, currow, nchan, rowcache);
     for (i=0; i<nchan; i++)
     {
-      int procdat=patptr[nchan*currow+i][4];
+      int procdat=rowcache[i][4];
 
-      switch (patptr[nchan*currow+i][3])
+      switch (rowcache[i][3])
       {
       case xmpCmdSync1: case xmpCmdSync2: case xmpCmdSync3:
         sync=procdat;
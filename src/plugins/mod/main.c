@@ -7,7 +7,10 @@
 #include "ims.h"
 #include "plugin.h"
 
-#if defined(MODSUPPORT_S3M)
+// GMD formats are opt-in per format, see 'formats=' in Makefile-isa
+#if defined(MODSUPPORT_S3M) || defined(MODSUPPORT_MTM) || defined(MODSUPPORT_669) || \
+    defined(MODSUPPORT_ULT) || defined(MODSUPPORT_DMF) || defined(MODSUPPORT_AMS) || \
+    defined(MODSUPPORT_MDL) || defined(MODSUPPORT_OKT) || defined(MODSUPPORT_PTM)
 #define PLAYSUPPORT_GMD
 #endif
 
@@ -19,20 +22,119 @@
 #define PLAYTYPE_XMP        0
 #define PLAYTYPE_GMD        1
 
-static uint8 modType = 0;
+// reduced samples are cached here, caching is off when the folder does not exist
+#ifndef MODCACHE_DIR
+#define MODCACHE_DIR "C:\\MODCACHE"
+#endif
+
 static uint8 playType = 0;
-static const char* modTypeNames[] = { "ProTracker", "FastTrackerII", "ScreamTracker" };
+static const char* modTypeName = "ProTracker";
 static uint8* currentSongPtr = 0;
+static mcpcachekey currentSongKey;
 static xmodule mod;
 
+// song parsed ahead of time, see jamOnPreload
+static uint8 nextPlayType = 0;
+static const char* nextTypeName = 0;
+static uint8* nextSongPtr = 0;
+static mcpcachekey nextSongKey;
+static xmodule nextmod;
+
 #ifdef PLAYSUPPORT_GMD
 #include "gmdplay.h"
 static gmdmodule modgmd;
+static gmdmodule nextgmd;
+
+#define GMDFMT_WEAKSIG      1   // short signature, only trusted when there is no MOD tag
+#define GMDFMT_NEEDSIZE     2   // loader needs the real file size
+
+#define GMDFMT_LENBYTE      0xFF    // title length is in the byte before the title
+
+typedef struct {
+    uint16 offset;
+    uint8 len;
+    uint8 flags;
+    const char* sig;
+    const char* ext;
+    const char* name;
+    int(*load)(gmdmodule*m, binfile*f);
+    uint16 titleofs;                // where the header keeps title and composer,
+    uint8 titlelen;                 // for showing them without loading the song
+    uint16 authorofs;
+    uint8 authorlen;
+} gmdFormat;
+
+// in order of preference for the limited Jam extension slots
+static const gmdFormat gmdFormats[] = {
+#ifdef MODSUPPORT_S3M
+    { 44, 4, 0, "SCRM",             "S3M", "ScreamTracker",     mpLoadS3M,  0, 28 },
+#endif
+#ifdef MODSUPPORT_MTM
+    {  0, 3, 0, "MTM",              "MTM", "MultiTracker",      mpLoadMTM,  4, 20 },
+#endif
+#ifdef MODSUPPORT_PTM
+    { 44, 4, 0, "PTMF",             "PTM", "PolyTracker",       mpLoadPTM,  0, 28 },
+#endif
+#ifdef MODSUPPORT_669
+    {  0, 2, GMDFMT_WEAKSIG, "if",  "669", "Composer 669",      mpLoad669,  2, 31 },
+    {  0, 2, GMDFMT_WEAKSIG, "JN",  "669", "UNIS 669",          mpLoad669,  2, 31 },
+#endif
+#ifdef MODSUPPORT_OKT
+    {  0, 8, 0, "OKTASONG",         "OKT", "Oktalyzer",         mpLoadOKT,  0, 0 },
+#endif
+#ifdef MODSUPPORT_DMF
+    {  0, 4, 0, "DDMF",             "DMF", "X-Tracker",         mpLoadDMF, 13, 30, 43, 20 },
+#endif
+#ifdef MODSUPPORT_AMS
+    {  0, 7, 0, "AMShdr\x1A",       "AMS", "Velvet Studio",     mpLoadAMS,  8, GMDFMT_LENBYTE },
 #endif
+#ifdef MODSUPPORT_MDL
+    {  0, 4, 0, "DMDL",             "MDL", "DigiTrakker",       mpLoadMDL, 11, 32, 43, 20 },
+#endif
+#ifdef MODSUPPORT_ULT
+    {  0, 14, GMDFMT_NEEDSIZE, "MAS_UTrack_V00", "ULT", "UltraTracker", mpLoadULT, 15, 32 },
+#endif
+    { 0, 0, 0, NULL, NULL, NULL, NULL, 0, 0, 0, 0 }
+};
+
+static bool hasModTag(const uint8* buf) {
+    // any printable tag at 1080 (M.K., FLT4, 8CHN...) marks a 31 instrument MOD
+    for (int i = 0; i < 4; i++) {
+        if ((buf[1080 + i] < 0x20) || (buf[1080 + i] > 0x7E)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const gmdFormat* gmdDetect(const uint8* buf, uint32 siz) {
+    bool modtag = (siz >= 1084) && hasModTag(buf);
+    for (const gmdFormat* f = gmdFormats; f->load; f++) {
+        if (((f->offset + f->len) <= siz) && (memcmp(&buf[f->offset], f->sig, f->len) == 0)) {
+            if ((f->flags & GMDFMT_WEAKSIG) && modtag) {
+                continue;
+            }
+            return f;
+        }
+    }
+    return NULL;
+}
+#endif
+
+static const char* songName() {
+    #ifdef PLAYSUPPORT_GMD
+    if (playType == PLAYTYPE_GMD) {
+        return modgmd.name;
+    }
+    #endif
+    return mod.name;
+}
 
 static bool pluginInit() {
     currentSongPtr = null;
+    nextSongPtr = null;
     memset(&mod, 0, sizeof(xmodule));
+    memset(&nextmod, 0, sizeof(xmodule));
 
     mxCalibrateDelay();
     uint32 iobase = mxIsaInit();
@@ -44,6 +146,8 @@ static bool pluginInit() {
     imsFillDefaults(&is);
     is.bufsize = 65536;
     is.pollmin = 61440;
+    is.releasesamples = 1;     // samples live in card memory, free the host copies
+    mcpCacheDir = MODCACHE_DIR;
 
     dbg("IMS Init");
     if (!imsInit(&is)) {
@@ -54,7 +158,27 @@ static bool pluginInit() {
     return true;
 }
 
+static void songDrop() {
+    // the preloaded song is not played after all
+    if (nextSongPtr) {
+        if (mcpPreloadSamples) {
+            mcpPreloadSamples(null, 0);
+        }
+        if (nextPlayType == PLAYTYPE_XMP) {
+            xmpFreeModule(&nextmod);
+            memset(&nextmod, 0, sizeof(xmodule));
+        }
+        #ifdef PLAYSUPPORT_GMD
+        else if (nextPlayType == PLAYTYPE_GMD) {
+            mpFree(&nextgmd);
+        }
+        #endif
+    }
+    nextSongPtr = null;
+}
+
 static void songUnload() {
+    mcpIdle = 0;
     if (currentSongPtr) {
         if (playType == PLAYTYPE_XMP) {
             xmpStopModule();
@@ -63,83 +187,152 @@ static void songUnload() {
         }
         #ifdef PLAYSUPPORT_GMD
         else if (playType == PLAYTYPE_GMD) {
+            mpFree(&modgmd);
         }
         #endif
     }
     currentSongPtr = null;
 }
 
-static bool songLoad(uint8* buf, uint32 siz) {
-    songUnload();
-    if (buf == null)
-        return false;
+static bool songParse(uint8* buf, uint32 siz, long bfflags, bool next) {
+    // the song without its samples, into the preload slot when next is set
+    uint8* type = next ? &nextPlayType : &playType;
+    const char** name = next ? &nextTypeName : &modTypeName;
+    mcpcachekey* key = next ? &nextSongKey : &currentSongKey;
+    xmodule* xm = next ? &nextmod : &mod;
+    #ifdef PLAYSUPPORT_GMD
+    gmdmodule* gm = next ? &nextgmd : &modgmd;
+    #endif
 
+    // sample data may be used straight from the host buffer
     binfile fil;
     bf_initref(&fil, buf, siz);
+    fil.flags |= bfflags;
 
     int(*xmpLoad)(xmodule*m, binfile*f) = null;
     #ifdef PLAYSUPPORT_GMD
     int(*gmdLoad)(gmdmodule*m, binfile*f) = null;
+    const gmdFormat* gmdFmt = null;
     #else
     void* gmdLoad = null;
     #endif    
 
     if (memcmp(&buf[0], "Extended Module: ", 17) == 0) {    // FastTrackerII
-        modType = 1;
-        playType = PLAYTYPE_XMP;
+        *name = "FastTrackerII";
+        *type = PLAYTYPE_XMP;
         xmpLoad = xmpLoadModule;
     }
-    #ifdef MODSUPPORT_S3M    
-    else if (memcmp(&buf[44], "SCRM", 4) == 0) {          // ScreamTracker (todo)
-        modType = 2;
-        playType = PLAYTYPE_GMD;
-        gmdLoad = mpLoadS3M;
+    #ifdef PLAYSUPPORT_GMD
+    else if ((gmdFmt = gmdDetect(buf, siz)) != null) {    // OpenCP GMD formats
+        *name = gmdFmt->name;
+        *type = PLAYTYPE_GMD;
+        gmdLoad = gmdFmt->load;
     }
     #endif        
     else {                                                // ProTracker / Generic
-        modType = 0;
-        playType = PLAYTYPE_XMP;
+        *name = "ProTracker";
+        *type = PLAYTYPE_XMP;
         xmpLoad = xmpLoadMOD;
     }
 
-    if (playType == PLAYTYPE_XMP) {
+    if (*type == PLAYTYPE_XMP) {
         if (xmpLoad == null) {
             err("xmpLoad");
             return false;
         }
         dbg("xmpLoadMOD");
-        if (xmpLoad(&mod, &fil) < 0) {
+        if (xmpLoad(xm, &fil) < 0) {
             err("xmpLoadMOD");
-            songUnload();
+            xmpFreeModule(xm);
+            memset(xm, 0, sizeof(xmodule));
             return false;
         }
-
-        currentSongPtr = buf;
-
-        dbg("xmpLoadSamples");
-        if (!xmpLoadSamples(&mod)) {
-            err("xmpLoadSamples");
-            songUnload();
-            return false;
+        #ifdef DEBUG
+        {
+            unsigned long used, slack, count;
+            ar_stats(&xm->heap, &used, &slack, &count);
+            dbg("arena: %ld used, %ld slack, %ld allocs", used, slack, count);
         }
+        #endif
     }
     #ifdef PLAYSUPPORT_GMD
-    else if (playType == PLAYTYPE_GMD) {
+    else if (*type == PLAYTYPE_GMD) {
         if (gmdLoad == null) {
             err("gmdLoad");
             return false;
         }
         dbg("gmdLoadMOD");
-        if (gmdLoad(&modgmd, &fil) < 0) {
+        if (gmdLoad(gm, &fil) < 0) {
             err("gmdLoadMOD");
-            songUnload();
+            mpFree(gm);
             return false;
         }
+        #ifdef DEBUG
+        {
+            unsigned long used, slack, count;
+            ar_stats(&gm->heap, &used, &slack, &count);
+            dbg("arena: %ld used, %ld slack, %ld allocs", used, slack, count);
+        }
+        #endif
+    }
+    #endif
+
+    // key covers the bytes the loader consumed, Jam does not tell us the file size.
+    // By now the loaders have delta decoded the sample data in place, so it is a
+    // checksum of the decoded module rather than of the file. The decode always
+    // gives the same bytes so the key is still stable from one load to the next.
+    // Without a cache directory the module is not hashed at all.
+    memset(key, 0, sizeof(mcpcachekey));
+    if (mcpCacheReady()) {
+        mcpCacheKeyOf(key, buf, bf_tell(&fil));
+    }
+    return true;
+}
+
+static bool songLoad(uint8* buf, uint32 siz, long bfflags) {
+    songUnload();
+    if (buf == null)
+        return false;
 
-        currentSongPtr = buf;
+    if (buf == nextSongPtr) {
+        // parsed while the previous song played, the samples it
+        // could upload by then are found in the card
+        playType = nextPlayType;
+        modTypeName = nextTypeName;
+        currentSongKey = nextSongKey;
+        mod = nextmod;
+        memset(&nextmod, 0, sizeof(xmodule));
+        #ifdef PLAYSUPPORT_GMD
+        modgmd = nextgmd;
+        memset(&nextgmd, 0, sizeof(gmdmodule));
+        #endif
+        nextSongPtr = null;
+    } else {
+        songDrop();
+        if (!songParse(buf, siz, bfflags, false)) {
+            return false;
+        }
+    }
+    currentSongPtr = buf;
 
+    if (playType == PLAYTYPE_XMP) {
+        dbg("xmpLoadSamples");
+        mcpCacheKey = currentSongKey;
+        bool ok = xmpLoadSamples(&mod);
+        memset(&mcpCacheKey, 0, sizeof(mcpCacheKey));
+        if (!ok) {
+            err("xmpLoadSamples");
+            songUnload();
+            return false;
+        }
+    }
+    #ifdef PLAYSUPPORT_GMD
+    else if (playType == PLAYTYPE_GMD) {
         dbg("gmdLoadSamples");
-        if (!mpLoadSamples(&modgmd)) {
+        mcpCacheKey = currentSongKey;
+        bool ok = mpLoadSamples(&modgmd);
+        memset(&mcpCacheKey, 0, sizeof(mcpCacheKey));
+        if (!ok) {
             err("gmdLoadSamples");
             songUnload();
             return false;
@@ -148,6 +341,7 @@ static bool songLoad(uint8* buf, uint32 siz) {
     #endif
 
     dbg("songLoad: OK")
+    dbg("mem: %s", mxMemReport());
     return true;
 }
 
@@ -184,10 +378,47 @@ static void songPause(bool paused) {
 }
 #endif
 
+static void songIdle() {
+    // background work such as uploading the remaining samples
+    if (mcpIdle) {
+        mcpIdle();
+    }
+}
+
 static bool songFinished() {
     return false;
 }
 
+#ifdef DEBUG
+static void songStats() {
+    // report wavetable register writes issued/suppressed per second
+    // and how far tick periods strayed from nominal
+    static int lastTime = 0;
+    static unsigned long lastWrites = 0;
+    static unsigned long lastSkips = 0;
+    static unsigned long lastTicks = 0;
+    static unsigned long lastJitter = 0;
+    int time = mcpGet(-1, mcpGCmdTimer);
+    unsigned long writes = mcpGet(-1, mcpGRegWrites);
+    unsigned long skips = mcpGet(-1, mcpGRegSkips);
+    unsigned long ticks = mcpGet(-1, mcpGTicks);
+    unsigned long jitter = mcpGet(-1, mcpGTickJitter);
+    if (time < lastTime) {
+        lastTime = time; lastWrites = writes; lastSkips = skips; lastTicks = ticks; lastJitter = jitter;
+    } else if ((time - lastTime) >= 65536) {
+        unsigned long w = umuldiv(writes - lastWrites, 65536, time - lastTime);
+        unsigned long s = umuldiv(skips - lastSkips, 65536, time - lastTime);
+        dbg("regs/s: %ld written, %ld suppressed", w, s);
+        if (ticks > lastTicks) {
+            dbg("tick jitter: %ld us avg, %ld us max", (jitter - lastJitter) / (ticks - lastTicks), (unsigned long)mcpGet(-1, mcpGTickJitterMax));
+        }
+        lastTime = time; lastWrites = writes; lastSkips = skips; lastTicks = ticks; lastJitter = jitter;
+    }
+}
+#else
+#define songStats()
+#endif
+
 
 // -----------------------------------------------------------------------
 //
@@ -214,16 +445,41 @@ const struct SExtension mx_extensions[] = {
 #ifdef MODSUPPORT_S3M    
 	{ "S3M", "ScreamTracker" },
 #endif    
+#ifdef MODSUPPORT_MTM
+	{ "MTM", "MultiTracker" },
+#endif
+#ifdef MODSUPPORT_PTM
+	{ "PTM", "PolyTracker" },
+#endif
+#ifdef MODSUPPORT_669
+	{ "669", "Composer 669" },
+#endif
+#ifdef MODSUPPORT_OKT
+	{ "OKT", "Oktalyzer" },
+#endif
+#ifdef MODSUPPORT_DMF
+	{ "DMF", "X-Tracker" },
+#endif
+#ifdef MODSUPPORT_AMS
+	{ "AMS", "Velvet Studio" },
+#endif
+#ifdef MODSUPPORT_MDL
+	{ "MDL", "DigiTrakker" },
+#endif
+#ifdef MODSUPPORT_ULT
+	{ "ULT", "UltraTracker" },
+#endif
 	{ NULL, NULL }
 };
 
 static int paramGetSongName() {
-    mx_plugin.inBuffer.value = (long) &mod.name;
+    mx_plugin.inBuffer.value = (long) songName();
     return MXP_OK;
 }
 
 const struct SParameter mx_settings[] = {
     { "Track", MXP_PAR_TYPE_CHAR|MXP_FLG_INFOLINE|MXP_FLG_MOD_PARAM, NULL, paramGetSongName },
+    MX_PROF_PARAMETER
     { NULL, 0, NULL, NULL }
 };
 
@@ -235,7 +491,7 @@ int mx_init() {
 int mx_register_module() {
     uint8* data = (uint8*) mx_plugin.inBuffer.pModule->p;
     size_t size = mx_plugin.inBuffer.pModule->size;
-    return songLoad(data, size) ? MXP_OK : MXP_ERROR;
+    return songLoad(data, size, BF_REF | BF_WRITABLE) ? MXP_OK : MXP_ERROR;
 }
 
 int mx_unregister_module() {
@@ -260,6 +516,8 @@ int mx_unset() {
 
 int mx_feed() {
    if (currentSongPtr) {
+        songIdle();
+        songStats();
         if (songFinished()) {
             songStop();
             return MXP_ERROR;
@@ -301,17 +559,12 @@ jamPluginInfo info = {
     "2024.08.07",               // date
     ".MOD",                     // ext
     ".XM",                      // ext
-#ifdef MODSUPPORT_S3M    
-    ".S3M",                     // ext
-#endif    
+    " ",                        // ext, GMD formats are filled in by jamOnPluginInfo
     " ",                        // ext
     " ",                        // ext
     " ",                        // ext
     " ",                        // ext
     " ",                        // ext
-#ifndef MODSUPPORT_S3M
-    " ",                        // ext
-#endif
     "OpenCP",                   // pluginName
     "Anders Granlund",          // authorName
     "granlund23@yahoo.se",      // authorEmail
@@ -330,6 +583,22 @@ jamPluginInfo info = {
 };
 
 jamPluginInfo* jamOnPluginInfo() {
+    #ifdef PLAYSUPPORT_GMD
+    // Jam has room for 8 extensions and does not tell us the file size
+    char (*ext)[6] = (char(*)[6]) info.fileExt3;
+    int slots = 6;
+    const char* last = "";
+    for (const gmdFormat* f = gmdFormats; f->load && (slots > 0); f++) {
+        if ((f->flags & GMDFMT_NEEDSIZE) || (strcmp(f->ext, last) == 0)) {
+            continue;
+        }
+        ext[0][0] = '.';
+        strcpy(&ext[0][1], f->ext);
+        last = f->ext;
+        ext++;
+        slots--;
+    }
+    #endif
     return &info;
 }
 
@@ -341,10 +610,93 @@ void jamOnPluginStop() {
     songUnload();
 }
 
+static void copyName(char* out, const uint8* in, int len) {
+    // fixed size header fields, zero or space padded
+    int n = 0;
+    while ((n < len) && in[n]) {
+        out[n] = ((in[n] < 0x20) || (in[n] > 0x7E)) ? ' ' : in[n];
+        n++;
+    }
+    while ((n > 0) && (out[n-1] == ' ')) {
+        n--;
+    }
+    out[n] = 0;
+}
+
+bool jamOnProbe(uint8* songData, jamSongInfo* songInfo) {
+    // title from the module header, nothing is loaded or uploaded
+    const char* type = "ProTracker";
+    songInfo->title[0] = 0;
+    songInfo->composer[0] = 0;
+    if (memcmp(&songData[0], "Extended Module: ", 17) == 0) {
+        type = "FastTrackerII";
+        copyName(songInfo->title, &songData[17], 20);
+    }
+    #ifdef PLAYSUPPORT_GMD
+    else {
+        // the size is not known, as in songLoad
+        const gmdFormat* f = gmdDetect(songData, 128 * 1024 * 1024);
+        if (f) {
+            type = f->name;
+            int len = (f->titlelen == GMDFMT_LENBYTE) ? songData[f->titleofs - 1] : f->titlelen;
+            copyName(songInfo->title, &songData[f->titleofs], len);
+            copyName(songInfo->composer, &songData[f->authorofs], f->authorlen);
+        } else {
+            copyName(songInfo->title, &songData[0], 20);
+        }
+    }
+    #else
+    else {
+        copyName(songInfo->title, &songData[0], 20);
+    }
+    #endif
+    strcpy(songInfo->comments, type);
+    songInfo->isYMsong = 1;
+    songInfo->songCount = 1;
+    return true;
+}
+
 void jamOnLoad(uint8* songData) {
     // they say size don't matter...
     uint32 size = 128 * 1024 * 1024;
-    songLoad(songData, size);
+    songLoad(songData, size, BF_REF);
+}
+
+void jamOnPreload(uint8* songData) {
+    // parse the next song and send its samples to free card memory while
+    // this one plays. Without room it is all done on play as before
+    if (songData != nextSongPtr) {
+        songDrop();
+    }
+    if ((songData == null) || (songData == nextSongPtr)) {
+        return;
+    }
+    if (!mcpPreloadSamples || !mxMemRoom(0)) {
+        dbg("preload: no room");
+        return;
+    }
+    if (!songParse(songData, 128 * 1024 * 1024, BF_REF, true)) {
+        return;
+    }
+    nextSongPtr = songData;
+    if (!mxMemRoom(0)) {
+        // it fit but left too little for anything else
+        dbg("preload: no room");
+        songDrop();
+        return;
+    }
+    bool ok = false;
+    mcpCacheKey = nextSongKey;
+    if (nextPlayType == PLAYTYPE_XMP) {
+        ok = xmpPreloadSamples(&nextmod);
+    }
+    #ifdef PLAYSUPPORT_GMD
+    else if (nextPlayType == PLAYTYPE_GMD) {
+        ok = mpPreloadSamples(&nextgmd);
+    }
+    #endif
+    memset(&mcpCacheKey, 0, sizeof(mcpCacheKey));
+    dbg("preload: samples %s, mem: %s", ok ? "queued" : "on play", mxMemReport());
 }
 
 void jamOnInfo(jamSongInfo* songInfo) {
@@ -352,8 +704,8 @@ void jamOnInfo(jamSongInfo* songInfo) {
     songInfo->songCount = 0;
     if (currentSongPtr) {
         songInfo->songCount = 1;
-        strcpy(songInfo->title, mod.name);
-        strcpy(songInfo->comments, modTypeNames[modType]);
+        strcpy(songInfo->title, songName());
+        strcpy(songInfo->comments, modTypeName);
     }
 }
 
@@ -367,6 +719,8 @@ void jamOnStop() {
 
 void jamOnUpdate() {
     if (currentSongPtr) {
+        songIdle();
+        songStats();
         if (songFinished()) {
 #if 0
             songUnload();
@@ -37,10 +37,14 @@ extern void vgmslap_info(
 
 static uint8* currentSongPtr = 0;
 static uint8* currentSongData = 0;
+static uint8* nextSongPtr = 0;          // song inflated ahead of time, see jamOnPreload
+static uint8* nextSongData = 0;
 
 static bool pluginInit() {
     currentSongPtr = null;
     currentSongData = null;
+    nextSongPtr = null;
+    nextSongData = null;
 
     mxCalibrateDelay();
     uint32 iobase = mxIsaInit();
@@ -60,48 +64,88 @@ static void songUnload() {
     if (currentSongPtr) {
         vgmslap_stop();
         if (currentSongData) {
-            free(currentSongData);
+            mxFree(currentSongData);
             currentSongData = null;
         }
         currentSongPtr = null;
     }
 }
 
-static bool songLoad(uint8* buf) {
-    songUnload();
-    if (buf == null)
-        return false;
+static void songDrop() {
+    if (nextSongData) {
+        mxFree(nextSongData);
+    }
+    nextSongPtr = null;
+    nextSongData = null;
+}
 
-    // decompress
-    currentSongPtr = buf;
+static uint32 songSize(uint8* buf) {
+    // size of the vgm stream, 0 when it is not one
     if ((buf[0] == 0x1F) && (buf[1] == 0x8B)) {
-        // decompress and validate header
-        uint8* buf_decompressed = malloc(1024);
-        uint32 s1 = em_inflate(buf, 256, buf_decompressed, 256);
-        if (*((uint32*)buf_decompressed) != 0x56676d20) {
-            free(buf_decompressed);
-            return false;
-        }
-        // reallocate decompression buffer for final size
-        uint32 fsize_decompressed = *((uint32*)&buf_decompressed[4]);
-        fsize_decompressed = 4 + swap32(fsize_decompressed);
-        buf_decompressed = realloc(buf_decompressed, fsize_decompressed);
+        uint32 header[64];
+        em_inflate(buf, 256, (uint8*)header, 256);
+        return (memcmp(header, "Vgm ", 4) == 0) ? (4 + swap32(header[1])) : 0;
+    }
+    return 4 + swap32(*((uint32*)&buf[4]));
+}
+
+static bool songUnpack(uint8* buf, uint8** data) {
+    // the stream the player reads, null when that is buf itself
+    *data = null;
+    uint32 fsize = songSize(buf);
+    if (fsize == 0) {
+        return false;
+    }
+    if ((buf[0] == 0x1F) && (buf[1] == 0x8B)) {
+        // the player reads the stream every tick, fast ram if there is any
+        uint8* buf_decompressed = mxAlloc(fsize, MX_MEM_SONG);
         if (!buf_decompressed) {
-            free(buf_decompressed);
             return false;
         }
         // decompress
-        uint32 s = em_inflate(buf, fsize_decompressed, buf_decompressed, fsize_decompressed);
-        if (*((uint32*)buf_decompressed) != 0x56676d20) {
-            free(buf_decompressed);
+        uint32 s = em_inflate(buf, fsize, buf_decompressed, fsize);
+        if (memcmp(buf_decompressed, "Vgm ", 4) != 0) {
+            mxFree(buf_decompressed);
+            return false;
+        }
+        *data = buf_decompressed;
+    } else if (!mxMemIsFast(buf)) {
+        // the player gave us ST-RAM, a copy pays off when it can go to fast ram
+        uint8* copy = mxAlloc(fsize, MX_MEM_SONG);
+        if (copy && !mxMemIsFast(copy)) {
+            mxFree(copy);
+            copy = null;
+        }
+        if (copy) {
+            memcpy(copy, buf, fsize);
+            *data = copy;
+        }
+    }
+    return true;
+}
+
+static bool songLoad(uint8* buf) {
+    songUnload();
+    if (buf == null)
+        return false;
+
+    currentSongPtr = buf;
+    if (buf == nextSongPtr) {
+        // inflated while the previous song played
+        currentSongData = nextSongData;
+        nextSongPtr = null;
+        nextSongData = null;
+    } else {
+        songDrop();
+        if (!songUnpack(buf, &currentSongData)) {
             return false;
         }
-        currentSongData = buf_decompressed;
     }
     if (vgmslap_load(currentSongData ? currentSongData : currentSongPtr) != 0) {
         songUnload();
         return false;
     }
+    dbg("mem: %s", mxMemReport());
     return true;
 }
 
@@ -221,6 +265,7 @@ const struct SParameter mx_settings[] = {
     { "Chip", MXP_PAR_TYPE_CHAR|MXP_FLG_INFOLINE|MXP_FLG_MOD_PARAM, NULL, paramGetChipType },
     { "Track", MXP_PAR_TYPE_CHAR|MXP_FLG_INFOLINE|MXP_FLG_MOD_PARAM, NULL, paramGetSongName },
     { "Author", MXP_PAR_TYPE_CHAR|MXP_FLG_MOD_PARAM, NULL, paramGetAuthor },
+    MX_PROF_PARAMETER
     { NULL, 0, NULL, NULL }
 };
 
@@ -336,11 +381,109 @@ void jamOnPluginStop() {
     songUnload();
 }
 
+static uint32 rd32le(const uint8* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static const uint8* gd3String(const uint8* p, const uint8* end, char* out, int buflen) {
+    // utf-16le, only the latin-1 range is kept
+    int pos = 0;
+    while ((p + 1) < end) {
+        uint16 c = p[0] | (p[1] << 8);
+        p += 2;
+        if (c == 0) {
+            break;
+        }
+        if (out && (pos < (buflen - 1))) {
+            out[pos++] = (c < 0x100) ? (char)c : '?';
+        }
+    }
+    if (out) {
+        out[pos] = 0;
+    }
+    return p;
+}
+
+bool jamOnProbe(uint8* songData, jamSongInfo* songInfo) {
+    // header and gd3 tag only. vgz keeps the tag at the end of the
+    // compressed stream, there only the header is inflated.
+    static uint8 hdr[1024];
+    const uint8* vgm = songData;
+    bool compressed = (songData[0] == 0x1F) && (songData[1] == 0x8B);
+    if (compressed) {
+        em_inflate(songData, 256, hdr, 256);
+        vgm = hdr;
+    }
+    if (memcmp(vgm, "Vgm ", 4) != 0) {
+        return false;
+    }
+    dbg("jamOnProbe %x", songData);
+    songInfo->isYMsong = 1;
+    songInfo->songCount = 1;
+    songInfo->title[0] = 0;
+    songInfo->composer[0] = 0;
+
+    uint8 chipType = 0;
+    if (rd32le(&vgm[0x08]) >= 0x151) {
+        uint32 opl2 = rd32le(&vgm[0x50]);
+        uint32 opl1 = rd32le(&vgm[0x54]);
+        uint32 opl3 = rd32le(&vgm[0x5C]);
+        if (opl2) {
+            chipType = (opl2 > 0x40000000) ? 5 : 2;
+        }
+        if (opl1) {
+            chipType = (opl1 > 0x40000000) ? 4 : (chipType == 2) ? 6 : 1;
+        }
+        if (opl3) {
+            chipType = (opl3 > 0x40000000) ? 0 : 3;
+        }
+    }
+    strcpy(songInfo->comments, chipNames[chipType]);
+
+    uint32 secs = rd32le(&vgm[0x18]) / 44100;
+    songInfo->playtime_min[0] = secs / 60;
+    songInfo->playtime_sec[0] = secs % 60;
+
+    uint32 gd3 = rd32le(&vgm[0x14]);
+    if (!compressed && gd3 && (memcmp(&vgm[0x14 + gd3], "Gd3 ", 4) == 0)) {
+        const uint8* p = &vgm[0x14 + gd3 + 12];
+        const uint8* end = p + rd32le(&vgm[0x14 + gd3 + 8]);
+        p = gd3String(p, end, songInfo->title, 256);    // track
+        p = gd3String(p, end, 0, 0);
+        p = gd3String(p, end, 0, 0);                    // game
+        p = gd3String(p, end, 0, 0);
+        p = gd3String(p, end, 0, 0);                    // system
+        p = gd3String(p, end, 0, 0);
+        p = gd3String(p, end, songInfo->composer, 256); // author
+    }
+    return true;
+}
+
 void jamOnLoad(uint8* songData) {
     dbg("jamOnLoad %x", songData);
     songLoad(songData);
 }
 
+void jamOnPreload(uint8* songData) {
+    // inflate the next song now so the switch is immediate, when there is room.
+    // without it songLoad does the work as before
+    dbg("jamOnPreload %x", songData);
+    if (songData != nextSongPtr) {
+        songDrop();
+    }
+    if ((songData == null) || (songData == nextSongPtr)) {
+        return;
+    }
+    uint32 fsize = songSize(songData);
+    if ((fsize == 0) || !mxMemRoom(fsize)) {
+        dbg("preload: no room for %u bytes", fsize);
+        return;
+    }
+    if (songUnpack(songData, &nextSongData)) {
+        nextSongPtr = songData;
+    }
+}
+
 void jamOnInfo(jamSongInfo* songInfo) {
     dbg("jamOnInfo %x", songInfo);
     songInfo->isYMsong = 1;
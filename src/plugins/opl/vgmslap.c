@@ -36,7 +36,7 @@
 typedef unsigned char   uint8_t;
 typedef unsigned short  uint16_t;
 typedef unsigned long   uint32_t;
-typedef short           wchar_t;
+typedef short           wchar16_t;
 
 #define err_ok          0
 #define err_init        0xff
@@ -62,16 +62,13 @@ typedef short           wchar_t;
 ///////////////////////////////////////////////////////////////////////////////
 
 static inline uint16_t getUint16(void* ptr) {
-    uint16_t r = *((uint16_t*)ptr);
-    return ((r >> 8 ) | (r << 8));
+    const uint8_t* p = (const uint8_t*)ptr;
+    return p[0] | (p[1] << 8);
 }
 
 static inline uint32_t getUint32(void* ptr) {
-    uint32_t r = *((uint32_t*)ptr);
-    return  ((r & 0xff000000) >> 24) |
-            ((r & 0x00ff0000) >>  8) |
-            ((r & 0x0000ff00) <<  8) |
-            ((r & 0x000000ff) << 24);
+    const uint8_t* p = (const uint8_t*)ptr;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
 }
 
 
@@ -101,7 +98,7 @@ void resetTimer (void);
 
 // VGM parsing functions
 uint8_t getNextCommandData(void);
-wchar_t* getNextGd3String(void);
+wchar16_t* getNextGd3String(void);
 uint8_t loadVGM(uint8_t* buf);
 void populateCurrentGd3(void);
 void processCommands(void);
@@ -236,17 +233,17 @@ typedef struct
 typedef struct
 {
 	uint32_t tagLength;
-	wchar_t* trackNameE;
-	wchar_t* trackNameJ;
-	wchar_t* gameNameE;
-	wchar_t* gameNameJ;
-	wchar_t* systemNameE;
-	wchar_t* systemNameJ;
-	wchar_t* originalAuthorE;
-	wchar_t* originalAuthorJ;
-	wchar_t* releaseDate;
-	wchar_t* converter;
-	wchar_t* notes;
+	wchar16_t* trackNameE;
+	wchar16_t* trackNameJ;
+	wchar16_t* gameNameE;
+	wchar16_t* gameNameJ;
+	wchar16_t* systemNameE;
+	wchar16_t* systemNameJ;
+	wchar16_t* originalAuthorE;
+	wchar16_t* originalAuthorJ;
+	wchar16_t* releaseDate;
+	wchar16_t* converter;
+	wchar16_t* notes;
 } gd3Tag;
 
 // Individual OPL operator struct, which are nested in an OPL channel struct
@@ -356,8 +353,8 @@ static inline void endSong()
 void vgmslap_info(
     uint8_t*    chipType,
     uint32_t*   songLength,
-    wchar_t**   songName,
-    wchar_t**   songAuthor)
+    wchar16_t**   songName,
+    wchar16_t**   songAuthor)
 {
     if (chipType) {
         *chipType = vgmChipType;
@@ -464,24 +461,33 @@ uint8_t vgmslap_init(uint32 isa_base, uint16 opl_base)
 void timerHandler(void)
 {
     if (programState == prgstate_playing) {
-        tickCounter = tickCounter + playbackFrequencyDivider;
+        // dropped ticks are caught up by processCommands
+        MX_PROF_BEGIN(MX_PROF_PLAYER);
+        tickCounter = tickCounter + (playbackFrequencyDivider * (1 + mxTimerAMissed));
         //uint16 sr = jamDisableInterrupts();
         processCommands();
+        MX_PROF_END(MX_PROF_PLAYER);
     }
 }
 
+static int16 timerTask = -1;
+
 void initTimer(uint16_t frequency)
 {
     dbgprintf("inittimer");
+    // a scheduler task, the period is exact on average so the
+    // tick stepper needs no correction for the real rate
     uint32_t hz = playbackFrequency / playbackFrequencyDivider;
-    uint32_t hz_real = mxHookTimerA(timerHandler, hz);
+    if (timerTask < 0) {
+        timerTask = mxAddTimerTask(timerHandler, MX_TASK_PERIOD(hz), false);
+    }
     dbgprintf("inittimer done");
-    // todo: set tick stepper based on hz_real
 }
 
 void resetTimer(void)
 {
-    mxUnhookTimerA();
+    mxRemoveTimerTask(timerTask);
+    timerTask = -1;
 }
 
 
@@ -1587,12 +1593,12 @@ uint8_t getNextCommandData(void)
 
 // Extract the next null terminated string from the overall GD3 tag
 // This is adapted from the original VGMPlay's ReadWStrFromFile
-wchar_t* getNextGd3String(void)
+wchar16_t* getNextGd3String(void)
 {
 	uint32_t currentPosition;
 	uint32_t eofLocation;
-	wchar_t* text;
-	wchar_t* tempText;
+	wchar16_t* text;
+	wchar16_t* tempText;
 	uint32_t stringLength;
 	uint16_t grabbeduint8_tacter;
 	
@@ -1602,7 +1608,7 @@ wchar_t* getNextGd3String(void)
 	currentPosition = fileCursorLocation;
 	
 	// Allocate memory the same size as the entire GD3 tag.
-	text = (wchar_t*)malloc(currentGD3Tag.tagLength);
+	text = (wchar16_t*)malloc(currentGD3Tag.tagLength);
 	// If there is nothing in the tag, return nothing!  (Admittedly, you shouldn't end up here at all... but just in case!)
 	if (text == NULL)
 	{
@@ -1620,7 +1626,7 @@ wchar_t* getNextGd3String(void)
 		readBytes(2);
 		// Store what we just read, interpret it as a wide uint8_tacter
 		grabbeduint8_tacter = (uint16_t)vgmFileBuffer[0x00];
-		*tempText = (wchar_t)grabbeduint8_tacter;
+		*tempText = (wchar16_t)grabbeduint8_tacter;
 		// Move our position
 		currentPosition+=0x02;
 		// Add one uint8_tacter to the length of this string
@@ -1634,7 +1640,7 @@ wchar_t* getNextGd3String(void)
 	} while (*tempText != L'\0');
 	
 	// Now that we know how long the actual single string is, reallocate the memory to the smaller size.
-	text = (wchar_t *)realloc(text, stringLength * sizeof(wchar_t));
+	text = (wchar16_t *)realloc(text, stringLength * sizeof(wchar16_t));
 	// Send that resized allocation back.  That is the string.
 	return text;
 }
@@ -1642,7 +1648,7 @@ wchar_t* getNextGd3String(void)
 // Calls getNextGd3String to populate each GD3 tag value
 void populateCurrentGd3(void)
 {
-    static wchar_t emptyName[2] = {0, 0};
+    static wchar16_t emptyName[2] = {0, 0};
 
     // Fill in default values
     currentGD3Tag.tagLength = 0;
@@ -2,34 +2,25 @@
 #include <mint/cookie.h>
 #include "plugin.h"
 extern int mxTimerAVecLock();
+extern volatile uint32 mxTimerALost;
 
 // ------------------------------------------------------------------------------------------
-static int mfpParamsFromHz(int32 hz, uint16* ctrl, uint16* data) {
-    const uint32 dividers[8] = {1, 4, 10, 16, 50, 64, 100, 200};
-    const uint32 baseclk = 2457600;
-    int mindiff = 0xFFFFFF;
-    int result = hz;
-    *ctrl = 1; *data = 1;
-    for (int i=7; i!=0; i--) {
-        uint32 val0 = baseclk / dividers[i];
-        for (int j=1; j<256; j++) {
-            int val = val0 / j;
-            int diff = (hz > val) ? (hz - val) : (val - hz);
-            if (diff < mindiff) {
-                result = val;
-                mindiff = diff;
-                *ctrl = i;
-                *data = j;
-            }
-            if (val < hz) {
-                break;
-            }
-        }
-    }
-    return result;
-}
+// timer tasks sharing Timer A, see mxAddTimerTask
+typedef struct {
+    void(*func)(void);
+    uint32 period;
+    uint32 deadline;
+    uint32 runs;
+    uint32 cpu;
+} mxTimerTask;
+static mxTimerTask mxTasks[MX_TIMERTASKS];
+static uint32 mxTaskNow;
+static uint16 mxTaskCur;
+static uint16 mxTaskNext;
+static uint32 mxTaskTicks;
+static void mxTimerSchedule();
 
-uint32 mxHookTimerA(void(*func)(void), uint32 hz)
+static void mfpHookTimerA(void(*func)(void), uint16 ctrl, uint16 data)
 {
     mxUnhookTimerA();
     bool ie = mxDisableTimerA();
@@ -37,12 +28,15 @@ uint32 mxHookTimerA(void(*func)(void), uint32 hz)
     // todo: save all relevant mfp regs?
     mxTimerAOld = (uint32)Setexc(0x134>>2, -1);
     mxTimerAFunc = func;
-    uint16 ctrl, data;
-    uint32 real_hz = mfpParamsFromHz(hz, &ctrl, &data);
+    mxTimerASkips = 0;
+    mxTimerAMissed = 0;
+    mxTimerALost = 0;
+#ifdef MX_PROFILE
+    mxProfReset();
+#endif
     Xbtimer(XB_TIMERA, ctrl, data, mxTimerAVec);
     Jenabint(MFP_TIMERA);
     mxRestoreTimerA(ie);
-    return real_hz;
 }
 
 void mxUnhookTimerA()
@@ -53,6 +47,9 @@ void mxUnhookTimerA()
         (void)Setexc(0x134>>2, mxTimerAOld);
         mxTimerAFunc = 0;
         mxTimerAOld = 0;
+        for (int i=0; i<MX_TIMERTASKS; i++) {
+            mxTasks[i].func = null;
+        }
         mxRestoreTimerA(ie);
     }
 }
@@ -67,61 +64,224 @@ void mxRestoreTimerA(bool enable)
     mxTimerALock = enable ? 0 : 1;
 }
 
-uint32 mxChangeTimerA(uint32 hz)
+// ------------------------------------------------------------------------------------------
+// The task scheduler runs Timer A with prescaler 64 so one count is one
+// MX_TIMESTAMP_HZ unit. Deadlines are absolute in 1/256 units, each
+// interrupt programs the interval after the one already running to end at
+// the nearest deadline, at most 256 counts away. The data register is only
+// reloaded when the running interval expires which is why it is one ahead.
+static void mxTimerSchedule()
+{
+    // intervals the vector skipped while locked all had the pending length
+    uint32 ticks = mxTimerATicks;
+    uint32 n = ticks - mxTaskTicks;
+    mxTaskTicks = ticks;
+    mxTaskNow += ((uint32)mxTaskCur + ((n - 1) * mxTaskNext)) << 8;
+    mxTaskCur = mxTaskNext;
+
+    for (int i=0; i<MX_TIMERTASKS; i++) {
+        mxTimerTask* t = &mxTasks[i];
+        void(*func)(void) = t->func;
+        if ((func == null) || ((int32)(t->deadline - mxTaskNow) > 0)) {
+            continue;
+        }
+        // periods that passed without a call are handed over as missed
+        uint32 missed = 0;
+        if (t->period) {
+            t->deadline += t->period;
+            while ((int32)(t->deadline - mxTaskNow) <= 0) {
+                if (++missed == MX_TASK_CATCHUP) {
+                    t->deadline = mxTaskNow + t->period;
+                    break;
+                }
+                t->deadline += t->period;
+            }
+        } else {
+            t->func = null;
+        }
+        mxTimerAMissed = missed;
+#ifdef MX_PROFILE
+        uint32 t0 = mxTimestamp();
+        func();
+        t->cpu += mxTimestamp() - t0;
+#else
+        func();
+#endif
+        t->runs++;
+    }
+
+    uint32 end = mxTaskNow + ((uint32)mxTaskCur << 8);
+    int32 nearest = 256 << 8;
+    bool idle = true;
+    for (int i=0; i<MX_TIMERTASKS; i++) {
+        if (mxTasks[i].func != null) {
+            int32 d = (int32)(mxTasks[i].deadline - end);
+            nearest = (d < nearest) ? d : nearest;
+            idle = false;
+        }
+    }
+    if (idle) {
+        // the last task went away while the vector was locked,
+        // mxRemoveTimerTask left the unhook to us
+        mxUnhookTimerA();
+        return;
+    }
+    nearest = (nearest + 128) >> 8;
+    uint16 next = (nearest < 1) ? 1 : (nearest > 256) ? 256 : nearest;
+    if (next != mxTaskNext) {
+        mxTaskNext = next;
+        *((volatile unsigned char*)0xfffa1f) = (uint8)next;
+    }
+}
+
+static uint32 mxTaskTime()
+{
+    // scheduler time including the part of the running interval
+    uint16 cnt = *((volatile unsigned char*)0xfffa1f);
+    cnt = cnt ? cnt : 256;
+    return mxTaskNow + ((uint32)((cnt < mxTaskCur) ? (mxTaskCur - cnt) : 0) << 8);
+}
+
+int16 mxAddTimerTask(void(*func)(void), uint32 period, bool oneshot)
 {
-    // todo: can this be made platform independent and in a safe way?
-    // this function can and will be called from inside a triggered
-    // timer interrupt so special care would have to be taken.
-    // Hades and Raven has MFP in the usual location but I am unsure about Milan
-    // so we may need a special case for that machine here.
+    if ((func == null) || (period == 0)) {
+        return -1;
+    }
+    // hooked with the vector locked so the scheduler can not see itself
+    // idle before the task is in
+    bool ie = mxDisableTimerA();
+    if (mxTimerAFunc != mxTimerSchedule) {
+        mfpHookTimerA(mxTimerSchedule, 5, 0);
+        mxTaskNow = 0;
+        mxTaskCur = 256;
+        mxTaskNext = 256;
+        mxTaskTicks = mxTimerATicks;
+    }
+    int16 task = -1;
+    for (int i=0; i<MX_TIMERTASKS; i++) {
+        mxTimerTask* t = &mxTasks[i];
+        if (t->func == null) {
+            t->period = oneshot ? 0 : period;
+            t->deadline = mxTaskTime() + period;
+            t->runs = 0;
+            t->cpu = 0;
+            t->func = func;
+            task = i;
+            break;
+        }
+    }
+    mxRestoreTimerA(ie);
+    return task;
+}
+
+void mxSetTimerTaskPeriod(int16 task, uint32 period)
+{
+    if ((task < 0) || (task >= MX_TIMERTASKS) || (period == 0)) {
+        return;
+    }
+    bool ie = mxDisableTimerA();
+    mxTimerTask* t = &mxTasks[task];
+    if (t->period) {
+        // keep the phase of the running period
+        t->deadline += period - t->period;
+        t->period = period;
+    }
+    mxRestoreTimerA(ie);
+}
+
+void mxRemoveTimerTask(int16 task)
+{
+    if ((task < 0) || (task >= MX_TIMERTASKS)) {
+        return;
+    }
     bool ie = mxDisableTimerA();
-    uint16 ctrl, data;
-    uint32 real_hz = mfpParamsFromHz(hz, &ctrl, &data);
-    *((volatile unsigned char*)0xfffa19) = ctrl;
-    *((volatile unsigned char*)0xfffa1f) = data;
+    mxTasks[task].func = null;
+    bool idle = true;
+    for (int i=0; i<MX_TIMERTASKS; i++) {
+        idle = (mxTasks[i].func == null) ? idle : false;
+    }
     mxRestoreTimerA(ie);
-    return real_hz;
+    // from inside a task, or with the vector locked, the scheduler
+    // unhooks itself on its way out once it finds no tasks left
+    if (idle && ie && (mxTimerAFunc == mxTimerSchedule)) {
+        mxUnhookTimerA();
+    }
+}
+
+#ifdef MX_PROFILE
+uint32 mxTimerTaskUsage(int16 task, uint32* runs)
+{
+    if ((task < 0) || (task >= MX_TIMERTASKS)) {
+        return 0;
+    }
+    if (runs) {
+        *runs = mxTasks[task].runs;
+    }
+    return mxTasks[task].cpu;
 }
+#endif
+
 
 // ------------------------------------------------------------------------------------------
-static uint32 delayus_count = 0;
-void mxCalibrateDelay() {
-    uint32 tick_start = *((volatile uint32*)0x4ba);
-    uint32 tick_end = tick_start;
-    uint32 counter = 0;
-    do {
+static uint32 delay_lpu = 0;    // delay loops per timestamp unit, 24.8
+
+static inline void mxDelayLoop(uint32 loops) {
+    for (uint32 i=0; i<loops; i++) {
         __asm__ volatile ( "nop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\t" : : : );
         __asm__ volatile ( "nop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\t" : : : );
-        tick_end = *((volatile uint32*)0x4ba);
-        counter++;
-        if (counter > 1000000) {
-            delayus_count = 0xffffffff;
+    }
+}
+
+void mxCalibrateDelay() {
+    // time doubling loop counts against the mfp timestamp until a run takes
+    // 16 units, about 400us. the fastest of three runs is used so interrupts
+    // can only make the delays longer.
+    delay_lpu = 0xffffffff;
+    uint32 t0 = mxTimestamp();
+    for (uint32 i=0; mxTimestamp() == t0; i++) {
+        if (i > 100000) {
             return;
         }
-    } while ((tick_end - tick_start) <= 50);
-    delayus_count = counter;
+    }
+    for (uint32 n = 64; n < 0x800000; n <<= 1) {
+        uint32 best = 0xffffffff;
+        for (int k=0; k<3; k++) {
+            uint32 t = mxTimestamp();
+            mxDelayLoop(n);
+            t = mxTimestamp() - t;
+            best = (t < best) ? t : best;
+        }
+        if (best >= 16) {
+            delay_lpu = (n << 8) / (best - 1);
+            return;
+        }
+    }
 }
 
 void mxDelay(uint32 us)
 {
-    if (delayus_count == 0) {
+    if (delay_lpu == 0) {
         mxCalibrateDelay();
+    }
+
+    if (delay_lpu == 0xffffffff) {
+        // no timestamp, libcmini sleep resolution is 5ms
+        unsigned int msec = us / 1000;
+        msec = (msec > 5) ? msec : 5;
+        extern void delay(unsigned long milliseconds);
+        delay(msec);
         return;
     }
-    if ((us < 1000) && (delayus_count != 0xffffffff)) {
-        uint32 loops = 1 + ((4 * delayus_count * us) / (1000 * 1000));
-        for (uint32 i=0; i<=loops; i++) {
-            __asm__ volatile ( "nop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\t" : : : );
-            __asm__ volatile ( "nop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\tnop\n\t" : : : );
+
+    // 38400Hz units, rounded up plus one for the partial unit we start in
+    if (us >= 100) {
+        uint32 units = ((us * 24) + 624) / 625 + 1;
+        uint32 t = mxTimestamp();
+        while ((mxTimestamp() - t) < units) {
         }
         return;
     }
-
-    // libcmini sleep resolution if 5ms
-    unsigned int msec = us / 1000;
-    msec = (msec > 5) ? msec : 5;
-    extern void delay(unsigned long milliseconds);
-    delay(msec);
+    mxDelayLoop((((us * 24 * delay_lpu) / 625) >> 8) + 1);
 }
 
 
@@ -178,40 +338,88 @@ typedef struct
     isa_dev_t*      (*find_dev)(const char* id, unsigned short idx);
 } isa_t;
 
+#ifndef ISA_ENDIAN_BE
+#define ISA_ENDIAN_BE       0   /* big endian */
+#define ISA_ENDIAN_LEAS     1   /* little endian, address swizzled */
+#define ISA_ENDIAN_LELS     2   /* little endian, lane swizzled */
+#endif
+
 static isa_t* isa = 0;
 static uint32 isabase = 0;
-void(*outp)(uint16 port, uint8 data);
-void(*outpw)(uint16 port, uint16 data); 
-uint8(*inp)(uint16 port);
-uint16(*inpw)(uint16 port);
+uint32 mxIsaDirect = 0;
+bool mxIsaDirectSwap = false;
+void(*mxIsaOutp)(uint16 port, uint8 data);
+void(*mxIsaOutpw)(uint16 port, uint16 data);
+uint8(*mxIsaInp)(uint16 port);
+uint16(*mxIsaInpw)(uint16 port);
+void(*mxIsaOutpBuf)(uint16 port, const uint8* buf, int count);
+void(*mxIsaOutpwBuf)(uint16 port, const uint16* buf, int count);
 
 static void   outpb_null(uint16 port, uint8  data) {  }
 static void   outpw_null(uint16 port, uint16 data) {  }
 static uint8  inpb_null(uint16 port) { return 0xff;   }
 static uint16 inpw_null(uint16 port) { return 0xffff; }
+static void   outpb_buf_null(uint16 port, const uint8*  buf, int count) {  }
+static void   outpw_buf_null(uint16 port, const uint16* buf, int count) {  }
 
 static void   outpb_isa(uint16 port, uint8  data)   { *((volatile uint8*)(isabase+port)) = data; }
 static void   outpw_isa(uint16 port, uint16 data)   { *((volatile uint16*)(isabase+port)) = swap16(data); }
 static uint8  inpb_isa(uint16 port)                 { return *((volatile uint8*)(isabase+port)); }
 static uint16 inpw_isa(uint16 port)                 { return swap16(*((volatile uint16*)(isabase+port))); }
 
+static void outpb_buf_isa(uint16 port, const uint8* buf, int count) {
+    volatile uint8* p = (volatile uint8*)(isabase+port);
+    while (count--) { *p = *buf++; }
+}
+static void outpw_buf_isa(uint16 port, const uint16* buf, int count) {
+    volatile uint16* p = (volatile uint16*)(isabase+port);
+    while (count--) { *p = swap16(*buf++); }
+}
+
 static void   outpb_isabios(uint16 port, uint8  data)   { isa->outp(isa->iobase + port, data);  }
 static void   outpw_isabios(uint16 port, uint16 data)   { isa->outpw(isa->iobase + port, data); }
 static uint8  inpb_isabios(uint16 port)                 { return isa->inp(isa->iobase + port);  }
 static uint16 inpw_isabios(uint16 port)                 { return isa->inpw(isa->iobase + port); }
 
+static void outpb_buf_isabios(uint16 port, const uint8* buf, int count) {
+    if (isa->outp_buf) {
+        isa->outp_buf(isa->iobase + port, (unsigned char*)buf, count);
+    } else {
+        while (count--) { isa->outp(isa->iobase + port, *buf++); }
+    }
+}
+static void outpw_buf_isabios(uint16 port, const uint16* buf, int count) {
+    if (isa->outpw_buf) {
+        isa->outpw_buf(isa->iobase + port, (unsigned short*)buf, count);
+    } else {
+        while (count--) { isa->outpw(isa->iobase + port, *buf++); }
+    }
+}
+
 
 uint32 mxIsaInit() {
     isa = null;
     isabase = 0;
+    mxIsaDirect = 0;
+    mxIsaDirectSwap = false;
 
     // isa_bios
     if (Getcookie(C__ISA, (long*)&isa) == C_FOUND) {
         isabase = isa->iobase;
-        outp = outpb_isabios;
-        outpw = outpw_isabios;
-        inp = inpb_isabios;
-        inpw = inpw_isabios;
+        mxIsaOutp = outpb_isabios;
+        mxIsaOutpw = outpw_isabios;
+        mxIsaInp = inpb_isabios;
+        mxIsaInpw = inpw_isabios;
+        mxIsaOutpBuf = outpb_buf_isabios;
+        mxIsaOutpwBuf = outpw_buf_isabios;
+        // a memory mapped bus with plain byte addressing can be used directly,
+        // address swizzled ones stay with isa_bios
+        if (isabase && (isa->endian == ISA_ENDIAN_BE)) {
+            mxIsaDirect = isabase;
+        } else if (isabase && (isa->endian == ISA_ENDIAN_LELS)) {
+            mxIsaDirect = isabase;
+            mxIsaDirectSwap = true;
+        }
     }
 
     // guess when isa_bios is not available
@@ -234,15 +442,21 @@ uint32 mxIsaInit() {
         }
 
         if (isabase == 0) {
-            outp  = outpb_null;
-            outpw = outpw_null;
-            inp   = inpb_null;
-            inpw  = inpw_null;
+            mxIsaOutp  = outpb_null;
+            mxIsaOutpw = outpw_null;
+            mxIsaInp   = inpb_null;
+            mxIsaInpw  = inpw_null;
+            mxIsaOutpBuf  = outpb_buf_null;
+            mxIsaOutpwBuf = outpw_buf_null;
         } else {
-            outp  = isabase ? outpb_isa : outpb_null;
-            outpw = isabase ? outpw_isa : outpw_null;
-            inp   = isabase ? inpb_isa : inpb_null;
-            inpw  = isabase ? inpw_isa : inpw_null;
+            mxIsaOutp  = outpb_isa;
+            mxIsaOutpw = outpw_isa;
+            mxIsaInp   = inpb_isa;
+            mxIsaInpw  = inpw_isa;
+            mxIsaOutpBuf  = outpb_buf_isa;
+            mxIsaOutpwBuf = outpw_buf_isa;
+            mxIsaDirect = isabase;
+            mxIsaDirectSwap = true;
         }
     }
 
@@ -269,10 +483,57 @@ uint8 mxIsaIrq(const char* dev_id, uint8 dev_idx, uint8 irq_idx, uint8 fallback)
     return fallback;
 }
 
+static uint8  isairq = 0;
+static uint32 isairqold = 0;
+static void (*isairqfunc)(void) = 0;
+
 bool mxHookIsaInterrupt(void(*func)(void), uint16 inum) {
-    return false;
+    // the hardware side of isa interrupts is machine specific,
+    // only isa_bios knows how they are routed.
+    mxUnhookIsaInterrupt();
+    if (!isa || !isa->irq_set || !isa->irq_en || (inum > 15)) {
+        return false;
+    }
+    if (isa->irqmask && !(isa->irqmask & (1 << inum))) {
+        return false;
+    }
+    isairq = inum;
+    isairqfunc = func;
+    isairqold = isa->irq_set(isairq, (uint32)func);
+    isa->irq_en(isairq, 1);
+    return true;
 }
 
 void mxUnhookIsaInterrupt() {
+    if (isairqfunc != null) {
+        isa->irq_en(isairq, 0);
+        (void)isa->irq_set(isairq, isairqold);
+        if (isairqold) {
+            isa->irq_en(isairq, 1);
+        }
+        isairqfunc = 0;
+        isairqold = 0;
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+uint32 mxTimestamp() {
+    // MFP timer C runs the 200Hz system tick with prescaler 64 and data 192,
+    // its counter gives the position within the current tick at 38400Hz.
+    volatile uint32* hz200 = (volatile uint32*)0x4ba;
+    volatile uint8* tcdr = (volatile uint8*)0xfffa23;
+    volatile uint8* iprb = (volatile uint8*)0xfffa0d;
+    uint32 t0, t1;
+    uint8 c;
+    do {
+        t0 = *hz200;
+        c = *tcdr;
+        t1 = *hz200;
+    } while (t0 != t1);
+    if ((*iprb & 0x20) && (c > 96)) {
+        // reloaded but the tick is still pending, we are at a higher ipl
+        t0++;
+    }
+    return (t0 * 192) + (192 - c);
 }
 
@@ -39,10 +39,10 @@ extern void(*mxTimerAFunc)(void);
 extern volatile uint32 mxTimerATicks;
 extern volatile uint32 mxTimerALock;
 extern volatile uint32 mxTimerAOld;
+extern volatile uint32 mxTimerASkips;     // ticks dropped while locked, an overload metric
+extern volatile uint32 mxTimerAMissed;    // ticks dropped just before the current callback
 extern void mxTimerAVec();
 
-extern uint32   mxHookTimerA(void(*func)(void), uint32 hz);
-extern uint32   mxChangeTimerA(uint32 hz);
 extern void     mxUnhookTimerA();
 extern bool     mxDisableTimerA();
 extern void     mxRestoreTimerA(bool enable);
@@ -50,10 +50,61 @@ extern void     mxRestoreTimerA(bool enable);
 extern bool     mxHookIsaInterrupt(void(*func)(void), uint16 inum);
 extern void     mxUnhookIsaInterrupt();
 
+#define MX_TIMESTAMP_HZ     38400
+extern uint32   mxTimestamp();
+
+// Timer A shared by several tasks. Periods are in 1/256 MX_TIMESTAMP_HZ
+// units, one-shot tasks are removed after they ran. mxUnhookTimerA
+// removes them all.
+#define MX_TIMERTASKS       8
+#define MX_TASK_CATCHUP     64      // most missed periods counted, a longer stall restarts the phase
+#define MX_TASK_PERIOD(hz)  (((uint32)MX_TIMESTAMP_HZ << 8) / (hz))
+extern int16    mxAddTimerTask(void(*func)(void), uint32 period, bool oneshot);
+extern void     mxSetTimerTaskPeriod(int16 task, uint32 period);
+extern void     mxRemoveTimerTask(int16 task);
+
 extern void mxCalibrateDelay();
 extern void mxDelay(uint32 us);
 
+// Memory by use, see plugin_mem.c. Song and player data prefer TT-RAM /
+// fast ram, DMA buffers stay in ST-RAM.
+#define MX_MEM_SONG         0       // song data, patterns, command streams
+#define MX_MEM_PLAYER       1       // player state
+#define MX_MEM_DMA          2       // read by a DMA device
+#define MX_MEM_TYPES        3
+extern void*    mxAlloc(uint32 size, uint16 type);
+extern void     mxFree(void* ptr);
+extern bool     mxMemIsFast(const void* ptr);
+extern bool     mxMemRoom(uint32 size);                 // size fits and leaves a reserve, for optional loads
+extern const char* mxMemReport();
+
+// Interrupt profiler, build with OPTS += -DMX_PROFILE. The probes
+// compile to nothing otherwise, see plugin_prof.c
+#define MX_PROF_VEC         0       // Timer A vector, every callback
+#define MX_PROF_PLAYER      1       // player tick
+#define MX_PROF_DEVICE      2       // device tick
+#define MX_PROF_PROBES      3
+#ifdef MX_PROFILE
+extern void     mxProfReset();
+extern uint32   mxProfBegin();
+extern void     mxProfEnd(uint16 probe, uint32 t0);
+extern const char* mxProfReport(int16 probe);      // -1 for a one line summary
+extern uint32   mxTimerTaskUsage(int16 task, uint32* runs);    // cpu time in MX_TIMESTAMP_HZ units
+extern int      mxProfParamGet();
+#define MX_PROF_BEGIN(p)    uint32 mxprof_##p = mxProfBegin()
+#define MX_PROF_END(p)      mxProfEnd(p, mxprof_##p)
+#define MX_PROF_PARAMETER   { "Timer", MXP_PAR_TYPE_CHAR|MXP_FLG_INFOLINE, NULL, mxProfParamGet },
+#else
+#define MX_PROF_BEGIN(p)
+#define MX_PROF_END(p)
+#define MX_PROF_PARAMETER
+#endif
+
 // -----------------------------------------------------------------------
+#ifdef MX_HOST
+extern uint16 mxDisableInterrupts();
+extern void mxRestoreInterrupts(uint16 oldsr);
+#else
 static inline uint16 mxDisableInterrupts() {
     uint16 oldsr;
     __asm__ __volatile__(
@@ -71,20 +122,91 @@ static inline void mxRestoreInterrupts(uint16 oldsr) {
         " move.w    d0,sr\r\t"
     : : "d"(oldsr) : "d0", "cc" );
 }
+#endif
 
 // -----------------------------------------------------------------------
+// little endian to native, only a little endian host build gets away without
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+static inline uint16 swap16(uint16 le) { return le; }
+static inline uint32 swap32(uint32 le) { return le; }
+#else
 static inline uint16 swap16(uint16 le) { uint16 be = ((le & 0xFF00) >> 8) | ((le << 8) & 0xFF00); return be; }
 static inline uint32 swap32(uint32 le) { uint32 be = (((le & 0xff000000) >> 24) | ((le & 0x00ff0000) >>  8) | ((le & 0x0000ff00) <<  8) | ((le & 0x000000ff) << 24)); return be; }
+#endif
 
 // -----------------------------------------------------------------------
 extern uint32 mxIsaInit();
 extern uint16 mxIsaPort(const char* dev_id, uint8 dev_idx, uint8 port_idx, uint16 fallback);
 extern uint8  mxIsaIrq(const char* dev_id, uint8 dev_idx, uint8 irq_idx, uint8 fallback);
 
-extern void(*outp)(uint16 port, uint8 data);
-extern void(*outpw)(uint16 port, uint16 data);
-extern uint8(*inp)(uint16 port);
-extern uint16(*inpw)(uint16 port);
+// Port access goes through the function pointers set up by mxIsaInit.
+// With MX_ISA_INLINE the accessors are inlined instead and go straight to
+// the bus when it is memory mapped with a known byte order, mxIsaDirect.
+#ifndef MX_ISA_INLINE
+#define MX_ISA_INLINE       1
+#endif
+
+extern uint32 mxIsaDirect;
+extern bool   mxIsaDirectSwap;
+extern void(*mxIsaOutp)(uint16 port, uint8 data);
+extern void(*mxIsaOutpw)(uint16 port, uint16 data);
+extern uint8(*mxIsaInp)(uint16 port);
+extern uint16(*mxIsaInpw)(uint16 port);
+extern void(*mxIsaOutpBuf)(uint16 port, const uint8* buf, int count);      // count writes to one port
+extern void(*mxIsaOutpwBuf)(uint16 port, const uint16* buf, int count);
+
+#if MX_ISA_INLINE
+static inline void outp(uint16 port, uint8 data) {
+    if (mxIsaDirect) {
+        *((volatile uint8*)(mxIsaDirect + port)) = data;
+    } else {
+        mxIsaOutp(port, data);
+    }
+}
+static inline void outpw(uint16 port, uint16 data) {
+    if (mxIsaDirect) {
+        *((volatile uint16*)(mxIsaDirect + port)) = mxIsaDirectSwap ? swap16(data) : data;
+    } else {
+        mxIsaOutpw(port, data);
+    }
+}
+static inline uint8 inp(uint16 port) {
+    return mxIsaDirect ? *((volatile uint8*)(mxIsaDirect + port)) : mxIsaInp(port);
+}
+static inline uint16 inpw(uint16 port) {
+    if (mxIsaDirect) {
+        uint16 data = *((volatile uint16*)(mxIsaDirect + port));
+        return mxIsaDirectSwap ? swap16(data) : data;
+    }
+    return mxIsaInpw(port);
+}
+static inline void outp_buf(uint16 port, const uint8* buf, int count) {
+    if (mxIsaDirect) {
+        volatile uint8* p = (volatile uint8*)(mxIsaDirect + port);
+        while (count--) { *p = *buf++; }
+    } else {
+        mxIsaOutpBuf(port, buf, count);
+    }
+}
+static inline void outpw_buf(uint16 port, const uint16* buf, int count) {
+    if (mxIsaDirect && mxIsaDirectSwap) {
+        volatile uint16* p = (volatile uint16*)(mxIsaDirect + port);
+        while (count--) { *p = swap16(*buf++); }
+    } else if (mxIsaDirect) {
+        volatile uint16* p = (volatile uint16*)(mxIsaDirect + port);
+        while (count--) { *p = *buf++; }
+    } else {
+        mxIsaOutpwBuf(port, buf, count);
+    }
+}
+#else
+#define outp        mxIsaOutp
+#define outpw       mxIsaOutpw
+#define inp         mxIsaInp
+#define inpw        mxIsaInpw
+#define outp_buf    mxIsaOutpBuf
+#define outpw_buf   mxIsaOutpwBuf
+#endif
 
 // -----------------------------------------------------------------------
 #ifdef PLUGIN_MXP
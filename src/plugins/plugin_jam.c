@@ -35,6 +35,11 @@ extern uint32 jamHookNextSong;
 static uint8* songData = 0;
 static jamSongInfo* songInfo = 0;
 static bool ignoreLoad = true;
+static bool songPending = false;    // probed only, loaded on play
+static uint8* songPlaying = 0;      // songData of the song playing
+static uint8* preloadData = 0;      // next song announced while another one plays, loaded from JAM_UPDATE
+static bool preloadQueued = false;
+static bool nextSongAsked = false;  // next song hook raised, the following JAM_SONGINFO is that song
 
 extern void jamCallHookNextSong();
 extern void jamCallHookLog(char* msg);
@@ -49,6 +54,20 @@ void jamInitLib()
     songInfo = 0;
     jamLibInited = 1;
     ignoreLoad = true;
+    songPending = false;
+    songPlaying = 0;
+    preloadData = 0;
+    preloadQueued = false;
+    nextSongAsked = false;
+}
+
+static void preloadDrop()
+{
+    if (preloadData) {
+        jamOnPreload(0);
+        preloadData = 0;
+        preloadQueued = false;
+    }
 }
 
 //-------------------------------------------------------------
@@ -59,12 +78,13 @@ void jamSongFinished()
     // todo...
     if (jamHookNextSong) {
         *((volatile uint16*)jamHookNextSong) = 1;
+        nextSongAsked = true;
     }
 }
 
 void jamLog(jamLogType type, const char* msg, ...)
 {
-#ifdef DEBUG
+#if defined(DEBUG) || defined(MX_PROFILE)
     if (!jamLibInited)
         return;
 
@@ -139,12 +159,30 @@ uint32 jamMessageHandler(int32 param, int32 msg, void* data2, void* data1)
             // data2 is same as JAM_SONGSELECT:data1 (file content)
             dbg("JAM_SONGINFO: %08x %08x", data1, data2);
 #if 1            
+            // browsing a playlist sends this for every song, read the headers
+            // only and leave loading and the hardware to JAM_PLAY.
+            songInfo = (jamSongInfo*) data1;
+            songPending = false;
             if (data2) {
                 songData = (uint8*) data2;
-                jamOnLoad(songData);
+                if (preloadData != songData) {
+                    preloadDrop();
+                }
+                songPending = jamOnProbe(songData, songInfo);
+                if (songPending && nextSongAsked && songPlaying && (songPlaying != songData) && !preloadData) {
+                    // only the song Jam moves on to after the next song hook. songs
+                    // browsed in the playlist stay probed, as they are not played
+                    preloadData = songData;
+                    preloadQueued = true;
+                }
+                nextSongAsked = false;
+                if (!songPending) {
+                    jamOnLoad(songData);
+                }
+            }
+            if (!songPending) {
+                jamOnInfo(songInfo);
             }
-            songInfo = (jamSongInfo*) data1;
-            jamOnInfo(songInfo);
 #else            
             if (data1) {
                 songInfo = (jamSongInfo*) data1;
@@ -157,19 +195,31 @@ uint32 jamMessageHandler(int32 param, int32 msg, void* data2, void* data1)
         {
             dbg("JAM_PLAY: %08x %08x", songData, songInfo);
             if (songData && songInfo) {
+                if (songPending) {
+                    songPending = false;
+                    jamOnLoad(songData);
+                    jamOnInfo(songInfo);
+                }
+                preloadDrop();
+                nextSongAsked = false;
                 jamOnPlay();
+                songPlaying = songData;
             }
         } break;
 
           case JAM_STOP:
         {
             dbg("JAM_STOP");
+            songPlaying = 0;
             jamOnStop();
         } break;
 
           case JAM_DEACTIVATE:
         {
             dbg("JAM_DEACTIVATE");
+            preloadDrop();
+            nextSongAsked = false;
+            songPlaying = 0;
             jamOnPluginStop();
         } break;
 
@@ -197,6 +247,33 @@ uint32 jamMessageHandler(int32 param, int32 msg, void* data2, void* data1)
         case JAM_UPDATE:
         {
             jamOnUpdate();
+            if (preloadQueued) {
+                preloadQueued = false;
+                jamOnPreload(preloadData);
+            }
+#ifdef DEBUG
+            // timer overload, at most once a second
+            static uint32 lastSkips = 0;
+            static uint32 lastReport = 0;
+            uint32 now = mxTimestamp();
+            if ((mxTimerASkips != lastSkips) && ((now - lastReport) >= MX_TIMESTAMP_HZ)) {
+                jamLog(JAM_LOG_DEBUG, "timer: %ld ticks lost", (mxTimerASkips > lastSkips) ? (mxTimerASkips - lastSkips) : mxTimerASkips);
+                lastSkips = mxTimerASkips;
+                lastReport = now;
+            }
+#endif
+#ifdef MX_PROFILE
+            // interrupt cost every few seconds
+            static uint32 lastProfile = 0;
+            uint32 stamp = mxTimestamp();
+            if ((stamp - lastProfile) >= (MX_TIMESTAMP_HZ * 5)) {
+                lastProfile = stamp;
+                jamLog(JAM_LOG_DEBUG, "%s", mxProfReport(-1));
+                for (int i=0; i<MX_PROF_PROBES; i++) {
+                    jamLog(JAM_LOG_DEBUG, "%s", mxProfReport(i));
+                }
+            }
+#endif
         } break;
 
         default:
@@ -111,7 +111,9 @@ extern jamPluginInfo* jamOnPluginInfo();            // plugin info
 extern bool jamOnPluginStart();                     // plugin start
 extern void jamOnPluginStop();                      // plugin stop
 
-extern void jamOnLoad(uint8* songData);             // load song data
+extern bool jamOnProbe(uint8* songData, jamSongInfo* songInfo); // song info from headers, false when it needs a load
+extern void jamOnLoad(uint8* songData);             // load song data, takes over a preloaded song
+extern void jamOnPreload(uint8* songData);          // idle time load of the next song, runs once. null drops it
 extern void jamOnInfo(jamSongInfo* songInfo);       // load song info
 extern void jamOnPlay();                            // play song
 extern void jamOnStop();                            // stop song
@@ -0,0 +1,134 @@
+//-------------------------------------------------------------------------------------
+// Memory by use
+//
+// Blocks the cpu works on every tick ask Mxalloc for TT-RAM / fast ram
+// first, blocks a DMA device reads ask for ST-RAM only. Without Mxalloc,
+// or when it has nothing to give, the block comes from malloc like before.
+// Every block carries a small header so mxFree knows where it came from.
+//-------------------------------------------------------------------------------------
+#include <stdlib.h>
+#include <stdio.h>
+#include <mint/osbind.h>
+#include "plugin.h"
+
+#define MX_MEM_MAGIC        0x4D584D45      // 'MXME'
+#define MX_MEM_ALTRAM       0x01000000UL    // TT-RAM and fast ram start here
+#define MX_MEM_RESERVE      (256UL * 1024)  // left for the player and the os by mxMemRoom
+
+#define MXALLOC_ST          0               // ST-RAM only
+#define MXALLOC_PREFER_ALT  3               // TT-RAM if possible, else ST-RAM
+
+typedef struct {
+    uint32 magic;
+    uint32 size;
+    uint16 type;
+    uint16 gemdos;                          // Mxalloc block, Mfree it
+    uint32 pad;
+} mxMemHeader;
+
+typedef struct {
+    uint32 st;                              // bytes in ST-RAM now
+    uint32 alt;                             // bytes in TT-RAM / fast ram now
+    uint32 peak;
+} mxMemStats;
+
+static const uint16 mxMemModes[MX_MEM_TYPES] = { MXALLOC_PREFER_ALT, MXALLOC_PREFER_ALT, MXALLOC_ST };
+static const char* mxMemNames[MX_MEM_TYPES] = { "song", "player", "dma" };
+static mxMemStats mxMem[MX_MEM_TYPES];
+static int16 mxMemAlt = -1;                 // -1 unknown, 0 no Mxalloc or alternate ram, 1 Mxalloc with alternate ram
+static char mxMemBuf[128];
+
+static void mxMemProbe()
+{
+    // old gemdos has no Mxalloc and answers EINVFN, 0 means no alternate ram
+    long largest = Mxalloc(-1, 1);
+    mxMemAlt = (largest > 0) ? 1 : 0;
+}
+
+bool mxMemIsFast(const void* ptr)
+{
+    return ((uint32)ptr >= MX_MEM_ALTRAM) ? true : false;
+}
+
+void* mxAlloc(uint32 size, uint16 type)
+{
+    type = (type < MX_MEM_TYPES) ? type : MX_MEM_SONG;
+    if (mxMemAlt < 0) {
+        mxMemProbe();
+    }
+
+    // gemdos blocks only pay off with alternate ram, each one is a descriptor
+    mxMemHeader* h = null;
+    uint32 total = size + sizeof(mxMemHeader);
+    if (mxMemAlt > 0) {
+        long p = Mxalloc(total, mxMemModes[type]);
+        h = (p > 0) ? (mxMemHeader*)p : null;
+    }
+    bool gemdos = h ? true : false;
+    if (!h) {
+        h = malloc(total);
+        if (!h) {
+            return null;
+        }
+    }
+
+    h->magic = MX_MEM_MAGIC;
+    h->size = size;
+    h->type = type;
+    h->gemdos = gemdos;
+    mxMemStats* s = &mxMem[type];
+    if (mxMemIsFast(h)) {
+        s->alt += size;
+    } else {
+        s->st += size;
+    }
+    s->peak = ((s->st + s->alt) > s->peak) ? (s->st + s->alt) : s->peak;
+    return (void*)(h + 1);
+}
+
+void mxFree(void* ptr)
+{
+    if (ptr == null) {
+        return;
+    }
+    mxMemHeader* h = ((mxMemHeader*)ptr) - 1;
+    if (h->magic != MX_MEM_MAGIC) {
+        err("mxFree: %08x not from mxAlloc", (uint32)ptr);
+        return;
+    }
+    mxMemStats* s = &mxMem[h->type];
+    if (mxMemIsFast(h)) {
+        s->alt -= h->size;
+    } else {
+        s->st -= h->size;
+    }
+    h->magic = 0;
+    if (h->gemdos) {
+        Mfree(h);
+    } else {
+        free(h);
+    }
+}
+
+bool mxMemRoom(uint32 size)
+{
+    // largest free gemdos block, memory inside the malloc pool is not
+    // counted so this errs on the safe side
+    if (mxMemAlt < 0) {
+        mxMemProbe();
+    }
+    long largest = (mxMemAlt > 0) ? Mxalloc(-1, MXALLOC_PREFER_ALT) : Malloc(-1);
+    return ((largest > 0) && ((uint32)largest >= (size + MX_MEM_RESERVE))) ? true : false;
+}
+
+const char* mxMemReport()
+{
+    // kilobytes per type, ST-RAM + TT-RAM now and the peak of both
+    char* s = mxMemBuf;
+    s += sprintf(s, "st+tt");
+    for (int i=0; i<MX_MEM_TYPES; i++) {
+        s += sprintf(s, " %s %u+%uK (%uK)", mxMemNames[i],
+            (mxMem[i].st + 1023) >> 10, (mxMem[i].alt + 1023) >> 10, (mxMem[i].peak + 1023) >> 10);
+    }
+    return mxMemBuf;
+}
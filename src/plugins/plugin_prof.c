@@ -0,0 +1,130 @@
+//-------------------------------------------------------------------------------------
+// Interrupt profiler
+//
+// Built with -DMX_PROFILE only. Probes sample mxTimestamp on entry and exit,
+// durations are in MX_TIMESTAMP_HZ units so anything shorter than a unit
+// reads as 0 or 1 depending on where the counter was. The average over many
+// calls is still right.
+//-------------------------------------------------------------------------------------
+#ifdef MX_PROFILE
+
+#include "stdio.h"
+#include "string.h"
+#include "plugin.h"
+
+#define MX_PROF_BUCKETS     8       // 0, 1, 2-3, 4-7 .. 64+ units
+#define MX_PROF_RING        32      // most recent durations
+
+typedef struct {
+    uint32 calls;
+    uint32 total;
+    uint16 min;
+    uint16 max;
+    uint16 hist[MX_PROF_BUCKETS];
+    uint8  ring[MX_PROF_RING];
+    uint16 ringpos;
+} mxProfStats;
+
+static mxProfStats mxProf[MX_PROF_PROBES];
+static uint32 mxProfStart;
+static char mxProfBuf[192];
+static const char* mxProfNames[MX_PROF_PROBES] = { "vec", "ply", "dev" };
+
+void mxProfReset()
+{
+    memset(mxProf, 0, sizeof(mxProf));
+    for (int i=0; i<MX_PROF_PROBES; i++) {
+        mxProf[i].min = 0xffff;
+    }
+    mxProfStart = mxTimestamp();
+}
+
+uint32 mxProfBegin()
+{
+    return mxTimestamp();
+}
+
+void mxProfEnd(uint16 probe, uint32 t0)
+{
+    uint32 d = mxTimestamp() - t0;
+    mxProfStats* p = &mxProf[probe];
+    uint16 b = 0;
+    for (uint32 v = d; v && (b < (MX_PROF_BUCKETS - 1)); v >>= 1) {
+        b++;
+    }
+    d = (d > 0xffff) ? 0xffff : d;
+    p->calls++;
+    p->total += d;
+    p->min = (d < p->min) ? d : p->min;
+    p->max = (d > p->max) ? d : p->max;
+    p->hist[b]++;
+    p->ring[p->ringpos] = (d > 0xff) ? 0xff : d;
+    p->ringpos = (p->ringpos + 1) & (MX_PROF_RING - 1);
+}
+
+void mxProfVecEnd(uint32 t0)
+{
+    // called from mxTimerAVec with the stamp from mxProfBegin
+    mxProfEnd(MX_PROF_VEC, t0);
+}
+
+static inline uint32 mxProfMicros(uint32 units)
+{
+    return (units * 625) / 24;
+}
+
+const char* mxProfReport(int16 probe)
+{
+    if ((probe < 0) || (probe >= MX_PROF_PROBES)) {
+        // one line summary, share of cpu time spent in the vector since it was hooked
+        uint32 elapsed = mxTimestamp() - mxProfStart;
+        uint32 busy = mxProf[MX_PROF_VEC].total;
+        uint32 load = elapsed ? (busy / ((elapsed + 999) / 1000)) : 0;
+        char* s = mxProfBuf;
+        s += sprintf(s, "load %u.%u%%", load / 10, load % 10);
+        for (int i=0; i<MX_PROF_PROBES; i++) {
+            mxProfStats* p = &mxProf[i];
+            if (p->calls) {
+                s += sprintf(s, " %s %u/%uus", mxProfNames[i],
+                    mxProfMicros(p->total / p->calls), mxProfMicros(p->max));
+            }
+        }
+        // and the share of each timer task that ran
+        for (int i=0; i<MX_TIMERTASKS; i++) {
+            uint32 runs;
+            uint32 cpu = mxTimerTaskUsage(i, &runs);
+            if (runs) {
+                uint32 share = elapsed ? (cpu / ((elapsed + 999) / 1000)) : 0;
+                s += sprintf(s, " task%d %u.%u%%", i, share / 10, share % 10);
+            }
+        }
+        return mxProfBuf;
+    }
+
+    // one probe, min/avg/max, the recent max and the histogram
+    mxProfStats* p = &mxProf[probe];
+    uint16 recent = 0;
+    for (int i=0; i<MX_PROF_RING; i++) {
+        recent = (p->ring[i] > recent) ? p->ring[i] : recent;
+    }
+    char* s = mxProfBuf;
+    s += sprintf(s, "%s %u calls %u/%u/%uus last %uus |", mxProfNames[probe], p->calls,
+        p->calls ? mxProfMicros(p->min) : 0, p->calls ? mxProfMicros(p->total / p->calls) : 0,
+        mxProfMicros(p->max), mxProfMicros(recent));
+    for (int i=0; i<MX_PROF_BUCKETS; i++) {
+        s += sprintf(s, " %u", p->hist[i]);
+    }
+    return mxProfBuf;
+}
+
+#ifdef PLUGIN_MXP
+extern struct SAudioPlugin mx_plugin;
+
+int mxProfParamGet()
+{
+    mx_plugin.inBuffer.value = (long) mxProfReport(-1);
+    return MXP_OK;
+}
+#endif
+
+#endif // MX_PROFILE